@@ -28,6 +28,7 @@ PyAPI_FUNC(PyObject *) PyEval_CallMethod(PyObject *obj,
 
 PyAPI_FUNC(void) PyEval_SetProfile(Py_tracefunc, PyObject *);
 PyAPI_FUNC(void) PyEval_SetTrace(Py_tracefunc, PyObject *);
+PyAPI_FUNC(void) PyEval_SetOpcodeTrace(Py_tracefunc, PyObject *);
 
 struct _frame; /* Avoid including frameobject.h */
 
@@ -46,6 +47,7 @@ PyAPI_FUNC(int) Py_FlushLine(void);
 
 PyAPI_FUNC(int) Py_AddPendingCall(int (*func)(void *), void *arg);
 PyAPI_FUNC(int) Py_MakePendingCalls(void);
+PyAPI_FUNC(PyObject *) _Py_PendingCallStats(void);
 
 /* Protection against deeply nested recursive calls */
 PyAPI_FUNC(void) Py_SetRecursionLimit(int);
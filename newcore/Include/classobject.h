@@ -53,6 +53,8 @@ PyAPI_FUNC(PyObject *) PyMethod_Function(PyObject *);
 PyAPI_FUNC(PyObject *) PyMethod_Self(PyObject *);
 PyAPI_FUNC(PyObject *) PyMethod_Class(PyObject *);
 
+PyAPI_FUNC(int) PyMethod_ClearFreeList(void);
+
 /* Look up attribute with name (a string) on instance object pinst, using
  * only the instance and base class dicts.  If a descriptor is found in
  * a class dict, the descriptor is returned without calling it.
@@ -7,6 +7,55 @@
 extern "C" {
 #endif
 
+/* What ceval.c remembers about one LOAD_GLOBAL instruction: the object it
+   found, valid for as long as the globals and builtins keep the versions
+   they had then. */
+typedef struct {
+    PyObject *ptr;			/* borrowed reference */
+    Py_dictversion_t globals_ver;
+    Py_dictversion_t builtins_ver;
+} PyOpcache_LoadGlobal;
+
+/* What ceval.c remembers about one LOAD_ATTR or STORE_ATTR instruction:
+   the type of the last object it looked the name up on, and what the type
+   itself has under that name.  Valid for other instances of the type for
+   as long as it keeps the version tag it had then. */
+typedef struct {
+    PyTypeObject *type;			/* borrowed reference, or NULL */
+    PyObject *descr;			/* borrowed from the type, or NULL */
+    unsigned int version;		/* tp_version_tag of type */
+    int misses;				/* times the entry was filled */
+    Py_ssize_t dictoffset;		/* tp_dictoffset of type, >= 0 */
+    Py_ssize_t hint;			/* the name's slot in the last dict */
+} PyOpcache_Attr;
+
+/* What ceval.c remembers about one CALL_FUNCTION instruction passing
+   keyword arguments: the parameter each keyword binds to in the functions
+   whose parameters are named by `varnames`.  Both tuples are held, so
+   that the entry can be checked by identity; the code object is not, as
+   a function calling itself would then keep its code alive forever. */
+#define PyOpcache_CALL_MAXKW 8
+
+typedef struct {
+    PyObject *varnames;			/* co_varnames of the callee, or NULL */
+    PyObject *names;			/* the keywords of the last call */
+    int na;				/* positional arguments, with self */
+    int first_missing;			/* lowest parameter neither passed
+					   nor named */
+    int argcount;			/* co_argcount of the callee */
+    int misses;				/* times the entry was filled */
+    unsigned char slots[PyOpcache_CALL_MAXKW];	/* parameter of each
+						   keyword */
+} PyOpcache_Call;
+
+typedef struct {
+    union {
+	PyOpcache_LoadGlobal lg;
+	PyOpcache_Attr attr;
+	PyOpcache_Call call;
+    } u;
+} PyOpcache;
+
 /* Bytecode object */
 typedef struct {
     PyObject_HEAD
@@ -26,6 +75,12 @@ typedef struct {
     int co_firstlineno;		/* first source line number */
     PyObject *co_lnotab;	/* string (encoding addr<->lineno mapping) */
     void *co_zombieframe;     /* for optimization only (see frameobject.c) */
+    int co_zombieslot;		/* index in frameobject.c's zombiecodes */
+    /* The instruction caches; see _PyCode_InitOpcache() */
+    unsigned char *co_opcache_map;	/* 1 + index in co_opcache by offset */
+    PyOpcache *co_opcache;
+    int co_opcache_size;
+    int co_opcache_runs;	/* runs so far, up to _PyCode_OPCACHE_MIN_RUNS */
 } PyCodeObject;
 
 /* Masks for co_flags above */
@@ -69,6 +124,17 @@ PyAPI_FUNC(PyCodeObject *) PyCode_New(
         /* same as struct above */
 PyAPI_FUNC(int) PyCode_Addr2Line(PyCodeObject *, int);
 
+/* Copies of a code string with and without superinstructions; compile.c */
+PyAPI_FUNC(PyObject *) _PyCode_FuseInstructions(PyObject *);
+PyAPI_FUNC(PyObject *) _PyCode_UnfuseInstructions(PyObject *);
+
+/* Code gets its instruction caches after running this many times, each
+   backward jump counted as a run, so that code which runs only once does
+   not pay for them. */
+#define _PyCode_OPCACHE_MIN_RUNS 1024
+
+PyAPI_FUNC(int) _PyCode_InitOpcache(PyCodeObject *);
+
 /* for internal use only */
 #define _PyCode_GETCODEPTR(co, pp) \
 	((*(co)->co_code->ob_type->tp_as_buffer->bf_getreadbuffer) \
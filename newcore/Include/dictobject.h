@@ -15,78 +15,93 @@ extern "C" {
 */
 
 /*
-There are three kinds of slots in the table:
-
-1. Unused.  me_key == me_value == NULL
-   Does not hold an active (key, value) pair now and never did.  Unused can
-   transition to Active upon key insertion.  This is the only case in which
-   me_key is NULL, and is each slot's initial state.
-
-2. Active.  me_key != NULL and me_key != dummy and me_value != NULL
-   Holds an active (key, value) pair.  Active can transition to Dummy upon
-   key deletion.  This is the only case in which me_value != NULL.
-
-3. Dummy.  me_key == dummy and me_value == NULL
-   Previously held an active (key, value) pair, but that was deleted and an
-   active pair has not yet overwritten the slot.  Dummy can transition to
-   Active upon key insertion.  Dummy slots cannot be made Unused again
-   (cannot have me_key set to NULL), else the probe sequence in case of
-   collision would have no way to know they were once active.
-
-Note: .popitem() abuses the me_hash field of an Unused or Dummy slot to
-hold a search finger.  The me_hash field of Unused or Dummy slots has no
-meaning otherwise.
+The table is split in two.  The entries, (hash, key, value) triples, are kept
+densely in the order they were inserted; the hash table proper is an array of
+small integers, each the position of an entry.  A table with no more than 128
+slots uses one byte per slot, up to 32768 slots two bytes, and so on, so the
+hash table costs far less than the 1/3 of empty entries it used to hold.
+Iteration walks the dense entries, and so yields the keys in insertion order.
+
+There are three kinds of slots in the hash table:
+
+1. Empty.  DKIX_EMPTY
+   Does not point to an entry now and never did.  Empty can transition to
+   Active upon key insertion.  This is each slot's initial state.
+
+2. Active.  An index >= 0 into the entries
+   The entry holds an active (key, value) pair.  Active can transition to
+   Dummy upon key deletion.
+
+3. Dummy.  DKIX_DUMMY
+   Previously pointed to an active entry, which was deleted.  Dummy can
+   transition to Active upon key insertion.  Dummy slots cannot be made Empty
+   again, else the probe sequence in case of collision would have no way to
+   know they were once active.
+
+A deleted entry has me_key == me_value == NULL, and stays in place until the
+next resize squeezes it out.
+
+The hash table and the entries live together in a PyDictKeysObject, defined
+in dictobject.c.  The empty dicts all share one keys object, so an empty dict
+costs no more than the dict object itself.
+
+Most tables are combined: the values are in the entries, and the keys object
+belongs to the one dict.  The instance dicts of a heap type instead start out
+split: they share the type's keys object, whose entries hold only keys, and
+each keeps its values in an array of its own.  A split table holds exact
+strings only, never has an entry deleted, and has values for the first
+ma_used entries of the shared keys exactly; a dict that is to break those
+rules is given a combined table first.
 */
 
-/* PyDict_MINSIZE is the minimum size of a dictionary.  This many slots are
- * allocated directly in the dict object (in the ma_smalltable member).
- * It must be a power of 2, and at least 4.  8 allows dicts with no more
- * than 5 active entries to live in ma_smalltable (and so avoid an
- * additional malloc); instrumentation suggested this suffices for the
- * majority of dicts (consisting mostly of usually-small instance dicts and
- * usually-small dicts created to pass keyword arguments).
+/* PyDict_MINSIZE is the number of slots in the hash table of a dict's first
+ * keys object.  It must be a power of 2, and at least 4.  8 allows dicts
+ * with no more than 5 active entries in it, which instrumentation suggested
+ * suffices for the majority of dicts (consisting mostly of usually-small
+ * instance dicts and usually-small dicts created to pass keyword
+ * arguments).  Keys objects of this size are recycled through a free list.
  */
 #define PyDict_MINSIZE 8
 
 typedef struct {
 	/* Cached hash code of me_key.  Note that hash codes are C longs.
-	 * We have to use Py_ssize_t instead because dict_popitem() abuses
-	 * me_hash to hold a search finger.
+	 * Py_ssize_t is kept here so that the entries keep their layout.
 	 */
 	Py_ssize_t me_hash;
 	PyObject *me_key;
 	PyObject *me_value;
 } PyDictEntry;
 
-/*
-To ensure the lookup algorithm terminates, there must be at least one Unused
-slot (NULL key) in the table.
-The value ma_fill is the number of non-NULL keys (sum of Active and Dummy);
-ma_used is the number of non-NULL, non-dummy keys (== the number of non-NULL
-values == the number of Active items).
-To avoid slowing down lookups on a near-full table, we resize the table when
-it's two-thirds full.
-*/
+#ifdef HAVE_LONG_LONG
+typedef unsigned PY_LONG_LONG Py_dictversion_t;
+#else
+typedef unsigned long Py_dictversion_t;
+#endif
+
+typedef struct _dictkeysobject PyDictKeysObject;
+
 typedef struct _dictobject PyDictObject;
 struct _dictobject {
 	PyObject_HEAD
-	Py_ssize_t ma_fill;  /* # Active + # Dummy */
 	Py_ssize_t ma_used;  /* # Active */
 
-	/* The table contains ma_mask + 1 slots, and that's a power of 2.
-	 * We store the mask instead of the size because the mask is more
-	 * frequently needed.
+	/* A new value, from a counter shared by all dicts, whenever the
+	 * dict is created or an item is added, replaced or removed.  The
+	 * same version thus always means the same dict with the same
+	 * contents; ceval.c relies on it to cache global lookups.
 	 */
-	Py_ssize_t ma_mask;
+	Py_dictversion_t ma_version;
 
-	/* ma_table points to ma_smalltable for small tables, else to
-	 * additional malloc'ed memory.  ma_table is never NULL!  This rule
+	/* The hash table and the entries.  ma_keys is never NULL!  This rule
 	 * saves repeated runtime null-tests in the workhorse getitem and
 	 * setitem calls.
 	 */
-	PyDictEntry *ma_table;
-	PyDictEntry *(*ma_lookup)(PyDictObject *mp, PyObject *key, long hash);
-	PyDictEntry ma_smalltable[PyDict_MINSIZE];
+	PyDictKeysObject *ma_keys;
+
+	/* NULL for a combined table; for a split one, the values, with
+	 * ma_values[i] belonging to entry i of the shared keys.
+	 */
+	PyObject **ma_values;
 };
 
 PyAPI_DATA(PyTypeObject, PyDict_Type);
@@ -96,6 +111,11 @@ PyAPI_DATA(PyTypeObject, PyDict_Type);
 
 PyAPI_FUNC(PyObject *) PyDict_New(void);
 PyAPI_FUNC(PyObject *) PyDict_GetItem(PyObject *mp, PyObject *key);
+PyAPI_FUNC(PyObject *) _PyDict_GetItemHint(PyObject *mp, PyObject *key,
+					   Py_ssize_t *hint);
+PyAPI_FUNC(PyObject *) _PyDict_LoadGlobal(PyDictObject *globals,
+					  PyDictObject *builtins,
+					  PyObject *key);
 PyAPI_FUNC(int) PyDict_SetItem(PyObject *mp, PyObject *key, PyObject *item);
 PyAPI_FUNC(int) PyDict_DelItem(PyObject *mp, PyObject *key);
 PyAPI_FUNC(void) PyDict_Clear(PyObject *mp);
@@ -110,6 +130,14 @@ PyAPI_FUNC(Py_ssize_t) PyDict_Size(PyObject *mp);
 PyAPI_FUNC(PyObject *) PyDict_Copy(PyObject *mp);
 PyAPI_FUNC(int) PyDict_Contains(PyObject *mp, PyObject *key);
 PyAPI_FUNC(int) _PyDict_Contains(PyObject *mp, PyObject *key, long hash);
+PyAPI_FUNC(Py_ssize_t) _PyDict_TableSize(PyObject *mp);
+
+/* Instance dicts whose keys are shared with the type; see typeobject.c */
+PyAPI_FUNC(PyDictKeysObject *) _PyDict_NewKeysForClass(void);
+PyAPI_FUNC(void) _PyDictKeys_DecRef(PyDictKeysObject *keys);
+PyAPI_FUNC(PyObject *) _PyObjectDict_New(PyTypeObject *tp);
+PyAPI_FUNC(int) _PyObjectDict_SetItem(PyTypeObject *tp, PyObject **dictptr,
+				      PyObject *key, PyObject *value);
 
 /* PyDict_Update(mp, other) is equivalent to PyDict_Merge(mp, other, 1). */
 PyAPI_FUNC(int) PyDict_Update(PyObject *mp, PyObject *other);
@@ -136,6 +164,8 @@ PyAPI_FUNC(PyObject *) PyDict_GetItemString(PyObject *dp, const char *key);
 PyAPI_FUNC(int) PyDict_SetItemString(PyObject *dp, const char *key, PyObject *item);
 PyAPI_FUNC(int) PyDict_DelItemString(PyObject *dp, const char *key);
 
+PyAPI_FUNC(int) PyDict_ClearFreeList(void);
+
 #ifdef __cplusplus
 }
 #endif
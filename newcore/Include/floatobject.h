@@ -93,6 +93,8 @@ PyAPI_FUNC(int) _PyFloat_Pack8(double x, unsigned char *p, int le);
 PyAPI_FUNC(double) _PyFloat_Unpack4(const unsigned char *p, int le);
 PyAPI_FUNC(double) _PyFloat_Unpack8(const unsigned char *p, int le);
 
+PyAPI_FUNC(int) PyFloat_ClearFreeList(void);
+
 
 #ifdef __cplusplus
 }
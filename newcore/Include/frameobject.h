@@ -75,6 +75,11 @@ PyAPI_FUNC(PyObject **) PyFrame_ExtendStack(PyFrameObject *, int, int);
 PyAPI_FUNC(void) PyFrame_LocalsToFast(PyFrameObject *, int);
 PyAPI_FUNC(void) PyFrame_FastToLocals(PyFrameObject *);
 
+PyAPI_FUNC(int) PyFrame_ClearFreeList(void);
+
+/* Used by code objects when they are deallocated */
+PyAPI_FUNC(void) _PyFrame_DelZombies(PyCodeObject *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,6 +46,8 @@ PyAPI_FUNC(unsigned PY_LONG_LONG) PyInt_AsUnsignedLongLongMask(PyObject *);
 
 PyAPI_FUNC(long) PyInt_GetMax(void);
 
+PyAPI_FUNC(int) PyInt_ClearFreeList(void);
+
 /* Macro, trading safety for speed */
 #define PyInt_AS_LONG(op) (((PyIntObject *)(op))->ob_ival)
 
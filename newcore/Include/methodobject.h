@@ -33,6 +33,7 @@ PyAPI_FUNC(int) PyCFunction_GetFlags(PyObject *);
 #define PyCFunction_GET_FLAGS(func) \
 	(((PyCFunctionObject *)func) -> m_ml -> ml_flags)
 PyAPI_FUNC(PyObject *) PyCFunction_Call(PyObject *, PyObject *, PyObject *);
+PyAPI_FUNC(int) PyCFunction_ClearFreeList(void);
 
 struct PyMethodDef {
     const char	*ml_name;	/* The name of the built-in function/method */
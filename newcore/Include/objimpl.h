@@ -98,6 +98,10 @@ PyAPI_FUNC(void *) PyObject_Malloc(size_t);
 PyAPI_FUNC(void *) PyObject_Realloc(void *, size_t);
 PyAPI_FUNC(void) PyObject_Free(void *);
 
+/* Hand empty pymalloc arenas back to the system; see obmalloc.c. */
+PyAPI_FUNC(size_t) _PyObject_TrimArenas(int keep);
+PyAPI_FUNC(int) _PyObject_SetSpareArenas(int n);
+
 
 /* Macros */
 #ifdef WITH_PYMALLOC
@@ -140,6 +140,16 @@ extern "C" {
 /* Support for opargs more than 16 bits long */
 #define EXTENDED_ARG  143
 
+/* Superinstructions: the compiler puts these in place of the first
+   instruction of a pair, keeping its argument.  The second instruction
+   follows unchanged.  They never appear in marshalled code. */
+#define LOAD_FAST__LOAD_FAST		144
+#define LOAD_FAST__LOAD_ATTR		145
+#define LOAD_FAST__LOAD_CONST		146
+#define STORE_FAST__LOAD_FAST		147
+#define LOAD_CONST__RETURN_VALUE	148
+#define COMPARE_OP__JUMP_IF_FALSE	149	/* followed by POP_TOP too */
+
 
 enum cmp_op {PyCmp_LT=Py_LT, PyCmp_LE=Py_LE, PyCmp_EQ=Py_EQ, PyCmp_NE=Py_NE, PyCmp_GT=Py_GT, PyCmp_GE=Py_GE,
 	     PyCmp_IN, PyCmp_NOT_IN, PyCmp_IS, PyCmp_IS_NOT, PyCmp_EXC_MATCH, PyCmp_BAD};
@@ -120,6 +120,39 @@ PyAPI_FUNC(void) PyMem_Free(void *);
 #define PyMem_Del		PyMem_Free
 #define PyMem_DEL		PyMem_FREE
 
+/*
+ * Releasing caches under memory pressure
+ * ======================================
+ *
+ * PyMem_ReleaseCaches(level) gives back memory the interpreter keeps only
+ * to run faster, and returns the number of objects and cache entries it
+ * released.  The levels are cumulative:
+ *
+ * PyMem_RELEASE_FREELISTS	the free lists of ints, floats, tuples,
+ *				frames, lists, dicts and methods, and the
+ *				empty arenas of the object allocator.  Also
+ *				done by the object allocator itself before
+ *				it gives up on a request.
+ * PyMem_RELEASE_CACHES		caches that are rebuilt on demand: linecache,
+ *				the importer caches, the interned strings
+ *				table.
+ * PyMem_RELEASE_ALL		a full garbage collection first.
+ *
+ * Other subsystems add their own caches with PyMem_RegisterCache().  The
+ * function is called with the GIL held and returns how many entries it
+ * freed.  Functions registered at PyMem_RELEASE_FREELISTS may run in the
+ * middle of an allocation, so they must only free memory: no Python code,
+ * no decref of objects that may still be in use.
+ */
+#define PyMem_RELEASE_FREELISTS	1
+#define PyMem_RELEASE_CACHES	2
+#define PyMem_RELEASE_ALL	3
+
+typedef int (*PyMem_CacheReleaser)(void);
+
+PyAPI_FUNC(int) PyMem_RegisterCache(int level, PyMem_CacheReleaser func);
+PyAPI_FUNC(Py_ssize_t) PyMem_ReleaseCaches(int level);
+
 #ifdef __cplusplus
 }
 #endif
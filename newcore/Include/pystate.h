@@ -52,6 +52,7 @@ typedef int (*Py_tracefunc)(PyObject *, struct _frame *, int, PyObject *);
 #define PyTrace_C_CALL 4
 #define PyTrace_C_EXCEPTION 5
 #define PyTrace_C_RETURN 6
+#define PyTrace_OPCODE 7	/* see PyEval_SetOpcodeTrace() */
 
 typedef struct _ts {
     /* See Python/ceval.c for comments explaining most fields */
@@ -95,6 +96,12 @@ typedef struct _ts {
     PyObject *async_exc; /* Asynchronous exception to raise */
     long thread_id; /* Thread id where this tstate was created */
 
+    /* Small block cache of obmalloc, see PYMALLOC_THREAD_CACHE */
+    struct _obmalloc_thread_cache *obmalloc_cache;
+
+    /* The trace function wants PyTrace_OPCODE instead of PyTrace_LINE */
+    int c_traceopcodes;
+
     /* XXX signal handlers should also be here */
 
 } PyThreadState;
@@ -115,6 +122,7 @@ PyAPI_FUNC(PyThreadState *) PyThreadState_Get(void);
 PyAPI_FUNC(PyThreadState *) PyThreadState_Swap(PyThreadState *);
 PyAPI_FUNC(PyObject *) PyThreadState_GetDict(void);
 PyAPI_FUNC(int) PyThreadState_SetAsyncExc(long, PyObject *);
+PyAPI_FUNC(void) _PyObject_ClearThreadCache(PyThreadState *);
 
 
 /* Variable and macro for in-line access to current thread state */
@@ -30,6 +30,20 @@ PyAPI_FUNC(void) PyThread_release_lock(PyThread_type_lock);
 PyAPI_FUNC(size_t) PyThread_get_stacksize(void);
 PyAPI_FUNC(int) PyThread_set_stacksize(size_t);
 
+/* The interpreter lock.  A thread that has waited for it longer than the
+   switch interval (in microseconds), or that comes back from a blocking
+   call (blocked is nonzero), asks for it: PyThread_gil_requested() then
+   returns true, *ticker is set to 0 so that the eval loop notices soon,
+   and the next release waits until the thread that asked has the lock. */
+typedef void *PyThread_type_gil;
+
+PyAPI_FUNC(PyThread_type_gil) PyThread_allocate_gil(volatile int *ticker);
+PyAPI_FUNC(void) PyThread_acquire_gil(PyThread_type_gil, int blocked);
+PyAPI_FUNC(void) PyThread_release_gil(PyThread_type_gil);
+PyAPI_FUNC(int) PyThread_gil_requested(PyThread_type_gil);
+PyAPI_FUNC(long) PyThread_get_switch_interval(void);
+PyAPI_FUNC(void) PyThread_set_switch_interval(long);
+
 #ifndef NO_EXIT_PROG
 PyAPI_FUNC(void) PyThread_exit_prog(int);
 PyAPI_FUNC(void) PyThread__PyThread_exit_prog(int);
@@ -69,6 +69,8 @@ def disassemble(co, lasti=-1):
     while i < n:
         c = code[i]
         op = ord(c)
+        # Show fused instructions as the ones the compiler wrote
+        op = superinstructions.get(op, op)
         if i in linestarts:
             if i > 0:
                 print
@@ -114,6 +116,7 @@ def disassemble_string(code, lasti=-1, varnames=None, names=None,
     while i < n:
         c = code[i]
         op = ord(c)
+        op = superinstructions.get(op, op)
         if i == lasti: print '-->',
         else: print '   ',
         if i in labels: print '>>',
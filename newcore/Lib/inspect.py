@@ -692,7 +692,7 @@ def getargs(co):
                 op = ord(co.co_code[step])
                 step = step + 1
                 if op >= dis.HAVE_ARGUMENT:
-                    opname = dis.opname[op]
+                    opname = dis.opname[dis.superinstructions.get(op, op)]
                     value = ord(co.co_code[step]) + ord(co.co_code[step+1])*256
                     step = step + 2
                     if opname in ('UNPACK_TUPLE', 'UNPACK_SEQUENCE'):
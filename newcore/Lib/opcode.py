@@ -6,7 +6,7 @@ operate on bytecodes (e.g. peephole optimizers).
 
 __all__ = ["cmp_op", "hasconst", "hasname", "hasjrel", "hasjabs",
            "haslocal", "hascompare", "hasfree", "opname", "opmap",
-           "HAVE_ARGUMENT", "EXTENDED_ARG"]
+           "HAVE_ARGUMENT", "EXTENDED_ARG", "superinstructions"]
 
 cmp_op = ('<', '<=', '==', '!=', '>', '>=', 'in', 'not in', 'is',
         'is not', 'exception match', 'BAD')
@@ -182,4 +182,24 @@ def_op('CALL_FUNCTION_VAR_KW', 142)  # #args + (#kwargs << 8)
 def_op('EXTENDED_ARG', 143)
 EXTENDED_ARG = 143
 
-del def_op, name_op, jrel_op, jabs_op
+# Superinstructions replace the first instruction of a pair, keeping its
+# argument, and the second instruction follows unchanged.  Each maps to the
+# instruction it replaced.
+superinstructions = {}
+
+def super_op(name, op, first):
+    first = opmap[first]
+    def_op(name, op)
+    superinstructions[op] = first
+    for table in hasconst, hasname, hasjrel, hasjabs, haslocal, hascompare:
+        if first in table:
+            table.append(op)
+
+super_op('LOAD_FAST__LOAD_FAST', 144, 'LOAD_FAST')
+super_op('LOAD_FAST__LOAD_ATTR', 145, 'LOAD_FAST')
+super_op('LOAD_FAST__LOAD_CONST', 146, 'LOAD_FAST')
+super_op('STORE_FAST__LOAD_FAST', 147, 'STORE_FAST')
+super_op('LOAD_CONST__RETURN_VALUE', 148, 'LOAD_CONST')
+super_op('COMPARE_OP__JUMP_IF_FALSE', 149, 'COMPARE_OP')  # and POP_TOP
+
+del def_op, name_op, jrel_op, jabs_op, super_op
@@ -0,0 +1,205 @@
+#! /usr/bin/env python
+
+"""Instruction level profiler.
+
+Counts, and times, every bytecode instruction the interpreter runs while
+the profiler is on, and reports the source lines and the opcodes that
+took the most time.  It needs no special build of the interpreter, unlike
+sys.getdxp(), and it sees inside functions, unlike cProfile.
+
+    import opprofile
+    opprofile.start()
+    ...
+    opprofile.stop()
+    opprofile.print_stats()
+
+or from the command line:
+
+    python -m opprofile [-n lines] [-s time|count] [-c] [-o file] script [arg] ...
+
+Only the thread that called start() is profiled.  Each instruction goes
+through the profiler, so the program runs a few times slower; the times
+are for comparing lines with each other.  start(timing=False), or -c,
+only counts the instructions, which is faster.
+"""
+
+import sys, dis, opcode, linecache
+from bisect import bisect_right
+import _opprofile
+
+__all__ = ["start", "stop", "clear", "is_enabled", "getstats", "lines",
+           "opcodes", "print_stats", "run", "runctx", "runcall"]
+
+start = _opprofile.enable
+stop = _opprofile.disable
+clear = _opprofile.clear
+is_enabled = _opprofile.is_enabled
+getstats = _opprofile.getstats
+
+def _lineno(code, offset, cache):
+    try:
+        offsets, linenos = cache[code]
+    except KeyError:
+        starts = list(dis.findlinestarts(code))
+        offsets = [start for start, lineno in starts]
+        linenos = [lineno for start, lineno in starts]
+        cache[code] = offsets, linenos
+    i = bisect_right(offsets, offset) - 1
+    if i < 0:
+        return code.co_firstlineno
+    return linenos[i]
+
+def _sorted(totals, sort):
+    if sort == 'count':
+        key = lambda item: (item[1], item[0])
+    elif sort == 'time':
+        key = lambda item: (item[0], item[1])
+    else:
+        raise ValueError("sort must be 'time' or 'count', not %r" % (sort,))
+    result = totals.values()
+    result.sort(key=key, reverse=True)
+    return result
+
+def lines(sort='time'):
+    """Return (seconds, count, filename, lineno, function) for every line
+    that ran, the slowest first, or the most run with sort='count'."""
+    totals = {}
+    cache = {}
+    for code, offset, count, seconds in getstats():
+        lineno = _lineno(code, offset, cache)
+        key = (code.co_filename, lineno, code.co_name)
+        try:
+            entry = totals[key]
+        except KeyError:
+            totals[key] = [seconds, count] + list(key)
+        else:
+            entry[0] += seconds
+            entry[1] += count
+    return map(tuple, _sorted(totals, sort))
+
+def opcodes(sort='time'):
+    """Return (seconds, count, opname) for every opcode that ran, the
+    slowest first, or the most run with sort='count'."""
+    totals = {}
+    for code, offset, count, seconds in getstats():
+        op = ord(code.co_code[offset])
+        op = opcode.superinstructions.get(op, op)
+        try:
+            entry = totals[op]
+        except KeyError:
+            totals[op] = [seconds, count, opcode.opname[op]]
+        else:
+            entry[0] += seconds
+            entry[1] += count
+    return map(tuple, _sorted(totals, sort))
+
+def _print_table(rows, limit, file, heading, show_source):
+    total_time = sum([row[0] for row in rows])
+    total_count = sum([row[1] for row in rows])
+    print >> file, '%10s %6s %12s  %s' % ('seconds', '%', 'count', heading)
+    for row in rows[:limit]:
+        seconds, count = row[:2]
+        if total_time:
+            share = 100.0 * seconds / total_time
+        else:
+            share = 100.0 * count / total_count
+        if show_source:
+            filename, lineno, name = row[2:]
+            where = '%s:%d(%s)' % (filename, lineno, name)
+        else:
+            where = row[2]
+        print >> file, '%10.6f %6.2f %12d  %s' % (seconds, share, count,
+                                                  where)
+        if show_source:
+            source = linecache.getline(filename, lineno).strip()
+            if source:
+                print >> file, '%30s  %s' % ('', source)
+
+def print_stats(limit=20, sort='time', file=None):
+    """Print the limit hottest lines and opcodes, by time or count."""
+    if file is None:
+        file = sys.stdout
+    rows = lines(sort)
+    total_time = sum([row[0] for row in rows])
+    total_count = sum([row[1] for row in rows])
+    print >> file, '%d instructions in %.6f seconds (%s)' % (
+        total_count, total_time, _opprofile.timer)
+    print >> file
+    _print_table(rows, limit, file, 'line', True)
+    print >> file
+    _print_table(opcodes(sort), limit, file, 'opcode', False)
+
+def runctx(statement, globals, locals, limit=20, sort='time', timing=True):
+    """Profile the statement from scratch and print the results."""
+    clear()
+    start(timing)
+    try:
+        exec statement in globals, locals
+    finally:
+        stop()
+        print_stats(limit, sort)
+
+def run(statement, limit=20, sort='time', timing=True):
+    """Like runctx(), in the namespace of __main__."""
+    import __main__
+    dict = __main__.__dict__
+    runctx(statement, dict, dict, limit, sort, timing)
+
+def runcall(func, *args, **kw):
+    """Call func under the profiler, adding to the results so far, and
+    return what it returns."""
+    start()
+    try:
+        return func(*args, **kw)
+    finally:
+        stop()
+
+def main():
+    import os
+    from optparse import OptionParser
+    usage = ("opprofile.py [-n lines] [-s time|count] [-c] [-o file] "
+             "scriptfile [arg] ...")
+    parser = OptionParser(usage=usage)
+    parser.allow_interspersed_args = False
+    parser.add_option('-n', '--lines', dest="limit", type="int",
+        help="Print this many lines and opcodes", default=20)
+    parser.add_option('-s', '--sort', dest="sort",
+        help="Sort by 'time' or 'count'", default='time')
+    parser.add_option('-c', '--count', dest="timing", action="store_false",
+        help="Only count the instructions", default=True)
+    parser.add_option('-o', '--outfile', dest="outfile",
+        help="Write the results to <outfile>", default=None)
+
+    if not sys.argv[1:]:
+        parser.print_usage()
+        sys.exit(2)
+
+    (options, args) = parser.parse_args()
+    sys.argv[:] = args
+    if not args:
+        parser.print_usage()
+        sys.exit(2)
+
+    sys.path.insert(0, os.path.dirname(sys.argv[0]))
+    import __main__
+    globs = __main__.__dict__
+    clear()
+    start(options.timing)
+    try:
+        try:
+            execfile(sys.argv[0], globs, globs)
+        except SystemExit:
+            pass
+    finally:
+        stop()
+        if options.outfile is not None:
+            f = open(options.outfile, 'w')
+            try:
+                print_stats(options.limit, options.sort, f)
+            finally:
+                f.close()
+        else:
+            print_stats(options.limit, options.sort)
+
+if __name__ == '__main__':
+    main()
@@ -1209,3 +1209,64 @@ class MixinStrUnicodeTest:
 
         else:
             self.fail("unexpected type for MixinStrUnicodeTest %r" % t)
+
+    def test_find_long(self):
+        # Haystacks long enough for the searches to take their
+        # word-at-a-time and two-way paths, checked against slicing
+        def naive(s, sub, reverse=False):
+            positions = range(len(s) - len(sub) + 1)
+            if reverse:
+                positions.reverse()
+            for i in positions:
+                if s[i:i+len(sub)] == sub:
+                    return i
+            return -1
+
+        cases = [
+            ('a' * 5000, 'a' * 49 + 'b' + 'a' * 50),
+            ('a' * 5000 + 'b' + 'a' * 100, 'a' * 49 + 'b' + 'a' * 50),
+            ('a' * 5000 + 'b' + 'a' * 100, 'a' * 50 + 'b' + 'a' * 50),
+            ('ab' * 3000, 'ab' * 30 + 'b'),
+            ('ab' * 3000 + 'b', 'ab' * 30 + 'b'),
+            ('abc' * 2000 + 'abd', 'abcabcabd'),
+            ('xyz' * 1000 + 'x', 'xx'),
+            ('line %d of the log\n' * 3, 'e 2'),
+        ]
+        for s, sub in cases:
+            s, sub = self.fixtype(s), self.fixtype(sub)
+            self.assertEqual(s.find(sub), naive(s, sub))
+            self.assertEqual(s.rfind(sub), naive(s, sub, True))
+            pos = naive(s, sub)
+            for cut in (0, 1, 7, len(s) // 2, len(s) - len(sub)):
+                self.assertEqual(s.find(sub, cut),
+                                 naive(s[cut:], sub) + cut
+                                 if naive(s[cut:], sub) >= 0 else -1)
+                self.assertEqual(s[:len(s) - cut].find(sub),
+                                 naive(s[:len(s) - cut], sub))
+
+        # the log format repeats, so find a line by more than one field
+        log = ''.join(['2008-01-%02d %s worker-%d GET /item?id=%d 200\n' %
+                       (i % 31 + 1, ('INFO', 'WARN', 'INFO')[i % 3],
+                        i % 7, i * 37 % 1009) for i in range(500)])
+        log = self.fixtype(log)
+        for sub in ['WARN', 'id=1008 ', 'worker-6 GET /item?id=3',
+                    'GET', '\n2', 'INFO worker-0', 'id=9999', 'ERROR']:
+            sub = self.fixtype(sub)
+            self.assertEqual(log.find(sub), naive(log, sub))
+            self.assertEqual(log.rfind(sub), naive(log, sub, True))
+            self.assertEqual(log.count(sub), len(log.split(sub)) - 1)
+
+        # count and replace do not let matches overlap
+        self.checkequal(2500, 'a' * 5000, 'count', 'aa')
+        self.checkequal(1666, 'a' * 5000, 'count', 'aaa')
+        self.checkequal(0, 'a' * 5000, 'count', 'a' * 40 + 'b')
+        self.checkequal(3000, 'ab' * 3000, 'count', 'ab')
+        self.checkequal(2, 'a' * 4000 + 'b' + 'a' * 4000 + 'b', 'count',
+                        'a' * 50 + 'b')
+        self.checkequal('b' * 2500, 'a' * 5000, 'replace', 'aa', 'b')
+        self.checkequal(('a' * 4000, 'a' * 50 + 'b', 'a' * 10),
+                        'a' * 4050 + 'b' + 'a' * 10, 'partition',
+                        'a' * 50 + 'b')
+        self.checkequal(('a' * 10 + 'b', 'b' + 'a' * 50, ''),
+                        'a' * 10 + 'bb' + 'a' * 50, 'rpartition',
+                        'b' + 'a' * 50)
@@ -4302,6 +4302,51 @@ def test_assign_slice():
     c[1:2] = 3
     vereq(c.value, 3)
 
+def test_type_cache():
+    if verbose: print "Testing the type attribute cache..."
+    class A(object):
+        def m(self): return 1
+    class B(A):
+        pass
+    class C(object):
+        def m(self): return 3
+    b = B()
+    for i in range(100):
+        vereq(b.m(), 1)
+    hits, misses = sys._type_cache_stats()
+    b.m()
+    verify(sys._type_cache_stats()[0] > hits)
+    # assigning to the base is seen through the subclass
+    A.m = lambda self: 2
+    vereq(b.m(), 2)
+    del A.m
+    try:
+        b.m()
+    except AttributeError:
+        pass
+    else:
+        raise TestFailed, "deleted method still found"
+    A.m = lambda self: 1
+    vereq(b.m(), 1)
+    # so is a new MRO
+    B.__bases__ = (C,)
+    vereq(b.m(), 3)
+    B.__bases__ = (A,)
+    vereq(b.m(), 1)
+    # and the cache starts over when cleared
+    sys._clear_type_cache()
+    vereq(b.m(), 1)
+    # classic classes in the MRO are not cached
+    class D:
+        def m(self): return 4
+    class E(D, object):
+        pass
+    e = E()
+    for i in range(10):
+        vereq(e.m(), 4)
+    D.m = lambda self: 5
+    vereq(e.m(), 5)
+
 def test_main():
     weakref_segfault() # Must be first, somehow
     wrapper_segfault()
@@ -4400,6 +4445,7 @@ def test_main():
     notimplemented()
     test_assign_slice()
     test_getattr_hooks()
+    test_type_cache()
 
     if verbose: print "All OK"
 
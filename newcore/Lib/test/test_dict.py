@@ -307,6 +307,29 @@ class DictTest(unittest.TestCase):
         d = {}
         self.assertRaises(KeyError, d.popitem)
 
+    def test_insertion_order(self):
+        keys = [5, 'x', 3.5, -1, 'abc', (1, 2), 100, 'y']
+        d = {}
+        for k in keys:
+            d[k] = str(k)
+        self.assertEqual(d.keys(), keys)
+        self.assertEqual(d.values(), map(str, keys))
+        del d['x']
+        del d[-1]
+        d[-1] = '-1'
+        d[5] = 'five'
+        expected = [5, 3.5, 'abc', (1, 2), 100, 'y', -1]
+        self.assertEqual(list(d), expected)
+        self.assertEqual(d.copy().keys(), expected)
+        self.assertEqual(dict(d).items(), d.items())
+        self.assertEqual(d.popitem(), (-1, '-1'))
+        self.assertEqual(d.popitem(), ('y', 'y'))
+        # growing the table keeps the order too
+        for i in range(1000):
+            d[i + 1000] = i
+        self.assertEqual(d.keys()[:5], [5, 3.5, 'abc', (1, 2), 100])
+        self.assertEqual(d.keys()[5:], range(1000, 2000))
+
     def test_pop(self):
         # Tests for pop with specified key
         d = {}
@@ -464,6 +487,56 @@ class DictTest(unittest.TestCase):
             pass
         d = {}
 
+    def test_instance_dicts(self):
+        # The instance dicts of a class share their keys for as long as
+        # the instances agree; none of that should show.
+        class C(object):
+            def __init__(self, n):
+                for i in range(n):
+                    setattr(self, 'a%d' % i, i)
+        a, b = C(3), C(3)
+        b.a1 = 'one'
+        self.assertEqual(a.__dict__, {'a0': 0, 'a1': 1, 'a2': 2})
+        self.assertEqual(b.__dict__.items(),
+                         [('a0', 0), ('a1', 'one'), ('a2', 2)])
+        big = C(20)
+        self.assertEqual(big.__dict__.keys(),
+                         ['a%d' % i for i in range(20)])
+        self.assertEqual(C(20).__dict__, big.__dict__)
+        # instances going their own ways
+        c = C(0)
+        c.z = 1
+        c.a0 = 0
+        self.assertEqual(c.__dict__.keys(), ['z', 'a0'])
+        self.assertEqual(C(2).__dict__.keys(), ['a0', 'a1'])
+        del a.a1
+        self.assertEqual(a.__dict__.items(), [('a0', 0), ('a2', 2)])
+        a.a1 = 1
+        self.assertEqual(a.__dict__.keys(), ['a0', 'a2', 'a1'])
+        self.assertEqual(b.__dict__.popitem(), ('a2', 2))
+        self.assertEqual(vars(b), {'a0': 0, 'a1': 'one'})
+        d = C(3)
+        d.__dict__[u'u'] = 1
+        d.__dict__[5] = 5
+        self.assertEqual(d.__dict__.keys(), ['a0', 'a1', 'a2', u'u', 5])
+        e = C(4)
+        f = e.__dict__.copy()
+        e.a4 = 4
+        self.assertEqual(f.keys(), ['a0', 'a1', 'a2', 'a3'])
+        f['x'] = 1
+        self.assertEqual(e.__dict__.keys(), ['a0', 'a1', 'a2', 'a3', 'a4'])
+        e.__dict__.clear()
+        self.failIf(hasattr(e, 'a0'))
+        e.a9 = 9
+        self.assertEqual(vars(e), {'a9': 9})
+        # deleting a missing attribute changes nothing
+        f = C(2)
+        self.assertRaises(AttributeError, delattr, f, 'a5')
+        self.assertRaises(KeyError, f.__dict__.__delitem__, 'a5')
+        self.assertEqual(f.__dict__.items(), [('a0', 0), ('a1', 1)])
+        f.a2 = 2
+        self.assertEqual(vars(f), vars(C(3)))
+
 
 
 from test import mapping_tests
@@ -0,0 +1,91 @@
+import os
+import unittest
+from test import test_support
+
+# The heap profiler hooks the core allocator, which only the Symbian
+# build routes through a replaceable function.
+try:
+    import _heapprof
+except ImportError:
+    raise test_support.TestSkipped, "_heapprof is not available"
+
+
+def allocate(n):
+    # Blocks this size bypass the small and medium object pools and go
+    # straight to the core allocator.
+    return ['x' * 10000 for i in range(n)]
+
+
+class HeapProfTest(unittest.TestCase):
+
+    def setUp(self):
+        _heapprof.clear()
+
+    def tearDown(self):
+        _heapprof.stop()
+        _heapprof.clear()
+        if os.path.exists(test_support.TESTFN):
+            os.remove(test_support.TESTFN)
+
+    def site_totals(self, funcname):
+        samples = bytes = live = 0
+        for stack, s, b, l in _heapprof.getsites():
+            if stack[0][1] == funcname:
+                samples += s
+                bytes += b
+                live += l
+        return samples, bytes, live
+
+    def test_start_stop(self):
+        self.failIf(_heapprof.isrunning())
+        _heapprof.start()
+        self.failUnless(_heapprof.isrunning())
+        self.assertRaises(RuntimeError, _heapprof.start)
+        _heapprof.stop()
+        self.failIf(_heapprof.isrunning())
+        _heapprof.stop()
+        self.assertRaises(ValueError, _heapprof.start, 0)
+
+    def test_sites(self):
+        _heapprof.start(1024)
+        keep = allocate(100)
+        _heapprof.stop()
+        samples, bytes, live = self.site_totals('allocate')
+        self.failUnless(samples > 0)
+        # The byte estimate should be in the right ballpark.
+        self.failUnless(500000 < bytes < 2000000, bytes)
+        self.assertEqual(live, bytes)
+        for stack, s, b, l in _heapprof.getsites():
+            if stack[0][1] == 'allocate':
+                self.assertEqual(stack[1][1], 'test_sites')
+                break
+        _heapprof.clear()
+        self.assertEqual(_heapprof.getsites(), [])
+
+    def test_live_bytes(self):
+        _heapprof.start(1024)
+        junk = allocate(100)
+        del junk
+        _heapprof.stop()
+        samples, bytes, live = self.site_totals('allocate')
+        self.failUnless(bytes > 0)
+        self.assertEqual(live, 0)
+
+    def test_dump(self):
+        _heapprof.start(1024)
+        keep = allocate(100)
+        _heapprof.stop()
+        _heapprof.dump(test_support.TESTFN)
+        lines = open(test_support.TESTFN).read().splitlines()
+        self.failUnless('events: Bytes Samples LiveBytes' in lines)
+        self.failUnless('fn=allocate' in lines)
+        self.failUnless('cfn=allocate' in lines)
+        self.assertRaises(IOError, _heapprof.dump,
+                          os.path.join(test_support.TESTFN, 'nonexistent'))
+
+
+def test_main():
+    test_support.run_unittest(HeapProfTest)
+
+if __name__ == "__main__":
+    test_main()
@@ -17,6 +17,7 @@ SHIFT = 15
 BASE = 2 ** SHIFT
 MASK = BASE - 1
 KARATSUBA_CUTOFF = 70   # from longobject.c
+BZ_CUTOFF = 2 * KARATSUBA_CUTOFF   # ditto
 
 # Max number of base BASE digits to use in test cases.  Doubling
 # this will more than double the runtime.
@@ -123,6 +124,54 @@ class LongTest(unittest.TestCase):
                 self.assertEqual(x, y,
                     Frm("bad result for a*b: a=%r, b=%r, x=%r, y=%r", a, b, x, y))
 
+    def test_recursive_division(self):
+        # Divisors and quotients with more than BZ_CUTOFF digits take the
+        # recursive path.  Divisors of all 1 bits make it correct most of
+        # its quotient estimates, and exact multiples leave no remainder.
+        digits = [BZ_CUTOFF + 1, BZ_CUTOFF * 2 + 1, BZ_CUTOFF * 5]
+        for lenq in digits:
+            for leny in digits:
+                x = self.getran(lenq + leny)
+                y = self.getran(leny)
+                self.check_division(x, y)
+                self.check_division(x * y, y)
+                self.check_division(x * y - 1, y)
+                y = (1L << (leny * SHIFT)) - 1
+                self.check_division(x, y)
+                self.check_division(x * y + y - 1, -y)
+
+    def slow_digits(self, x, base):
+        digits = []
+        while x:
+            x, r = divmod(x, base)
+            digits.append("0123456789abcdefghijklmnopqrstuvwxyz"[r])
+        digits.reverse()
+        return "".join(digits) or "0"
+
+    def test_long_conversion(self):
+        # Long numbers are converted a half at a time, so the low halves
+        # need their leading zeroes.
+        for ndigits in (50, 300, 1000, 3000):
+            self.check_format_1(self.getran(ndigits))
+        for k in (100, 1000, 5000):
+            x = 10L ** k
+            self.assertEqual(str(x - 1), "9" * k)
+            self.assertEqual(str(x), "1" + "0" * k)
+            self.assertEqual(str(x + 1), "1" + "0" * (k - 1) + "1")
+            self.assertEqual(str(-x * x), "-1" + "0" * (2 * k))
+            self.assertEqual(str(-x - 1), "-1" + "0" * (k - 1) + "1")
+            self.assertEqual(repr(1 - x), "-" + "9" * k + "L")
+            self.assertEqual(long("1" + "0" * k), x)
+            self.assertEqual(long("9" * k), x - 1)
+            self.assertEqual(long("0" * k + "1" + "0" * k), x)
+            self.assertEqual(long(" -1" + "0" * k + "L "), -x)
+        for base in 3, 7, 10, 36:
+            x = abs(self.getran(2000))
+            s = self.slow_digits(x, base)
+            self.assertEqual(long(s, base), x)
+            self.assertEqual(long("-" + s, base), -x)
+        self.assertRaises(ValueError, long, "1" * 5000 + "x")
+
     def check_bitop_identities_1(self, x):
         eq = self.assertEqual
         eq(x & 0, 0, Frm("x & 0 != 0 for x=%r", x))
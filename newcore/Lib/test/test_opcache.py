@@ -0,0 +1,486 @@
+"""Tests for the instruction caches of the interpreter loop.
+
+The caches only start after a code object has run a while, so each test
+warms its function up first and then checks that it still sees every
+change to the namespaces and types it reads from.
+"""
+
+import unittest
+from test import test_support
+
+WARMUP = 3000       # well above _PyCode_OPCACHE_MIN_RUNS
+
+def make_reader(name, globals_dict):
+    # A function that reads `name` as a global, run in `globals_dict`
+    ns = {}
+    exec "def f():\n    return %s\n" % name in globals_dict, ns
+    return ns['f']
+
+def warm(func):
+    for i in xrange(WARMUP):
+        func()
+    return func()
+
+class LoadGlobalTests(unittest.TestCase):
+
+    def test_rebind_global(self):
+        g = {'x': 1}
+        f = make_reader('x', g)
+        self.assertEqual(warm(f), 1)
+        g['x'] = 2
+        self.assertEqual(f(), 2)
+        g.update(x=3)
+        self.assertEqual(f(), 3)
+
+    def test_delete_global(self):
+        g = {'x': 1}
+        f = make_reader('x', g)
+        self.assertEqual(warm(f), 1)
+        del g['x']
+        self.assertRaises(NameError, f)
+        g['x'] = 4
+        self.assertEqual(f(), 4)
+        g.pop('x')
+        self.assertRaises(NameError, f)
+        g.setdefault('x', 5)
+        self.assertEqual(f(), 5)
+        g.clear()
+        self.assertRaises(NameError, f)
+
+    def test_builtin_shadowed(self):
+        g = {}
+        f = make_reader('len', g)
+        self.assert_(warm(f) is len)
+        g['len'] = 42
+        self.assertEqual(f(), 42)
+        del g['len']
+        self.assert_(f() is len)
+
+    def test_builtin_changed(self):
+        b = {'y': 1}
+        g = {'__builtins__': b}
+        f = make_reader('y', g)
+        self.assertEqual(warm(f), 1)
+        b['y'] = 2
+        self.assertEqual(f(), 2)
+        b.popitem()
+        self.assertRaises(NameError, f)
+
+    def test_other_globals(self):
+        # The same code run with different globals
+        g1 = {'x': 1}
+        f1 = make_reader('x', g1)
+        self.assertEqual(warm(f1), 1)
+        g2 = {'x': 2}
+        f2 = type(f1)(f1.func_code, g2)
+        self.assertEqual(f2(), 2)
+        self.assertEqual(f1(), 1)
+        g1['x'] = 3
+        self.assertEqual(f1(), 3)
+        self.assertEqual(f2(), 2)
+
+    def test_same_value_rebound(self):
+        g = {'x': 'a'}
+        f = make_reader('x', g)
+        self.assertEqual(warm(f), 'a')
+        old = g['x']
+        g['x'] = 'b' * 1000
+        self.assertEqual(f(), 'b' * 1000)
+        g['x'] = old
+        self.assertEqual(f(), 'a')
+
+    def test_loop_in_one_call(self):
+        # Backward jumps count as runs too
+        g = {'x': 0}
+        exec ("def f(n):\n"
+              "    global x\n"
+              "    total = 0\n"
+              "    for i in xrange(n):\n"
+              "        total += x\n"
+              "        x = i\n"
+              "    return total\n") in g
+        self.assertEqual(g['f'](WARMUP), sum(range(WARMUP - 1)))
+
+def make_getter(name):
+    ns = {}
+    exec "def f(obj):\n    return obj.%s\n" % name in ns
+    return ns['f']
+
+def make_setter(name):
+    ns = {}
+    exec "def f(obj, value):\n    obj.%s = value\n" % name in ns
+    return ns['f']
+
+def warm_attr(func, *args):
+    for i in xrange(WARMUP):
+        func(*args)
+    return func(*args)
+
+class AttrTests(unittest.TestCase):
+
+    def test_instance_dict(self):
+        class C(object):
+            pass
+        a, b = C(), C()
+        a.x, b.x = 1, 2
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, a), 1)
+        self.assertEqual(f(b), 2)
+        del b.x
+        self.assertRaises(AttributeError, f, b)
+        b.y = 3
+        b.x = 4
+        self.assertEqual(f(b), 4)
+        b.__dict__ = {'x': 5}
+        self.assertEqual(f(b), 5)
+
+    def test_class_changed(self):
+        class B(object):
+            pass
+        class C(B):
+            x = 1
+        class D(C):
+            pass
+        d = D()
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, d), 1)
+        C.x = 2
+        self.assertEqual(f(d), 2)
+        D.x = 3
+        self.assertEqual(f(d), 3)
+        d.x = 4
+        self.assertEqual(f(d), 4)
+        del D.x, d.x
+        self.assertEqual(f(d), 2)
+        D.__bases__ = (B,)
+        self.assertRaises(AttributeError, f, d)
+
+    def test_shadowing(self):
+        class C(object):
+            def m(self):
+                return 1
+        c = C()
+        f = make_getter('m')
+        self.assertEqual(warm_attr(f, c)(), 1)
+        c.m = lambda: 2
+        self.assertEqual(f(c)(), 2)
+        # a data descriptor wins over the instance dict
+        C.m = property(lambda self: 3)
+        self.assertEqual(f(c), 3)
+        del C.m
+        self.assertEqual(f(c)(), 2)
+
+    def test_descriptor_changed(self):
+        class Desc(object):
+            def __get__(self, obj, type):
+                return 'get'
+        class C(object):
+            x = Desc()
+        c = C()
+        c.__dict__['x'] = 'dict'
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, c), 'dict')
+        Desc.__set__ = lambda self, obj, value: None
+        self.assertEqual(f(c), 'get')
+
+    def test_other_types(self):
+        class C(object):
+            x = 1
+        class D(object):
+            x = 2
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, C()), 1)
+        self.assertEqual(f(D()), 2)
+        for i in xrange(WARMUP):
+            self.assertEqual(f(C()), 1)
+            self.assertEqual(f(D()), 2)
+        self.assertRaises(AttributeError, f, 1)
+
+    def test_class_changed_type(self):
+        class C(object):
+            x = 1
+        class D(object):
+            x = 2
+        c = C()
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, c), 1)
+        c.__class__ = D
+        self.assertEqual(f(c), 2)
+
+    def test_getattr_hooks(self):
+        class C(object):
+            pass
+        c = C()
+        c.x = 1
+        f = make_getter('x')
+        g = make_getter('y')
+        self.assertEqual(warm_attr(f, c), 1)
+        self.assertRaises(AttributeError, g, c)
+        C.__getattr__ = lambda self, name: name
+        self.assertEqual(g(c), 'y')
+        C.__getattribute__ = lambda self, name: 42
+        self.assertEqual(f(c), 42)
+
+    def test_store(self):
+        class C(object):
+            pass
+        class S(object):
+            __slots__ = ['x']
+        c, s = C(), S()
+        f = make_setter('x')
+        warm_attr(f, c, 1)
+        self.assertEqual(c.x, 1)
+        c2 = C()
+        f(c2, 2)
+        self.assertEqual(c2.__dict__, {'x': 2})
+        log = []
+        C.x = property(lambda self: 0, lambda self, v: log.append(v))
+        f(c2, 3)
+        self.assertEqual(log, [3])
+        self.assertEqual(c2.x, 0)
+        del C.x
+        self.assertEqual(c2.x, 2)
+        warm_attr(f, s, 4)
+        self.assertEqual(s.x, 4)
+        self.assertRaises(AttributeError, f, object(), 5)
+
+    def test_modules(self):
+        import types
+        m = types.ModuleType('m')
+        m.x = 1
+        f = make_getter('x')
+        self.assertEqual(warm_attr(f, m), 1)
+        # module dicts are globals too
+        g = make_reader('x', m.__dict__)
+        self.assertEqual(warm(g), 1)
+        make_setter('x')(m, 2)
+        self.assertEqual(f(m), 2)
+        self.assertEqual(g(), 2)
+
+    def test_type_cache_cleared(self):
+        # Clearing the type cache must not let a changed class get its old
+        # version tag back, or the entry would hand out the freed value.
+        import sys
+        class C(object):
+            a = [1, 2, 3]
+        c = C()
+        f = make_getter('a')
+        sys._clear_type_cache()
+        self.assertEqual(warm_attr(f, c), [1, 2, 3])
+        sys._clear_type_cache()
+        C.a = None
+        getattr(c, 'b', None)
+        x = [4, 5, 6, 7]
+        self.assertEqual(f(c), None)
+
+class SuperinstructionTests(unittest.TestCase):
+
+    def ops(self, code):
+        import opcode
+        result = []
+        i = 0
+        co_code = code.co_code
+        while i < len(co_code):
+            op = ord(co_code[i])
+            result.append(opcode.opname[op])
+            i += 1
+            if op >= opcode.HAVE_ARGUMENT:
+                i += 2
+        return result
+
+    def test_fused(self):
+        def f(a, b):
+            if a < b:
+                return a.__class__
+            c = a
+            return c + 1
+        ops = self.ops(f.func_code)
+        for name in ['LOAD_FAST__LOAD_FAST', 'COMPARE_OP__JUMP_IF_FALSE',
+                     'LOAD_FAST__LOAD_ATTR', 'STORE_FAST__LOAD_FAST',
+                     'LOAD_FAST__LOAD_CONST']:
+            self.assert_(name in ops, name)
+        self.assertEqual(f(1, 2), int)
+        self.assertEqual(f(3, 2), 4)
+        def g():
+            return 1
+        self.assert_('LOAD_CONST__RETURN_VALUE' in self.ops(g.func_code))
+        self.assertEqual(g(), 1)
+
+    def test_marshal(self):
+        # .pyc files only ever hold the plain instructions
+        import marshal
+        def f(a, b):
+            if a < b:
+                return a
+            return b
+        data = marshal.dumps(f.func_code)
+        co = marshal.loads(data)
+        self.assertEqual(co.co_code, f.func_code.co_code)
+        self.assert_(f.func_code.co_code not in data)
+        self.assert_('LOAD_FAST__LOAD_FAST' in self.ops(co))
+
+    def test_compare_results(self):
+        class Weird(object):
+            def __lt__(self, other):
+                return []
+        class Truthy(object):
+            def __lt__(self, other):
+                return 1
+        def f(a, b):
+            if a < b:
+                return 'yes'
+            return 'no'
+        self.assertEqual(f(1, 2), 'yes')
+        self.assertEqual(f(2, 1), 'no')
+        self.assertEqual(f(Weird(), 1), 'no')
+        self.assertEqual(f(Truthy(), 1), 'yes')
+        def g(a, b):
+            while a < b:
+                a += 1
+            return a
+        self.assertEqual(g(0, 10), 10)
+        self.assertRaises(TypeError, f, 1j, 2j)
+
+    def test_unbound(self):
+        def f(a):
+            return a, b
+            b = 1
+        self.assertRaises(UnboundLocalError, f, 1)
+        def g():
+            a.x
+            a = 1
+        self.assertRaises(UnboundLocalError, g)
+
+    def test_return_in_finally(self):
+        log = []
+        def f():
+            try:
+                return 1
+            finally:
+                log.append(1)
+        self.assertEqual(f(), 1)
+        self.assertEqual(log, [1])
+
+    def test_trace(self):
+        import sys
+        def f(a, b):
+            c = a
+            if c < b:
+                c = b
+            return c
+        events = []
+        def tracer(frame, event, arg):
+            if frame.f_code is f.func_code:
+                events.append((event, frame.f_lineno))
+            return tracer
+        sys.settrace(tracer)
+        try:
+            f(1, 2)
+        finally:
+            sys.settrace(None)
+        first = f.func_code.co_firstlineno
+        self.assertEqual([(e, l - first) for e, l in events],
+                         [('call', 0), ('line', 1), ('line', 2),
+                          ('line', 3), ('line', 4), ('return', 4)])
+
+    def test_getargs(self):
+        import inspect
+        def f(a, (b, c)):
+            return b
+        self.assertEqual(inspect.getargs(f.func_code),
+                         (['a', ['b', 'c']], None, None))
+
+def make_caller(args):
+    ns = {}
+    exec "def call(f):\n    return f(%s)\n" % args in ns
+    return ns['call']
+
+class CallTests(unittest.TestCase):
+
+    def test_keywords(self):
+        def f(a, b, c=3, d=4):
+            return a, b, c, d
+        call = make_caller('1, d=5, b=2')
+        self.assertEqual(warm_attr(call, f), (1, 2, 3, 5))
+        # another function with the same parameters in another order
+        def g(c, b, d, a=0):
+            return a, b, c, d
+        self.assertEqual(call(g), (0, 2, 1, 5))
+        def h(a, **kw):
+            return a, kw
+        self.assertEqual(call(h), (1, {'b': 2, 'd': 5}))
+        def k(a, b, *args):
+            return a, b
+        self.assertRaises(TypeError, call, k)
+        class C(object):
+            def m(self, a, b, d):
+                return a, b, d
+        self.assertEqual(call(C().m), (1, 2, 5))
+        self.assertEqual(call(lambda *args, **kw: (args, kw)),
+                         ((1,), {'b': 2, 'd': 5}))
+
+    def test_defaults_changed(self):
+        def f(a, b, c=3, d=4):
+            return a, b, c, d
+        call = make_caller('1, b=2')
+        self.assertEqual(warm_attr(call, f), (1, 2, 3, 4))
+        f.func_defaults = (5, 6)
+        self.assertEqual(call(f), (1, 2, 5, 6))
+        f.func_defaults = (6,)
+        self.assertRaises(TypeError, call, f)
+        f.func_defaults = None
+        self.assertRaises(TypeError, call, f)
+        f.func_defaults = (7, 8, 9)
+        self.assertEqual(call(f), (1, 2, 8, 9))
+
+    def test_code_changed(self):
+        def f(a, b):
+            return a, b
+        def g(b, a):
+            return a, b
+        call = make_caller('a=1, b=2')
+        self.assertEqual(warm_attr(call, f), (1, 2))
+        f.func_code = g.func_code
+        self.assertEqual(call(f), (1, 2))
+        for i in xrange(WARMUP):
+            self.assertEqual(call(f), (1, 2))
+            self.assertEqual(call(g), (1, 2))
+
+    def test_errors(self):
+        def f(a, b=2):
+            return a, b
+        call = make_caller('1, a=2')
+        self.assertRaises(TypeError, warm_attr, call, f)
+        call = make_caller('c=1')
+        self.assertRaises(TypeError, warm_attr, call, f)
+        call = make_caller('b=1')
+        self.assertRaises(TypeError, warm_attr, call, f)
+        self.assertRaises(TypeError, make_caller('1, 2, b=3'), f)
+        call = make_caller('**{"a": 1}')
+        self.assertEqual(warm_attr(call, f), (1, 2))
+
+    def test_defaults_only(self):
+        def f(a, b=2, c=[]):
+            c.append(a)
+            return a, b, len(c)
+        call = make_caller('1')
+        self.assertEqual(call(f), (1, 2, 1))
+        self.assertEqual(call(f), (1, 2, 2))
+        self.assertRaises(TypeError, make_caller(''), f)
+        self.assertRaises(TypeError, make_caller('1, 2, 3, 4'), f)
+
+    def test_recursion(self):
+        def f(n, acc=0):
+            if n == 0:
+                return acc
+            return f(acc=acc + n, n=n - 1)
+        for i in xrange(WARMUP):
+            self.assertEqual(f(10), 55)
+
+
+def test_main():
+    test_support.run_unittest(LoadGlobalTests, AttrTests,
+                              SuperinstructionTests, CallTests)
+
+if __name__ == "__main__":
+    test_main()
@@ -0,0 +1,124 @@
+import sys
+import unittest
+import opcode
+from StringIO import StringIO
+from test import test_support
+
+import opprofile
+
+
+def loop(n):
+    total = 0
+    for i in xrange(n):
+        total += i
+    return total
+
+
+def opcode_counts(func):
+    counts = {}
+    code = func.func_code
+    for c, offset, count, seconds in opprofile.getstats():
+        if c is code:
+            op = ord(code.co_code[offset])
+            name = opcode.opname[opcode.superinstructions.get(op, op)]
+            counts[name] = counts.get(name, 0) + count
+    return counts
+
+
+class OpProfileTest(unittest.TestCase):
+
+    def setUp(self):
+        opprofile.clear()
+
+    def tearDown(self):
+        opprofile.stop()
+        opprofile.clear()
+
+    def test_enable(self):
+        self.failIf(opprofile.is_enabled())
+        opprofile.start()
+        self.failUnless(opprofile.is_enabled())
+        opprofile.stop()
+        self.failIf(opprofile.is_enabled())
+        # stopping twice is harmless
+        opprofile.stop()
+
+    def test_settrace_replaces(self):
+        opprofile.start()
+        sys.settrace(None)
+        self.failIf(opprofile.is_enabled())
+        loop(10)
+        self.assertEqual(opcode_counts(loop), {})
+
+    def test_counts(self):
+        opprofile.runcall(loop, 100)
+        counts = opcode_counts(loop)
+        self.assertEqual(counts['INPLACE_ADD'], 100)
+        self.assertEqual(counts['FOR_ITER'], 101)
+        # both halves of a superinstruction are counted, and n and total
+        # are loaded once more each
+        self.assertEqual(counts['LOAD_FAST'], 202)
+        self.assertEqual(counts['RETURN_VALUE'], 1)
+
+    def test_accumulate_and_clear(self):
+        opprofile.runcall(loop, 10)
+        opprofile.runcall(loop, 10)
+        self.assertEqual(opcode_counts(loop)['INPLACE_ADD'], 20)
+        opprofile.clear()
+        self.assertEqual(opprofile.getstats(), [])
+
+    def test_timing(self):
+        opprofile.start(timing=False)
+        loop(100)
+        opprofile.stop()
+        for code, offset, count, seconds in opprofile.getstats():
+            self.assertEqual(seconds, 0.0)
+        opprofile.clear()
+        opprofile.runcall(loop, 10000)
+        seconds = [s for c, o, n, s in opprofile.getstats()
+                   if c is loop.func_code]
+        self.failUnless(min(seconds) >= 0.0)
+        self.failUnless(sum(seconds) > 0.0)
+
+    def test_lines(self):
+        opprofile.runcall(loop, 50)
+        firstlineno = loop.func_code.co_firstlineno
+        counts = {}
+        for seconds, count, filename, lineno, name in opprofile.lines():
+            if name == 'loop':
+                counts[lineno - firstlineno] = count
+        # total += i is four instructions, and the jump back to the loop
+        # and the POP_BLOCK after it are on the same line
+        self.assertEqual(counts[3], 251)
+        self.assertEqual(counts[4], 2)
+        rows = opprofile.lines(sort='count')
+        self.assertEqual(rows, sorted(rows, key=lambda r: r[1],
+                                      reverse=True))
+        self.assertRaises(ValueError, opprofile.lines, 'name')
+
+    def test_print_stats(self):
+        opprofile.runcall(loop, 50)
+        f = StringIO()
+        opprofile.print_stats(file=f)
+        out = f.getvalue()
+        self.failUnless('(loop)' in out)
+        self.failUnless('total += i' in out)
+        self.failUnless('INPLACE_ADD' in out)
+
+    def test_tracing_still_works(self):
+        opprofile.runcall(loop, 5)
+        events = []
+        def tracer(frame, event, arg):
+            events.append(event)
+            return tracer
+        sys.settrace(tracer)
+        loop(2)
+        sys.settrace(None)
+        self.failUnless('line' in events)
+
+
+def test_main():
+    test_support.run_unittest(OpProfileTest)
+
+if __name__ == "__main__":
+    test_main()
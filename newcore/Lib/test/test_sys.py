@@ -191,6 +191,26 @@ class SysModuleTest(unittest.TestCase):
             sys.setcheckinterval(n)
             self.assertEquals(sys.getcheckinterval(), n)
 
+    def test_switchinterval(self):
+        if not hasattr(sys, "setswitchinterval"):
+            return
+        self.assertRaises(TypeError, sys.setswitchinterval)
+        self.assertRaises(TypeError, sys.setswitchinterval, "a")
+        self.assertRaises(ValueError, sys.setswitchinterval, -1.0)
+        self.assertRaises(ValueError, sys.setswitchinterval, 0.0)
+        self.assertRaises(ValueError, sys.setswitchinterval, float('nan'))
+        self.assertRaises(OverflowError, sys.setswitchinterval, 1e300)
+        self.assertRaises(OverflowError, sys.setswitchinterval, float('inf'))
+        orig = sys.getswitchinterval()
+        # sanity check
+        self.assert_(orig < 0.5, orig)
+        try:
+            for n in 0.00001, 0.05, 3.0, orig:
+                sys.setswitchinterval(n)
+                self.assertAlmostEquals(sys.getswitchinterval(), n)
+        finally:
+            sys.setswitchinterval(orig)
+
     def test_recursionlimit(self):
         self.assertRaises(TypeError, sys.getrecursionlimit, 42)
         oldlimit = sys.getrecursionlimit()
@@ -200,6 +220,54 @@ class SysModuleTest(unittest.TestCase):
         self.assertEqual(sys.getrecursionlimit(), 10000)
         sys.setrecursionlimit(oldlimit)
 
+    def test_sparearenas(self):
+        self.assertRaises(TypeError, sys.getsparearenas, 42)
+        oldspare = sys.getsparearenas()
+        self.assertRaises(TypeError, sys.setsparearenas)
+        self.assertRaises(ValueError, sys.setsparearenas, -1)
+        sys.setsparearenas(5)
+        self.assertEqual(sys.getsparearenas(), 5)
+        sys.setsparearenas(oldspare)
+
+    def test_trimheap(self):
+        self.assertRaises(TypeError, sys.trimheap, "x")
+        # Fill a few arenas with small objects and free them again; the
+        # empty arenas are then kept as spares until trimmed.
+        junk = [(i, i) for i in xrange(100000)]
+        del junk
+        released = sys.trimheap(0)
+        self.assert_(isinstance(released, (int, long)))
+        self.assert_(released >= 0)
+        self.assertEqual(sys.trimheap(0), 0)
+        self.assert_(sys.trimheap() >= 0)
+
+    def test_releasecaches(self):
+        self.assertRaises(TypeError, sys.releasecaches, "x")
+        self.assertRaises(ValueError, sys.releasecaches, 0)
+        self.assertRaises(ValueError, sys.releasecaches, 4)
+        # Dead frames, tuples and floats go to the free lists
+        def f(x):
+            return (x, x * 1.5)
+        for i in range(1000):
+            f(i)
+        self.assert_(sys.releasecaches(1) > 0)
+        import linecache
+        linecache.getline(__file__, 1)
+        self.assert_(sys.releasecaches(2) > 0)
+        self.assertEqual(linecache.cache, {})
+        self.assert_(sys.releasecaches() >= 0)
+        # So do the frames of a recursive function, beyond the first
+        def r(n):
+            if n:
+                return r(n - 1) + 1
+            return 0
+        r(100)
+        self.assert_(sys.releasecaches(1) >= 100)
+        # The interpreter keeps working with everything released
+        self.assertEqual(r(100), 100)
+        self.assertEqual(f(2), (2, 3.0))
+        self.assertEqual(eval("'abc' + 'def'"), 'abcdef')
+
     def test_getwindowsversion(self):
         if hasattr(sys, "getwindowsversion"):
             v = sys.getwindowsversion()
@@ -63,6 +63,22 @@ class ThreadSignals(unittest.TestCase):
                            thread.get_ident())
         signalled_all.release()
 
+    def test_pending_call_stats(self):
+        # Each signal is handled through a call queued for the main thread
+        stats = sys._pending_call_stats()
+        for key in ('run', 'refused', 'merged', 'blocks', 'max_batch',
+                    'max_latency', 'mean_latency'):
+            self.assert_(key in stats)
+        before = stats['run']
+        signal.alarm(1)
+        signal.pause()
+        signal.alarm(0)
+        stats = sys._pending_call_stats()
+        self.assert_(stats['run'] > before)
+        self.assert_(stats['max_batch'] >= 1)
+        self.assert_(stats['blocks'] >= 1)
+        self.assert_(stats['max_latency'] >= stats['mean_latency'] >= 0.0)
+
     def spawnSignallingThread(self):
         thread.start_new_thread(send_signals, ())
 
@@ -125,6 +125,30 @@ class UnicodeTest(
         self.checkequalnofix(12,  'abcdefghiabc', 'rfind', u'')
         self.checkequalnofix(12, u'abcdefghiabc', 'rfind',  '')
 
+    def test_find_wide(self):
+        # characters that share their low byte with others, which the
+        # single character search has to tell apart
+        s = u'A\u0141\u4141' * 100 + u'\u0100' + u'\u0141' * 100
+        self.assertEqual(s.find(u'\u4141'), 2)
+        self.assertEqual(s.find(u'\u4141', 3), 5)
+        self.assertEqual(s.find(u'\u0100'), 300)
+        self.assertEqual(s.find(u'\u4100'), -1)
+        self.assertEqual(s.find(u'\u0141', 301), 301)
+        self.assertEqual(s.rfind(u'\u4141'), 299)
+        self.assertEqual(s.count(u'\u0141'), 200)
+        self.assertEqual(s.count(u'\u4141'), 100)
+        self.assertEqual((u'\u0141' * 100).find(u'A'), -1)
+        # and longer needles
+        s = u'\u0430\u0431' * 3000
+        self.assertEqual(s.find(u'\u0431\u0430\u0432'), -1)
+        self.assertEqual(s.find(u'\u0431\u0430' * 50 + u'\u0431'), 1)
+        self.assertEqual(s.count(u'\u0430\u0431\u0430'), 1500)
+        s = u'\u0430' * 5000 + u'\u0431' + u'\u0430' * 60
+        self.assertEqual(s.find(u'\u0430' * 50 + u'\u0431' + u'\u0430' * 50),
+                         4950)
+        self.assertEqual(s.find(u'\u0430' * 49 + u'\u0432' + u'\u0430' * 50),
+                         -1)
+
     def test_index(self):
         string_tests.CommonTest.test_index(self)
         # check mixed argument types
@@ -574,6 +598,29 @@ class UnicodeTest(
         # * strict decoding testing for all of the
         #   UTF8_ERROR cases in PyUnicode_DecodeUTF8
 
+    def test_codecs_ascii_runs(self):
+        # The codecs take runs of ASCII a word at a time where they can;
+        # end the runs at every offset, in short strings and long ones
+        def bytes(u):
+            return ''.join([chr(ord(c)) for c in u])
+        for size in range(20) + range(295, 310):
+            text = u''.join([unichr(ord('a') + i % 26) for i in range(size)])
+            self.assertEqual(text.encode('utf-8'), bytes(text))
+            self.assertEqual(unicode(bytes(text), 'utf-8'), text)
+            self.assertEqual(unicode(bytes(text), 'ascii'), text)
+            for i in range(size):
+                for c, u8 in ((u'\x80', '\xc2\x80'), (u'\u20ac', '\xe2\x82\xac')):
+                    u = text[:i] + c + text[i+1:]
+                    s = bytes(text[:i]) + u8 + bytes(text[i+1:])
+                    self.assertEqual(u.encode('utf-8'), s)
+                    self.assertEqual(unicode(s, 'utf-8'), u)
+                    self.assertEqual(unicode(s, 'ascii', 'replace'),
+                                     text[:i] + u'\ufffd' * len(u8) +
+                                     text[i+1:])
+                    self.assertRaises(UnicodeError, u.encode, 'ascii')
+                self.assertRaises(UnicodeError, unicode,
+                                  bytes(text[:i]) + '\xff', 'utf-8')
+
     def test_codecs_idna(self):
         # Test whether trailing dot is preserved
         self.assertEqual(u"www.python.org.".encode("idna"), "www.python.org.")
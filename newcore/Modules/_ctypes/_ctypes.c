@@ -1609,6 +1609,8 @@ SimpleType_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 				Py_DECREF(result);
 				return NULL;
 			}
+			/* written behind type_setattro's back */
+			PyType_Modified(result);
 		}
 	}
 
@@ -0,0 +1,458 @@
+/* Instruction level profiler
+
+   Counts how many times each instruction of each code object runs, and
+   how long it takes, in the thread that turned the profiler on.  The
+   profiler is an opcode trace function (see PyEval_SetOpcodeTrace()), so
+   the interpreter does not pay for it until it is enabled.  The time of
+   an instruction is from its own event to the next one; an instruction
+   calling a C function is charged with the call, one calling Python code
+   only with setting up the frame.  The time the profiler spends on itself
+   is left out where it can be.  Several threads may be profiled at once,
+   and then the time of an instruction runs until the next instruction of
+   any of them.
+
+   The results are kept per code object, in a table with a slot for every
+   offset in co_code.  The Python module opprofile turns them into hot
+   lines and opcodes.
+*/
+
+#include "Python.h"
+#include "compile.h"
+#include "frameobject.h"
+
+#if !defined(HAVE_LONG_LONG)
+#error "This module requires long longs!"
+#endif
+
+/*** Selection of a high-precision timer ***/
+
+#ifdef MS_WINDOWS
+
+#include <windows.h>
+
+static PY_LONG_LONG
+hpTimer(void)
+{
+	LARGE_INTEGER li;
+	QueryPerformanceCounter(&li);
+	return li.QuadPart;
+}
+
+static double
+hpTimerUnit(void)
+{
+	LARGE_INTEGER li;
+	if (QueryPerformanceFrequency(&li))
+		return 1.0 / li.QuadPart;
+	else
+		return 0.000001;  /* unlikely */
+}
+
+static const char timer_name[] = "QueryPerformanceCounter";
+
+#else  /* !MS_WINDOWS */
+
+#ifndef HAVE_GETTIMEOFDAY
+#error "This module requires gettimeofday() on non-Windows platforms!"
+#endif
+
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+/* A monotonic clock where there is one: the wall clock may step */
+#ifdef CLOCK_MONOTONIC
+static int have_monotonic = 1;		/* until clock_gettime() fails */
+#endif
+
+static PY_LONG_LONG
+hpTimer(void)
+{
+	struct timeval tv;
+	PY_LONG_LONG ret;
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if (have_monotonic && clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		ret = ts.tv_sec;
+		return ret * 1000000000 + ts.tv_nsec;
+	}
+	have_monotonic = 0;
+#endif
+#ifdef GETTIMEOFDAY_NO_TZ
+	gettimeofday(&tv);
+#else
+	gettimeofday(&tv, (struct timezone *)NULL);
+#endif
+	ret = tv.tv_sec;
+	ret = ret * 1000000 + tv.tv_usec;
+	return ret;
+}
+
+static double
+hpTimerUnit(void)
+{
+#ifdef CLOCK_MONOTONIC
+	if (have_monotonic)
+		return 0.000000001;
+#endif
+	return 0.000001;
+}
+
+#ifdef CLOCK_MONOTONIC
+#define timer_name (have_monotonic ? "clock_gettime" : "gettimeofday")
+#else
+static const char timer_name[] = "gettimeofday";
+#endif
+
+#endif  /* MS_WINDOWS */
+
+/* On x86 the time stamp counter is read instead, which is much cheaper
+   than a system call per instruction, and converted to seconds by how
+   fast it ran since the module was imported. */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+static PY_LONG_LONG
+cycles(void)
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((PY_LONG_LONG)hi << 32) | lo;
+}
+
+static PY_LONG_LONG start_cycles, start_time;
+
+static void
+init_cycles(void)
+{
+	start_time = hpTimer();
+	start_cycles = cycles();
+}
+
+static double
+cycles_unit(void)
+{
+	PY_LONG_LONG c, t;
+	double unit = hpTimerUnit();
+
+	/* Measure for at least 10 ms */
+	do {
+		t = hpTimer();
+		c = cycles();
+	} while ((t - start_time) * unit < 0.01 || c == start_cycles);
+	return (t - start_time) * unit / (c - start_cycles);
+}
+
+#define TIMER() cycles()
+#define TIMER_UNIT() cycles_unit()
+#define TIMER_NAME "rdtsc"
+
+#else
+
+#define init_cycles() ((void)hpTimer())
+#define TIMER() hpTimer()
+#define TIMER_UNIT() hpTimerUnit()
+#define TIMER_NAME timer_name
+
+#endif
+
+/*** The tables ***/
+
+typedef struct {
+	unsigned long count;		/* times the instruction ran */
+	PY_LONG_LONG ticks;		/* TIMER() units spent in it */
+} opstat;
+
+typedef struct {
+	PyCodeObject *code;		/* owned reference, or NULL if free */
+	Py_ssize_t size;		/* length of co_code */
+	opstat *stats;			/* one for each offset */
+} coderecord;
+
+#define MINSIZE 64			/* must be a power of two */
+
+static coderecord *records = NULL;	/* open addressing, by address */
+static Py_ssize_t records_size = 0;
+static Py_ssize_t records_used = 0;
+
+static int timing = 1;			/* not only counting */
+static PyCodeObject *last_code = NULL;	/* the last instruction's code */
+static coderecord *last_record = NULL;	/* and its record */
+static opstat *last_stat = NULL;	/* the instruction, to charge */
+static PY_LONG_LONG last_time;		/* from when it started */
+
+#define HASH(code) ((size_t)(code) >> 4)
+
+static coderecord *
+find_record(PyCodeObject *code)
+{
+	size_t mask = records_size - 1;
+	size_t i = HASH(code) & mask;
+
+	while (records[i].code != NULL && records[i].code != code)
+		i = (i + 1) & mask;
+	return &records[i];
+}
+
+static int
+grow_records(void)
+{
+	coderecord *old = records, *rec;
+	Py_ssize_t oldsize = records_size, i;
+	Py_ssize_t newsize = oldsize ? oldsize * 2 : MINSIZE;
+
+	if (newsize > PY_SSIZE_T_MAX / (Py_ssize_t)sizeof(coderecord))
+		return -1;
+	records = PyMem_New(coderecord, newsize);
+	if (records == NULL) {
+		records = old;
+		return -1;
+	}
+	memset(records, 0, newsize * sizeof(coderecord));
+	records_size = newsize;
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].code != NULL) {
+			rec = find_record(old[i].code);
+			*rec = old[i];
+		}
+	}
+	PyMem_Free(old);
+	last_code = NULL;
+	last_record = NULL;
+	return 0;
+}
+
+/* The record of code, added if it is new; NULL if out of memory */
+
+static coderecord *
+get_record(PyCodeObject *code)
+{
+	coderecord *rec;
+	Py_ssize_t size;
+
+	if (records_used * 2 >= records_size && grow_records() < 0)
+		return NULL;
+	rec = find_record(code);
+	if (rec->code == NULL) {
+		size = PyString_GET_SIZE(code->co_code);
+		rec->stats = PyMem_New(opstat, size);
+		if (rec->stats == NULL)
+			return NULL;
+		memset(rec->stats, 0, size * sizeof(opstat));
+		Py_INCREF(code);
+		rec->code = code;
+		rec->size = size;
+		records_used++;
+	}
+	return rec;
+}
+
+static void
+clear_records(void)
+{
+	coderecord *old = records;
+	Py_ssize_t oldsize = records_size, i;
+
+	records = NULL;
+	records_size = records_used = 0;
+	last_code = NULL;
+	last_record = NULL;
+	last_stat = NULL;
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].code != NULL) {
+			PyMem_Free(old[i].stats);
+			Py_DECREF(old[i].code);
+		}
+	}
+	PyMem_Free(old);
+}
+
+/*** The trace function ***/
+
+static int
+opcode_trace(PyObject *obj, PyFrameObject *frame, int what, PyObject *arg)
+{
+	PY_LONG_LONG now = 0;
+	coderecord *rec;
+	int offset;
+
+	if (what != PyTrace_OPCODE)
+		return 0;
+	if (timing) {
+		now = TIMER();
+		if (last_stat != NULL)
+			last_stat->ticks += now - last_time;
+	}
+	if (frame->f_code == last_code)
+		rec = last_record;
+	else {
+		rec = get_record(frame->f_code);
+		if (rec == NULL) {
+			/* Stop rather than fail the program */
+			last_stat = NULL;
+			return 0;
+		}
+		last_code = frame->f_code;
+		last_record = rec;
+	}
+	offset = frame->f_lasti;
+	if (offset < 0 || offset >= rec->size) {
+		last_stat = NULL;
+		return 0;
+	}
+	last_stat = &rec->stats[offset];
+	last_stat->count++;
+	if (timing)
+		last_time = TIMER();
+	return 0;
+}
+
+/*** The module ***/
+
+PyDoc_STRVAR(enable_doc,
+"enable(timing=True)\n\
+\n\
+Start profiling the current thread, replacing any trace function set\n\
+with sys.settrace().  Unless timing is false the time of every\n\
+instruction is measured as well as its count.  The results add up\n\
+until clear() is called.");
+
+static PyObject *
+opprofile_enable(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"timing", 0};
+	int t = 1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i:enable", kwlist, &t))
+		return NULL;
+	timing = t;
+	last_stat = NULL;
+	PyEval_SetOpcodeTrace(opcode_trace, NULL);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+/* Charge the instruction running now, the call of disable() or
+   getstats() */
+
+static void
+flush_last(void)
+{
+	if (timing && last_stat != NULL)
+		last_stat->ticks += TIMER() - last_time;
+	last_stat = NULL;
+}
+
+static int
+is_enabled(void)
+{
+	PyThreadState *tstate = PyThreadState_GET();
+	return tstate->c_tracefunc == opcode_trace && tstate->c_traceopcodes;
+}
+
+PyDoc_STRVAR(disable_doc,
+"disable()\n\
+\n\
+Stop profiling the current thread and remove its trace function.");
+
+static PyObject *
+opprofile_disable(PyObject *self, PyObject *noarg)
+{
+	if (is_enabled()) {
+		flush_last();
+		PyEval_SetOpcodeTrace(NULL, NULL);
+	}
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(is_enabled_doc,
+"is_enabled() -> bool\n\
+\n\
+True while the profiler is the trace function of the current thread.");
+
+static PyObject *
+opprofile_is_enabled(PyObject *self, PyObject *noarg)
+{
+	return PyBool_FromLong(is_enabled());
+}
+
+PyDoc_STRVAR(clear_doc,
+"clear()\n\
+\n\
+Forget the results so far, and the code objects they are about.");
+
+static PyObject *
+opprofile_clear(PyObject *self, PyObject *noarg)
+{
+	clear_records();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(getstats_doc,
+"getstats() -> list of (code, offset, count, seconds)\n\
+\n\
+Return an entry for every instruction that ran since the last clear(),\n\
+in no particular order.  seconds is 0.0 for instructions that were only\n\
+counted.");
+
+static PyObject *
+opprofile_getstats(PyObject *self, PyObject *noarg)
+{
+	PyObject *result, *item;
+	double unit = TIMER_UNIT();
+	Py_ssize_t i, j;
+	opstat *st;
+
+	flush_last();
+	result = PyList_New(0);
+	if (result == NULL)
+		return NULL;
+	for (i = 0; i < records_size; i++) {
+		if (records[i].code == NULL)
+			continue;
+		for (j = 0; j < records[i].size; j++) {
+			st = &records[i].stats[j];
+			if (st->count == 0)
+				continue;
+			item = Py_BuildValue("(Onkd)", records[i].code, j,
+					     st->count, st->ticks * unit);
+			if (item == NULL || PyList_Append(result, item) < 0) {
+				Py_XDECREF(item);
+				Py_DECREF(result);
+				return NULL;
+			}
+			Py_DECREF(item);
+		}
+	}
+	return result;
+}
+
+static PyMethodDef opprofile_methods[] = {
+	{"enable",	(PyCFunction)opprofile_enable,
+	 METH_VARARGS | METH_KEYWORDS, enable_doc},
+	{"disable",	(PyCFunction)opprofile_disable, METH_NOARGS,
+	 disable_doc},
+	{"is_enabled",	(PyCFunction)opprofile_is_enabled, METH_NOARGS,
+	 is_enabled_doc},
+	{"clear",	(PyCFunction)opprofile_clear, METH_NOARGS, clear_doc},
+	{"getstats",	(PyCFunction)opprofile_getstats, METH_NOARGS,
+	 getstats_doc},
+	{NULL, NULL}
+};
+
+PyDoc_STRVAR(module_doc,
+"Fast instruction level profiler, used by the opprofile module.");
+
+PyMODINIT_FUNC
+init_opprofile(void)
+{
+	PyObject *m;
+
+	m = Py_InitModule3("_opprofile", opprofile_methods, module_doc);
+	if (m == NULL)
+		return;
+	init_cycles();			/* also settles which clock is used */
+	PyModule_AddStringConstant(m, "timer", (char *)TIMER_NAME);
+}
@@ -880,6 +880,12 @@ collect(int generation)
 		PyErr_WriteUnraisable(gc_str);
 		Py_FatalError("unexpected exception during garbage collection");
 	}
+
+	/* A full collection is a good time to give the spare arenas kept
+	 * since the last one back to the system.
+	 */
+	if (generation == NUM_GENERATIONS-1)
+		(void)_PyObject_TrimArenas(-1);
 	return n+m;
 }
 
@@ -1,5 +1,7 @@
 #include "Python.h"
 #include "code.h"
+#include "frameobject.h"
+#include "opcode.h"
 #include "structmember.h"
 
 #define NAME_CHARS \
@@ -103,10 +105,88 @@ PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 		Py_INCREF(lnotab);
 		co->co_lnotab = lnotab;
                 co->co_zombieframe = NULL;
+		co->co_zombieslot = -1;
+		co->co_opcache_map = NULL;
+		co->co_opcache = NULL;
+		co->co_opcache_size = 0;
+		co->co_opcache_runs = 0;
 	}
 	return co;
 }
 
+/* Give each LOAD_GLOBAL, LOAD_ATTR and STORE_ATTR instruction of the code,
+   and each CALL_FUNCTION passing keywords, a cache entry, up to 255 of
+   them.  co_opcache_map has a byte for every byte of co_code, holding 1 +
+   the index of the entry of the instruction starting there, or 0.  The
+   entries start out zeroed: with versions no dict has, or empty, so the
+   first lookup fills them.  Return -1 without setting an exception if out
+   of memory; the code then runs without the caches. */
+
+/* Drop the references the CALL_FUNCTION entries hold */
+
+static void
+clear_opcache(PyCodeObject *co)
+{
+	unsigned char *code = (unsigned char *)PyString_AS_STRING(co->co_code);
+	Py_ssize_t codesize = PyString_GET_SIZE(co->co_code);
+	Py_ssize_t i;
+	PyOpcache *oc;
+
+	for (i = 0; i < codesize; i += HAS_ARG(code[i]) ? 3 : 1) {
+		if (code[i] != CALL_FUNCTION || co->co_opcache_map[i] == 0)
+			continue;
+		oc = &co->co_opcache[co->co_opcache_map[i] - 1];
+		Py_XDECREF(oc->u.call.varnames);
+		Py_XDECREF(oc->u.call.names);
+	}
+}
+
+int
+_PyCode_InitOpcache(PyCodeObject *co)
+{
+	unsigned char *code = (unsigned char *)PyString_AS_STRING(co->co_code);
+	Py_ssize_t codesize = PyString_GET_SIZE(co->co_code);
+	Py_ssize_t i;
+	int n = 0;
+
+	co->co_opcache_runs = _PyCode_OPCACHE_MIN_RUNS;
+	if (co->co_opcache_map != NULL)
+		return 0;
+	co->co_opcache_map = (unsigned char *)PyMem_MALLOC(codesize);
+	if (co->co_opcache_map == NULL)
+		return -1;
+	memset(co->co_opcache_map, 0, codesize);
+	for (i = 0; i < codesize; i += HAS_ARG(code[i]) ? 3 : 1) {
+		switch (code[i]) {
+		case LOAD_GLOBAL:
+		case LOAD_ATTR:
+		case STORE_ATTR:
+			if (n < 255)
+				co->co_opcache_map[i] = ++n;
+			break;
+		case CALL_FUNCTION:
+			/* the number of keyword arguments is the high byte */
+			if (code[i+2] != 0 && n < 255)
+				co->co_opcache_map[i] = ++n;
+			break;
+		}
+	}
+	if (n == 0) {
+		PyMem_FREE(co->co_opcache_map);
+		co->co_opcache_map = NULL;
+		return 0;
+	}
+	co->co_opcache = PyMem_NEW(PyOpcache, n);
+	if (co->co_opcache == NULL) {
+		PyMem_FREE(co->co_opcache_map);
+		co->co_opcache_map = NULL;
+		return -1;
+	}
+	memset(co->co_opcache, 0, n * sizeof(PyOpcache));
+	co->co_opcache_size = n;
+	return 0;
+}
+
 
 #define OFF(x) offsetof(PyCodeObject, x)
 
@@ -257,6 +337,11 @@ code_new(PyTypeObject *type, PyObject *args, PyObject *kw)
 static void
 code_dealloc(PyCodeObject *co)
 {
+	if (co->co_opcache_map != NULL) {
+		clear_opcache(co);
+		PyMem_FREE(co->co_opcache_map);
+		PyMem_FREE(co->co_opcache);
+	}
 	Py_XDECREF(co->co_code);
 	Py_XDECREF(co->co_consts);
 	Py_XDECREF(co->co_names);
@@ -266,8 +351,7 @@ code_dealloc(PyCodeObject *co)
 	Py_XDECREF(co->co_filename);
 	Py_XDECREF(co->co_name);
 	Py_XDECREF(co->co_lnotab);
-        if (co->co_zombieframe != NULL)
-                PyObject_GC_Del(co->co_zombieframe);
+	_PyFrame_DelZombies(co);
 	PyObject_DEL(co);
 }
 
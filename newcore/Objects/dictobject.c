@@ -7,6 +7,7 @@
 */
 
 #include "Python.h"
+#include "structmember.h"	/* for offsetof() */
 
 typedef PyDictEntry dictentry;
 typedef PyDictObject dictobject;
@@ -135,21 +136,130 @@ practice, this probably won't make a lick of difference for many years (at
 which point everyone will have terabytes of RAM on 64-bit boxes).
 */
 
-/* Object used as dummy key to fill deleted entries */
-static PyObject *dummy = NULL; /* Initialized by first call to newdictobject() */
+/* The hash table slots that don't point to an entry, and the lookup result
+   for an error; see the comment in dictobject.h */
+#define DKIX_EMPTY (-1)
+#define DKIX_DUMMY (-2)
+#define DKIX_ERROR (-3)
+
+/* Look key up.  Return the position of its entry in the dense entries and
+   set *value_addr to the address of its value; or return DKIX_EMPTY, with
+   *value_addr NULL, if key isn't there; or DKIX_ERROR if a comparison
+   raised.  Either way *hashpos is the hash table slot of the key, or the
+   slot where it would be inserted. */
+typedef Py_ssize_t (*dict_lookup_func)(dictobject *mp, PyObject *key,
+				       long hash, PyObject ***value_addr,
+				       Py_ssize_t *hashpos);
+
+struct _dictkeysobject {
+	Py_ssize_t dk_refcnt;
+	Py_ssize_t dk_size;	/* slots in the hash table, a power of 2 */
+	dict_lookup_func dk_lookup;
+	Py_ssize_t dk_usable;	/* entries that can be added before a resize */
+	Py_ssize_t dk_nentries;	/* entries in use, deleted ones included */
+	Py_ssize_t dk_ixbytes;	/* size of the hash table in bytes */
+
+	/* The hash table, dk_size slots of 1, 2, 4 or sizeof(Py_ssize_t)
+	   bytes each, and then room for USABLE_FRACTION(dk_size) entries.
+	   dk_ixbytes spares the iterators working out where they start. */
+	char dk_indices[8];
+};
 
+#define DK_SIZE(dk) ((dk)->dk_size)
+#define DK_MASK(dk) (DK_SIZE(dk) - 1)
+#define DK_ENTRIES(dk) ((dictentry *)(&(dk)->dk_indices[0] + (dk)->dk_ixbytes))
 
-#ifdef Py_REF_DEBUG
-PyObject *
-_PyDict_Dummy(void)
+/* The hash table is kept at most 2/3 full: the entries have room for that
+   many, and a resize comes when they run out. */
+#define USABLE_FRACTION(n) (((n) << 1) / 3)
+
+/* A table size with room for n entries */
+#define ESTIMATE_SIZE(n) (((n) * 3 + 1) >> 1)
+
+/* The minimum size a dict grows to when it runs out of entries.  Tripling
+ * the number of items at least doubles the table, so that a growing dict
+ * is resized a logarithmic number of times.  A dict with many deleted
+ * entries may get smaller instead.  The old tables quadrupled to keep
+ * themselves sparse, but that costs nothing much now that the hash table
+ * holds small integers rather than entries.
+ */
+#define GROWTH_RATE(mp) ((mp)->ma_used * 3)
+
+static Py_ssize_t
+dk_get_index(PyDictKeysObject *keys, Py_ssize_t i)
 {
-	return dummy;
+	Py_ssize_t s = DK_SIZE(keys);
+
+	if (s <= 0x80)
+		return ((signed char *)keys->dk_indices)[i];
+	else if (s <= 0x8000)
+		return ((short *)keys->dk_indices)[i];
+#if SIZEOF_VOID_P > 4
+	else if (s <= 0x80000000L)
+		return ((int *)keys->dk_indices)[i];
+#endif
+	else
+		return ((Py_ssize_t *)keys->dk_indices)[i];
 }
+
+static void
+dk_set_index(PyDictKeysObject *keys, Py_ssize_t i, Py_ssize_t ix)
+{
+	Py_ssize_t s = DK_SIZE(keys);
+
+	if (s <= 0x80)
+		((signed char *)keys->dk_indices)[i] = (signed char)ix;
+	else if (s <= 0x8000)
+		((short *)keys->dk_indices)[i] = (short)ix;
+#if SIZEOF_VOID_P > 4
+	else if (s <= 0x80000000L)
+		((int *)keys->dk_indices)[i] = (int)ix;
 #endif
+	else
+		((Py_ssize_t *)keys->dk_indices)[i] = ix;
+}
 
 /* forward declarations */
-static dictentry *
-lookdict_string(dictobject *mp, PyObject *key, long hash);
+static Py_ssize_t
+lookdict(dictobject *mp, PyObject *key, long hash,
+	 PyObject ***value_addr, Py_ssize_t *hashpos);
+static Py_ssize_t
+lookdict_string(dictobject *mp, PyObject *key, long hash,
+		PyObject ***value_addr, Py_ssize_t *hashpos);
+static Py_ssize_t
+lookdict_split(dictobject *mp, PyObject *key, long hash,
+	       PyObject ***value_addr, Py_ssize_t *hashpos);
+
+/* The keys of all the empty dicts.  Its one slot is empty, and there is no
+   room for an entry, so the first insertion always resizes.  lookdict()
+   rather than lookdict_string() is its lookup, as only lookdict_string()
+   changes dk_lookup, and this one mustn't change. */
+static PyDictKeysObject empty_keys_struct = {
+	1,		/* dk_refcnt, never falls to 0 */
+	1,		/* dk_size */
+	lookdict,	/* dk_lookup */
+	0,		/* dk_usable */
+	0,		/* dk_nentries */
+	1,		/* dk_ixbytes */
+	{DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY,
+	 DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY},
+};
+
+#define Py_EMPTY_KEYS &empty_keys_struct
+
+#define DK_INCREF(dk) ((dk)->dk_refcnt++)
+#define DK_DECREF(dk) do {					\
+		if (--(dk)->dk_refcnt == 0)				\
+			free_keys_object(dk);				\
+	} while (0)
+
+/* The value of entry i of mp: NULL for a deleted entry, and in a split
+   table for the shared keys mp has no value for. */
+#define DICT_VALUE(mp, i) ((mp)->ma_values != NULL ? (mp)->ma_values[i] : \
+			   DK_ENTRIES((mp)->ma_keys)[i].me_value)
+
+/* The values of a split table, room for one per entry the keys can hold */
+#define SPLIT_VALUES_SIZE(dk) (USABLE_FRACTION(DK_SIZE(dk)))
 
 #ifdef SHOW_CONVERSION_COUNTS
 static long created = 0L;
@@ -164,65 +274,162 @@ show_counts(void)
 }
 #endif
 
-/* Initialization macros.
-   There are two ways to create a dict:  PyDict_New() is the main C API
-   function, and the tp_new slot maps to dict_new().  In the latter case we
-   can save a little time over what PyDict_New does because it's guaranteed
-   that the PyDictObject struct is already zeroed out.
-   Everyone except dict_new() should use EMPTY_TO_MINSIZE (unless they have
-   an excellent reason not to).
-*/
-
-#define INIT_NONZERO_DICT_SLOTS(mp) do {				\
-	(mp)->ma_table = (mp)->ma_smalltable;				\
-	(mp)->ma_mask = PyDict_MINSIZE - 1;				\
-    } while(0)
+/* The last version given to a dict; see ma_version in dictobject.h */
+static Py_dictversion_t dict_version = 0;
 
-#define EMPTY_TO_MINSIZE(mp) do {					\
-	memset((mp)->ma_smalltable, 0, sizeof((mp)->ma_smalltable));	\
-	(mp)->ma_used = (mp)->ma_fill = 0;				\
-	INIT_NONZERO_DICT_SLOTS(mp);					\
-    } while(0)
+#define NEW_VERSION(mp) ((mp)->ma_version = ++dict_version)
 
-/* Dictionary reuse scheme to save calls to malloc, free, and memset */
+/* Reuse schemes to save calls to malloc and free: dict objects, and keys
+   objects of the minimum size */
 #define MAXFREEDICTS 80
 static PyDictObject *free_dicts[MAXFREEDICTS];
 static int num_free_dicts = 0;
 
-PyObject *
-PyDict_New(void)
+#define MAXFREEKEYS 80
+static PyDictKeysObject *free_keys[MAXFREEKEYS];
+static int num_free_keys = 0;
+
+int
+PyDict_ClearFreeList(void)
+{
+	int freed = num_free_dicts + num_free_keys;
+
+	while (num_free_dicts) {
+		PyDictObject *op = free_dicts[--num_free_dicts];
+		assert(PyDict_CheckExact(op));
+		PyObject_GC_Del(op);
+	}
+	while (num_free_keys)
+		PyObject_FREE(free_keys[--num_free_keys]);
+	return freed;
+}
+
+/* Return a keys object with size slots, all empty, and room for
+   USABLE_FRACTION(size) entries. */
+static PyDictKeysObject *
+new_keys_object(Py_ssize_t size)
+{
+	PyDictKeysObject *dk;
+	Py_ssize_t usable, ixsize;
+	size_t bytes;
+
+	assert(size >= PyDict_MINSIZE);
+	assert((size & (size - 1)) == 0);
+	usable = USABLE_FRACTION(size);
+	if (size <= 0x80)
+		ixsize = 1;
+	else if (size <= 0x8000)
+		ixsize = 2;
+#if SIZEOF_VOID_P > 4
+	else if (size <= 0x80000000L)
+		ixsize = 4;
+#endif
+	else
+		ixsize = sizeof(Py_ssize_t);
+
+	if (size == PyDict_MINSIZE && num_free_keys > 0)
+		dk = free_keys[--num_free_keys];
+	else {
+		if ((size_t)size > (PY_SSIZE_T_MAX - sizeof(PyDictKeysObject)) /
+				   (ixsize + sizeof(dictentry)))
+			return (PyDictKeysObject *)PyErr_NoMemory();
+		bytes = offsetof(PyDictKeysObject, dk_indices) +
+			ixsize * size + sizeof(dictentry) * usable;
+		dk = (PyDictKeysObject *)PyObject_MALLOC(bytes);
+		if (dk == NULL)
+			return (PyDictKeysObject *)PyErr_NoMemory();
+	}
+	dk->dk_refcnt = 1;
+	dk->dk_size = size;
+	dk->dk_usable = usable;
+	dk->dk_lookup = lookdict_string;
+	dk->dk_nentries = 0;
+	dk->dk_ixbytes = ixsize * size;
+	/* every byte 0xff is DKIX_EMPTY in every width */
+	memset(&dk->dk_indices[0], 0xff, ixsize * size);
+	memset(DK_ENTRIES(dk), 0, sizeof(dictentry) * usable);
+	return dk;
+}
+
+/* Give back the memory of keys, whose entries no longer hold references. */
+static void
+free_keys_memory(PyDictKeysObject *keys)
+{
+	assert(keys != Py_EMPTY_KEYS);
+	if (keys->dk_size == PyDict_MINSIZE && num_free_keys < MAXFREEKEYS)
+		free_keys[num_free_keys++] = keys;
+	else
+		PyObject_FREE(keys);
+}
+
+static void
+free_keys_object(PyDictKeysObject *keys)
+{
+	dictentry *ep = DK_ENTRIES(keys);
+	Py_ssize_t i, n;
+
+	for (i = 0, n = keys->dk_nentries; i < n; i++) {
+		Py_XDECREF(ep[i].me_key);
+		Py_XDECREF(ep[i].me_value);
+	}
+	free_keys_memory(keys);
+}
+
+/* Return the values of a split table with keys, all NULL */
+static PyObject **
+new_values(PyDictKeysObject *keys)
+{
+	size_t size = SPLIT_VALUES_SIZE(keys) * sizeof(PyObject *);
+	PyObject **values = (PyObject **)PyObject_MALLOC(size);
+
+	if (values == NULL)
+		return (PyObject **)PyErr_NoMemory();
+	memset(values, 0, size);
+	return values;
+}
+
+/* Give back the values of a split table with keys, and their memory */
+static void
+free_values(PyObject **values, PyDictKeysObject *keys)
+{
+	Py_ssize_t i, n;
+
+	for (i = 0, n = keys->dk_nentries; i < n; i++)
+		Py_XDECREF(values[i]);
+	PyObject_FREE(values);
+}
+
+/* Make a dict of keys and values, taking the reference to keys and the
+   values, which are freed if it fails. */
+static PyObject *
+new_dict(PyDictKeysObject *keys, PyObject **values)
 {
 	register dictobject *mp;
-	if (dummy == NULL) { /* Auto-initialize dummy */
-		dummy = PyString_FromString("<dummy key>");
-		if (dummy == NULL)
-			return NULL;
 #ifdef SHOW_CONVERSION_COUNTS
+	static int show_counts_registered = 0;
+	if (!show_counts_registered) {
+		show_counts_registered = 1;
 		Py_AtExit(show_counts);
-#endif
 	}
+#endif
 	if (num_free_dicts) {
 		mp = free_dicts[--num_free_dicts];
 		assert (mp != NULL);
 		assert (mp->ob_type == &PyDict_Type);
 		_Py_NewReference((PyObject *)mp);
-		if (mp->ma_fill) {
-			EMPTY_TO_MINSIZE(mp);
-		} else {
-			/* At least set ma_table and ma_mask; these are wrong
-			   if an empty but presized dict is added to freelist */
-			INIT_NONZERO_DICT_SLOTS(mp);
-		}
-		assert (mp->ma_used == 0);
-		assert (mp->ma_table == mp->ma_smalltable);
-		assert (mp->ma_mask == PyDict_MINSIZE - 1);
 	} else {
 		mp = PyObject_GC_New(dictobject, &PyDict_Type);
-		if (mp == NULL)
+		if (mp == NULL) {
+			if (values != NULL)
+				free_values(values, keys);
+			DK_DECREF(keys);
 			return NULL;
-		EMPTY_TO_MINSIZE(mp);
+		}
 	}
-	mp->ma_lookup = lookdict_string;
+	mp->ma_keys = keys;
+	mp->ma_values = values;
+	mp->ma_used = 0;
+	NEW_VERSION(mp);
 #ifdef SHOW_CONVERSION_COUNTS
 	++created;
 #endif
@@ -230,6 +437,13 @@ PyDict_New(void)
 	return (PyObject *)mp;
 }
 
+PyObject *
+PyDict_New(void)
+{
+	DK_INCREF(Py_EMPTY_KEYS);
+	return new_dict(Py_EMPTY_KEYS, NULL);
+}
+
 /*
 The basic lookup function used by all operations.
 This is based on Algorithm D from Knuth Vol. 3, Sec. 6.4.
@@ -245,45 +459,65 @@ All arithmetic on hash should ignore overflow.
 contributions by Reimer Behrends, Jyrki Alakuijala, Vladimir Marangozov and
 Christian Tismer).
 
-lookdict() is general-purpose, and may return NULL if (and only if) a
+lookdict() is general-purpose, and may return DKIX_ERROR if (and only if) a
 comparison raises an exception (this was new in Python 2.5).
 lookdict_string() below is specialized to string keys, comparison of which can
-never raise an exception; that function can never return NULL.  For both, when
-the key isn't found a dictentry* is returned for which the me_value field is
-NULL; this is the slot in the dict at which the key would have been found, and
-the caller can (if it wishes) add the <key, value> pair to the returned
-dictentry*.
+never raise an exception; that function can never return DKIX_ERROR.  For
+both, when the key isn't found DKIX_EMPTY is returned, and *hashpos is the
+slot in the hash table at which the key would have been found; the caller can
+(if it wishes) add the <key, value> pair as a new entry there.
 */
-static dictentry *
-lookdict(dictobject *mp, PyObject *key, register long hash)
+static Py_ssize_t
+lookdict(dictobject *mp, PyObject *key, register long hash,
+	 PyObject ***value_addr, Py_ssize_t *hashpos)
 {
 	register size_t i;
 	register size_t perturb;
-	register dictentry *freeslot;
-	register size_t mask = (size_t)mp->ma_mask;
-	dictentry *ep0 = mp->ma_table;
+	register Py_ssize_t freeslot;
+	register size_t mask;
+	PyDictKeysObject *dk;
+	dictentry *ep0;
 	register dictentry *ep;
+	register Py_ssize_t ix;
 	register int cmp;
 	PyObject *startkey;
 
+  top:
+	dk = mp->ma_keys;
+	mask = DK_MASK(dk);
+	ep0 = DK_ENTRIES(dk);
 	i = (size_t)hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
 
-	if (ep->me_key == dummy)
-		freeslot = ep;
+	ix = dk_get_index(dk, i);
+	if (ix == DKIX_EMPTY) {
+		*hashpos = i;
+		*value_addr = NULL;
+		return DKIX_EMPTY;
+	}
+	if (ix == DKIX_DUMMY)
+		freeslot = i;
 	else {
+		ep = &ep0[ix];
+		if (ep->me_key == key) {
+			*hashpos = i;
+			*value_addr = &ep->me_value;
+			return ix;
+		}
 		if (ep->me_hash == hash) {
 			startkey = ep->me_key;
 			Py_INCREF(startkey);
 			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
 			Py_DECREF(startkey);
-			if (cmp < 0)
-				return NULL;
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
-				if (cmp > 0)
-					return ep;
+			if (cmp < 0) {
+				*value_addr = NULL;
+				return DKIX_ERROR;
+			}
+			if (dk == mp->ma_keys && ep->me_key == startkey) {
+				if (cmp > 0) {
+					*hashpos = i;
+					*value_addr = &ep->me_value;
+					return ix;
+				}
 			}
 			else {
 				/* The compare did major nasty stuff to the
@@ -291,31 +525,49 @@ lookdict(dictobject *mp, PyObject *key, register long hash)
 				 * XXX A clever adversary could prevent this
 				 * XXX from terminating.
  				 */
- 				return lookdict(mp, key, hash);
+ 				goto top;
  			}
 		}
-		freeslot = NULL;
+		freeslot = -1;
 	}
 
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
+	/* In the loop, DKIX_DUMMY is by far (factor of 100s) the least
+	   likely outcome, so test for that last. */
 	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
 		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL)
-			return freeslot == NULL ? ep : freeslot;
-		if (ep->me_key == key)
-			return ep;
-		if (ep->me_hash == hash && ep->me_key != dummy) {
+		ix = dk_get_index(dk, i & mask);
+		if (ix == DKIX_EMPTY) {
+			*hashpos = freeslot == -1 ? (Py_ssize_t)(i & mask)
+						  : freeslot;
+			*value_addr = NULL;
+			return DKIX_EMPTY;
+		}
+		if (ix == DKIX_DUMMY) {
+			if (freeslot == -1)
+				freeslot = i & mask;
+			continue;
+		}
+		ep = &ep0[ix];
+		if (ep->me_key == key) {
+			*hashpos = i & mask;
+			*value_addr = &ep->me_value;
+			return ix;
+		}
+		if (ep->me_hash == hash) {
 			startkey = ep->me_key;
 			Py_INCREF(startkey);
 			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
 			Py_DECREF(startkey);
-			if (cmp < 0)
-				return NULL;
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
-				if (cmp > 0)
-					return ep;
+			if (cmp < 0) {
+				*value_addr = NULL;
+				return DKIX_ERROR;
+			}
+			if (dk == mp->ma_keys && ep->me_key == startkey) {
+				if (cmp > 0) {
+					*hashpos = i & mask;
+					*value_addr = &ep->me_value;
+					return ix;
+				}
 			}
 			else {
 				/* The compare did major nasty stuff to the
@@ -323,11 +575,9 @@ lookdict(dictobject *mp, PyObject *key, register long hash)
 				 * XXX A clever adversary could prevent this
 				 * XXX from terminating.
  				 */
- 				return lookdict(mp, key, hash);
+ 				goto top;
  			}
 		}
-		else if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
 	}
 	assert(0);	/* NOT REACHED */
 	return 0;
@@ -342,15 +592,17 @@ lookdict(dictobject *mp, PyObject *key, register long hash)
  *
  * This is valuable because dicts with only string keys are very common.
  */
-static dictentry *
-lookdict_string(dictobject *mp, PyObject *key, register long hash)
+static Py_ssize_t
+lookdict_string(dictobject *mp, PyObject *key, register long hash,
+		PyObject ***value_addr, Py_ssize_t *hashpos)
 {
 	register size_t i;
 	register size_t perturb;
-	register dictentry *freeslot;
-	register size_t mask = (size_t)mp->ma_mask;
-	dictentry *ep0 = mp->ma_table;
+	register Py_ssize_t freeslot;
+	register size_t mask = (size_t)DK_MASK(mp->ma_keys);
+	dictentry *ep0 = DK_ENTRIES(mp->ma_keys);
 	register dictentry *ep;
+	register Py_ssize_t ix;
 
 	/* Make sure this function doesn't have to handle non-string keys,
 	   including subclasses of str; e.g., one reason to subclass
@@ -360,126 +612,255 @@ lookdict_string(dictobject *mp, PyObject *key, register long hash)
 #ifdef SHOW_CONVERSION_COUNTS
 		++converted;
 #endif
-		mp->ma_lookup = lookdict;
-		return lookdict(mp, key, hash);
+		mp->ma_keys->dk_lookup = lookdict;
+		return lookdict(mp, key, hash, value_addr, hashpos);
 	}
 	i = hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
-	if (ep->me_key == dummy)
-		freeslot = ep;
+	ix = dk_get_index(mp->ma_keys, i);
+	if (ix == DKIX_EMPTY) {
+		*hashpos = i;
+		*value_addr = NULL;
+		return DKIX_EMPTY;
+	}
+	if (ix == DKIX_DUMMY)
+		freeslot = i;
 	else {
-		if (ep->me_hash == hash && _PyString_Eq(ep->me_key, key))
-			return ep;
-		freeslot = NULL;
+		ep = &ep0[ix];
+		if (ep->me_key == key
+		    || (ep->me_hash == hash && _PyString_Eq(ep->me_key, key))) {
+			*hashpos = i;
+			*value_addr = &ep->me_value;
+			return ix;
+		}
+		freeslot = -1;
 	}
 
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
+	/* In the loop, DKIX_DUMMY is by far (factor of 100s) the least
+	   likely outcome, so test for that last. */
 	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
 		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL)
-			return freeslot == NULL ? ep : freeslot;
+		ix = dk_get_index(mp->ma_keys, i & mask);
+		if (ix == DKIX_EMPTY) {
+			*hashpos = freeslot == -1 ? (Py_ssize_t)(i & mask)
+						  : freeslot;
+			*value_addr = NULL;
+			return DKIX_EMPTY;
+		}
+		if (ix == DKIX_DUMMY) {
+			if (freeslot == -1)
+				freeslot = i & mask;
+			continue;
+		}
+		ep = &ep0[ix];
 		if (ep->me_key == key
-		    || (ep->me_hash == hash
-		        && ep->me_key != dummy
-			&& _PyString_Eq(ep->me_key, key)))
-			return ep;
-		if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
+		    || (ep->me_hash == hash && _PyString_Eq(ep->me_key, key))) {
+			*hashpos = i & mask;
+			*value_addr = &ep->me_value;
+			return ix;
+		}
 	}
 	assert(0);	/* NOT REACHED */
 	return 0;
 }
 
+/*
+ * The lookup of split tables.  Their keys are all exact strings, so
+ * lookdict_string() will do for an exact string, but another key could still
+ * compare equal to one of them.  A shared key mp has no value for is
+ * reported missing, with *hashpos its slot, which is no use for inserting:
+ * insert_split_value() sees to that.
+ */
+static Py_ssize_t
+lookdict_split(dictobject *mp, PyObject *key, register long hash,
+	       PyObject ***value_addr, Py_ssize_t *hashpos)
+{
+	Py_ssize_t ix;
+
+	if (PyString_CheckExact(key))
+		ix = lookdict_string(mp, key, hash, value_addr, hashpos);
+	else {
+		ix = lookdict(mp, key, hash, value_addr, hashpos);
+		/* The comparisons may have combined the table */
+		if (mp->ma_values == NULL)
+			return ix;
+	}
+	if (ix >= 0) {
+		if (mp->ma_values[ix] == NULL) {
+			*value_addr = NULL;
+			return DKIX_EMPTY;
+		}
+		*value_addr = &mp->ma_values[ix];
+	}
+	return ix;
+}
+
+/* Return the hash table slot that points to entry ix, which is active. */
+static Py_ssize_t
+lookdict_index(PyDictKeysObject *k, long hash, Py_ssize_t ix)
+{
+	register size_t i;
+	register size_t perturb;
+	register size_t mask = (size_t)DK_MASK(k);
+
+	i = (size_t)hash & mask;
+	for (perturb = hash; dk_get_index(k, i & mask) != ix;
+	     perturb >>= PERTURB_SHIFT)
+		i = (i << 2) + i + perturb + 1;
+	return i & mask;
+}
+
+/* Return the first empty slot in the probe sequence of hash.  The hash
+   table mustn't have dummy slots, as in a fresh one. */
+static Py_ssize_t
+find_empty_slot(PyDictKeysObject *k, long hash)
+{
+	register size_t i;
+	register size_t perturb;
+	register size_t mask = (size_t)DK_MASK(k);
+
+	i = (size_t)hash & mask;
+	for (perturb = hash; dk_get_index(k, i & mask) != DKIX_EMPTY;
+	     perturb >>= PERTURB_SHIFT)
+		i = (i << 2) + i + perturb + 1;
+	return i & mask;
+}
+
+static int dictresize(dictobject *mp, Py_ssize_t minused);
+
+/*
+Insert into a split table, eating a reference to key and one to value.  The
+key goes in if mp has it already, or if it is the next of the shared keys,
+so that all the dicts sharing them have their keys in the same order; or it
+is added to the shared keys, if mp has all of them and there is room.  Any
+other key gives mp a combined table, and 1 is returned for insertdict() to
+carry on with; otherwise the result is insertdict()'s.
+*/
+static int
+insert_split_value(dictobject *mp, PyObject *key, long hash, PyObject *value)
+{
+	PyDictKeysObject *dk = mp->ma_keys;
+	PyObject **value_addr, *old_value;
+	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+
+	if (PyString_CheckExact(key)) {
+		ix = lookdict_string(mp, key, hash, &value_addr, &hashpos);
+		if (ix >= 0 && mp->ma_values[ix] != NULL) {
+			old_value = mp->ma_values[ix];
+			mp->ma_values[ix] = value;
+			NEW_VERSION(mp);
+			Py_DECREF(old_value); /* which **CAN** re-enter */
+			Py_DECREF(key);
+			return 0;
+		}
+		if (ix == mp->ma_used ||
+		    (ix == DKIX_EMPTY && mp->ma_used == dk->dk_nentries &&
+		     dk->dk_usable > 0)) {
+			if (ix == DKIX_EMPTY) {
+				ix = dk->dk_nentries;
+				ep = &DK_ENTRIES(dk)[ix];
+				dk_set_index(dk, hashpos, ix);
+				ep->me_key = key;
+				ep->me_hash = (Py_ssize_t)hash;
+				dk->dk_usable--;
+				dk->dk_nentries++;
+			}
+			else
+				Py_DECREF(key);
+			mp->ma_values[ix] = value;
+			mp->ma_used++;
+			NEW_VERSION(mp);
+			return 0;
+		}
+	}
+	if (dictresize(mp, GROWTH_RATE(mp)) != 0) {
+		Py_DECREF(key);
+		Py_DECREF(value);
+		return -1;
+	}
+	return 1;
+}
+
 /*
 Internal routine to insert a new item into the table.
-Used both by the internal resize routine and by the public insert routine.
+Used both by the public insert routine and by the bulk inserts below.
 Eats a reference to key and one to value.
 Returns -1 if an error occurred, or 0 on success.
+
+CAUTION: it must not resize the dictionary if it's merely replacing the
+value for an existing key.  This means that it's safe to loop over a
+dictionary with PyDict_Next() and occasionally replace a value -- but you
+can't insert new keys or remove them.
 */
 static int
 insertdict(register dictobject *mp, PyObject *key, long hash, PyObject *value)
 {
 	PyObject *old_value;
+	PyObject **value_addr;
+	PyDictKeysObject *dk;
 	register dictentry *ep;
-	typedef PyDictEntry *(*lookupfunc)(PyDictObject *, PyObject *, long);
+	Py_ssize_t ix, hashpos;
 
-	assert(mp->ma_lookup != NULL);
-	ep = mp->ma_lookup(mp, key, hash);
-	if (ep == NULL) {
+	if (mp->ma_values != NULL) {
+		int res = insert_split_value(mp, key, hash, value);
+		if (res <= 0)
+			return res;
+	}
+	ix = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR) {
 		Py_DECREF(key);
 		Py_DECREF(value);
 		return -1;
 	}
-	if (ep->me_value != NULL) {
-		old_value = ep->me_value;
-		ep->me_value = value;
+	NEW_VERSION(mp);
+	if (ix >= 0) {
+		old_value = *value_addr;
+		*value_addr = value;
 		Py_DECREF(old_value); /* which **CAN** re-enter */
 		Py_DECREF(key);
+		return 0;
 	}
-	else {
-		if (ep->me_key == NULL)
-			mp->ma_fill++;
-		else {
-			assert(ep->me_key == dummy);
-			Py_DECREF(dummy);
-		}
-		ep->me_key = key;
-		ep->me_hash = (Py_ssize_t)hash;
-		ep->me_value = value;
-		mp->ma_used++;
-	}
-	return 0;
-}
-
-/*
-Internal routine used by dictresize() to insert an item which is
-known to be absent from the dict.  This routine also assumes that
-the dict contains no deleted entries.  Besides the performance benefit,
-using insertdict() in dictresize() is dangerous (SF bug #1456209).
-Note that no refcounts are changed by this routine; if needed, the caller
-is responsible for incref'ing `key` and `value`.
-*/
-static void
-insertdict_clean(register dictobject *mp, PyObject *key, long hash,
-		 PyObject *value)
-{
-	register size_t i;
-	register size_t perturb;
-	register size_t mask = (size_t)mp->ma_mask;
-	dictentry *ep0 = mp->ma_table;
-	register dictentry *ep;
 
-	i = hash & mask;
-	ep = &ep0[i];
-	for (perturb = hash; ep->me_key != NULL; perturb >>= PERTURB_SHIFT) {
-		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-	}
-	assert(ep->me_value == NULL);
-	mp->ma_fill++;
+	if (mp->ma_keys->dk_usable <= 0) {
+		/* No room for the entry: resize, which also squeezes out
+		 * the deleted entries and the dummy slots. */
+		if (dictresize(mp, GROWTH_RATE(mp)) != 0) {
+			Py_DECREF(key);
+			Py_DECREF(value);
+			return -1;
+		}
+		hashpos = find_empty_slot(mp->ma_keys, hash);
+	}
+	dk = mp->ma_keys;
+	/* The lookup may have been done in the empty keys, which never
+	   switch to lookdict() by themselves. */
+	if (dk->dk_lookup == lookdict_string && !PyString_CheckExact(key))
+		dk->dk_lookup = lookdict;
+	ep = &DK_ENTRIES(dk)[dk->dk_nentries];
+	dk_set_index(dk, hashpos, dk->dk_nentries);
 	ep->me_key = key;
 	ep->me_hash = (Py_ssize_t)hash;
 	ep->me_value = value;
 	mp->ma_used++;
+	dk->dk_usable--;
+	dk->dk_nentries++;
+	return 0;
 }
 
 /*
-Restructure the table by allocating a new table and reinserting all
-items again.  When entries have been deleted, the new table may
-actually be smaller than the old one.
+Restructure the table by allocating a new keys object and moving the active
+entries over, in order.  Only the hash table is rebuilt; no key is compared
+or even rehashed, so this is safe from the side effects that made
+insertdict() unusable here (SF bug #1456209).  When entries have been
+deleted, the new table may actually be smaller than the old one.  A split
+table always comes out combined, leaving the shared keys to the others.
 */
 static int
 dictresize(dictobject *mp, Py_ssize_t minused)
 {
-	Py_ssize_t newsize;
-	dictentry *oldtable, *newtable, *ep;
-	Py_ssize_t i;
-	int is_oldtable_malloced;
-	dictentry small_copy[PyDict_MINSIZE];
+	Py_ssize_t newsize, numentries, i, j;
+	PyDictKeysObject *oldkeys, *newkeys;
+	dictentry *oldentries, *newentries;
 
 	assert(minused >= 0);
 
@@ -493,65 +874,56 @@ dictresize(dictobject *mp, Py_ssize_t minused)
 		return -1;
 	}
 
-	/* Get space for a new table. */
-	oldtable = mp->ma_table;
-	assert(oldtable != NULL);
-	is_oldtable_malloced = oldtable != mp->ma_smalltable;
-
-	if (newsize == PyDict_MINSIZE) {
-		/* A large table is shrinking, or we can't get any smaller. */
-		newtable = mp->ma_smalltable;
-		if (newtable == oldtable) {
-			if (mp->ma_fill == mp->ma_used) {
-				/* No dummies, so no point doing anything. */
-				return 0;
-			}
-			/* We're not going to resize it, but rebuild the
-			   table anyway to purge old dummy entries.
-			   Subtle:  This is *necessary* if fill==size,
-			   as lookdict needs at least one virgin slot to
-			   terminate failing searches.  If fill < size, it's
-			   merely desirable, as dummies slow searches. */
-			assert(mp->ma_fill > mp->ma_used);
-			memcpy(small_copy, oldtable, sizeof(small_copy));
-			oldtable = small_copy;
+	oldkeys = mp->ma_keys;
+	numentries = mp->ma_used;
+	assert(USABLE_FRACTION(newsize) >= numentries);
+	newkeys = new_keys_object(newsize);
+	if (newkeys == NULL)
+		return -1;
+	/* Once a dict has held a non-string key it stays general; the
+	   shared empty keys don't count. */
+	if (oldkeys->dk_lookup == lookdict && oldkeys != Py_EMPTY_KEYS)
+		newkeys->dk_lookup = lookdict;
+
+	/* Move the active entries; this is refcount-neutral, but for the
+	   keys of a split table, which stay in the shared entries too. */
+	oldentries = DK_ENTRIES(oldkeys);
+	newentries = DK_ENTRIES(newkeys);
+	if (mp->ma_values != NULL) {
+		for (j = 0; j < numentries; j++) {
+			newentries[j].me_hash = oldentries[j].me_hash;
+			newentries[j].me_key = oldentries[j].me_key;
+			Py_INCREF(newentries[j].me_key);
+			newentries[j].me_value = mp->ma_values[j];
 		}
 	}
+	else if (oldkeys->dk_nentries == numentries)
+		memcpy(newentries, oldentries, numentries * sizeof(dictentry));
 	else {
-		newtable = PyMem_NEW(dictentry, newsize);
-		if (newtable == NULL) {
-			PyErr_NoMemory();
-			return -1;
+		for (i = 0, j = 0; j < numentries; i++) {
+			if (oldentries[i].me_value != NULL)
+				newentries[j++] = oldentries[i];
 		}
 	}
-
-	/* Make the dict empty, using the new table. */
-	assert(newtable != oldtable);
-	mp->ma_table = newtable;
-	mp->ma_mask = newsize - 1;
-	memset(newtable, 0, sizeof(dictentry) * newsize);
-	mp->ma_used = 0;
-	i = mp->ma_fill;
-	mp->ma_fill = 0;
-
-	/* Copy the data over; this is refcount-neutral for active entries;
-	   dummy entries aren't copied over, of course */
-	for (ep = oldtable; i > 0; ep++) {
-		if (ep->me_value != NULL) {	/* active entry */
-			--i;
-			insertdict_clean(mp, ep->me_key, (long)ep->me_hash,
-					 ep->me_value);
-		}
-		else if (ep->me_key != NULL) {	/* dummy entry */
-			--i;
-			assert(ep->me_key == dummy);
-			Py_DECREF(ep->me_key);
-		}
-		/* else key == value == NULL:  nothing to do */
+	for (j = 0; j < numentries; j++)
+		dk_set_index(newkeys,
+			     find_empty_slot(newkeys,
+					     (long)newentries[j].me_hash), j);
+	newkeys->dk_usable -= numentries;
+	newkeys->dk_nentries = numentries;
+
+	mp->ma_keys = newkeys;
+	if (mp->ma_values != NULL) {
+		PyObject_FREE(mp->ma_values);
+		mp->ma_values = NULL;
+		DK_DECREF(oldkeys);
+	}
+	else if (oldkeys == Py_EMPTY_KEYS)
+		DK_DECREF(oldkeys);
+	else {
+		assert(oldkeys->dk_refcnt == 1);
+		free_keys_memory(oldkeys);
 	}
-
-	if (is_oldtable_malloced)
-		PyMem_DEL(oldtable);
 	return 0;
 }
 
@@ -570,7 +942,8 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 {
 	long hash;
 	dictobject *mp = (dictobject *)op;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 	PyThreadState *tstate;
 	if (!PyDict_Check(op))
 		return NULL;
@@ -592,34 +965,96 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 		/* preserve the existing exception */
 		PyObject *err_type, *err_value, *err_tb;
 		PyErr_Fetch(&err_type, &err_value, &err_tb);
-		ep = (mp->ma_lookup)(mp, key, hash);
+		ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr,
+					      &hashpos);
 		/* ignore errors */
 		PyErr_Restore(err_type, err_value, err_tb);
-		if (ep == NULL)
+		if (ix < 0)
 			return NULL;
 	}
 	else {
-		ep = (mp->ma_lookup)(mp, key, hash);
-		if (ep == NULL) {
-			PyErr_Clear();
+		ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr,
+					      &hashpos);
+		if (ix < 0) {
+			if (ix == DKIX_ERROR)
+				PyErr_Clear();
 			return NULL;
 		}
 	}
-	return ep->me_value;
+	return *value_addr;
+}
+
+/* PyDict_GetItem() for a string key, looking first in entry *hint and
+   leaving in *hint the entry the key was found in.  Dicts that got the same
+   keys in the same order, like the instance dicts of one class, have them
+   in the same entries, so this is for looking the same name up in many of
+   them; instance dicts that share their keys always do.  Must not be called
+   with an exception set. */
+PyObject *
+_PyDict_GetItemHint(PyObject *op, PyObject *key, Py_ssize_t *hint)
+{
+	dictobject *mp = (dictobject *)op;
+	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
+	long hash;
+
+	if (!PyDict_Check(op))
+		return NULL;
+	assert(PyString_CheckExact(key));
+	if ((size_t)*hint < (size_t)mp->ma_keys->dk_nentries) {
+		ep = &DK_ENTRIES(mp->ma_keys)[*hint];
+		if (ep->me_key == key)
+			return DICT_VALUE(mp, *hint);
+	}
+	hash = ((PyStringObject *)key)->ob_shash;
+	if (hash == -1)
+		return PyDict_GetItem(op, key);
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix < 0) {
+		if (ix == DKIX_ERROR)
+			PyErr_Clear();
+		return NULL;
+	}
+	*hint = ix;
+	return *value_addr;
+}
+
+/* The lookups of LOAD_GLOBAL: key in globals, else in builtins.  Return a
+   borrowed reference, or NULL, with an exception set only if a hash or a
+   comparison raised one. */
+PyObject *
+_PyDict_LoadGlobal(PyDictObject *globals, PyDictObject *builtins,
+		   PyObject *key)
+{
+	long hash;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
+
+	if (!PyString_CheckExact(key) ||
+	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
+		hash = PyObject_Hash(key);
+		if (hash == -1)
+			return NULL;
+	}
+	ix = globals->ma_keys->dk_lookup(globals, key, hash, &value_addr,
+					 &hashpos);
+	if (ix == DKIX_ERROR)
+		return NULL;
+	if (ix >= 0)
+		return *value_addr;
+	ix = builtins->ma_keys->dk_lookup(builtins, key, hash, &value_addr,
+					  &hashpos);
+	if (ix < 0)
+		return NULL;
+	return *value_addr;
 }
 
-/* CAUTION: PyDict_SetItem() must guarantee that it won't resize the
- * dictionary if it's merely replacing the value for an existing key.
- * This means that it's safe to loop over a dictionary with PyDict_Next()
- * and occasionally replace a value -- but you can't insert new keys or
- * remove them.
- */
 int
 PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 {
 	register dictobject *mp;
 	register long hash;
-	register Py_ssize_t n_used;
 
 	if (!PyDict_Check(op)) {
 		PyErr_BadInternalCall();
@@ -638,29 +1073,28 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 		if (hash == -1)
 			return -1;
 	}
-	assert(mp->ma_fill <= mp->ma_mask);  /* at least one empty slot */
-	n_used = mp->ma_used;
 	Py_INCREF(value);
 	Py_INCREF(key);
-	if (insertdict(mp, key, hash, value) != 0)
-		return -1;
-	/* If we added a key, we can safely resize.  Otherwise just return!
-	 * If fill >= 2/3 size, adjust size.  Normally, this doubles or
-	 * quaduples the size, but it's also possible for the dict to shrink
-	 * (if ma_fill is much larger than ma_used, meaning a lot of dict
-	 * keys have been * deleted).
-	 *
-	 * Quadrupling the size improves average dictionary sparseness
-	 * (reducing collisions) at the cost of some memory and iteration
-	 * speed (which loops over every possible entry).  It also halves
-	 * the number of expensive resize operations in a growing dictionary.
-	 *
-	 * Very large dictionaries (over 50K items) use doubling instead.
-	 * This may help applications with severe memory constraints.
-	 */
-	if (!(mp->ma_used > n_used && mp->ma_fill*3 >= (mp->ma_mask+1)*2))
-		return 0;
-	return dictresize(mp, (mp->ma_used > 50000 ? 2 : 4) * mp->ma_used);
+	return insertdict(mp, key, hash, value);
+}
+
+/* Remove the active entry ix, found at slot hashpos of the hash table, and
+   give back the reference to its value; the caller still has to give back
+   the one to the key, which is returned. */
+static PyObject *
+delitem_common(dictobject *mp, Py_ssize_t hashpos, Py_ssize_t ix)
+{
+	dictentry *ep;
+	PyObject *old_key;
+
+	dk_set_index(mp->ma_keys, hashpos, DKIX_DUMMY);
+	ep = &DK_ENTRIES(mp->ma_keys)[ix];
+	old_key = ep->me_key;
+	ep->me_key = NULL;
+	ep->me_value = NULL;
+	mp->ma_used--;
+	NEW_VERSION(mp);
+	return old_key;
 }
 
 int
@@ -668,7 +1102,8 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 {
 	register dictobject *mp;
 	register long hash;
-	register dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 	PyObject *old_value, *old_key;
 
 	if (!PyDict_Check(op)) {
@@ -683,19 +1118,29 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 			return -1;
 	}
 	mp = (dictobject *)op;
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return -1;
-	if (ep->me_value == NULL) {
+	if (ix == DKIX_EMPTY) {
 		set_key_error(key);
 		return -1;
 	}
-	old_key = ep->me_key;
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	old_value = ep->me_value;
-	ep->me_value = NULL;
-	mp->ma_used--;
+	if (mp->ma_values != NULL) {
+		/* Split tables can't lose keys */
+		if (dictresize(mp, ESTIMATE_SIZE(mp->ma_used)) != 0)
+			return -1;
+		ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr,
+					      &hashpos);
+		if (ix == DKIX_ERROR)
+			return -1;
+		if (ix == DKIX_EMPTY) {
+			/* a comparison took it out under our feet */
+			set_key_error(key);
+			return -1;
+		}
+	}
+	old_value = *value_addr;
+	old_key = delitem_common(mp, hashpos, ix);
 	Py_DECREF(old_value);
 	Py_DECREF(old_key);
 	return 0;
@@ -705,69 +1150,31 @@ void
 PyDict_Clear(PyObject *op)
 {
 	dictobject *mp;
-	dictentry *ep, *table;
-	int table_is_malloced;
-	Py_ssize_t fill;
-	dictentry small_copy[PyDict_MINSIZE];
-#ifdef Py_DEBUG
-	Py_ssize_t i, n;
-#endif
+	PyDictKeysObject *oldkeys;
+	PyObject **oldvalues;
 
 	if (!PyDict_Check(op))
 		return;
 	mp = (dictobject *)op;
-#ifdef Py_DEBUG
-	n = mp->ma_mask + 1;
-	i = 0;
-#endif
-
-	table = mp->ma_table;
-	assert(table != NULL);
-	table_is_malloced = table != mp->ma_smalltable;
 
 	/* This is delicate.  During the process of clearing the dict,
 	 * decrefs can cause the dict to mutate.  To avoid fatal confusion
 	 * (voice of experience), we have to make the dict empty before
-	 * clearing the slots, and never refer to anything via mp->xxx while
-	 * clearing.
+	 * clearing the entries, and never refer to anything via mp->xxx while
+	 * clearing.  Giving the dict the empty keys does that, and can't fail.
 	 */
-	fill = mp->ma_fill;
-	if (table_is_malloced)
-		EMPTY_TO_MINSIZE(mp);
-
-	else if (fill > 0) {
-		/* It's a small table with something that needs to be cleared.
-		 * Afraid the only safe way is to copy the dict entries into
-		 * another small table first.
-		 */
-		memcpy(small_copy, table, sizeof(small_copy));
-		table = small_copy;
-		EMPTY_TO_MINSIZE(mp);
-	}
-	/* else it's a small table that's already empty */
-
-	/* Now we can finally clear things.  If C had refcounts, we could
-	 * assert that the refcount on table is 1 now, i.e. that this function
-	 * has unique access to it, so decref side-effects can't alter it.
-	 */
-	for (ep = table; fill > 0; ++ep) {
-#ifdef Py_DEBUG
-		assert(i < n);
-		++i;
-#endif
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
-			Py_XDECREF(ep->me_value);
-		}
-#ifdef Py_DEBUG
-		else
-			assert(ep->me_value == NULL);
-#endif
-	}
-
-	if (table_is_malloced)
-		PyMem_DEL(table);
+	oldkeys = mp->ma_keys;
+	oldvalues = mp->ma_values;
+	NEW_VERSION(mp);
+	if (oldkeys == Py_EMPTY_KEYS)
+		return;
+	DK_INCREF(Py_EMPTY_KEYS);
+	mp->ma_keys = Py_EMPTY_KEYS;
+	mp->ma_values = NULL;
+	mp->ma_used = 0;
+	if (oldvalues != NULL)
+		free_values(oldvalues, oldkeys);
+	DK_DECREF(oldkeys);
 }
 
 /*
@@ -780,6 +1187,8 @@ PyDict_Clear(PyObject *op)
  *              Refer to borrowed references in key and value.
  *     }
  *
+ * The items come in the order they were inserted.
+ *
  * CAUTION:  In general, it isn't safe to use PyDict_Next in a loop that
  * mutates the dict.  One exception:  it is safe if the loop merely changes
  * the values associated with the keys (but doesn't insert new keys or
@@ -789,25 +1198,37 @@ int
 PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue)
 {
 	register Py_ssize_t i;
-	register Py_ssize_t mask;
+	register Py_ssize_t n;
 	register dictentry *ep;
+	dictobject *mp;
+	PyObject *value;
 
 	if (!PyDict_Check(op))
 		return 0;
+	mp = (dictobject *)op;
 	i = *ppos;
 	if (i < 0)
 		return 0;
-	ep = ((dictobject *)op)->ma_table;
-	mask = ((dictobject *)op)->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
-		i++;
+	ep = DK_ENTRIES(mp->ma_keys);
+	if (mp->ma_values != NULL) {
+		/* A split table has values for its first ma_used entries */
+		if (i >= mp->ma_used)
+			return 0;
+		value = mp->ma_values[i];
+	}
+	else {
+		n = mp->ma_keys->dk_nentries;
+		while (i < n && ep[i].me_value == NULL)
+			i++;
+		if (i >= n)
+			return 0;
+		value = ep[i].me_value;
+	}
 	*ppos = i+1;
-	if (i > mask)
-		return 0;
 	if (pkey)
 		*pkey = ep[i].me_key;
 	if (pvalue)
-		*pvalue = ep[i].me_value;
+		*pvalue = value;
 	return 1;
 }
 
@@ -816,26 +1237,38 @@ int
 _PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue, long *phash)
 {
 	register Py_ssize_t i;
-	register Py_ssize_t mask;
+	register Py_ssize_t n;
 	register dictentry *ep;
+	dictobject *mp;
+	PyObject *value;
 
 	if (!PyDict_Check(op))
 		return 0;
+	mp = (dictobject *)op;
 	i = *ppos;
 	if (i < 0)
 		return 0;
-	ep = ((dictobject *)op)->ma_table;
-	mask = ((dictobject *)op)->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
-		i++;
+	ep = DK_ENTRIES(mp->ma_keys);
+	if (mp->ma_values != NULL) {
+		/* A split table has values for its first ma_used entries */
+		if (i >= mp->ma_used)
+			return 0;
+		value = mp->ma_values[i];
+	}
+	else {
+		n = mp->ma_keys->dk_nentries;
+		while (i < n && ep[i].me_value == NULL)
+			i++;
+		if (i >= n)
+			return 0;
+		value = ep[i].me_value;
+	}
 	*ppos = i+1;
-	if (i > mask)
-		return 0;
-        *phash = (long)(ep[i].me_hash);
+	*phash = (long)(ep[i].me_hash);
 	if (pkey)
 		*pkey = ep[i].me_key;
 	if (pvalue)
-		*pvalue = ep[i].me_value;
+		*pvalue = value;
 	return 1;
 }
 
@@ -844,19 +1277,13 @@ _PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue,
 static void
 dict_dealloc(register dictobject *mp)
 {
-	register dictentry *ep;
-	Py_ssize_t fill = mp->ma_fill;
+	PyDictKeysObject *keys = mp->ma_keys;
+	PyObject **values = mp->ma_values;
  	PyObject_GC_UnTrack(mp);
 	Py_TRASHCAN_SAFE_BEGIN(mp)
-	for (ep = mp->ma_table; fill > 0; ep++) {
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
-			Py_XDECREF(ep->me_value);
-		}
-	}
-	if (mp->ma_table != mp->ma_smalltable)
-		PyMem_DEL(mp->ma_table);
+	if (values != NULL)
+		free_values(values, keys);
+	DK_DECREF(keys);
 	if (num_free_dicts < MAXFREEDICTS && mp->ob_type == &PyDict_Type)
 		free_dicts[num_free_dicts++] = mp;
 	else
@@ -881,20 +1308,23 @@ dict_print(register dictobject *mp, register FILE *fp, register int flags)
 
 	fprintf(fp, "{");
 	any = 0;
-	for (i = 0; i <= mp->ma_mask; i++) {
-		dictentry *ep = mp->ma_table + i;
-		PyObject *pvalue = ep->me_value;
+	for (i = 0; i < mp->ma_keys->dk_nentries; i++) {
+		PyObject *pvalue = DICT_VALUE(mp, i);
 		if (pvalue != NULL) {
-			/* Prevent PyObject_Repr from deleting value during
-			   key format */
+			PyObject *pkey = DK_ENTRIES(mp->ma_keys)[i].me_key;
+			/* Prevent PyObject_Repr from deleting key or value
+			   during key format */
+			Py_INCREF(pkey);
 			Py_INCREF(pvalue);
 			if (any++ > 0)
 				fprintf(fp, ", ");
-			if (PyObject_Print((PyObject *)ep->me_key, fp, 0)!=0) {
+			if (PyObject_Print(pkey, fp, 0) != 0) {
+				Py_DECREF(pkey);
 				Py_DECREF(pvalue);
 				Py_ReprLeave((PyObject*)mp);
 				return -1;
 			}
+			Py_DECREF(pkey);
 			fprintf(fp, ": ");
 			if (PyObject_Print(pvalue, fp, 0) != 0) {
 				Py_DECREF(pvalue);
@@ -999,19 +1429,19 @@ dict_subscript(dictobject *mp, register PyObject *key)
 {
 	PyObject *v;
 	long hash;
-	dictentry *ep;
-	assert(mp->ma_table != NULL);
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
+	assert(mp->ma_keys != NULL);
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
 		hash = PyObject_Hash(key);
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return NULL;
-	v = ep->me_value;
-	if (v == NULL) {
+	if (ix == DKIX_EMPTY) {
 		if (!PyDict_CheckExact(mp)) {
 			/* Look up __missing__ method if we're a subclass. */
 		    	PyObject *missing;
@@ -1027,8 +1457,8 @@ dict_subscript(dictobject *mp, register PyObject *key)
 		set_key_error(key);
 		return NULL;
 	}
-	else
-		Py_INCREF(v);
+	v = *value_addr;
+	Py_INCREF(v);
 	return v;
 }
 
@@ -1053,7 +1483,7 @@ dict_keys(register dictobject *mp)
 	register PyObject *v;
 	register Py_ssize_t i, j;
 	dictentry *ep;
-	Py_ssize_t mask, n;
+	Py_ssize_t n_entries, n;
 
   again:
 	n = mp->ma_used;
@@ -1067,10 +1497,10 @@ dict_keys(register dictobject *mp)
 		Py_DECREF(v);
 		goto again;
 	}
-	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if (ep[i].me_value != NULL) {
+	ep = DK_ENTRIES(mp->ma_keys);
+	n_entries = mp->ma_values != NULL ? n : mp->ma_keys->dk_nentries;
+	for (i = 0, j = 0; i < n_entries; i++) {
+		if (mp->ma_values != NULL || ep[i].me_value != NULL) {
 			PyObject *key = ep[i].me_key;
 			Py_INCREF(key);
 			PyList_SET_ITEM(v, j, key);
@@ -1087,7 +1517,9 @@ dict_values(register dictobject *mp)
 	register PyObject *v;
 	register Py_ssize_t i, j;
 	dictentry *ep;
-	Py_ssize_t mask, n;
+	Py_ssize_t n_entries, n;
+	PyObject **value_ptr;
+	size_t offset;
 
   again:
 	n = mp->ma_used;
@@ -1101,11 +1533,20 @@ dict_values(register dictobject *mp)
 		Py_DECREF(v);
 		goto again;
 	}
-	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if (ep[i].me_value != NULL) {
-			PyObject *value = ep[i].me_value;
+	ep = DK_ENTRIES(mp->ma_keys);
+	n_entries = mp->ma_keys->dk_nentries;
+	if (mp->ma_values != NULL) {
+		value_ptr = mp->ma_values;
+		offset = sizeof(PyObject *);
+	}
+	else {
+		value_ptr = &ep[0].me_value;
+		offset = sizeof(dictentry);
+	}
+	for (i = 0, j = 0; i < n_entries; i++) {
+		PyObject *value = *value_ptr;
+		value_ptr = (PyObject **)((char *)value_ptr + offset);
+		if (value != NULL) {
 			Py_INCREF(value);
 			PyList_SET_ITEM(v, j, value);
 			j++;
@@ -1120,9 +1561,11 @@ dict_items(register dictobject *mp)
 {
 	register PyObject *v;
 	register Py_ssize_t i, j, n;
-	Py_ssize_t mask;
+	Py_ssize_t n_entries;
 	PyObject *item, *key, *value;
 	dictentry *ep;
+	PyObject **value_ptr;
+	size_t offset;
 
 	/* Preallocate the list of tuples, to avoid allocations during
 	 * the loop over the items, which could trigger GC, which
@@ -1149,10 +1592,20 @@ dict_items(register dictobject *mp)
 		goto again;
 	}
 	/* Nothing we do below makes any function calls. */
-	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if ((value=ep[i].me_value) != NULL) {
+	ep = DK_ENTRIES(mp->ma_keys);
+	n_entries = mp->ma_keys->dk_nentries;
+	if (mp->ma_values != NULL) {
+		value_ptr = mp->ma_values;
+		offset = sizeof(PyObject *);
+	}
+	else {
+		value_ptr = &ep[0].me_value;
+		offset = sizeof(dictentry);
+	}
+	for (i = 0, j = 0; i < n_entries; i++) {
+		value = *value_ptr;
+		value_ptr = (PyObject **)((char *)value_ptr + offset);
+		if (value != NULL) {
 			key = ep[i].me_key;
 			item = PyList_GET_ITEM(v, j);
 			Py_INCREF(key);
@@ -1189,7 +1642,7 @@ dict_fromkeys(PyObject *cls, PyObject *args)
 		PyObject *key;
 		long hash;
 
-		if (dictresize(mp, PySet_GET_SIZE(seq)))
+		if (dictresize(mp, ESTIMATE_SIZE(PySet_GET_SIZE(seq))))
 			return NULL;
 
 		while (_PySet_NextEntry(seq, &pos, &key, &hash)) {
@@ -1349,6 +1802,8 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 	register PyDictObject *mp, *other;
 	register Py_ssize_t i;
 	dictentry *entry;
+	PyObject *key, *value;
+	long hash;
 
 	/* We accept for the argument either a concrete dictionary object,
 	 * or an abstract "mapping" object.  For the former, we can do
@@ -1373,22 +1828,27 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 			override = 1;
 		/* Do one big resize at the start, rather than
 		 * incrementally resizing as we insert new items.  Expect
-		 * that there will be no (or few) overlapping keys.
+		 * that there will be no (or few) overlapping keys.  A split
+		 * table is left alone, as its keys may well be there already.
 		 */
-		if ((mp->ma_fill + other->ma_used)*3 >= (mp->ma_mask+1)*2) {
-		   if (dictresize(mp, (mp->ma_used + other->ma_used)*2) != 0)
-			   return -1;
+		if (mp->ma_values == NULL &&
+		    mp->ma_keys->dk_usable < other->ma_used) {
+			if (dictresize(mp, ESTIMATE_SIZE(mp->ma_used +
+							 other->ma_used)) != 0)
+				return -1;
 		}
-		for (i = 0; i <= other->ma_mask; i++) {
-			entry = &other->ma_table[i];
-			if (entry->me_value != NULL &&
-			    (override ||
-			     PyDict_GetItem(a, entry->me_key) == NULL)) {
-				Py_INCREF(entry->me_key);
-				Py_INCREF(entry->me_value);
-				if (insertdict(mp, entry->me_key,
-					       (long)entry->me_hash,
-					       entry->me_value) != 0)
+		/* The entries are fetched afresh every time, as
+		 * PyDict_GetItem() can run code that changes other. */
+		for (i = 0; i < other->ma_keys->dk_nentries; i++) {
+			entry = &DK_ENTRIES(other->ma_keys)[i];
+			key = entry->me_key;
+			value = DICT_VALUE(other, i);
+			hash = (long)entry->me_hash;
+			if (value != NULL &&
+			    (override || PyDict_GetItem(a, key) == NULL)) {
+				Py_INCREF(key);
+				Py_INCREF(value);
+				if (insertdict(mp, key, hash, value) != 0)
 					return -1;
 			}
 		}
@@ -1450,14 +1910,58 @@ PyObject *
 PyDict_Copy(PyObject *o)
 {
 	PyObject *copy;
+	dictobject *mp;
+	PyDictKeysObject *keys;
+	dictentry *ep;
+	Py_ssize_t i, n, bytes;
 
 	if (o == NULL || !PyDict_Check(o)) {
 		PyErr_BadInternalCall();
 		return NULL;
 	}
+	mp = (dictobject *)o;
+	keys = mp->ma_keys;
+	if (mp->ma_values != NULL) {
+		/* The copy of a split table shares the keys as well */
+		PyObject **values = new_values(keys);
+		if (values == NULL)
+			return NULL;
+		for (i = 0, n = mp->ma_used; i < n; i++) {
+			values[i] = mp->ma_values[i];
+			Py_INCREF(values[i]);
+		}
+		DK_INCREF(keys);
+		copy = new_dict(keys, values);
+		if (copy != NULL)
+			((dictobject *)copy)->ma_used = n;
+		return copy;
+	}
 	copy = PyDict_New();
 	if (copy == NULL)
 		return NULL;
+	if (keys != Py_EMPTY_KEYS && keys->dk_nentries == mp->ma_used) {
+		/* No deleted entries: clone the keys object as it is,
+		   hash table and all, rather than insert one by one. */
+		bytes = (char *)&DK_ENTRIES(keys)[keys->dk_nentries] -
+			(char *)keys;
+		keys = new_keys_object(DK_SIZE(keys));
+		if (keys == NULL) {
+			Py_DECREF(copy);
+			return NULL;
+		}
+		memcpy(keys, mp->ma_keys, bytes);
+		keys->dk_refcnt = 1;
+		ep = DK_ENTRIES(keys);
+		for (i = 0, n = keys->dk_nentries; i < n; i++) {
+			Py_INCREF(ep[i].me_key);
+			Py_INCREF(ep[i].me_value);
+		}
+		mp = (dictobject *)copy;
+		DK_DECREF(mp->ma_keys);
+		mp->ma_keys = keys;
+		mp->ma_used = n;
+		return copy;
+	}
 	if (PyDict_Merge(copy, o, 1) == 0)
 		return copy;
 	Py_DECREF(copy);
@@ -1520,11 +2024,11 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 	Py_ssize_t i;
 	int cmp;
 
-	for (i = 0; i <= a->ma_mask; i++) {
+	for (i = 0; i < a->ma_keys->dk_nentries; i++) {
 		PyObject *thiskey, *thisaval, *thisbval;
-		if (a->ma_table[i].me_value == NULL)
+		if (DICT_VALUE(a, i) == NULL)
 			continue;
-		thiskey = a->ma_table[i].me_key;
+		thiskey = DK_ENTRIES(a->ma_keys)[i].me_key;
 		Py_INCREF(thiskey);  /* keep alive across compares */
 		if (akey != NULL) {
 			cmp = PyObject_RichCompareBool(akey, thiskey, Py_LT);
@@ -1533,8 +2037,8 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 				goto Fail;
 			}
 			if (cmp > 0 ||
-			    i > a->ma_mask ||
-			    a->ma_table[i].me_value == NULL)
+			    i >= a->ma_keys->dk_nentries ||
+			    DICT_VALUE(a, i) == NULL)
 			{
 				/* Not the *smallest* a key; or maybe it is
 				 * but the compare shrunk the dict so we can't
@@ -1548,7 +2052,7 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 		}
 
 		/* Compare a[thiskey] to b[thiskey]; cmp <- true iff equal. */
-		thisaval = a->ma_table[i].me_value;
+		thisaval = DICT_VALUE(a, i);
 		assert(thisaval);
 		Py_INCREF(thisaval);   /* keep alive */
 		thisbval = PyDict_GetItem((PyObject *)b, thiskey);
@@ -1648,12 +2152,12 @@ dict_equal(dictobject *a, dictobject *b)
 		return 0;
 
 	/* Same # of entries -- check all of 'em.  Exit early on any diff. */
-	for (i = 0; i <= a->ma_mask; i++) {
-		PyObject *aval = a->ma_table[i].me_value;
+	for (i = 0; i < a->ma_keys->dk_nentries; i++) {
+		PyObject *aval = DICT_VALUE(a, i);
 		if (aval != NULL) {
 			int cmp;
 			PyObject *bval;
-			PyObject *key = a->ma_table[i].me_key;
+			PyObject *key = DK_ENTRIES(a->ma_keys)[i].me_key;
 			/* temporarily bump aval's refcount to ensure it stays
 			   alive until we're done with it */
 			Py_INCREF(aval);
@@ -1699,7 +2203,8 @@ static PyObject *
 dict_has_key(register dictobject *mp, PyObject *key)
 {
 	long hash;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
@@ -1707,10 +2212,10 @@ dict_has_key(register dictobject *mp, PyObject *key)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return NULL;
-	return PyBool_FromLong(ep->me_value != NULL);
+	return PyBool_FromLong(ix >= 0);
 }
 
 static PyObject *
@@ -1720,7 +2225,8 @@ dict_get(register dictobject *mp, PyObject *args)
 	PyObject *failobj = Py_None;
 	PyObject *val = NULL;
 	long hash;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 
 	if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &failobj))
 		return NULL;
@@ -1731,12 +2237,13 @@ dict_get(register dictobject *mp, PyObject *args)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return NULL;
-	val = ep->me_value;
-	if (val == NULL)
+	if (ix == DKIX_EMPTY)
 		val = failobj;
+	else
+		val = *value_addr;
 	Py_INCREF(val);
 	return val;
 }
@@ -1749,7 +2256,8 @@ dict_setdefault(register dictobject *mp, PyObject *args)
 	PyObject *failobj = Py_None;
 	PyObject *val = NULL;
 	long hash;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 
 	if (!PyArg_UnpackTuple(args, "setdefault", 1, 2, &key, &failobj))
 		return NULL;
@@ -1760,11 +2268,12 @@ dict_setdefault(register dictobject *mp, PyObject *args)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return NULL;
-	val = ep->me_value;
-	if (val == NULL) {
+	if (ix >= 0)
+		val = *value_addr;
+	else {
 		val = failobj;
 		if (PyDict_SetItem((PyObject*)mp, key, failobj))
 			val = NULL;
@@ -1785,7 +2294,8 @@ static PyObject *
 dict_pop(dictobject *mp, PyObject *args)
 {
 	long hash;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 	PyObject *old_value, *old_key;
 	PyObject *key, *deflt = NULL;
 
@@ -1806,10 +2316,10 @@ dict_pop(dictobject *mp, PyObject *args)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	if (ix == DKIX_ERROR)
 		return NULL;
-	if (ep->me_value == NULL) {
+	if (ix == DKIX_EMPTY) {
 		if (deflt) {
 			Py_INCREF(deflt);
 			return deflt;
@@ -1817,12 +2327,22 @@ dict_pop(dictobject *mp, PyObject *args)
 		set_key_error(key);
 		return NULL;
 	}
-	old_key = ep->me_key;
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	old_value = ep->me_value;
-	ep->me_value = NULL;
-	mp->ma_used--;
+	if (mp->ma_values != NULL) {
+		/* Split tables can't lose keys */
+		if (dictresize(mp, ESTIMATE_SIZE(mp->ma_used)) != 0)
+			return NULL;
+		ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr,
+					      &hashpos);
+		if (ix == DKIX_ERROR)
+			return NULL;
+		if (ix == DKIX_EMPTY) {
+			/* a comparison took it out under our feet */
+			set_key_error(key);
+			return NULL;
+		}
+	}
+	old_value = *value_addr;
+	old_key = delitem_common(mp, hashpos, ix);
 	Py_DECREF(old_key);
 	return old_value;
 }
@@ -1830,7 +2350,8 @@ dict_pop(dictobject *mp, PyObject *args)
 static PyObject *
 dict_popitem(dictobject *mp)
 {
-	Py_ssize_t i = 0;
+	Py_ssize_t i, j;
+	PyDictKeysObject *keys;
 	dictentry *ep;
 	PyObject *res;
 
@@ -1852,36 +2373,32 @@ dict_popitem(dictobject *mp)
 				"popitem(): dictionary is empty");
 		return NULL;
 	}
-	/* Set ep to "the first" dict entry with a value.  We abuse the hash
-	 * field of slot 0 to hold a search finger:
-	 * If slot 0 has a value, use slot 0.
-	 * Else slot 0 is being used to hold a search finger,
-	 * and we use its hash value as the first index to look.
+	/* Pop the last entry, which is the one most recently inserted.
+	 * The deleted entries after it go too, so the next popitem()
+	 * finds its entry at once.  Split tables can't lose keys.
 	 */
-	ep = &mp->ma_table[0];
-	if (ep->me_value == NULL) {
-		i = ep->me_hash;
-		/* The hash field may be a real hash value, or it may be a
-		 * legit search finger, or it may be a once-legit search
-		 * finger that's out of bounds now because it wrapped around
-		 * or the table shrunk -- simply make sure it's in bounds now.
-		 */
-		if (i > mp->ma_mask || i < 1)
-			i = 1;	/* skip slot 0 */
-		while ((ep = &mp->ma_table[i])->me_value == NULL) {
-			i++;
-			if (i > mp->ma_mask)
-				i = 1;
-		}
+	if (mp->ma_values != NULL &&
+	    dictresize(mp, ESTIMATE_SIZE(mp->ma_used)) != 0) {
+		Py_DECREF(res);
+		return NULL;
 	}
+	keys = mp->ma_keys;
+	ep = DK_ENTRIES(keys);
+	i = keys->dk_nentries - 1;
+	while (i >= 0 && ep[i].me_value == NULL)
+		i--;
+	assert(i >= 0);
+	ep = &ep[i];
+	j = lookdict_index(keys, (long)ep->me_hash, i);
+	dk_set_index(keys, j, DKIX_DUMMY);
 	PyTuple_SET_ITEM(res, 0, ep->me_key);
 	PyTuple_SET_ITEM(res, 1, ep->me_value);
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
+	ep->me_key = NULL;
 	ep->me_value = NULL;
+	/* dk_usable isn't given back: the dummy slot still counts */
+	keys->dk_nentries = i;
 	mp->ma_used--;
-	assert(mp->ma_table[0].me_value == NULL);
-	mp->ma_table[0].me_hash = i + 1;  /* next place to start */
+	NEW_VERSION(mp);
 	return res;
 }
 
@@ -2029,7 +2546,8 @@ PyDict_Contains(PyObject *op, PyObject *key)
 {
 	long hash;
 	dictobject *mp = (dictobject *)op;
-	dictentry *ep;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
 
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
@@ -2037,8 +2555,8 @@ PyDict_Contains(PyObject *op, PyObject *key)
 		if (hash == -1)
 			return -1;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	return ep == NULL ? -1 : (ep->me_value != NULL);
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	return ix == DKIX_ERROR ? -1 : (ix >= 0);
 }
 
 /* Internal version of PyDict_Contains used when the hash value is already known */
@@ -2046,10 +2564,149 @@ int
 _PyDict_Contains(PyObject *op, PyObject *key, long hash)
 {
 	dictobject *mp = (dictobject *)op;
+	Py_ssize_t ix, hashpos;
+	PyObject **value_addr;
+
+	ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+	return ix == DKIX_ERROR ? -1 : (ix >= 0);
+}
+
+/* The number of slots in the hash table of dict op, for callers that
+   keep an eye on how much room a dict takes. */
+Py_ssize_t
+_PyDict_TableSize(PyObject *op)
+{
+	assert(PyDict_Check(op));
+	return DK_SIZE(((dictobject *)op)->ma_keys);
+}
+
+/* Instance dicts can share their keys with the type, in a split table, for
+   as long as the instances get the same attributes in the same order; see
+   dictobject.h.  The type makes its keys with _PyDict_NewKeysForClass() and
+   lets them go with _PyDictKeys_DecRef(). */
+
+#define CACHED_KEYS(tp) (((PyHeapTypeObject *)(tp))->ht_cached_keys)
+
+PyDictKeysObject *
+_PyDict_NewKeysForClass(void)
+{
+	PyDictKeysObject *keys = new_keys_object(PyDict_MINSIZE);
+
+	/* A type can do without */
+	if (keys == NULL)
+		PyErr_Clear();
+	else
+		keys->dk_lookup = lookdict_split;
+	return keys;
+}
+
+void
+_PyDictKeys_DecRef(PyDictKeysObject *keys)
+{
+	DK_DECREF(keys);
+}
+
+/* Give mp a split table with its keys, and return them with a reference
+   for the type that is to share them; or NULL if they aren't fit to share,
+   or, with an exception set, if that fails. */
+static PyDictKeysObject *
+make_keys_shared(dictobject *mp)
+{
+	PyDictKeysObject *dk;
+	PyObject **values;
 	dictentry *ep;
+	Py_ssize_t i, n;
+
+	if (!PyDict_CheckExact(mp) || mp->ma_values != NULL ||
+	    mp->ma_keys->dk_lookup != lookdict_string)
+		return NULL;
+	/* squeeze out the deleted entries */
+	if (mp->ma_keys->dk_nentries != mp->ma_used &&
+	    dictresize(mp, DK_SIZE(mp->ma_keys) - 1) != 0)
+		return NULL;
+	dk = mp->ma_keys;
+	values = new_values(dk);
+	if (values == NULL)
+		return NULL;
+	ep = DK_ENTRIES(dk);
+	for (i = 0, n = dk->dk_nentries; i < n; i++) {
+		values[i] = ep[i].me_value;
+		ep[i].me_value = NULL;
+	}
+	dk->dk_lookup = lookdict_split;
+	mp->ma_values = values;
+	DK_INCREF(dk);
+	return dk;
+}
+
+/* A new instance dict for an object of type tp */
+PyObject *
+_PyObjectDict_New(PyTypeObject *tp)
+{
+	PyDictKeysObject *cached;
+	PyObject **values;
 
-	ep = (mp->ma_lookup)(mp, key, hash);
-	return ep == NULL ? -1 : (ep->me_value != NULL);
+	if (!(tp->tp_flags & Py_TPFLAGS_HEAPTYPE) ||
+	    (cached = CACHED_KEYS(tp)) == NULL)
+		return PyDict_New();
+	values = new_values(cached);
+	if (values == NULL)
+		return NULL;
+	DK_INCREF(cached);
+	return new_dict(cached, values);
+}
+
+/* Set attribute key of an object of type tp, whose instance dict is at
+   *dictptr, to value, or delete it if value is NULL; the dict is made if
+   there is none yet.  Return 0, or -1 with an exception set. */
+int
+_PyObjectDict_SetItem(PyTypeObject *tp, PyObject **dictptr,
+		      PyObject *key, PyObject *value)
+{
+	PyObject *dict = *dictptr;
+	PyDictKeysObject *cached = NULL;
+	int res;
+
+	if (dict == NULL) {
+		assert(value != NULL);
+		dict = _PyObjectDict_New(tp);
+		if (dict == NULL)
+			return -1;
+		*dictptr = dict;
+	}
+	if (tp->tp_flags & Py_TPFLAGS_HEAPTYPE)
+		cached = CACHED_KEYS(tp);
+	if (value == NULL || cached == NULL ||
+	    ((dictobject *)dict)->ma_keys != cached) {
+		Py_INCREF(dict);
+		if (value == NULL)
+			res = PyDict_DelItem(dict, key);
+		else
+			res = PyDict_SetItem(dict, key, value);
+		Py_DECREF(dict);
+		return res;
+	}
+
+	/* Held on to, as the insertion can run any code */
+	Py_INCREF(dict);
+	DK_INCREF(cached);
+	res = PyDict_SetItem(dict, key, value);
+	if (CACHED_KEYS(tp) == cached &&
+	    ((dictobject *)dict)->ma_keys != cached) {
+		/* The dict has left the keys it shared.  If no other dict
+		   shares them, as when the first instance outgrows them,
+		   the type shares the new keys of this one instead; if
+		   others do, the instances have parted ways, and the type
+		   stops sharing.  Either way the attribute is set. */
+		CACHED_KEYS(tp) = res == 0 && cached->dk_refcnt == 2 ?
+			make_keys_shared((dictobject *)dict) : NULL;
+		DK_DECREF(cached);
+		if (res == 0 && PyErr_Occurred())
+			PyErr_Clear();
+	}
+	DK_DECREF(cached);
+	Py_DECREF(dict);
+	return res;
 }
 
 /* Hack to implement "key in dict" */
@@ -2076,9 +2733,11 @@ dict_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 	if (self != NULL) {
 		PyDictObject *d = (PyDictObject *)self;
 		/* It's guaranteed that tp->alloc zeroed out the struct. */
-		assert(d->ma_table == NULL && d->ma_fill == 0 && d->ma_used == 0);
-		INIT_NONZERO_DICT_SLOTS(d);
-		d->ma_lookup = lookdict_string;
+		assert(d->ma_keys == NULL && d->ma_values == NULL &&
+		       d->ma_used == 0);
+		DK_INCREF(Py_EMPTY_KEYS);
+		d->ma_keys = Py_EMPTY_KEYS;
+		NEW_VERSION(d);
 #ifdef SHOW_CONVERSION_COUNTS
 		++created;
 #endif
@@ -2263,7 +2922,7 @@ static PyMethodDef dictiter_methods[] = {
 static PyObject *dictiter_iternextkey(dictiterobject *di)
 {
 	PyObject *key;
-	register Py_ssize_t i, mask;
+	register Py_ssize_t i, n;
 	register dictentry *ep;
 	dictobject *d = di->di_dict;
 
@@ -2281,13 +2940,19 @@ static PyObject *dictiter_iternextkey(dictiterobject *di)
 	i = di->di_pos;
 	if (i < 0)
 		goto fail;
-	ep = d->ma_table;
-	mask = d->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
-		i++;
+	ep = DK_ENTRIES(d->ma_keys);
+	if (d->ma_values != NULL) {
+		if (i >= d->ma_used)
+			goto fail;
+	}
+	else {
+		n = d->ma_keys->dk_nentries;
+		while (i < n && ep[i].me_value == NULL)
+			i++;
+		if (i >= n)
+			goto fail;
+	}
 	di->di_pos = i+1;
-	if (i > mask)
-		goto fail;
 	di->len--;
 	key = ep[i].me_key;
 	Py_INCREF(key);
@@ -2336,7 +3001,7 @@ PyTypeObject PyDictIterKey_Type = {
 static PyObject *dictiter_iternextvalue(dictiterobject *di)
 {
 	PyObject *value;
-	register Py_ssize_t i, mask;
+	register Py_ssize_t i, n;
 	register dictentry *ep;
 	dictobject *d = di->di_dict;
 
@@ -2352,14 +3017,21 @@ static PyObject *dictiter_iternextvalue(dictiterobject *di)
 	}
 
 	i = di->di_pos;
-	mask = d->ma_mask;
-	if (i < 0 || i > mask)
-		goto fail;
-	ep = d->ma_table;
-	while ((value=ep[i].me_value) == NULL) {
-		i++;
-		if (i > mask)
+	if (d->ma_values != NULL) {
+		if (i < 0 || i >= d->ma_used)
 			goto fail;
+		value = d->ma_values[i];
+	}
+	else {
+		n = d->ma_keys->dk_nentries;
+		if (i < 0 || i >= n)
+			goto fail;
+		ep = DK_ENTRIES(d->ma_keys);
+		while ((value=ep[i].me_value) == NULL) {
+			i++;
+			if (i >= n)
+				goto fail;
+		}
 	}
 	di->di_pos = i+1;
 	di->len--;
@@ -2409,7 +3081,7 @@ PyTypeObject PyDictIterValue_Type = {
 static PyObject *dictiter_iternextitem(dictiterobject *di)
 {
 	PyObject *key, *value, *result = di->di_result;
-	register Py_ssize_t i, mask;
+	register Py_ssize_t i, n;
 	register dictentry *ep;
 	dictobject *d = di->di_dict;
 
@@ -2427,13 +3099,21 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
 	i = di->di_pos;
 	if (i < 0)
 		goto fail;
-	ep = d->ma_table;
-	mask = d->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
-		i++;
+	ep = DK_ENTRIES(d->ma_keys);
+	if (d->ma_values != NULL) {
+		if (i >= d->ma_used)
+			goto fail;
+		value = d->ma_values[i];
+	}
+	else {
+		n = d->ma_keys->dk_nentries;
+		while (i < n && ep[i].me_value == NULL)
+			i++;
+		if (i >= n)
+			goto fail;
+		value = ep[i].me_value;
+	}
 	di->di_pos = i+1;
-	if (i > mask)
-		goto fail;
 
 	if (result->ob_refcnt == 1) {
 		Py_INCREF(result);
@@ -2446,7 +3126,6 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
 	}
 	di->len--;
 	key = ep[i].me_key;
-	value = ep[i].me_value;
 	Py_INCREF(key);
 	Py_INCREF(value);
 	PyTuple_SET_ITEM(result, 0, key);
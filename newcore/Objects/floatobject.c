@@ -1255,8 +1255,13 @@ _PyFloat_Init(void)
 	float_format = detected_float_format;
 }
 
-void
-PyFloat_Fini(void)
+/* Return the blocks that hold no live float to the system and rebuild
+   the free list from the others.  *pbc and *pbf are set to the number of
+   blocks and the number of blocks freed, *pfsum to the number of floats
+   still alive. */
+
+static void
+float_clear_blocks(int *pbc, int *pbf, int *pfsum)
 {
 	PyFloatObject *p;
 	PyFloatBlock *list, *next;
@@ -1301,6 +1306,30 @@ PyFloat_Fini(void)
 		fsum += frem;
 		list = next;
 	}
+	*pbc = bc;
+	*pbf = bf;
+	*pfsum = fsum;
+}
+
+int
+PyFloat_ClearFreeList(void)
+{
+	int bc, bf, fsum;
+
+	float_clear_blocks(&bc, &bf, &fsum);
+	return bf * N_FLOATOBJECTS;
+}
+
+void
+PyFloat_Fini(void)
+{
+	PyFloatObject *p;
+	PyFloatBlock *list;
+	unsigned i;
+	int bc, bf;	/* block count, number of freed blocks */
+	int fsum;	/* remaining unfreed floats */
+
+	float_clear_blocks(&bc, &bf, &fsum);
 	if (!Py_VerboseFlag)
 		return;
 	fprintf(stderr, "# cleanup floats");
@@ -396,11 +396,49 @@ static PyGetSetDef frame_getsetlist[] = {
    Later, MAXFREELIST was added to bound the # of frames saved on
    free_list.  Else programs creating lots of cyclic trash involving
    frames could provoke free_list into growing without bound.
+
+   3. A recursive function or a generator needs several frames of the
+   same code object at once, and one zombie only serves the outermost.
+   So a code object may hold a stack of zombies instead, linked through
+   f_back.  The frames beyond the first, counted in numzombies, have a
+   bound of their own: up to MAXZOMBIES of them over all code objects,
+   on top of the MAXFREELIST frames in free_list.  Only frames that find
+   no room there go to free_list.  The code objects holding them are
+   listed in zombiecodes, so that PyFrame_ClearFreeList() can free all
+   but the first zombie of each; the rest go with their code object, in
+   _PyFrame_DelZombies().
 */
 
 static PyFrameObject *free_list = NULL;
 static int numfree = 0;		/* number of frames currently in free_list */
 #define MAXFREELIST 200		/* max value for numfree */
+static int numzombies = 0;	/* zombies after the first of each code */
+#define MAXZOMBIES 200		/* max value for numzombies */
+
+/* The code objects holding more than one zombie, in no order.  Each
+   holds at least one of the numzombies frames, so MAXZOMBIES slots are
+   enough.  A code object's co_zombieslot is its index here, or -1. */
+static PyCodeObject *zombiecodes[MAXZOMBIES];
+static int numzombiecodes = 0;
+
+static void
+zombiecodes_add(PyCodeObject *co)
+{
+	assert(co->co_zombieslot < 0 && numzombiecodes < MAXZOMBIES);
+	co->co_zombieslot = numzombiecodes;
+	zombiecodes[numzombiecodes++] = co;
+}
+
+static void
+zombiecodes_remove(PyCodeObject *co)
+{
+	int i = co->co_zombieslot;
+
+	assert(i >= 0 && i < numzombiecodes && zombiecodes[i] == co);
+	zombiecodes[i] = zombiecodes[--numzombiecodes];
+	zombiecodes[i]->co_zombieslot = i;
+	co->co_zombieslot = -1;
+}
 
 static void
 frame_dealloc(PyFrameObject *f)
@@ -431,8 +469,17 @@ frame_dealloc(PyFrameObject *f)
 	Py_CLEAR(f->f_exc_traceback);
 
         co = f->f_code;
-        if (co->co_zombieframe == NULL)
+        if (co->co_zombieframe == NULL) {
+                f->f_back = NULL;
                 co->co_zombieframe = f;
+        }
+	else if (numzombies < MAXZOMBIES) {
+		f->f_back = (PyFrameObject *)co->co_zombieframe;
+		if (f->f_back->f_back == NULL)
+			zombiecodes_add(co);
+		++numzombies;
+		co->co_zombieframe = f;
+	}
 	else if (numfree < MAXFREELIST) {
 		++numfree;
 		f->f_back = free_list;
@@ -600,7 +647,12 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 	}
 	if (code->co_zombieframe != NULL) {
                 f = code->co_zombieframe;
-                code->co_zombieframe = NULL;
+                code->co_zombieframe = f->f_back;
+                if (f->f_back != NULL) {
+                        --numzombies;
+                        if (f->f_back->f_back == NULL)
+                                zombiecodes_remove(code);
+                }
                 _Py_NewReference((PyObject *)f);
                 assert(f->f_code == code);
 	}
@@ -832,11 +884,14 @@ PyFrame_LocalsToFast(PyFrameObject *f, int clear)
 	PyErr_Restore(error_type, error_value, error_traceback);
 }
 
-/* Clear out the free list */
+/* Clear out the free list, and the zombies beyond the first of each
+   code object */
 
-void
-PyFrame_Fini(void)
+int
+PyFrame_ClearFreeList(void)
 {
+	int freed = numfree + numzombies;
+
 	while (free_list != NULL) {
 		PyFrameObject *f = free_list;
 		free_list = free_list->f_back;
@@ -844,6 +899,49 @@ PyFrame_Fini(void)
 		--numfree;
 	}
 	assert(numfree == 0);
+	while (numzombiecodes > 0) {
+		PyCodeObject *co = zombiecodes[--numzombiecodes];
+		PyFrameObject *f = (PyFrameObject *)co->co_zombieframe;
+
+		co->co_zombieslot = -1;
+		while (f->f_back != NULL) {
+			PyFrameObject *next = f->f_back;
+			PyObject_GC_Del(f);
+			--numzombies;
+			f = next;
+		}
+		co->co_zombieframe = f;
+	}
+	assert(numzombies == 0);
+	return freed;
+}
+
+/* Free the zombie frames of a code object that is going away */
+
+void
+_PyFrame_DelZombies(PyCodeObject *co)
+{
+	PyFrameObject *f;
+
+	if (co->co_zombieframe == NULL)
+		return;
+	f = (PyFrameObject *)co->co_zombieframe;
+	co->co_zombieframe = NULL;
+	if (f->f_back != NULL)
+		zombiecodes_remove(co);
+	while (f != NULL) {
+		PyFrameObject *next = f->f_back;
+		if (next != NULL)
+			--numzombies;
+		PyObject_GC_Del(f);
+		f = next;
+	}
+}
+
+void
+PyFrame_Fini(void)
+{
+	(void)PyFrame_ClearFreeList();
 	Py_XDECREF(builtin_object);
 	builtin_object = NULL;
 }
@@ -1179,26 +1179,20 @@ _PyInt_Init(void)
 	return 1;
 }
 
-void
-PyInt_Fini(void)
+/* Return the blocks that hold no live int to the system and rebuild the
+   free list from the others.  *pbc and *pbf are set to the number of
+   blocks and the number of blocks freed, *pisum to the number of ints
+   still alive. */
+
+static void
+int_clear_blocks(int *pbc, int *pbf, int *pisum)
 {
 	PyIntObject *p;
 	PyIntBlock *list, *next;
-	int i;
 	unsigned int ctr;
 	int bc, bf;	/* block count, number of freed blocks */
 	int irem, isum;	/* remaining unfreed ints per block, total */
 
-#if NSMALLNEGINTS + NSMALLPOSINTS > 0
-        PyIntObject **q;
-
-        i = NSMALLNEGINTS + NSMALLPOSINTS;
-        q = small_ints;
-        while (--i >= 0) {
-                Py_XDECREF(*q);
-                *q++ = NULL;
-        }
-#endif
 	bc = 0;
 	bf = 0;
 	isum = 0;
@@ -1246,6 +1240,41 @@ PyInt_Fini(void)
 		isum += irem;
 		list = next;
 	}
+	*pbc = bc;
+	*pbf = bf;
+	*pisum = isum;
+}
+
+int
+PyInt_ClearFreeList(void)
+{
+	int bc, bf, isum;
+
+	int_clear_blocks(&bc, &bf, &isum);
+	return bf * N_INTOBJECTS;
+}
+
+void
+PyInt_Fini(void)
+{
+	PyIntObject *p;
+	PyIntBlock *list;
+	int i;
+	unsigned int ctr;
+	int bc, bf;	/* block count, number of freed blocks */
+	int isum;	/* remaining unfreed ints */
+
+#if NSMALLNEGINTS + NSMALLPOSINTS > 0
+        PyIntObject **q;
+
+        i = NSMALLNEGINTS + NSMALLPOSINTS;
+        q = small_ints;
+        while (--i >= 0) {
+                Py_XDECREF(*q);
+                *q++ = NULL;
+        }
+#endif
+	int_clear_blocks(&bc, &bf, &isum);
 	if (!Py_VerboseFlag)
 		return;
 	fprintf(stderr, "# cleanup ints");
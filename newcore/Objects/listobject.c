@@ -59,7 +59,8 @@ list_resize(PyListObject *self, Py_ssize_t newsize)
 		new_allocated = 0;
 	items = self->ob_item;
 	if (new_allocated <= ((~(size_t)0) / sizeof(PyObject *)))
-		PyMem_RESIZE(items, PyObject *, new_allocated);
+		items = (PyObject **)PyObject_REALLOC(items,
+					new_allocated * sizeof(PyObject *));
 	else
 		items = NULL;
 	if (items == NULL) {
@@ -77,10 +78,11 @@ list_resize(PyListObject *self, Py_ssize_t newsize)
 static PyListObject *free_lists[MAXFREELISTS];
 static int num_free_lists = 0;
 
-void
-PyList_Fini(void)
+int
+PyList_ClearFreeList(void)
 {
 	PyListObject *op;
+	int freed = num_free_lists;
 
 	while (num_free_lists) {
 		num_free_lists--;
@@ -88,6 +90,13 @@ PyList_Fini(void)
 		assert(PyList_CheckExact(op));
 		PyObject_GC_Del(op);
 	}
+	return freed;
+}
+
+void
+PyList_Fini(void)
+{
+	(void)PyList_ClearFreeList();
 }
 
 PyObject *
@@ -117,7 +126,7 @@ PyList_New(Py_ssize_t size)
 	if (size <= 0)
 		op->ob_item = NULL;
 	else {
-		op->ob_item = (PyObject **) PyMem_MALLOC(nbytes);
+		op->ob_item = (PyObject **) PyObject_MALLOC(nbytes);
 		if (op->ob_item == NULL) {
 			Py_DECREF(op);
 			return PyErr_NoMemory();
@@ -273,7 +282,7 @@ list_dealloc(PyListObject *op)
 		while (--i >= 0) {
 			Py_XDECREF(op->ob_item[i]);
 		}
-		PyMem_FREE(op->ob_item);
+		PyObject_FREE(op->ob_item);
 	}
 	if (num_free_lists < MAXFREELISTS && PyList_CheckExact(op))
 		free_lists[num_free_lists++] = op;
@@ -541,7 +550,7 @@ list_clear(PyListObject *a)
 		while (--i >= 0) {
 			Py_XDECREF(item[i]);
 		}
-		PyMem_FREE(item);
+		PyObject_FREE(item);
 	}
 	/* Never fails; the return value can be ignored.
 	   Note that there is no guarantee that the list is actually empty
@@ -2149,7 +2158,7 @@ dsu_fail:
 		while (--i >= 0) {
 			Py_XDECREF(final_ob_item[i]);
 		}
-		PyMem_FREE(final_ob_item);
+		PyObject_FREE(final_ob_item);
 	}
 	Py_XDECREF(compare);
 	Py_XINCREF(result);
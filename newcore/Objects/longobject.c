@@ -23,6 +23,27 @@
  */
 #define FIVEARY_CUTOFF 8
 
+/* For long division, use the O(N**2) school algorithm unless both the
+ * divisor and the quotient have more than BZ_CUTOFF digits.  Past that
+ * the recursive division below is faster, as it multiplies with k_mul.
+ */
+#define BZ_CUTOFF (2 * KARATSUBA_CUTOFF)
+
+/* For converting longs to strings in bases that aren't powers of 2, divide
+ * repeatedly by a power of the base that fits in a digit unless there are
+ * more than FORMAT_CUTOFF digits.  Past that, split the number in two by a
+ * long division first:  that is subquadratic for big numbers, and x_divrem
+ * beats one hardware divide per digit per output chunk well before then.
+ */
+#define FORMAT_CUTOFF 20
+
+/* For converting strings to longs in bases that aren't powers of 2, use
+ * the O(N**2) multiply-and-add loop unless there are more than
+ * FROMSTRING_CUTOFF characters.  Past that, convert the two halves of the
+ * string and join them with a k_mul.
+ */
+#define FROMSTRING_CUTOFF 1000
+
 #define ABS(x) ((x) < 0 ? -(x) : (x))
 
 #undef MIN
@@ -36,6 +57,13 @@ static PyLongObject *mul1(PyLongObject *, wdigit);
 static PyLongObject *muladd1(PyLongObject *, wdigit, wdigit);
 static PyLongObject *divrem1(PyLongObject *, digit, digit *);
 static PyObject *long_format(PyObject *aa, int base, int addL);
+static int long_divrem(PyLongObject *, PyLongObject *,
+	PyLongObject **, PyLongObject **);
+static int long_compare(PyLongObject *, PyLongObject *);
+static PyLongObject *x_add(PyLongObject *, PyLongObject *);
+static PyLongObject *x_sub(PyLongObject *, PyLongObject *);
+static PyObject *long_add(PyLongObject *, PyLongObject *);
+static PyLongObject *k_mul(PyLongObject *, PyLongObject *);
 
 #define SIGCHECK(PyTryBlock) \
 	if (--_Py_Ticker < 0) { \
@@ -1176,6 +1204,150 @@ divrem1(PyLongObject *a, digit n, digit *prem)
 	return long_normalize(z);
 }
 
+/* Store the base `base` digits of abs(a) backwards, ending just before *pp,
+   and leave *pp pointing at the first one.  Store at least `pad` characters,
+   zero-filling on the left.  base is not a power of 2, and powbase ==
+   base ** power is the highest power of base that fits in a digit.
+   Return -1 if interrupted, else 0. */
+
+static int
+long_format_digits(PyLongObject *a, int base, digit powbase, int power,
+		   Py_ssize_t pad, char **pp)
+{
+	Py_ssize_t size = ABS(a->ob_size);
+	digit *pin = a->ob_digit;
+	PyLongObject *scratch;
+	char *p = *pp;
+	char *end = p;
+
+	if (size > 0) {
+		/* Divide repeatedly by base, but for speed use powbase.
+		   Get a scratch area for repeated division. */
+		scratch = _PyLong_New(size);
+		if (scratch == NULL)
+			return -1;
+
+		/* Repeatedly divide by powbase. */
+		do {
+			int ntostore = power;
+			digit rem = inplace_divrem1(scratch->ob_digit,
+						     pin, size, powbase);
+			pin = scratch->ob_digit; /* no need to use a again */
+			if (pin[size - 1] == 0)
+				--size;
+			SIGCHECK({
+				Py_DECREF(scratch);
+				return -1;
+			})
+
+			/* Break rem into digits. */
+			assert(ntostore > 0);
+			do {
+				digit nextrem = (digit)(rem / base);
+				char c = (char)(rem - nextrem * base);
+				c += (c < 10) ? '0' : 'a'-10;
+				*--p = c;
+				rem = nextrem;
+				--ntostore;
+				/* Termination is a bit delicate:  must not
+				   store leading zeroes, so must get out if
+				   remaining quotient and rem are both 0. */
+			} while (ntostore && (size || rem));
+		} while (size != 0);
+		Py_DECREF(scratch);
+	}
+	while (end - p < pad)
+		*--p = '0';
+	*pp = p;
+	return 0;
+}
+
+/* Divide and conquer for long_format_digits:  with P = base ** k for a k
+   around half the digits of a, store a % P padded to k characters, then
+   a / P in front of it.  powers[i] is base ** (power << i). */
+
+static int
+long_format_rec(PyLongObject *a, PyLongObject **powers, int level,
+		int base, digit powbase, int power, Py_ssize_t pad, char **pp)
+{
+	PyLongObject *hi, *lo;
+	int result;
+
+	/* Unless padding, skip the powers bigger than a, which would
+	   only add leading zeroes. */
+	if (pad == 0)
+		while (level >= 0 && long_compare(a, powers[level]) < 0)
+			--level;
+	if (level < 0 || ABS(a->ob_size) <= FORMAT_CUTOFF)
+		return long_format_digits(a, base, powbase, power, pad, pp);
+
+	if (long_divrem(a, powers[level], &hi, &lo) < 0)
+		return -1;
+	result = long_format_rec(lo, powers, level - 1, base, powbase, power,
+				 (Py_ssize_t)power << level, pp);
+	if (result == 0) {
+		pad -= (Py_ssize_t)power << level;
+		result = long_format_rec(hi, powers, pad > 0 ? level - 1 : level,
+					 base, powbase, power, MAX(pad, 0), pp);
+	}
+	Py_DECREF(hi);
+	Py_DECREF(lo);
+	return result;
+}
+
+/* Store abs(a) in base `base`, which is not a power of 2, for long_format.
+   Return -1 on error, else 0.  Repeated division by a digit is quadratic;
+   past FORMAT_CUTOFF digits the number is split with long_divrem instead,
+   which is subquadratic there. */
+
+static int
+long_format_dc(PyLongObject *a, int base, char **pp)
+{
+	PyLongObject *powers[8 * sizeof(Py_ssize_t)];
+	const Py_ssize_t size_a = ABS(a->ob_size);
+	int i, n = 0, result = -1;
+	/* powbase <- largest power of base that fits in a digit. */
+	digit powbase = base;  /* powbase == base ** power */
+	int power = 1;
+
+	for (;;) {
+		unsigned long newpow = powbase * (unsigned long)base;
+		if (newpow >> SHIFT)  /* doesn't fit in a digit */
+			break;
+		powbase = (digit)newpow;
+		++power;
+	}
+	if (size_a <= FORMAT_CUTOFF)
+		return long_format_digits(a, base, powbase, power, 0, pp);
+
+	/* Square powbase until the top power has about half of a's size. */
+	powers[0] = (PyLongObject *)PyLong_FromLong((long)powbase);
+	if (powers[0] == NULL)
+		return -1;
+	for (n = 1; 2 * ABS(powers[n-1]->ob_size) <= size_a; ++n) {
+		powers[n] = k_mul(powers[n-1], powers[n-1]);
+		if (powers[n] == NULL)
+			goto done;
+	}
+
+	/* long_format_rec compares with the powers, so give it abs(a). */
+	if (a->ob_size < 0) {
+		a = (PyLongObject *)_PyLong_Copy(a);
+		if (a == NULL)
+			goto done;
+		a->ob_size = -(a->ob_size);
+	}
+	else
+		Py_INCREF(a);
+	result = long_format_rec(a, powers, n - 1, base, powbase, power, 0, pp);
+	Py_DECREF(a);
+
+ done:
+	for (i = 0; i < n; ++i)
+		Py_DECREF(powers[i]);
+	return result;
+}
+
 /* Convert a long int object to a string, using a given conversion base.
    Return a string object.
    If base is 8 or 16, add the proper prefix '0' or '0x'. */
@@ -1251,60 +1423,12 @@ long_format(PyObject *aa, int base, int addL)
 		}
 	}
 	else {
-		/* Not 0, and base not a power of 2.  Divide repeatedly by
-		   base, but for speed use the highest power of base that
-		   fits in a digit. */
-		Py_ssize_t size = size_a;
-		digit *pin = a->ob_digit;
-		PyLongObject *scratch;
-		/* powbasw <- largest power of base that fits in a digit. */
-		digit powbase = base;  /* powbase == base ** power */
-		int power = 1;
-		for (;;) {
-			unsigned long newpow = powbase * (unsigned long)base;
-			if (newpow >> SHIFT)  /* doesn't fit in a digit */
-				break;
-			powbase = (digit)newpow;
-			++power;
-		}
-
-		/* Get a scratch area for repeated division. */
-		scratch = _PyLong_New(size);
-		if (scratch == NULL) {
+		/* Not 0, and base not a power of 2. */
+		if (long_format_dc(a, base, &p) < 0) {
 			Py_DECREF(str);
 			return NULL;
 		}
-
-		/* Repeatedly divide by powbase. */
-		do {
-			int ntostore = power;
-			digit rem = inplace_divrem1(scratch->ob_digit,
-						     pin, size, powbase);
-			pin = scratch->ob_digit; /* no need to use a again */
-			if (pin[size - 1] == 0)
-				--size;
-			SIGCHECK({
-				Py_DECREF(scratch);
-				Py_DECREF(str);
-				return NULL;
-			})
-
-			/* Break rem into digits. */
-			assert(ntostore > 0);
-			do {
-				digit nextrem = (digit)(rem / base);
-				char c = (char)(rem - nextrem * base);
-				assert(p > PyString_AS_STRING(str));
-				c += (c < 10) ? '0' : 'a'-10;
-				*--p = c;
-				rem = nextrem;
-				--ntostore;
-				/* Termination is a bit delicate:  must not
-				   store leading zeroes, so must get out if
-				   remaining quotient and rem are both 0. */
-			} while (ntostore && (size || rem));
-		} while (size != 0);
-		Py_DECREF(scratch);
+		assert(p >= PyString_AS_STRING(str));
 	}
 
 	if (base == 8) {
@@ -1428,49 +1552,12 @@ long_from_binary_base(char **str, int base)
 	return long_normalize(z);
 }
 
-PyObject *
-PyLong_FromString(char *str, char **pend, int base)
-{
-	int sign = 1;
-	char *start, *orig_str = str;
-	PyLongObject *z;
-	PyObject *strobj, *strrepr;
-	Py_ssize_t slen;
-
-	if ((base != 0 && base < 2) || base > 36) {
-		PyErr_SetString(PyExc_ValueError,
-				"long() arg 2 must be >= 2 and <= 36");
-		return NULL;
-	}
-	while (*str != '\0' && isspace(Py_CHARMASK(*str)))
-		str++;
-	if (*str == '+')
-		++str;
-	else if (*str == '-') {
-		++str;
-		sign = -1;
-	}
-	while (*str != '\0' && isspace(Py_CHARMASK(*str)))
-		str++;
-	if (base == 0) {
-		if (str[0] != '0')
-			base = 10;
-		else if (str[1] == 'x' || str[1] == 'X')
-			base = 16;
-		else
-			base = 8;
-	}
-	if (base == 16 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
-		str += 2;
-
-	start = str;
-	if ((base & (base - 1)) == 0)
-		z = long_from_binary_base(&str, base);
-	else {
 /***
 Binary bases can be converted in time linear in the number of digits, because
 Python's representation base is binary.  Other bases (including decimal!) use
-the simple quadratic-time algorithm below, complicated by some speed tricks.
+the simple quadratic-time algorithm below, complicated by some speed tricks,
+for up to FROMSTRING_CUTOFF characters; long_from_non_binary_base() splits
+longer strings and puts the pieces together with k_mul.
 
 First some math:  the largest integer that can be expressed in N base-B digits
 is B**N-1.  Consequently, if we have an N-digit input in base B, the worst-
@@ -1508,7 +1595,7 @@ case
 
 where `N` is the number of input digits in base `B`.  This is computed via
 
-    size_z = (Py_ssize_t)((scan - str) * log_base_BASE[base]) + 1;
+    size_z = (Py_ssize_t)((end - str) * log_base_BASE[base]) + 1;
 
 below.  Two numeric concerns are how much space this can waste, and whether
 the computed result can be too small.  To be concrete, assume BASE = 2**15,
@@ -1552,116 +1639,243 @@ that triggers it(!).  Instead the code was tested by artificially allocating
 just 1 digit at the start, so that the copying code was exercised for every
 digit beyond the first.
 ***/
-		register twodigits c;	/* current input character */
-		Py_ssize_t size_z;
-		int i;
-		int convwidth;
-		twodigits convmultmax, convmult;
-		digit *pz, *pzstop;
-		char* scan;
-
-		static double log_base_BASE[37] = {0.0e0,};
-		static int convwidth_base[37] = {0,};
-		static twodigits convmultmax_base[37] = {0,};
-
-		if (log_base_BASE[base] == 0.0) {
-			twodigits convmax = base;
-			int i = 1;
-
-			log_base_BASE[base] = log((double)base) /
-						log((double)BASE);
-			for (;;) {
-				twodigits next = convmax * base;
-				if (next > BASE)
-					break;
-				convmax = next;
-				++i;
-			}
-			convmultmax_base[base] = convmax;
-			assert(i > 0);
-			convwidth_base[base] = i;
-		}
 
-		/* Find length of the string of numeric characters. */
-		scan = str;
-		while (_PyLong_DigitValue[Py_CHARMASK(*scan)] < base)
-			++scan;
+static double log_base_BASE[37] = {0.0e0,};
+static int convwidth_base[37] = {0,};
+static twodigits convmultmax_base[37] = {0,};
 
-		/* Create a long object that can contain the largest possible
-		 * integer with this base and length.  Note that there's no
-		 * need to initialize z->ob_digit -- no slot is read up before
-		 * being stored into.
-		 */
-		size_z = (Py_ssize_t)((scan - str) * log_base_BASE[base]) + 1;
-		/* Uncomment next line to test exceedingly rare copy code */
-		/* size_z = 1; */
-		assert(size_z > 0);
-		z = _PyLong_New(size_z);
-		if (z == NULL)
-			return NULL;
-		z->ob_size = 0;
+static void
+init_conversion_tables(int base)
+{
+	twodigits convmax = base;
+	int i = 1;
 
-		/* `convwidth` consecutive input digits are treated as a single
-		 * digit in base `convmultmax`.
-		 */
-		convwidth = convwidth_base[base];
-		convmultmax = convmultmax_base[base];
-
-		/* Work ;-) */
-		while (str < scan) {
-			/* grab up to convwidth digits from the input string */
-			c = (digit)_PyLong_DigitValue[Py_CHARMASK(*str++)];
-			for (i = 1; i < convwidth && str != scan; ++i, ++str) {
-				c = (twodigits)(c *  base +
-					_PyLong_DigitValue[Py_CHARMASK(*str)]);
-				assert(c < BASE);
-			}
+	if (log_base_BASE[base] != 0.0)
+		return;
+	log_base_BASE[base] = log((double)base) / log((double)BASE);
+	for (;;) {
+		twodigits next = convmax * base;
+		if (next > BASE)
+			break;
+		convmax = next;
+		++i;
+	}
+	convmultmax_base[base] = convmax;
+	assert(i > 0);
+	convwidth_base[base] = i;
+}
 
-			convmult = convmultmax;
-			/* Calculate the shift only if we couldn't get
-			 * convwidth digits.
-			 */
-			if (i != convwidth) {
-				convmult = base;
-				for ( ; i > 1; --i)
-					convmult *= base;
-			}
+/* Convert the base `base` digits from str up to end, where base is not a
+ * power of 2, and init_conversion_tables(base) has been called.
+ */
+static PyLongObject *
+long_from_digits(char *str, char *end, int base)
+{
+	register twodigits c;	/* current input character */
+	Py_ssize_t size_z;
+	int i;
+	int convwidth;
+	twodigits convmultmax, convmult;
+	digit *pz, *pzstop;
+	PyLongObject *z;
+
+	/* Create a long object that can contain the largest possible
+	 * integer with this base and length.  Note that there's no
+	 * need to initialize z->ob_digit -- no slot is read up before
+	 * being stored into.
+	 */
+	size_z = (Py_ssize_t)((end - str) * log_base_BASE[base]) + 1;
+	/* Uncomment next line to test exceedingly rare copy code */
+	/* size_z = 1; */
+	assert(size_z > 0);
+	z = _PyLong_New(size_z);
+	if (z == NULL)
+		return NULL;
+	z->ob_size = 0;
 
-			/* Multiply z by convmult, and add c. */
-			pz = z->ob_digit;
-			pzstop = pz + z->ob_size;
-			for (; pz < pzstop; ++pz) {
-				c += (twodigits)*pz * convmult;
-				*pz = (digit)(c & MASK);
-				c >>= SHIFT;
+	/* `convwidth` consecutive input digits are treated as a single
+	 * digit in base `convmultmax`.
+	 */
+	convwidth = convwidth_base[base];
+	convmultmax = convmultmax_base[base];
+
+	/* Work ;-) */
+	while (str < end) {
+		/* grab up to convwidth digits from the input string */
+		c = (digit)_PyLong_DigitValue[Py_CHARMASK(*str++)];
+		for (i = 1; i < convwidth && str != end; ++i, ++str) {
+			c = (twodigits)(c *  base +
+				_PyLong_DigitValue[Py_CHARMASK(*str)]);
+			assert(c < BASE);
+		}
+
+		convmult = convmultmax;
+		/* Calculate the shift only if we couldn't get
+		 * convwidth digits.
+		 */
+		if (i != convwidth) {
+			convmult = base;
+			for ( ; i > 1; --i)
+				convmult *= base;
+		}
+
+		/* Multiply z by convmult, and add c. */
+		pz = z->ob_digit;
+		pzstop = pz + z->ob_size;
+		for (; pz < pzstop; ++pz) {
+			c += (twodigits)*pz * convmult;
+			*pz = (digit)(c & MASK);
+			c >>= SHIFT;
+		}
+		/* carry off the current end? */
+		if (c) {
+			assert(c < BASE);
+			if (z->ob_size < size_z) {
+				*pz = (digit)c;
+				++z->ob_size;
 			}
-			/* carry off the current end? */
-			if (c) {
-				assert(c < BASE);
-				if (z->ob_size < size_z) {
-					*pz = (digit)c;
-					++z->ob_size;
-				}
-				else {
-					PyLongObject *tmp;
-					/* Extremely rare.  Get more space. */
-					assert(z->ob_size == size_z);
-					tmp = _PyLong_New(size_z + 1);
-					if (tmp == NULL) {
-						Py_DECREF(z);
-						return NULL;
-					}
-					memcpy(tmp->ob_digit,
-					       z->ob_digit,
-					       sizeof(digit) * size_z);
+			else {
+				PyLongObject *tmp;
+				/* Extremely rare.  Get more space. */
+				assert(z->ob_size == size_z);
+				tmp = _PyLong_New(size_z + 1);
+				if (tmp == NULL) {
 					Py_DECREF(z);
-					z = tmp;
-					z->ob_digit[size_z] = (digit)c;
-					++size_z;
+					return NULL;
 				}
+				memcpy(tmp->ob_digit,
+				       z->ob_digit,
+				       sizeof(digit) * size_z);
+				Py_DECREF(z);
+				z = tmp;
+				z->ob_digit[size_z] = (digit)c;
+				++size_z;
 			}
 		}
 	}
+	return z;
+}
+
+/* Divide and conquer for long_from_digits:  the value of the characters
+ * from str up to end is hi * base**k + lo, where lo is the value of the
+ * last k of them and hi that of the rest.  powers[i] is base**(width << i),
+ * and k is the largest of those exponents below the number of characters.
+ */
+static PyLongObject *
+long_from_digits_rec(char *str, char *end, int base,
+		     PyLongObject **powers, int level, int width)
+{
+	PyLongObject *hi, *lo, *t, *z;
+	Py_ssize_t k;
+
+	if (end - str <= FROMSTRING_CUTOFF)
+		return long_from_digits(str, end, base);
+	while (((Py_ssize_t)width << level) >= end - str)
+		--level;
+	assert(level >= 0);
+	k = (Py_ssize_t)width << level;
+
+	hi = long_from_digits_rec(str, end - k, base, powers, level, width);
+	if (hi == NULL)
+		return NULL;
+	t = k_mul(hi, powers[level]);
+	Py_DECREF(hi);
+	if (t == NULL)
+		return NULL;
+	lo = long_from_digits_rec(end - k, end, base, powers, level - 1, width);
+	if (lo == NULL) {
+		Py_DECREF(t);
+		return NULL;
+	}
+	z = x_add(t, lo);
+	Py_DECREF(t);
+	Py_DECREF(lo);
+	return z;
+}
+
+/* Convert the base `base` digits from str up to end, where base is not a
+ * power of 2.  This is quadratic in the number of digits up to
+ * FROMSTRING_CUTOFF of them, and as fast as k_mul past that.
+ */
+static PyLongObject *
+long_from_non_binary_base(char *str, char *end, int base)
+{
+	PyLongObject *powers[8 * sizeof(Py_ssize_t)];
+	PyLongObject *z = NULL;
+	int i, n, width;
+
+	init_conversion_tables(base);
+	if (end - str <= FROMSTRING_CUTOFF)
+		return long_from_digits(str, end, base);
+
+	/* Square base**width until the top power has about half the
+	 * characters.
+	 */
+	width = convwidth_base[base];
+	powers[0] = (PyLongObject *)PyLong_FromLong(
+				(long)convmultmax_base[base]);
+	if (powers[0] == NULL)
+		return NULL;
+	for (n = 1; ((Py_ssize_t)width << n) < end - str; ++n) {
+		powers[n] = k_mul(powers[n-1], powers[n-1]);
+		if (powers[n] == NULL)
+			goto done;
+	}
+	z = long_from_digits_rec(str, end, base, powers, n - 1, width);
+
+ done:
+	for (i = 0; i < n; ++i)
+		Py_DECREF(powers[i]);
+	return z;
+}
+
+PyObject *
+PyLong_FromString(char *str, char **pend, int base)
+{
+	int sign = 1;
+	char *start, *orig_str = str;
+	PyLongObject *z;
+	PyObject *strobj, *strrepr;
+	Py_ssize_t slen;
+
+	if ((base != 0 && base < 2) || base > 36) {
+		PyErr_SetString(PyExc_ValueError,
+				"long() arg 2 must be >= 2 and <= 36");
+		return NULL;
+	}
+	while (*str != '\0' && isspace(Py_CHARMASK(*str)))
+		str++;
+	if (*str == '+')
+		++str;
+	else if (*str == '-') {
+		++str;
+		sign = -1;
+	}
+	while (*str != '\0' && isspace(Py_CHARMASK(*str)))
+		str++;
+	if (base == 0) {
+		if (str[0] != '0')
+			base = 10;
+		else if (str[1] == 'x' || str[1] == 'X')
+			base = 16;
+		else
+			base = 8;
+	}
+	if (base == 16 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+		str += 2;
+
+	start = str;
+	if ((base & (base - 1)) == 0)
+		z = long_from_binary_base(&str, base);
+	else {
+		char *scan = str;
+
+		/* Find length of the string of numeric characters. */
+		while (_PyLong_DigitValue[Py_CHARMASK(*scan)] < base)
+			++scan;
+		z = long_from_non_binary_base(str, scan, base);
+		str = scan;
+	}
 	if (z == NULL)
 		return NULL;
 	if (str == start)
@@ -1718,9 +1932,9 @@ PyLong_FromUnicode(Py_UNICODE *u, Py_ssize_t length, int base)
 /* forward */
 static PyLongObject *x_divrem
 	(PyLongObject *, PyLongObject *, PyLongObject **);
+static PyLongObject *x_divrem_bz
+	(PyLongObject *, PyLongObject *, PyLongObject **);
 static PyObject *long_pos(PyLongObject *);
-static int long_divrem(PyLongObject *, PyLongObject *,
-	PyLongObject **, PyLongObject **);
 
 /* Long division with remainder, top-level routine */
 
@@ -1759,7 +1973,10 @@ long_divrem(PyLongObject *a, PyLongObject *b,
 		}
 	}
 	else {
-		z = x_divrem(a, b, prem);
+		if (size_b > BZ_CUTOFF && size_a - size_b > BZ_CUTOFF)
+			z = x_divrem_bz(a, b, prem);
+		else
+			z = x_divrem(a, b, prem);
 		if (z == NULL)
 			return -1;
 	}
@@ -1875,6 +2092,278 @@ x_divrem(PyLongObject *v1, PyLongObject *w1, PyLongObject **prem)
 	return a;
 }
 
+/* Recursive division, after Burnikel and Ziegler, "Fast Recursive
+   Division" (MPI-I-98-1-022).  Dividing an m-digit number by an n-digit
+   one with x_divrem costs O(n*(m-n)) digit operations, quadratic when
+   both are big, as they are when str() splits a number in halves.  The
+   recursive form does the work in k_mul instead, and so inherits its
+   O(n**1.585).
+
+   Everything here works on absolute values.  The divisor is normalized
+   like x_divrem normalizes it, so that its top digit is at least BASE/2;
+   that is what bounds the number of corrections in bz_div3n2n by two.
+   Below BZ_CUTOFF digits the recursion bottoms out in x_divrem. */
+
+/* Return digits [lo, hi) of abs(n) as a new long. */
+
+static PyLongObject *
+long_slice(PyLongObject *n, Py_ssize_t lo, Py_ssize_t hi)
+{
+	const Py_ssize_t size_n = ABS(n->ob_size);
+	PyLongObject *z;
+
+	hi = MIN(hi, size_n);
+	lo = MIN(lo, hi);
+	z = _PyLong_New(hi - lo);
+	if (z == NULL)
+		return NULL;
+	memcpy(z->ob_digit, n->ob_digit + lo, (hi - lo) * sizeof(digit));
+	return long_normalize(z);
+}
+
+/* Return abs(hi) * BASE**shift + abs(lo); abs(lo) must be < BASE**shift. */
+
+static PyLongObject *
+long_join(PyLongObject *hi, PyLongObject *lo, Py_ssize_t shift)
+{
+	const Py_ssize_t size_hi = ABS(hi->ob_size);
+	const Py_ssize_t size_lo = ABS(lo->ob_size);
+	PyLongObject *z;
+
+	assert(size_lo <= shift);
+	if (size_hi == 0)
+		return long_slice(lo, 0, size_lo);
+	z = _PyLong_New(shift + size_hi);
+	if (z == NULL)
+		return NULL;
+	memcpy(z->ob_digit, lo->ob_digit, size_lo * sizeof(digit));
+	memset(z->ob_digit + size_lo, 0, (shift - size_lo) * sizeof(digit));
+	memcpy(z->ob_digit + shift, hi->ob_digit, size_hi * sizeof(digit));
+	return z;
+}
+
+static int bz_div2n1n(PyLongObject *, PyLongObject *, Py_ssize_t,
+		      PyLongObject **, PyLongObject **);
+
+/* Divide [a12, a3] = a12 * BASE**n + a3 by b = b1 * BASE**n + b2, where
+   b has 2*n digits, a3 < BASE**n and the quotient fits in n digits. */
+
+static int
+bz_div3n2n(PyLongObject *a12, PyLongObject *a3, PyLongObject *b,
+	   PyLongObject *b1, PyLongObject *b2, Py_ssize_t n,
+	   PyLongObject **pq, PyLongObject **pr)
+{
+	PyLongObject *q = NULL, *r = NULL, *t, *u;
+	Py_ssize_t i;
+
+	if (ABS(a12->ob_size) - n == ABS(b1->ob_size) &&
+	    memcmp(a12->ob_digit + n, b1->ob_digit,
+		   ABS(b1->ob_size) * sizeof(digit)) == 0) {
+		/* The estimate a12 // b1 would not fit in n digits;
+		   use BASE**n - 1 and its remainder a12 - q*b1. */
+		q = _PyLong_New(n);
+		if (q == NULL)
+			return -1;
+		for (i = 0; i < n; ++i)
+			q->ob_digit[i] = MASK;
+		t = long_slice(a12, 0, n);
+		if (t == NULL)
+			goto error;
+		r = x_add(t, b1);
+		Py_DECREF(t);
+	}
+	else if (bz_div2n1n(a12, b1, n, &q, &r) < 0)
+		return -1;
+	if (r == NULL)
+		goto error;
+
+	/* r = [r, a3] - q*b2, then add b back until it's >= 0 */
+	t = long_join(r, a3, n);
+	Py_DECREF(r);
+	r = NULL;
+	if (t == NULL)
+		goto error;
+	u = k_mul(q, b2);
+	if (u == NULL) {
+		Py_DECREF(t);
+		goto error;
+	}
+	r = x_sub(t, u);
+	Py_DECREF(t);
+	Py_DECREF(u);
+	if (r == NULL)
+		goto error;
+	while (r->ob_size < 0) {
+		t = (PyLongObject *)long_add(r, b);
+		if (t == NULL)
+			goto error;
+		Py_DECREF(r);
+		r = t;
+		u = (PyLongObject *)PyLong_FromLong(1L);
+		if (u == NULL)
+			goto error;
+		t = x_sub(q, u);
+		Py_DECREF(u);
+		if (t == NULL)
+			goto error;
+		Py_DECREF(q);
+		q = t;
+	}
+	*pq = q;
+	*pr = r;
+	return 0;
+
+ error:
+	Py_XDECREF(q);
+	Py_XDECREF(r);
+	return -1;
+}
+
+/* Divide a by b, where b has n digits and is normalized, and
+   a < b * BASE**n, so that the quotient fits in n digits. */
+
+static int
+bz_div2n1n(PyLongObject *a, PyLongObject *b, Py_ssize_t n,
+	   PyLongObject **pq, PyLongObject **pr)
+{
+	PyLongObject *a12 = NULL, *a3 = NULL, *b1 = NULL, *b2 = NULL;
+	PyLongObject *q1 = NULL, *q2 = NULL, *r = NULL, *t;
+	Py_ssize_t half;
+	int pad, result = -1;
+
+	if (n <= BZ_CUTOFF)
+		return long_divrem(a, b, pq, pr);
+
+	/* Split in halves; for odd n, work with a and b times BASE */
+	pad = n & 1;
+	if (pad) {
+		a3 = _PyLong_New(0);
+		if (a3 == NULL)
+			return -1;
+		a = long_join(a, a3, 1);
+		b = long_join(b, a3, 1);
+		Py_CLEAR(a3);
+		if (a == NULL || b == NULL) {
+			Py_XDECREF(a);
+			Py_XDECREF(b);
+			return -1;
+		}
+		++n;
+	}
+	half = n >> 1;
+
+	if ((b1 = long_slice(b, half, n)) == NULL ||
+	    (b2 = long_slice(b, 0, half)) == NULL ||
+	    (a12 = long_slice(a, n, PY_SSIZE_T_MAX)) == NULL ||
+	    (a3 = long_slice(a, half, n)) == NULL)
+		goto done;
+	if (bz_div3n2n(a12, a3, b, b1, b2, half, &q1, &t) < 0)
+		goto done;
+	Py_DECREF(a3);
+	a3 = long_slice(a, 0, half);
+	if (a3 == NULL) {
+		Py_DECREF(t);
+		goto done;
+	}
+	result = bz_div3n2n(t, a3, b, b1, b2, half, &q2, &r);
+	Py_DECREF(t);
+	if (result < 0)
+		goto done;
+	result = -1;
+	if ((t = long_join(q1, q2, half)) == NULL)
+		goto done;
+	*pq = t;
+	if (pad) {
+		t = long_slice(r, 1, PY_SSIZE_T_MAX);
+		Py_DECREF(r);
+		r = t;
+		if (r == NULL) {
+			Py_CLEAR(*pq);
+			goto done;
+		}
+	}
+	*pr = r;
+	r = NULL;
+	result = 0;
+
+ done:
+	Py_XDECREF(a12);
+	Py_XDECREF(a3);
+	Py_XDECREF(b1);
+	Py_XDECREF(b2);
+	Py_XDECREF(q1);
+	Py_XDECREF(q2);
+	Py_XDECREF(r);
+	if (pad) {
+		Py_DECREF(a);
+		Py_DECREF(b);
+	}
+	return result;
+}
+
+/* Unsigned long division with remainder, for long divisors.  Like
+   long division by hand, a is divided by b an n-digit block at a time,
+   where n is the size of b, but each step is a recursive bz_div2n1n. */
+
+static PyLongObject *
+x_divrem_bz(PyLongObject *v1, PyLongObject *w1, PyLongObject **prem)
+{
+	Py_ssize_t size_v, size_w = ABS(w1->ob_size);
+	digit d = (digit) ((twodigits)BASE / (w1->ob_digit[size_w-1] + 1));
+	PyLongObject *v = mul1(v1, d);
+	PyLongObject *w = mul1(w1, d);
+	PyLongObject *a = NULL, *r = NULL, *block, *q, *t;
+	Py_ssize_t j;
+
+	if (v == NULL || w == NULL)
+		goto error;
+	assert(size_w == ABS(w->ob_size)); /* That's how d was calculated */
+	size_v = ABS(v->ob_size);
+	a = _PyLong_New(size_v);
+	if (a == NULL)
+		goto error;
+	memset(a->ob_digit, 0, size_v * sizeof(digit));
+	r = _PyLong_New(0);
+	if (r == NULL)
+		goto error;
+
+	/* Blocks from the top down; the top one may be partial. */
+	for (j = (size_v - 1) / size_w * size_w; j >= 0; j -= size_w) {
+		block = long_slice(v, j, j + size_w);
+		if (block == NULL)
+			goto error;
+		t = long_join(r, block, size_w);
+		Py_DECREF(block);
+		if (t == NULL)
+			goto error;
+		Py_CLEAR(r);
+		if (bz_div2n1n(t, w, size_w, &q, &r) < 0) {
+			Py_DECREF(t);
+			goto error;
+		}
+		Py_DECREF(t);
+		assert(ABS(q->ob_size) <= size_w);
+		memcpy(a->ob_digit + j, q->ob_digit,
+		       ABS(q->ob_size) * sizeof(digit));
+		Py_DECREF(q);
+	}
+	*prem = divrem1(r, d, &d);
+	/* d receives the (unused) remainder */
+	if (*prem == NULL)
+		goto error;
+	Py_DECREF(r);
+	Py_DECREF(v);
+	Py_DECREF(w);
+	return long_normalize(a);
+
+ error:
+	Py_XDECREF(a);
+	Py_XDECREF(r);
+	Py_XDECREF(v);
+	Py_XDECREF(w);
+	return NULL;
+}
+
 /* Methods */
 
 static void
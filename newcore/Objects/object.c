@@ -15,12 +15,9 @@ _Py_GetRefTotal(void)
 {
 	PyObject *o;
 	Py_ssize_t total = _Py_RefTotal;
-        /* ignore the references to the dummy object of the dicts and sets
+        /* ignore the references to the dummy object of the sets
            because they are not reliable and not useful (now that the
            hash table code is well-tested) */
-	o = _PyDict_Dummy();
-	if (o != NULL)
-		total -= o->ob_refcnt;
 	o = _PySet_Dummy();
 	if (o != NULL)
 		total -= o->ob_refcnt;
@@ -1282,31 +1279,7 @@ PyObject_GenericGetAttr(PyObject *obj, PyObject *name)
 			goto done;
 	}
 
-	/* Inline _PyType_Lookup */
-	{
-		Py_ssize_t i, n;
-		PyObject *mro, *base, *dict;
-
-		/* Look in tp_dict of types in MRO */
-		mro = tp->tp_mro;
-		assert(mro != NULL);
-		assert(PyTuple_Check(mro));
-		n = PyTuple_GET_SIZE(mro);
-		for (i = 0; i < n; i++) {
-			base = PyTuple_GET_ITEM(mro, i);
-			if (PyClass_Check(base))
-				dict = ((PyClassObject *)base)->cl_dict;
-			else {
-				assert(PyType_Check(base));
-				dict = ((PyTypeObject *)base)->tp_dict;
-			}
-			assert(dict && PyDict_Check(dict));
-			descr = PyDict_GetItem(dict, name);
-			if (descr != NULL)
-				break;
-		}
-	}
-
+	descr = _PyType_Lookup(tp, name);
 	Py_XINCREF(descr);
 
 	f = NULL;
@@ -1420,25 +1393,11 @@ PyObject_GenericSetAttr(PyObject *obj, PyObject *name, PyObject *value)
 	}
 
 	dictptr = _PyObject_GetDictPtr(obj);
-	if (dictptr != NULL) {
-		PyObject *dict = *dictptr;
-		if (dict == NULL && value != NULL) {
-			dict = PyDict_New();
-			if (dict == NULL)
-				goto done;
-			*dictptr = dict;
-		}
-		if (dict != NULL) {
-			Py_INCREF(dict);
-			if (value == NULL)
-				res = PyDict_DelItem(dict, name);
-			else
-				res = PyDict_SetItem(dict, name, value);
-			if (res < 0 && PyErr_ExceptionMatches(PyExc_KeyError))
-				PyErr_SetObject(PyExc_AttributeError, name);
-			Py_DECREF(dict);
-			goto done;
-		}
+	if (dictptr != NULL && (*dictptr != NULL || value != NULL)) {
+		res = _PyObjectDict_SetItem(tp, dictptr, name, value);
+		if (res < 0 && PyErr_ExceptionMatches(PyExc_KeyError))
+			PyErr_SetObject(PyExc_AttributeError, name);
+		goto done;
 	}
 
 	if (f != NULL) {
@@ -62,7 +62,8 @@
  * Allocation strategy abstract:
  *
  * For small requests, the allocator sub-allocates <Big> blocks of memory.
- * Requests greater than 256 bytes are routed to the system's allocator.
+ * Medium requests, up to 8K, are served from arenas of their own, and
+ * requests greater than that are routed to the system's allocator.
  *
  * Small requests are grouped in size classes spaced 8 bytes apart, due
  * to the required valid alignment of the returned address. Requests of
@@ -97,7 +98,24 @@
  *	241-248                 248                      30
  *	249-256                 256                      31
  *
- *	0, 257 and up: routed to the underlying allocator.
+ *	0: routed to the underlying allocator.
+ *
+ * Medium requests are grouped in size classes at powers of two and halfway
+ * between them, so that no more than a third of a block is wasted.  Each
+ * medium arena holds blocks of a single size class, carved off in address
+ * order and recycled through a free list, like the blocks of a pool:
+ *
+ * Request in bytes	Size of allocated block      Size class idx
+ * ----------------------------------------------------------------
+ *	257-384                 384                       0
+ *	385-512                 512                       1
+ *	513-768                 768                       2
+ *	769-1024               1024                       3
+ *	  ...                   ...                     ...
+ *     4097-6144               6144                       8
+ *     6145-8192               8192                       9
+ *
+ *	8193 and up: routed to the underlying allocator.
  */
 
 /*==========================================================================*/
@@ -136,6 +154,21 @@
 #define SMALL_REQUEST_THRESHOLD	256
 #define NB_SMALL_SIZE_CLASSES	(SMALL_REQUEST_THRESHOLD / ALIGNMENT)
 
+/*
+ * Requests up to MEDIUM_REQUEST_THRESHOLD bytes that are too big for the
+ * pools are served from medium arenas.  There are two size classes per power
+ * of two above SMALL_REQUEST_THRESHOLD, so the threshold must be a power of
+ * 2 and small enough that an arena holds a few blocks of the largest class.
+ */
+#define MEDIUM_REQUEST_THRESHOLD	8192
+#define NB_MEDIUM_SIZE_CLASSES		10	/* 2 * log2(8192 / 256) */
+
+/* Return the number of bytes in medium size class I, as a uint:
+ * 384, 512, 768, 1024, ... 6144, 8192.
+ */
+#define MEDIUM_INDEX2SIZE(I) ((I) & 1 ? 1U << (9 + ((I) >> 1)) : \
+				        3U << (7 + ((I) >> 1)))
+
 /*
  * The system's VMM page size can be obtained on most unices with a
  * getpagesize() call or deduced from various header files. To make
@@ -179,6 +212,10 @@
 #define MAX_ARENAS		(SMALL_MEMORY_LIMIT / ARENA_SIZE)
 #endif
 
+#if ARENA_SIZE < 4 * MEDIUM_REQUEST_THRESHOLD
+#error "ARENA_SIZE is too small for MEDIUM_REQUEST_THRESHOLD"
+#endif
+
 /*
  * Size of the pools used for small blocks. Should be a power of 2,
  * between 1K and SYSTEM_PAGE_SIZE, that is: 1k, 2k, 4k.
@@ -471,6 +508,19 @@ usable_arenas
 
 Note that an arena_object associated with an arena all of whose pools are
 currently in use isn't on either list.
+
+Spare arenas
+
+    An arena whose pools have all become free is not necessarily free()'d
+    right away.  Up to arena_spare_limit() such empty arenas stay on
+    usable_arenas (where the sort order puts them at the end), so a script
+    that repeatedly grows and shrinks its heap by a few arenas doesn't pay
+    for a malloc()/free() pair every time.  The limit is the larger of
+    spare_arenas and a fraction of the high-water mark, so a big burst keeps
+    a proportionally bigger cache.  _PyObject_TrimArenas() hands the empty
+    arenas beyond a given count back to the system and resets the high-water
+    mark; the cyclic gc calls it after each full collection, and it is also
+    exposed as sys.trimheap().
 */
 
 /* Array of objects used to track chunks of memory (arenas). */
@@ -497,11 +547,30 @@ static struct arena_object* usable_arenas = NULL;
 /* Number of arenas allocated that haven't been free()'d. */
 static size_t narenas_currently_allocated = 0;
 
+/* High water mark (max value ever seen) for narenas_currently_allocated,
+ * since the last _PyObject_TrimArenas().
+ */
+static size_t narenas_highwater = 0;
+
+/* Number of arenas on usable_arenas with all their pools free. */
+static size_t narenas_spare = 0;
+
+/* Minimum number of empty arenas kept around instead of being free()'d. */
+#ifndef SPARE_ARENAS
+#define SPARE_ARENAS 1
+#endif
+static uint spare_arenas = SPARE_ARENAS;
+
+/* Above spare_arenas, keep up to 1/8 of the high-water mark as spares. */
+#define SPARE_ARENA_SHIFT 3
+
+#define arena_spare_limit() \
+	(narenas_highwater >> SPARE_ARENA_SHIFT > spare_arenas ? \
+	 narenas_highwater >> SPARE_ARENA_SHIFT : (size_t)spare_arenas)
+
 #ifdef PYMALLOC_DEBUG
 /* Total number of times malloc() called to allocate an arena. */
 static size_t ntimes_arena_allocated = 0;
-/* High water mark (max value ever seen) for narenas_currently_allocated. */
-static size_t narenas_highwater = 0;
 #endif
 
 /* Allocate a new arena.  If we run out of memory, return NULL.  Else
@@ -575,10 +644,12 @@ new_arena(void)
 	}
 
 	++narenas_currently_allocated;
-#ifdef PYMALLOC_DEBUG
-	++ntimes_arena_allocated;
 	if (narenas_currently_allocated > narenas_highwater)
 		narenas_highwater = narenas_currently_allocated;
+	/* All of its pools are free; PyObject_Malloc() takes one right away. */
+	++narenas_spare;
+#ifdef PYMALLOC_DEBUG
+	++ntimes_arena_allocated;
 #endif
 	arenaobj->freepools = NULL;
 	/* pool_address <- first pool-aligned address in the arena
@@ -596,6 +667,290 @@ new_arena(void)
 	return arenaobj;
 }
 
+/* Unlink the empty arena `ao` from usable_arenas, free() it, and put its
+ * arena_object back on unused_arena_objects.
+ */
+static void
+release_arena(struct arena_object *ao)
+{
+	assert(ao->nfreepools == ao->ntotalpools);
+	assert(ao->prevarena == NULL ||
+	       ao->prevarena->address != 0);
+	assert(ao ->nextarena == NULL ||
+	       ao->nextarena->address != 0);
+
+	/* Fix the pointer in the prevarena, or the
+	 * usable_arenas pointer.
+	 */
+	if (ao->prevarena == NULL) {
+		usable_arenas = ao->nextarena;
+		assert(usable_arenas == NULL ||
+		       usable_arenas->address != 0);
+	}
+	else {
+		assert(ao->prevarena->nextarena == ao);
+		ao->prevarena->nextarena =
+			ao->nextarena;
+	}
+	/* Fix the pointer in the nextarena. */
+	if (ao->nextarena != NULL) {
+		assert(ao->nextarena->prevarena == ao);
+		ao->nextarena->prevarena =
+			ao->prevarena;
+	}
+	/* Record that this arena_object slot is
+	 * available to be reused.
+	 */
+	ao->nextarena = unused_arena_objects;
+	unused_arena_objects = ao;
+
+	/* Free the entire arena. */
+	PyCore_FREE_FUNC((void *)ao->address);
+	ao->address = 0;	/* mark unassociated */
+	--narenas_currently_allocated;
+}
+
+/*==========================================================================
+Medium blocks.
+
+Requests between SMALL_REQUEST_THRESHOLD and MEDIUM_REQUEST_THRESHOLD bytes
+are served from medium arenas.  A medium arena is ARENA_SIZE bytes obtained
+from PyCore_MALLOC_FUNC like any other arena, but it isn't split into pools:
+it starts with a medium_arena header and the rest is carved into blocks of a
+single size class.  As in a pool, blocks are handed out in address order the
+first time and then recycled through a singly-linked free list, so an arena
+never touches memory it doesn't need.
+
+Medium arenas are not in `arenas`.  A medium block spans several pages, so
+POOL_ADDR(p) of a medium block may point into the middle of another block,
+where Py_ADDRESS_IN_RANGE() reads user data as an arena index.  That's fine
+as long as the index can't name the arena p is in:  Py_ADDRESS_IN_RANGE()
+then reports the block as not ours, exactly as for memory obtained from the
+system.  So PyObject_Free() tries the pools first and only then looks the
+address up in `medium_arenas`, a vector of all medium arenas sorted by
+address.  That binary search is only paid by blocks that are not small.
+
+medium_usable[i] is a doubly-linked list of the arenas of size class i that
+have free blocks, and allocations come from its head.  An arena that becomes
+full is unlinked, and one that gets a block back after being full is linked
+in at the front again.  An arena whose blocks are all free is returned to the
+system unless it's the only usable arena of its class, so a script that
+allocates and frees one medium block in a loop doesn't pay for an arena each
+time.  Such spares are released by _PyObject_TrimArenas().
+*/
+
+struct medium_arena {
+	block *freeblock;		/* arena's free list head	 */
+	uint count;			/* number of allocated blocks	 */
+	uint szidx;			/* medium size class index	 */
+	uint nextoffset;		/* bytes to virgin block	 */
+	uint maxnextoffset;		/* largest valid nextoffset	 */
+	struct medium_arena *nextarena;	/* next usable arena of the class */
+	struct medium_arena *prevarena;	/* previous usable arena ""	 */
+};
+
+#define MEDIUM_OVERHEAD		ROUNDUP(sizeof(struct medium_arena))
+
+/* Return total number of blocks in a medium arena of size index I. */
+#define MEDIUM_NUMBLOCKS(I) \
+	((uint)(ARENA_SIZE - MEDIUM_OVERHEAD) / MEDIUM_INDEX2SIZE(I))
+
+/* Is there neither a free nor a virgin block left in arena MA? */
+#define MEDIUM_ARENA_FULL(MA) \
+	((MA)->freeblock == NULL && (MA)->nextoffset > (MA)->maxnextoffset)
+
+static struct medium_arena *medium_usable[NB_MEDIUM_SIZE_CLASSES];
+
+/* All allocated medium arenas, in increasing address order. */
+static struct medium_arena **medium_arenas = NULL;
+static uint nmedium_arenas = 0;
+static uint maxmedium_arenas = 0;
+
+#ifdef PYMALLOC_DEBUG
+/* Total number of times malloc() called to allocate a medium arena. */
+static size_t ntimes_medium_arena_allocated = 0;
+#endif
+
+/* Return the size class index for a request of 257..8192 bytes. */
+Py_LOCAL_INLINE(uint)
+medium_size_index(size_t nbytes)
+{
+	uint n = (uint)(nbytes - 1);
+	uint shift = 8;
+
+	while (n >> (shift + 1))
+		++shift;
+	/* n is in [1 << shift, 2 << shift); the bit below the top one tells
+	 * in which half of that range it is. */
+	return ((shift - 8) << 1) + ((n >> (shift - 1)) & 1);
+}
+
+/* Return the position in medium_arenas of the first arena whose address
+ * is greater than p.
+ */
+static uint
+medium_arena_position(const void *p)
+{
+	uint lo = 0, hi = nmedium_arenas;
+
+	while (lo < hi) {
+		uint mid = (lo + hi) >> 1;
+		if ((uptr)medium_arenas[mid] <= (uptr)p)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Return the medium arena that p points into, or NULL if there is none. */
+Py_LOCAL_INLINE(struct medium_arena *)
+medium_arena_of(const void *p)
+{
+	struct medium_arena *ma;
+	uint i;
+
+	if (nmedium_arenas == 0)
+		return NULL;
+	i = medium_arena_position(p);
+	if (i == 0)
+		return NULL;
+	ma = medium_arenas[i - 1];
+	if ((uptr)p - (uptr)ma >= (uptr)ARENA_SIZE)
+		return NULL;
+	return ma;
+}
+
+/* Allocate a medium arena for size class `szidx` and make it the only
+ * usable one of its class.  Return NULL if we run out of memory.
+ */
+static struct medium_arena *
+new_medium_arena(uint szidx)
+{
+	struct medium_arena *ma;
+	uint i;
+
+	assert(medium_usable[szidx] == NULL);
+	if (nmedium_arenas == maxmedium_arenas) {
+		struct medium_arena **v;
+		uint n = maxmedium_arenas ? maxmedium_arenas << 1 :
+					    INITIAL_ARENA_OBJECTS;
+		if (n <= maxmedium_arenas ||
+		    n > PY_SIZE_MAX / sizeof(*medium_arenas))
+			return NULL;	/* overflow */
+		v = (struct medium_arena **)PyCore_REALLOC_FUNC(medium_arenas,
+						n * sizeof(*medium_arenas));
+		if (v == NULL)
+			return NULL;
+		medium_arenas = v;
+		maxmedium_arenas = n;
+	}
+	ma = (struct medium_arena *)PyCore_MALLOC_FUNC(ARENA_SIZE);
+	if (ma == NULL)
+		return NULL;
+#ifdef PYMALLOC_DEBUG
+	++ntimes_medium_arena_allocated;
+#endif
+
+	i = medium_arena_position(ma);
+	memmove(&medium_arenas[i + 1], &medium_arenas[i],
+		(nmedium_arenas - i) * sizeof(*medium_arenas));
+	medium_arenas[i] = ma;
+	++nmedium_arenas;
+
+	ma->freeblock = NULL;
+	ma->count = 0;
+	ma->szidx = szidx;
+	ma->nextoffset = MEDIUM_OVERHEAD;
+	ma->maxnextoffset = ARENA_SIZE - MEDIUM_INDEX2SIZE(szidx);
+	ma->nextarena = ma->prevarena = NULL;
+	medium_usable[szidx] = ma;
+	return ma;
+}
+
+/* Unlink the empty medium arena `ma` from its usable list and free() it. */
+static void
+release_medium_arena(struct medium_arena *ma)
+{
+	uint i;
+
+	assert(ma->count == 0);
+	if (ma->prevarena != NULL)
+		ma->prevarena->nextarena = ma->nextarena;
+	else {
+		assert(medium_usable[ma->szidx] == ma);
+		medium_usable[ma->szidx] = ma->nextarena;
+	}
+	if (ma->nextarena != NULL)
+		ma->nextarena->prevarena = ma->prevarena;
+
+	i = medium_arena_position(ma) - 1;
+	assert(medium_arenas[i] == ma);
+	--nmedium_arenas;
+	memmove(&medium_arenas[i], &medium_arenas[i + 1],
+		(nmedium_arenas - i) * sizeof(*medium_arenas));
+	PyCore_FREE_FUNC(ma);
+}
+
+/* Allocate a block of medium size class `szidx`.  Return NULL if there is
+ * no free block and no new arena can be allocated.
+ */
+Py_LOCAL_INLINE(void *)
+medium_alloc(uint szidx)
+{
+	struct medium_arena *ma;
+	block *bp;
+
+	LOCK();
+	ma = medium_usable[szidx];
+	if (ma == NULL) {
+		ma = new_medium_arena(szidx);
+		if (ma == NULL) {
+			UNLOCK();
+			return NULL;
+		}
+	}
+	if ((bp = ma->freeblock) != NULL)
+		ma->freeblock = *(block **)bp;
+	else {
+		assert(ma->nextoffset <= ma->maxnextoffset);
+		bp = (block *)ma + ma->nextoffset;
+		ma->nextoffset += MEDIUM_INDEX2SIZE(szidx);
+	}
+	++ma->count;
+	if (MEDIUM_ARENA_FULL(ma)) {
+		/* Arena is full, unlink it from the usable ones. */
+		assert(ma->prevarena == NULL);
+		medium_usable[szidx] = ma->nextarena;
+		if (ma->nextarena != NULL)
+			ma->nextarena->prevarena = NULL;
+	}
+	UNLOCK();
+	return (void *)bp;
+}
+
+/* Return block p to its medium arena, which must be the arena of p. */
+static void
+medium_free(void *p, struct medium_arena *ma)
+{
+	LOCK();
+	assert(ma->count > 0);
+	if (MEDIUM_ARENA_FULL(ma)) {
+		/* It's usable again:  link it in at the front. */
+		ma->prevarena = NULL;
+		ma->nextarena = medium_usable[ma->szidx];
+		if (ma->nextarena != NULL)
+			ma->nextarena->prevarena = ma;
+		medium_usable[ma->szidx] = ma;
+	}
+	*(block **)p = ma->freeblock;
+	ma->freeblock = (block *)p;
+	if (--ma->count == 0 &&
+	    (ma->prevarena != NULL || ma->nextarena != NULL))
+		release_medium_arena(ma);
+	UNLOCK();
+}
+
 /*
 Py_ADDRESS_IN_RANGE(P, POOL)
 
@@ -709,10 +1064,6 @@ int Py_ADDRESS_IN_RANGE(void *P, poolp pool) Py_NO_INLINE;
 
 /*==========================================================================*/
 
-/* malloc.  Note that nbytes==0 tries to return a non-NULL pointer, distinct
- * from all other currently live pointers.  This may not be possible.
- */
-
 /*
  * The basic blocks are ordered by decreasing execution frequency,
  * which minimizes the number of jumps in the most common cases,
@@ -721,198 +1072,558 @@ int Py_ADDRESS_IN_RANGE(void *P, poolp pool) Py_NO_INLINE;
  * Unless the optimizer reorders everything, being too smart...
  */
 
-#undef PyObject_Malloc
-void *
-PyObject_Malloc(size_t nbytes)
+/* Allocate a block of size class `size` from the pools.  Return NULL if
+ * there is no free block and no new arena can be allocated.
+ */
+Py_LOCAL_INLINE(void *)
+pool_alloc(uint size)
 {
 	block *bp;
 	poolp pool;
 	poolp next;
-	uint size;
 
+	LOCK();
 	/*
-	 * Limit ourselves to PY_SSIZE_T_MAX bytes to prevent security holes.
-	 * Most python internals blindly use a signed Py_ssize_t to track
-	 * things without checking for overflows or negatives.
-	 * As size_t is unsigned, checking for nbytes < 0 is not required.
-	 */
-	if (nbytes > PY_SSIZE_T_MAX)
-		return NULL;
-
-	/*
-	 * This implicitly redirects malloc(0).
+	 * Most frequent paths first
 	 */
-	if ((nbytes - 1) < SMALL_REQUEST_THRESHOLD) {
-		LOCK();
+	pool = usedpools[size + size];
+	if (pool != pool->nextpool) {
 		/*
-		 * Most frequent paths first
+		 * There is a used pool for this size class.
+		 * Pick up the head block of its free list.
 		 */
-		size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
-		pool = usedpools[size + size];
-		if (pool != pool->nextpool) {
-			/*
-			 * There is a used pool for this size class.
-			 * Pick up the head block of its free list.
-			 */
-			++pool->ref.count;
-			bp = pool->freeblock;
-			assert(bp != NULL);
-			if ((pool->freeblock = *(block **)bp) != NULL) {
-				UNLOCK();
-				return (void *)bp;
-			}
-			/*
-			 * Reached the end of the free list, try to extend it.
-			 */
-			if (pool->nextoffset <= pool->maxnextoffset) {
-				/* There is room for another block. */
-				pool->freeblock = (block*)pool +
-						  pool->nextoffset;
-				pool->nextoffset += INDEX2SIZE(size);
-				*(block **)(pool->freeblock) = NULL;
-				UNLOCK();
-				return (void *)bp;
-			}
-			/* Pool is full, unlink from used pools. */
-			next = pool->nextpool;
-			pool = pool->prevpool;
-			next->prevpool = pool;
-			pool->nextpool = next;
+		++pool->ref.count;
+		bp = pool->freeblock;
+		assert(bp != NULL);
+		if ((pool->freeblock = *(block **)bp) != NULL) {
 			UNLOCK();
 			return (void *)bp;
 		}
-
-		/* There isn't a pool of the right size class immediately
-		 * available:  use a free pool.
+		/*
+		 * Reached the end of the free list, try to extend it.
 		 */
-		if (usable_arenas == NULL) {
-			/* No arena has a free pool:  allocate a new arena. */
-#ifdef WITH_MEMORY_LIMITS
-			if (narenas_currently_allocated >= MAX_ARENAS) {
-				UNLOCK();
-				goto redirect;
-			}
-#endif
-			usable_arenas = new_arena();
-			if (usable_arenas == NULL) {
-				UNLOCK();
-				goto redirect;
-			}
-			usable_arenas->nextarena =
-				usable_arenas->prevarena = NULL;
-		}
-		assert(usable_arenas->address != 0);
-
-		/* Try to get a cached free pool. */
-		pool = usable_arenas->freepools;
-		if (pool != NULL) {
-			/* Unlink from cached pools. */
-			usable_arenas->freepools = pool->nextpool;
-
-			/* This arena already had the smallest nfreepools
-			 * value, so decreasing nfreepools doesn't change
-			 * that, and we don't need to rearrange the
-			 * usable_arenas list.  However, if the arena has
-			 * become wholly allocated, we need to remove its
-			 * arena_object from usable_arenas.
-			 */
-			--usable_arenas->nfreepools;
-			if (usable_arenas->nfreepools == 0) {
-				/* Wholly allocated:  remove. */
-				assert(usable_arenas->freepools == NULL);
-				assert(usable_arenas->nextarena == NULL ||
-				       usable_arenas->nextarena->prevarena ==
-					   usable_arenas);
-
-				usable_arenas = usable_arenas->nextarena;
-				if (usable_arenas != NULL) {
-					usable_arenas->prevarena = NULL;
-					assert(usable_arenas->address != 0);
-				}
-			}
-			else {
-				/* nfreepools > 0:  it must be that freepools
-				 * isn't NULL, or that we haven't yet carved
-				 * off all the arena's pools for the first
-				 * time.
-				 */
-				assert(usable_arenas->freepools != NULL ||
-				       usable_arenas->pool_address <=
-				           (block*)usable_arenas->address +
-				               ARENA_SIZE - POOL_SIZE);
-			}
-		init_pool:
-			/* Frontlink to used pools. */
-			next = usedpools[size + size]; /* == prev */
-			pool->nextpool = next;
-			pool->prevpool = next;
-			next->nextpool = pool;
-			next->prevpool = pool;
-			pool->ref.count = 1;
-			if (pool->szidx == size) {
-				/* Luckily, this pool last contained blocks
-				 * of the same size class, so its header
-				 * and free list are already initialized.
-				 */
-				bp = pool->freeblock;
-				pool->freeblock = *(block **)bp;
-				UNLOCK();
-				return (void *)bp;
-			}
-			/*
-			 * Initialize the pool header, set up the free list to
-			 * contain just the second block, and return the first
-			 * block.
-			 */
-			pool->szidx = size;
-			size = INDEX2SIZE(size);
-			bp = (block *)pool + POOL_OVERHEAD;
-			pool->nextoffset = POOL_OVERHEAD + (size << 1);
-			pool->maxnextoffset = POOL_SIZE - size;
-			pool->freeblock = bp + size;
+		if (pool->nextoffset <= pool->maxnextoffset) {
+			/* There is room for another block. */
+			pool->freeblock = (block*)pool +
+					  pool->nextoffset;
+			pool->nextoffset += INDEX2SIZE(size);
 			*(block **)(pool->freeblock) = NULL;
 			UNLOCK();
 			return (void *)bp;
 		}
+		/* Pool is full, unlink from used pools. */
+		next = pool->nextpool;
+		pool = pool->prevpool;
+		next->prevpool = pool;
+		pool->nextpool = next;
+		UNLOCK();
+		return (void *)bp;
+	}
 
-		/* Carve off a new pool. */
-		assert(usable_arenas->nfreepools > 0);
-		assert(usable_arenas->freepools == NULL);
-		pool = (poolp)usable_arenas->pool_address;
-		assert((block*)pool <= (block*)usable_arenas->address +
-		                       ARENA_SIZE - POOL_SIZE);
-		pool->arenaindex = usable_arenas - arenas;
-		assert(&arenas[pool->arenaindex] == usable_arenas);
-		pool->szidx = DUMMY_SIZE_IDX;
-		usable_arenas->pool_address += POOL_SIZE;
+	/* There isn't a pool of the right size class immediately
+	 * available:  use a free pool.
+	 */
+	if (usable_arenas == NULL) {
+		/* No arena has a free pool:  allocate a new arena. */
+#ifdef WITH_MEMORY_LIMITS
+		if (narenas_currently_allocated >= MAX_ARENAS) {
+			UNLOCK();
+			return NULL;
+		}
+#endif
+		usable_arenas = new_arena();
+		if (usable_arenas == NULL) {
+			UNLOCK();
+			return NULL;
+		}
+		usable_arenas->nextarena =
+			usable_arenas->prevarena = NULL;
+	}
+	assert(usable_arenas->address != 0);
+
+	/* Try to get a cached free pool. */
+	pool = usable_arenas->freepools;
+	if (pool != NULL) {
+		/* Unlink from cached pools. */
+		usable_arenas->freepools = pool->nextpool;
+		if (usable_arenas->nfreepools ==
+		    usable_arenas->ntotalpools)
+			--narenas_spare;
+
+		/* This arena already had the smallest nfreepools
+		 * value, so decreasing nfreepools doesn't change
+		 * that, and we don't need to rearrange the
+		 * usable_arenas list.  However, if the arena has
+		 * become wholly allocated, we need to remove its
+		 * arena_object from usable_arenas.
+		 */
 		--usable_arenas->nfreepools;
-
 		if (usable_arenas->nfreepools == 0) {
+			/* Wholly allocated:  remove. */
+			assert(usable_arenas->freepools == NULL);
 			assert(usable_arenas->nextarena == NULL ||
 			       usable_arenas->nextarena->prevarena ==
-			       	   usable_arenas);
-			/* Unlink the arena:  it is completely allocated. */
+				   usable_arenas);
+
 			usable_arenas = usable_arenas->nextarena;
 			if (usable_arenas != NULL) {
 				usable_arenas->prevarena = NULL;
 				assert(usable_arenas->address != 0);
 			}
 		}
+		else {
+			/* nfreepools > 0:  it must be that freepools
+			 * isn't NULL, or that we haven't yet carved
+			 * off all the arena's pools for the first
+			 * time.
+			 */
+			assert(usable_arenas->freepools != NULL ||
+			       usable_arenas->pool_address <=
+			           (block*)usable_arenas->address +
+			               ARENA_SIZE - POOL_SIZE);
+		}
+	init_pool:
+		/* Frontlink to used pools. */
+		next = usedpools[size + size]; /* == prev */
+		pool->nextpool = next;
+		pool->prevpool = next;
+		next->nextpool = pool;
+		next->prevpool = pool;
+		pool->ref.count = 1;
+		if (pool->szidx == size) {
+			/* Luckily, this pool last contained blocks
+			 * of the same size class, so its header
+			 * and free list are already initialized.
+			 */
+			bp = pool->freeblock;
+			pool->freeblock = *(block **)bp;
+			UNLOCK();
+			return (void *)bp;
+		}
+		/*
+		 * Initialize the pool header, set up the free list to
+		 * contain just the second block, and return the first
+		 * block.
+		 */
+		pool->szidx = size;
+		size = INDEX2SIZE(size);
+		bp = (block *)pool + POOL_OVERHEAD;
+		pool->nextoffset = POOL_OVERHEAD + (size << 1);
+		pool->maxnextoffset = POOL_SIZE - size;
+		pool->freeblock = bp + size;
+		*(block **)(pool->freeblock) = NULL;
+		UNLOCK();
+		return (void *)bp;
+	}
 
-		goto init_pool;
+	/* Carve off a new pool. */
+	assert(usable_arenas->nfreepools > 0);
+	assert(usable_arenas->freepools == NULL);
+	pool = (poolp)usable_arenas->pool_address;
+	assert((block*)pool <= (block*)usable_arenas->address +
+	                       ARENA_SIZE - POOL_SIZE);
+	pool->arenaindex = usable_arenas - arenas;
+	assert(&arenas[pool->arenaindex] == usable_arenas);
+	pool->szidx = DUMMY_SIZE_IDX;
+	usable_arenas->pool_address += POOL_SIZE;
+	if (usable_arenas->nfreepools == usable_arenas->ntotalpools)
+		--narenas_spare;
+	--usable_arenas->nfreepools;
+
+	if (usable_arenas->nfreepools == 0) {
+		assert(usable_arenas->nextarena == NULL ||
+		       usable_arenas->nextarena->prevarena ==
+		       	   usable_arenas);
+		/* Unlink the arena:  it is completely allocated. */
+		usable_arenas = usable_arenas->nextarena;
+		if (usable_arenas != NULL) {
+			usable_arenas->prevarena = NULL;
+			assert(usable_arenas->address != 0);
+		}
 	}
 
-        /* The small block allocator ends here. */
+	goto init_pool;
+}
+
+/* Return block p to its pool, which must be the pool of p. */
+Py_LOCAL_INLINE(void)
+pool_free(void *p, poolp pool)
+{
+	block *lastfree;
+	poolp next, prev;
+	uint size;
+
+	LOCK();
+	/* Link p to the start of the pool's freeblock list.  Since
+	 * the pool had at least the p block outstanding, the pool
+	 * wasn't empty (so it's already in a usedpools[] list, or
+	 * was full and is in no list -- it's not in the freeblocks
+	 * list in any case).
+	 */
+	assert(pool->ref.count > 0);	/* else it was empty */
+	*(block **)p = lastfree = pool->freeblock;
+	pool->freeblock = (block *)p;
+	if (lastfree) {
+		struct arena_object* ao;
+		uint nf;  /* ao->nfreepools */
+
+		/* freeblock wasn't NULL, so the pool wasn't full,
+		 * and the pool is in a usedpools[] list.
+		 */
+		if (--pool->ref.count != 0) {
+			/* pool isn't empty:  leave it in usedpools */
+			UNLOCK();
+			return;
+		}
+		/* Pool is now empty:  unlink from usedpools, and
+		 * link to the front of freepools.  This ensures that
+		 * previously freed pools will be allocated later
+		 * (being not referenced, they are perhaps paged out).
+		 */
+		next = pool->nextpool;
+		prev = pool->prevpool;
+		next->prevpool = prev;
+		prev->nextpool = next;
+
+		/* Link the pool to freepools.  This is a singly-linked
+		 * list, and pool->prevpool isn't used there.
+		 */
+		ao = &arenas[pool->arenaindex];
+		pool->nextpool = ao->freepools;
+		ao->freepools = pool;
+		nf = ++ao->nfreepools;
+
+		/* All the rest is arena management.  We just freed
+		 * a pool, and there are 4 cases for arena mgmt:
+		 * 1. If all the pools are free and we already hold
+		 *    enough spare arenas, return the arena to the
+		 *    system free().  Otherwise keep it as a spare
+		 *    and go on with the cases below.
+		 * 2. If this is the only free pool in the arena,
+		 *    add the arena back to the `usable_arenas` list.
+		 * 3. If the "next" arena has a smaller count of free
+		 *    pools, we have to "slide this arena right" to
+		 *    restore that usable_arenas is sorted in order of
+		 *    nfreepools.
+		 * 4. Else there's nothing more to do.
+		 */
+		if (nf == ao->ntotalpools) {
+			if (narenas_spare >= arena_spare_limit()) {
+				/* Case 1. */
+				release_arena(ao);
+				UNLOCK();
+				return;
+			}
+			++narenas_spare;
+		}
+		if (nf == 1) {
+			/* Case 2.  Put ao at the head of
+			 * usable_arenas.  Note that because
+			 * ao->nfreepools was 0 before, ao isn't
+			 * currently on the usable_arenas list.
+			 */
+			ao->nextarena = usable_arenas;
+			ao->prevarena = NULL;
+			if (usable_arenas)
+				usable_arenas->prevarena = ao;
+			usable_arenas = ao;
+			assert(usable_arenas->address != 0);
+
+			UNLOCK();
+			return;
+		}
+		/* If this arena is now out of order, we need to keep
+		 * the list sorted.  The list is kept sorted so that
+		 * the "most full" arenas are used first, which allows
+		 * the nearly empty arenas to be completely freed.  In
+		 * a few un-scientific tests, it seems like this
+		 * approach allowed a lot more memory to be freed.
+		 */
+		if (ao->nextarena == NULL ||
+			     nf <= ao->nextarena->nfreepools) {
+			/* Case 4.  Nothing to do. */
+			UNLOCK();
+			return;
+		}
+		/* Case 3:  We have to move the arena towards the end
+		 * of the list, because it has more free pools than
+		 * the arena to its right.
+		 * First unlink ao from usable_arenas.
+		 */
+		if (ao->prevarena != NULL) {
+			/* ao isn't at the head of the list */
+			assert(ao->prevarena->nextarena == ao);
+			ao->prevarena->nextarena = ao->nextarena;
+		}
+		else {
+			/* ao is at the head of the list */
+			assert(usable_arenas == ao);
+			usable_arenas = ao->nextarena;
+		}
+		ao->nextarena->prevarena = ao->prevarena;
+
+		/* Locate the new insertion point by iterating over
+		 * the list, using our nextarena pointer.
+		 */
+		while (ao->nextarena != NULL &&
+				nf > ao->nextarena->nfreepools) {
+			ao->prevarena = ao->nextarena;
+			ao->nextarena = ao->nextarena->nextarena;
+		}
+
+		/* Insert ao at this point. */
+		assert(ao->nextarena == NULL ||
+			ao->prevarena == ao->nextarena->prevarena);
+		assert(ao->prevarena->nextarena == ao->nextarena);
+
+		ao->prevarena->nextarena = ao;
+		if (ao->nextarena != NULL)
+			ao->nextarena->prevarena = ao;
+
+		/* Verify that the swaps worked. */
+		assert(ao->nextarena == NULL ||
+			  nf <= ao->nextarena->nfreepools);
+		assert(ao->prevarena == NULL ||
+			  nf > ao->prevarena->nfreepools);
+		assert(ao->nextarena == NULL ||
+			ao->nextarena->prevarena == ao);
+		assert((usable_arenas == ao &&
+			ao->prevarena == NULL) ||
+			ao->prevarena->nextarena == ao);
+
+		UNLOCK();
+		return;
+	}
+	/* Pool was full, so doesn't currently live in any list:
+	 * link it to the front of the appropriate usedpools[] list.
+	 * This mimics LRU pool usage for new allocations and
+	 * targets optimal filling when several pools contain
+	 * blocks of the same size class.
+	 */
+	--pool->ref.count;
+	assert(pool->ref.count > 0);	/* else the pool is empty */
+	size = pool->szidx;
+	next = usedpools[size + size];
+	prev = next->prevpool;
+	/* insert pool before next:   prev <-> pool <-> next */
+	pool->nextpool = next;
+	pool->prevpool = prev;
+	next->prevpool = pool;
+	prev->nextpool = pool;
+	UNLOCK();
+}
+
+#ifdef PYMALLOC_THREAD_CACHE
+/*==========================================================================*/
+
+/* Per-thread block cache.
+ *
+ * Each thread state lazily gets a small cache of free blocks for the
+ * THREAD_CACHE_CLASSES smallest size classes, kept as one singly-linked
+ * list per class (the link lives in the block, as in a pool's freeblock
+ * list).  PyObject_Malloc() pops from it, and PyObject_Free() pushes onto
+ * it, without touching usedpools[].  An empty list is refilled with
+ * THREAD_CACHE_BATCH blocks in one go, and a list that reaches
+ * THREAD_CACHE_DEPTH blocks gives THREAD_CACHE_BATCH of them back to their
+ * pools.  Cached blocks count as allocated as far as the pools are
+ * concerned, so the caches are flushed before arenas are trimmed and when a
+ * thread state is cleared or deleted.  Like everything else here that is
+ * done with the GIL held, never from PyThreadState_Delete(), which may run
+ * without it.
+ */
+#define THREAD_CACHE_CLASSES	8	/* blocks of up to 64 bytes */
+#define THREAD_CACHE_DEPTH	64
+#define THREAD_CACHE_BATCH	16
+
+struct _obmalloc_thread_cache {
+	block *freeblocks[THREAD_CACHE_CLASSES];
+	uint count[THREAD_CACHE_CLASSES];
+	/* all caches are linked in a doubly-linked list */
+	struct _obmalloc_thread_cache *prevcache;
+	struct _obmalloc_thread_cache *nextcache;
+};
+
+/* The head of the list of all thread caches. */
+static struct _obmalloc_thread_cache *thread_caches = NULL;
+
+/* Return the cache of the current thread, creating it if needed, or NULL if
+ * there is no current thread state or no memory for the cache.
+ */
+static struct _obmalloc_thread_cache *
+get_thread_cache(void)
+{
+	PyThreadState *tstate = _PyThreadState_Current;
+	struct _obmalloc_thread_cache *tc;
+
+	if (tstate == NULL)
+		return NULL;
+	tc = tstate->obmalloc_cache;
+	if (tc == NULL) {
+		tc = (struct _obmalloc_thread_cache *)
+			PyCore_MALLOC_FUNC(sizeof(*tc));
+		if (tc == NULL)
+			return NULL;
+		memset(tc, 0, sizeof(*tc));
+		tc->nextcache = thread_caches;
+		if (thread_caches != NULL)
+			thread_caches->prevcache = tc;
+		thread_caches = tc;
+		tstate->obmalloc_cache = tc;
+	}
+	return tc;
+}
+
+/* Give up to n cached blocks of size class `size` back to their pools. */
+static void
+thread_cache_flush(struct _obmalloc_thread_cache *tc, uint size, uint n)
+{
+	block *bp;
+
+	while (n-- > 0 && (bp = tc->freeblocks[size]) != NULL) {
+		tc->freeblocks[size] = *(block **)bp;
+		--tc->count[size];
+		pool_free(bp, POOL_ADDR(bp));
+	}
+}
+
+static void *
+thread_cache_alloc(uint size)
+{
+	struct _obmalloc_thread_cache *tc = get_thread_cache();
+	block *bp;
+	uint i;
+
+	if (tc == NULL)
+		return NULL;
+	if (tc->freeblocks[size] == NULL) {
+		for (i = 0; i < THREAD_CACHE_BATCH; ++i) {
+			bp = (block *)pool_alloc(size);
+			if (bp == NULL)
+				break;
+			*(block **)bp = tc->freeblocks[size];
+			tc->freeblocks[size] = bp;
+			++tc->count[size];
+		}
+		if (tc->freeblocks[size] == NULL)
+			return NULL;
+	}
+	bp = tc->freeblocks[size];
+	tc->freeblocks[size] = *(block **)bp;
+	--tc->count[size];
+	return (void *)bp;
+}
+
+/* Cache block p of size class `size`.  Return 0 if the caller has to give
+ * it back to its pool instead.
+ */
+static int
+thread_cache_free(void *p, uint size)
+{
+	struct _obmalloc_thread_cache *tc = get_thread_cache();
+
+	if (tc == NULL)
+		return 0;
+	if (tc->count[size] >= THREAD_CACHE_DEPTH)
+		thread_cache_flush(tc, size, THREAD_CACHE_BATCH);
+	*(block **)p = tc->freeblocks[size];
+	tc->freeblocks[size] = (block *)p;
+	++tc->count[size];
+	return 1;
+}
+
+/* Flush the caches of all threads back to the pools. */
+static void
+flush_thread_caches(void)
+{
+	struct _obmalloc_thread_cache *tc;
+	uint i;
+
+	for (tc = thread_caches; tc != NULL; tc = tc->nextcache)
+		for (i = 0; i < THREAD_CACHE_CLASSES; ++i)
+			thread_cache_flush(tc, i, tc->count[i]);
+}
+
+#endif /* PYMALLOC_THREAD_CACHE */
+
+/* Give the cached blocks of a thread state back to the pools and free its
+ * cache.  The caller must hold the GIL.
+ */
+void
+_PyObject_ClearThreadCache(PyThreadState *tstate)
+{
+#ifdef PYMALLOC_THREAD_CACHE
+	struct _obmalloc_thread_cache *tc = tstate->obmalloc_cache;
+	uint i;
+
+	if (tc == NULL)
+		return;
+	tstate->obmalloc_cache = NULL;
+	for (i = 0; i < THREAD_CACHE_CLASSES; ++i)
+		thread_cache_flush(tc, i, tc->count[i]);
+	if (tc->prevcache != NULL)
+		tc->prevcache->nextcache = tc->nextcache;
+	else
+		thread_caches = tc->nextcache;
+	if (tc->nextcache != NULL)
+		tc->nextcache->prevcache = tc->prevcache;
+	PyCore_FREE_FUNC(tc);
+#endif
+}
+
+/*==========================================================================*/
+
+/* malloc.  Note that nbytes==0 tries to return a non-NULL pointer, distinct
+ * from all other currently live pointers.  This may not be possible.
+ */
+
+#undef PyObject_Malloc
+void *
+PyObject_Malloc(size_t nbytes)
+{
+	void *bp;
+	uint size;
+
+	/*
+	 * Limit ourselves to PY_SSIZE_T_MAX bytes to prevent security holes.
+	 * Most python internals blindly use a signed Py_ssize_t to track
+	 * things without checking for overflows or negatives.
+	 * As size_t is unsigned, checking for nbytes < 0 is not required.
+	 */
+	if (nbytes > PY_SSIZE_T_MAX)
+		return NULL;
+
+	/*
+	 * This implicitly redirects malloc(0).
+	 */
+	if ((nbytes - 1) < SMALL_REQUEST_THRESHOLD) {
+		size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
+#ifdef PYMALLOC_THREAD_CACHE
+		if (size < THREAD_CACHE_CLASSES &&
+		    (bp = thread_cache_alloc(size)) != NULL)
+			return bp;
+#endif
+		bp = pool_alloc(size);
+		if (bp != NULL)
+			return bp;
+	}
+	else if ((nbytes - 1) < MEDIUM_REQUEST_THRESHOLD) {
+		bp = medium_alloc(medium_size_index(nbytes));
+		if (bp != NULL)
+			return bp;
+	}
 
-redirect:
 	/* Redirect the original request to the underlying (libc) allocator.
-	 * We jump here on bigger requests, on error in the code above (as a
+	 * We get here on bigger requests, on error in the code above (as a
 	 * last chance to serve the request) or when the max memory limit
-	 * has been reached.
+	 * has been reached.  If that fails too, the free lists are emptied
+	 * and the request tried once more.
 	 */
 	if (nbytes == 0)
 		nbytes = 1;
-	return (void *)PyCore_MALLOC_FUNC(nbytes);
+	bp = (void *)PyCore_MALLOC_FUNC(nbytes);
+	if (bp == NULL && PyMem_ReleaseCaches(PyMem_RELEASE_FREELISTS) > 0)
+		bp = (void *)PyCore_MALLOC_FUNC(nbytes);
+	return bp;
 }
 
 /* free */
@@ -922,9 +1633,7 @@ void
 PyObject_Free(void *p)
 {
 	poolp pool;
-	block *lastfree;
-	poolp next, prev;
-	uint size;
+	struct medium_arena *ma;
 
 	if (p == NULL)	/* free(NULL) has no effect */
 		return;
@@ -932,194 +1641,16 @@ PyObject_Free(void *p)
 	pool = POOL_ADDR(p);
 	if (Py_ADDRESS_IN_RANGE(p, pool)) {
 		/* We allocated this address. */
-		LOCK();
-		/* Link p to the start of the pool's freeblock list.  Since
-		 * the pool had at least the p block outstanding, the pool
-		 * wasn't empty (so it's already in a usedpools[] list, or
-		 * was full and is in no list -- it's not in the freeblocks
-		 * list in any case).
-		 */
-		assert(pool->ref.count > 0);	/* else it was empty */
-		*(block **)p = lastfree = pool->freeblock;
-		pool->freeblock = (block *)p;
-		if (lastfree) {
-			struct arena_object* ao;
-			uint nf;  /* ao->nfreepools */
-
-			/* freeblock wasn't NULL, so the pool wasn't full,
-			 * and the pool is in a usedpools[] list.
-			 */
-			if (--pool->ref.count != 0) {
-				/* pool isn't empty:  leave it in usedpools */
-				UNLOCK();
-				return;
-			}
-			/* Pool is now empty:  unlink from usedpools, and
-			 * link to the front of freepools.  This ensures that
-			 * previously freed pools will be allocated later
-			 * (being not referenced, they are perhaps paged out).
-			 */
-			next = pool->nextpool;
-			prev = pool->prevpool;
-			next->prevpool = prev;
-			prev->nextpool = next;
-
-			/* Link the pool to freepools.  This is a singly-linked
-			 * list, and pool->prevpool isn't used there.
-			 */
-			ao = &arenas[pool->arenaindex];
-			pool->nextpool = ao->freepools;
-			ao->freepools = pool;
-			nf = ++ao->nfreepools;
-
-			/* All the rest is arena management.  We just freed
-			 * a pool, and there are 4 cases for arena mgmt:
-			 * 1. If all the pools are free, return the arena to
-			 *    the system free().
-			 * 2. If this is the only free pool in the arena,
-			 *    add the arena back to the `usable_arenas` list.
-			 * 3. If the "next" arena has a smaller count of free
-			 *    pools, we have to "slide this arena right" to
-			 *    restore that usable_arenas is sorted in order of
-			 *    nfreepools.
-			 * 4. Else there's nothing more to do.
-			 */
-			if (nf == ao->ntotalpools) {
-				/* Case 1.  First unlink ao from usable_arenas.
-				 */
-				assert(ao->prevarena == NULL ||
-				       ao->prevarena->address != 0);
-				assert(ao ->nextarena == NULL ||
-				       ao->nextarena->address != 0);
-
-				/* Fix the pointer in the prevarena, or the
-				 * usable_arenas pointer.
-				 */
-				if (ao->prevarena == NULL) {
-					usable_arenas = ao->nextarena;
-					assert(usable_arenas == NULL ||
-					       usable_arenas->address != 0);
-				}
-				else {
-					assert(ao->prevarena->nextarena == ao);
-					ao->prevarena->nextarena =
-						ao->nextarena;
-				}
-				/* Fix the pointer in the nextarena. */
-				if (ao->nextarena != NULL) {
-					assert(ao->nextarena->prevarena == ao);
-					ao->nextarena->prevarena =
-						ao->prevarena;
-				}
-				/* Record that this arena_object slot is
-				 * available to be reused.
-				 */
-				ao->nextarena = unused_arena_objects;
-				unused_arena_objects = ao;
-
-				/* Free the entire arena. */
-				PyCore_FREE_FUNC((void *)ao->address);				
-				ao->address = 0;	/* mark unassociated */
-				--narenas_currently_allocated;
-
-				UNLOCK();
-				return;
-			}
-			if (nf == 1) {
-				/* Case 2.  Put ao at the head of
-				 * usable_arenas.  Note that because
-				 * ao->nfreepools was 0 before, ao isn't
-				 * currently on the usable_arenas list.
-				 */
-				ao->nextarena = usable_arenas;
-				ao->prevarena = NULL;
-				if (usable_arenas)
-					usable_arenas->prevarena = ao;
-				usable_arenas = ao;
-				assert(usable_arenas->address != 0);
-
-				UNLOCK();
-				return;
-			}
-			/* If this arena is now out of order, we need to keep
-			 * the list sorted.  The list is kept sorted so that
-			 * the "most full" arenas are used first, which allows
-			 * the nearly empty arenas to be completely freed.  In
-			 * a few un-scientific tests, it seems like this
-			 * approach allowed a lot more memory to be freed.
-			 */
-			if (ao->nextarena == NULL ||
-				     nf <= ao->nextarena->nfreepools) {
-				/* Case 4.  Nothing to do. */
-				UNLOCK();
-				return;
-			}
-			/* Case 3:  We have to move the arena towards the end
-			 * of the list, because it has more free pools than
-			 * the arena to its right.
-			 * First unlink ao from usable_arenas.
-			 */
-			if (ao->prevarena != NULL) {
-				/* ao isn't at the head of the list */
-				assert(ao->prevarena->nextarena == ao);
-				ao->prevarena->nextarena = ao->nextarena;
-			}
-			else {
-				/* ao is at the head of the list */
-				assert(usable_arenas == ao);
-				usable_arenas = ao->nextarena;
-			}
-			ao->nextarena->prevarena = ao->prevarena;
-
-			/* Locate the new insertion point by iterating over
-			 * the list, using our nextarena pointer.
-			 */
-			while (ao->nextarena != NULL &&
-					nf > ao->nextarena->nfreepools) {
-				ao->prevarena = ao->nextarena;
-				ao->nextarena = ao->nextarena->nextarena;
-			}
-
-			/* Insert ao at this point. */
-			assert(ao->nextarena == NULL ||
-				ao->prevarena == ao->nextarena->prevarena);
-			assert(ao->prevarena->nextarena == ao->nextarena);
-
-			ao->prevarena->nextarena = ao;
-			if (ao->nextarena != NULL)
-				ao->nextarena->prevarena = ao;
-
-			/* Verify that the swaps worked. */
-			assert(ao->nextarena == NULL ||
-				  nf <= ao->nextarena->nfreepools);
-			assert(ao->prevarena == NULL ||
-				  nf > ao->prevarena->nfreepools);
-			assert(ao->nextarena == NULL ||
-				ao->nextarena->prevarena == ao);
-			assert((usable_arenas == ao &&
-				ao->prevarena == NULL) ||
-				ao->prevarena->nextarena == ao);
-
-			UNLOCK();
+#ifdef PYMALLOC_THREAD_CACHE
+		if (pool->szidx < THREAD_CACHE_CLASSES &&
+		    thread_cache_free(p, pool->szidx))
 			return;
-		}
-		/* Pool was full, so doesn't currently live in any list:
-		 * link it to the front of the appropriate usedpools[] list.
-		 * This mimics LRU pool usage for new allocations and
-		 * targets optimal filling when several pools contain
-		 * blocks of the same size class.
-		 */
-		--pool->ref.count;
-		assert(pool->ref.count > 0);	/* else the pool is empty */
-		size = pool->szidx;
-		next = usedpools[size + size];
-		prev = next->prevpool;
-		/* insert pool before next:   prev <-> pool <-> next */
-		pool->nextpool = next;
-		pool->prevpool = prev;
-		next->prevpool = pool;
-		prev->nextpool = pool;
-		UNLOCK();
+#endif
+		pool_free(p, pool);
+		return;
+	}
+	if ((ma = medium_arena_of(p)) != NULL) {
+		medium_free(p, ma);
 		return;
 	}
 
@@ -1138,6 +1669,7 @@ PyObject_Realloc(void *p, size_t nbytes)
 {
 	void *bp;
 	poolp pool;
+	struct medium_arena *ma = NULL;
 	size_t size;
 
 	if (p == NULL)
@@ -1153,9 +1685,11 @@ PyObject_Realloc(void *p, size_t nbytes)
 		return NULL;
 
 	pool = POOL_ADDR(p);
-	if (Py_ADDRESS_IN_RANGE(p, pool)) {
+	if (Py_ADDRESS_IN_RANGE(p, pool) ||
+	    (ma = medium_arena_of(p)) != NULL) {
 		/* We're in charge of this block */
-		size = INDEX2SIZE(pool->szidx);
+		size = ma == NULL ? INDEX2SIZE(pool->szidx) :
+				    MEDIUM_INDEX2SIZE(ma->szidx);
 		if (nbytes <= size) {
 			/* The block is staying the same or shrinking.  If
 			 * it's shrinking, there's a tradeoff:  it costs
@@ -1180,7 +1714,7 @@ PyObject_Realloc(void *p, size_t nbytes)
 		return bp;
 	}
 	/* We're not managing this block.  If nbytes <=
-	 * SMALL_REQUEST_THRESHOLD, it's tempting to try to take over this
+	 * MEDIUM_REQUEST_THRESHOLD, it's tempting to try to take over this
 	 * block.  However, if we do, we need to copy the valid data from
 	 * the C-managed block to one of our blocks, and there's no portable
 	 * way to know how much of the memory space starting at p is valid.
@@ -1191,7 +1725,11 @@ PyObject_Realloc(void *p, size_t nbytes)
          */
 	if (nbytes)
 	{
-		return PyCore_REALLOC_FUNC(p, nbytes);
+		bp = PyCore_REALLOC_FUNC(p, nbytes);
+		if (bp == NULL &&
+		    PyMem_ReleaseCaches(PyMem_RELEASE_FREELISTS) > 0)
+			bp = PyCore_REALLOC_FUNC(p, nbytes);
+		return bp;
 	}
 	/* C doesn't define the result of realloc(p, 0) (it may or may not
 	 * return NULL then), but Python's docs promise that nbytes==0 never
@@ -1203,6 +1741,71 @@ PyObject_Realloc(void *p, size_t nbytes)
    	return bp ? bp : p;
 }
 
+/* Return the empty arenas, small or medium, beyond the first `keep` ones to
+ * the system, or those beyond spare_arenas if `keep` is negative, and restart
+ * the high-water mark from the current arena count.  Return the number of
+ * bytes released.
+ */
+size_t
+_PyObject_TrimArenas(int keep)
+{
+	struct arena_object *ao, *next;
+	size_t nkept = 0;
+	size_t nreleased = 0;
+	uint i;
+
+	if (keep < 0)
+		keep = (int)spare_arenas;
+#ifdef PYMALLOC_THREAD_CACHE
+	flush_thread_caches();
+#endif
+	LOCK();
+	for (ao = usable_arenas; ao != NULL; ao = next) {
+		next = ao->nextarena;
+		if (ao->nfreepools != ao->ntotalpools)
+			continue;
+		if (nkept < (size_t)keep) {
+			++nkept;
+			continue;
+		}
+		release_arena(ao);
+		--narenas_spare;
+		++nreleased;
+	}
+	for (i = 0; i < NB_MEDIUM_SIZE_CLASSES; ++i) {
+		/* An empty medium arena was alone on its list when it was
+		 * kept, but arenas that were full may have been linked in
+		 * front of it since, so look through the whole list. */
+		struct medium_arena *ma, *mnext;
+		for (ma = medium_usable[i]; ma != NULL; ma = mnext) {
+			mnext = ma->nextarena;
+			if (ma->count != 0)
+				continue;
+			if (nkept < (size_t)keep) {
+				++nkept;
+				continue;
+			}
+			release_medium_arena(ma);
+			++nreleased;
+		}
+	}
+	narenas_highwater = narenas_currently_allocated;
+	UNLOCK();
+	return nreleased * ARENA_SIZE;
+}
+
+/* Set the minimum number of empty arenas kept for reuse, return the old
+ * value.
+ */
+int
+_PyObject_SetSpareArenas(int n)
+{
+	int old = (int)spare_arenas;
+	if (n >= 0)
+		spare_arenas = (uint)n;
+	return old;
+}
+
 #else	/* ! WITH_PYMALLOC */
 
 /*==========================================================================*/
@@ -1226,6 +1829,23 @@ PyObject_Free(void *p)
 {
 	PyMem_FREE(p);
 }
+
+size_t
+_PyObject_TrimArenas(int keep)
+{
+	return 0;
+}
+
+int
+_PyObject_SetSpareArenas(int n)
+{
+	return 0;
+}
+
+void
+_PyObject_ClearThreadCache(PyThreadState *tstate)
+{
+}
 #endif /* WITH_PYMALLOC */
 
 #ifdef PYMALLOC_DEBUG
@@ -1732,6 +2352,7 @@ _PyObject_DebugMallocStats(void)
 	(void)printone("# arenas reclaimed", ntimes_arena_allocated - narenas);
 	(void)printone("# arenas highwater mark", narenas_highwater);
 	(void)printone("# arenas allocated current", narenas);
+	(void)printone("# arenas kept as spares", narenas_spare);
 
 	PyOS_snprintf(buf, sizeof(buf),
 		"%" PY_FORMAT_SIZE_T "u arenas * %d bytes/arena",
@@ -1751,6 +2372,68 @@ _PyObject_DebugMallocStats(void)
 	total += printone("# bytes lost to quantization", quantization);
 	total += printone("# bytes lost to arena alignment", arena_alignment);
 	(void)printone("Total", total);
+
+	/* Medium arenas hold a single size class each, and are all in
+	 * medium_arenas.
+	 */
+	fprintf(stderr, "\nMedium block threshold = %d, in %d size classes.\n",
+		MEDIUM_REQUEST_THRESHOLD, NB_MEDIUM_SIZE_CLASSES);
+	for (i = 0; i < NB_MEDIUM_SIZE_CLASSES; ++i)
+		numpools[i] = numblocks[i] = numfreeblocks[i] = 0;
+	for (i = 0; i < nmedium_arenas; ++i) {
+		struct medium_arena *ma = medium_arenas[i];
+		assert(i == 0 || (uptr)medium_arenas[i - 1] < (uptr)ma);
+		++numpools[ma->szidx];
+		numblocks[ma->szidx] += ma->count;
+		numfreeblocks[ma->szidx] +=
+			MEDIUM_NUMBLOCKS(ma->szidx) - ma->count;
+	}
+
+	fputc('\n', stderr);
+	fputs("class   size  num arenas   blocks in use  avail blocks\n"
+	      "-----   ----  ----------   -------------  ------------\n",
+		stderr);
+
+	allocated_bytes = available_bytes = quantization = 0;
+	for (i = 0; i < NB_MEDIUM_SIZE_CLASSES; ++i) {
+		size_t p = numpools[i];
+		size_t b = numblocks[i];
+		size_t f = numfreeblocks[i];
+		uint size = MEDIUM_INDEX2SIZE(i);
+		if (p == 0)
+			continue;
+		fprintf(stderr, "%5u %6u "
+				"%11" PY_FORMAT_SIZE_T "u "
+				"%15" PY_FORMAT_SIZE_T "u "
+				"%13" PY_FORMAT_SIZE_T "u\n",
+			i, size, p, b, f);
+		allocated_bytes += b * size;
+		available_bytes += f * size;
+		quantization += p * ((ARENA_SIZE - MEDIUM_OVERHEAD) % size);
+	}
+	fputc('\n', stderr);
+	(void)printone("# medium arenas allocated total",
+		       ntimes_medium_arena_allocated);
+	(void)printone("# medium arenas reclaimed",
+		       ntimes_medium_arena_allocated - nmedium_arenas);
+	(void)printone("# medium arenas allocated current", nmedium_arenas);
+
+	PyOS_snprintf(buf, sizeof(buf),
+		"%u medium arenas * %d bytes/arena",
+		nmedium_arenas, ARENA_SIZE);
+	(void)printone(buf, (size_t)nmedium_arenas * ARENA_SIZE);
+
+	fputc('\n', stderr);
+
+	total = printone("# bytes in allocated medium blocks",
+			 allocated_bytes);
+	total += printone("# bytes in available medium blocks",
+			  available_bytes);
+	total += printone("# bytes lost to medium headers",
+			  (size_t)nmedium_arenas * MEDIUM_OVERHEAD);
+	total += printone("# bytes lost to medium quantization",
+			  quantization);
+	(void)printone("Total", total);
 }
 
 #endif	/* PYMALLOC_DEBUG */
@@ -14,8 +14,338 @@
    it has actually checked for matches, but didn't find any.  callers
    beware! */
 
+/* searching forward is done in one of three ways:
+
+   - single characters are looked up with memchr, which most C libraries
+     implement a word or a vector at a time.
+
+   - longer needles go through a first-and-last character filter, which
+     tests a machine word's worth of positions at once and compares the
+     rest of the needle only where both of these characters match.
+     ordinary text has few such candidates, whatever the needle length.
+
+   - when a needle turns out to match partially over and over (think of
+     "aaa...aba" against "aaaa..."), the rest of the haystack is handed
+     to the two-way algorithm, which always finishes in linear time.
+
+   reverse searching (rfind, rpartition), and forward searching where a
+   word cannot hold two characters, use the horspool variant. */
+
 #define FAST_COUNT 0
 #define FAST_SEARCH 1
+#define FAST_RSEARCH 2
+
+/* below this many characters a plain loop beats the memchr setup */
+#define MEMCHR_CUT_OFF (sizeof(STRINGLIB_CHAR) == 1 ? 15 : 40)
+
+/* how far a search must be from the end of the haystack for two-way
+   to be worth its setup */
+#define TWO_WAY_MIN_REST 2000
+
+/* the two-way skip table is indexed by the low bits of a character */
+#define TWO_WAY_TABLE_SIZE 64
+#define TWO_WAY_TABLE_MASK (TWO_WAY_TABLE_SIZE - 1)
+
+Py_LOCAL_INLINE(Py_ssize_t)
+stringlib_find_char(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const STRINGLIB_CHAR *p, *e;
+
+    p = s;
+    e = s + n;
+    if (n > MEMCHR_CUT_OFF) {
+        if (sizeof(STRINGLIB_CHAR) == 1) {
+            p = (const STRINGLIB_CHAR *) memchr(s, ch, n);
+            if (p == NULL)
+                return -1;
+            return p - s;
+        }
+        else {
+            /* wider characters: look for their low byte, which catches
+               every occurrence plus the odd false positive.  that is
+               useless for multiples of 256, which would hit every
+               ascii character in a ucs-2 string */
+            const STRINGLIB_CHAR *s1, *e1;
+            const char *candidate;
+            unsigned char needle = ch & 0xff;
+
+            if (needle != 0) {
+                do {
+                    candidate = (const char *) memchr(
+                        p, needle, (e - p) * sizeof(STRINGLIB_CHAR));
+                    if (candidate == NULL)
+                        return -1;
+                    s1 = p;
+                    p += (candidate - (const char *) p) /
+                        sizeof(STRINGLIB_CHAR);
+                    if (*p == ch)
+                        return p - s;
+                    /* false positive; if they come thick and fast,
+                       scan a stretch by hand before asking memchr
+                       again */
+                    p++;
+                    if (p - s1 > MEMCHR_CUT_OFF)
+                        continue;
+                    if (e - p <= MEMCHR_CUT_OFF)
+                        break;
+                    e1 = p + MEMCHR_CUT_OFF;
+                    while (p != e1) {
+                        if (*p == ch)
+                            return p - s;
+                        p++;
+                    }
+                } while (e - p > MEMCHR_CUT_OFF);
+            }
+        }
+    }
+    while (p < e) {
+        if (*p == ch)
+            return p - s;
+        p++;
+    }
+    return -1;
+}
+
+Py_LOCAL_INLINE(Py_ssize_t)
+stringlib_rfind_char(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const STRINGLIB_CHAR *p;
+
+    p = s + n;
+    while (p > s) {
+        p--;
+        if (*p == ch)
+            return p - s;
+    }
+    return -1;
+}
+
+Py_LOCAL_INLINE(Py_ssize_t)
+stringlib_count_char(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    Py_ssize_t i, count = 0;
+
+    for (i = 0; i < n; i++)
+        if (s[i] == ch)
+            count++;
+    return count;
+}
+
+/* two-way string matching.  the needle is split at a critical
+   factorization p = u + v; v is compared left to right, then u right to
+   left, and on a mismatch the window moves on by an amount that never
+   skips a match.  a bad character table on the last character of the
+   window makes it skip through text that has nothing to do with the
+   needle, much like horspool.  see crochemore & perrin, "two-way
+   string-matching", journal of the acm 38 (1991), and lecroq's online
+   handbook of exact string matching algorithms. */
+
+typedef struct {
+    Py_ssize_t ell;     /* last index of u, -1 if u is empty */
+    Py_ssize_t period;  /* the period of p, or a bound on the shift */
+    int periodic;       /* true if u occurs in v at period */
+    Py_ssize_t table[TWO_WAY_TABLE_SIZE];
+} stringlib_two_way_t;
+
+/* maximal suffix of p for the ordinary (invert == 0) or the reversed
+   alphabet order, and its period */
+Py_LOCAL(Py_ssize_t)
+stringlib_max_suffix(const STRINGLIB_CHAR* p, Py_ssize_t m,
+                     Py_ssize_t *period, int invert)
+{
+    Py_ssize_t ms = -1, j = 0, k = 1, per = 1;
+    STRINGLIB_CHAR a, b;
+
+    while (j + k < m) {
+        a = p[j + k];
+        b = p[ms + k];
+        if (invert ? a > b : a < b) {
+            j += k;
+            k = 1;
+            per = j - ms;
+        }
+        else if (a == b) {
+            if (k != per)
+                k++;
+            else {
+                j += per;
+                k = 1;
+            }
+        }
+        else {
+            ms = j;
+            j = ms + 1;
+            k = per = 1;
+        }
+    }
+    *period = per;
+    return ms;
+}
+
+Py_LOCAL(void)
+stringlib_two_way_prepare(const STRINGLIB_CHAR* p, Py_ssize_t m,
+                          stringlib_two_way_t *tw)
+{
+    Py_ssize_t i, j, per1, per2;
+
+    i = stringlib_max_suffix(p, m, &per1, 0);
+    j = stringlib_max_suffix(p, m, &per2, 1);
+    if (i > j) {
+        tw->ell = i;
+        tw->period = per1;
+    }
+    else {
+        tw->ell = j;
+        tw->period = per2;
+    }
+    tw->periodic = (tw->ell + 1 + tw->period <= m &&
+                    memcmp(p, p + tw->period,
+                           (tw->ell + 1) * sizeof(STRINGLIB_CHAR)) == 0);
+    if (!tw->periodic) {
+        /* no useful period; any shift up to this one is safe */
+        i = tw->ell + 1;
+        if (i < m - tw->ell - 1)
+            i = m - tw->ell - 1;
+        tw->period = i + 1;
+    }
+    for (i = 0; i < TWO_WAY_TABLE_SIZE; i++)
+        tw->table[i] = m;
+    for (i = 0; i < m; i++)
+        tw->table[p[i] & TWO_WAY_TABLE_MASK] = m - 1 - i;
+}
+
+Py_LOCAL(Py_ssize_t)
+stringlib_two_way(const STRINGLIB_CHAR* s, Py_ssize_t n,
+                  const STRINGLIB_CHAR* p, Py_ssize_t m,
+                  int mode)
+{
+    stringlib_two_way_t tw;
+    Py_ssize_t i, j, shift, memory, ell, per, count = 0;
+
+    stringlib_two_way_prepare(p, m, &tw);
+    ell = tw.ell;
+    per = tw.period;
+    j = 0;
+    /* p[:memory] is known to match at j; only the periodic case
+       remembers anything, and the skip table is only consulted when
+       nothing is remembered, which keeps the scan linear */
+    memory = 0;
+    while (j <= n - m) {
+        if (memory == 0) {
+            shift = tw.table[s[j + m - 1] & TWO_WAY_TABLE_MASK];
+            if (shift) {
+                j += shift;
+                continue;
+            }
+        }
+        i = ell + 1;
+        if (i < memory)
+            i = memory;
+        while (i < m && p[i] == s[i + j])
+            i++;
+        if (i < m) {
+            j += i - ell;
+            memory = 0;
+            continue;
+        }
+        i = ell;
+        while (i >= memory && p[i] == s[i + j])
+            i--;
+        if (i < memory) {
+            if (mode != FAST_COUNT)
+                return j;
+            count++;
+            j += m;
+            memory = 0;
+        }
+        else {
+            j += per;
+            memory = tw.periodic ? m - per : 0;
+        }
+    }
+    if (mode != FAST_COUNT)
+        return -1;
+    return count;
+}
+
+/* first-and-last character filter.  a size_t is treated as a row of
+   characters; xor-ing the words at s+i and s+i+m-1 with the first and
+   the last character of the needle repeated along the word leaves zero
+   lanes exactly where these characters occur, and the lanes that are
+   zero in both words are the candidate positions.  this needs no
+   particular byte order or alignment, and only the candidates are
+   looked at one by one.  the positions that do not fill a whole word
+   at the end are tried one at a time. */
+
+Py_LOCAL(Py_ssize_t)
+stringlib_filter_find(const STRINGLIB_CHAR* s, Py_ssize_t n,
+                      const STRINGLIB_CHAR* p, Py_ssize_t m,
+                      int mode)
+{
+    const size_t lane = sizeof(STRINGLIB_CHAR) == 1 ? 0xFF :
+        sizeof(STRINGLIB_CHAR) == 2 ? 0xFFFF : 0xFFFFFFFF;
+    const size_t ones = (size_t)-1 / lane;
+    const size_t high = ones << (8 * sizeof(STRINGLIB_CHAR) - 1);
+    const Py_ssize_t lanes = sizeof(size_t) / sizeof(STRINGLIB_CHAR);
+    const Py_ssize_t mlast = m - 1;
+    const Py_ssize_t w = n - m;
+    size_t first, last, a, b;
+    Py_ssize_t i, j, k, stop, last_word, hits = 0, count = 0;
+
+    first = ((size_t) p[0] & lane) * ones;
+    last = ((size_t) p[mlast] & lane) * ones;
+    /* the last whole word read starts at s[last_word+mlast] */
+    last_word = w + 1 - lanes;
+    i = 0;
+    while (i <= w) {
+        if (i <= last_word) {
+            memcpy(&a, s + i, sizeof(size_t));
+            memcpy(&b, s + i + mlast, sizeof(size_t));
+            a ^= first;
+            b ^= last;
+            /* now the high bit of a lane is set unless the lane is zero */
+            a = ((a & ~high) + ~high) | a;
+            b = ((b & ~high) + ~high) | b;
+            if (((a | b) & high) == high) {
+                i += lanes;
+                continue;
+            }
+            stop = i + lanes;
+        }
+        else
+            stop = w + 1;
+        for (k = i; k < stop; k++) {
+            if (s[k] != p[0] || s[k+mlast] != p[mlast])
+                continue;
+            for (j = 1; j < mlast; j++)
+                if (s[k+j] != p[j])
+                    break;
+            if (j < mlast) {
+                hits += j;
+                continue;
+            }
+            if (mode != FAST_COUNT)
+                return k;
+            count++;
+            /* matches may not overlap */
+            stop = k + m;
+            break;
+        }
+        i = stop;
+        /* comparing more characters than there are in the haystack
+           means the needle keeps matching in part: two-way puts a
+           linear bound on the rest of the search */
+        if (hits > i + 2 * m && w - i > TWO_WAY_MIN_REST) {
+            j = stringlib_two_way(s + i, n - i, p, m, mode);
+            if (mode != FAST_COUNT)
+                return j < 0 ? -1 : j + i;
+            return count + j;
+        }
+    }
+    if (mode != FAST_COUNT)
+        return -1;
+    return count;
+}
 
 Py_LOCAL_INLINE(Py_ssize_t)
 fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
@@ -23,7 +353,7 @@ fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
            int mode)
 {
     long mask;
-    Py_ssize_t skip, count = 0;
+    Py_ssize_t skip, count = 0, hits = 0;
     Py_ssize_t i, j, mlast, w;
 
     w = n - m;
@@ -36,56 +366,99 @@ fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
         if (m <= 0)
             return -1;
         /* use special case for 1-character strings */
-        if (mode == FAST_COUNT) {
-            for (i = 0; i < n; i++)
-                if (s[i] == p[0])
-                    count++;
-            return count;
-        } else {
-            for (i = 0; i < n; i++)
-                if (s[i] == p[0])
-                    return i;
-        }
-        return -1;
+        if (mode == FAST_COUNT)
+            return stringlib_count_char(s, n, p[0]);
+        else if (mode == FAST_SEARCH)
+            return stringlib_find_char(s, n, p[0]);
+        else
+            return stringlib_rfind_char(s, n, p[0]);
     }
 
+    /* the filter wants at least two characters to a word */
+    if (mode != FAST_RSEARCH &&
+        sizeof(size_t) >= 2 * sizeof(STRINGLIB_CHAR))
+        return stringlib_filter_find(s, n, p, m, mode);
+
     mlast = m - 1;
 
     /* create compressed boyer-moore delta 1 table */
     skip = mlast - 1;
-    /* process pattern[:-1] */
-    for (mask = i = 0; i < mlast; i++) {
-        mask |= (1 << (p[i] & 0x1F));
-        if (p[i] == p[mlast])
-            skip = mlast - i - 1;
-    }
-    /* process pattern[-1] outside the loop */
-    mask |= (1 << (p[mlast] & 0x1F));
-
-    for (i = 0; i <= w; i++) {
-        /* note: using mlast in the skip path slows things down on x86 */
-        if (s[i+m-1] == p[m-1]) {
-            /* candidate match */
-            for (j = 0; j < mlast; j++)
-                if (s[i+j] != p[j])
-                    break;
-            if (j == mlast) {
-                /* got a match! */
-                if (mode != FAST_COUNT)
+    mask = 0;
+    if (mode != FAST_RSEARCH) {
+        /* process pattern[:-1] */
+        for (j = 0; j < mlast; j++) {
+            mask |= (1 << (p[j] & 0x1F));
+            if (p[j] == p[mlast])
+                skip = mlast - j - 1;
+        }
+        /* process pattern[-1] outside the loop */
+        mask |= (1 << (p[mlast] & 0x1F));
+
+        for (i = 0; i <= w; i++) {
+            /* note: using mlast in the skip path slows things down on x86 */
+            if (s[i+m-1] == p[m-1]) {
+                /* candidate match */
+                for (j = 0; j < mlast; j++)
+                    if (s[i+j] != p[j])
+                        break;
+                if (j == mlast) {
+                    /* got a match! */
+                    if (mode != FAST_COUNT)
+                        return i;
+                    count++;
+                    i = i + mlast;
+                    continue;
+                }
+                /* the needle keeps matching in part: two-way puts a
+                   linear bound on the rest of the search */
+                /* see stringlib_filter_find */
+                hits += j;
+                if (hits > i + 2 * m && w - i > TWO_WAY_MIN_REST) {
+                    j = stringlib_two_way(s + i, n - i, p, m, mode);
+                    if (mode != FAST_COUNT)
+                        return j < 0 ? -1 : j + i;
+                    return count + j;
+                }
+                /* miss: check if next character is part of pattern */
+                if (!(mask & (1 << (s[i+m] & 0x1F))))
+                    i = i + m;
+                else
+                    i = i + skip;
+            } else {
+                /* skip: check if next character is part of pattern */
+                if (!(mask & (1 << (s[i+m] & 0x1F))))
+                    i = i + m;
+            }
+        }
+    } else {
+        /* process pattern[0] outside the loop */
+        mask |= (1 << (p[0] & 0x1F));
+        /* process pattern[:0:-1] */
+        for (j = mlast; j > 0; j--) {
+            mask |= (1 << (p[j] & 0x1F));
+            if (p[j] == p[0])
+                skip = j - 1;
+        }
+
+        for (i = w; i >= 0; i--) {
+            if (s[i] == p[0]) {
+                /* candidate match */
+                for (j = mlast; j > 0; j--)
+                    if (s[i+j] != p[j])
+                        break;
+                if (j == 0)
+                    /* got a match! */
                     return i;
-                count++;
-                i = i + mlast;
-                continue;
+                /* miss: check if previous character is part of pattern */
+                if (i > 0 && !(mask & (1 << (s[i-1] & 0x1F))))
+                    i = i - m;
+                else
+                    i = i - skip;
+            } else {
+                /* skip: check if previous character is part of pattern */
+                if (i > 0 && !(mask & (1 << (s[i-1] & 0x1F))))
+                    i = i - m;
             }
-            /* miss: check if next character is part of pattern */
-            if (!(mask & (1 << (s[i+m] & 0x1F))))
-                i = i + m;
-            else
-                i = i + skip;
-        } else {
-            /* skip: check if next character is part of pattern */
-            if (!(mask & (1 << (s[i+m] & 0x1F))))
-                i = i + m;
         }
     }
 
@@ -783,7 +783,6 @@ PyString_AsStringAndSize(register PyObject *obj,
 
 #define STRINGLIB_CHAR char
 
-#define STRINGLIB_CMP memcmp
 #define STRINGLIB_LEN PyString_GET_SIZE
 #define STRINGLIB_NEW PyString_FromStringAndSize
 #define STRINGLIB_STR PyString_AS_STRING
@@ -1439,23 +1438,20 @@ split_whitespace(const char *s, Py_ssize_t len, Py_ssize_t maxsplit)
 Py_LOCAL_INLINE(PyObject *)
 split_char(const char *s, Py_ssize_t len, char ch, Py_ssize_t maxcount)
 {
-	register Py_ssize_t i, j, count=0;
+	register Py_ssize_t i, pos, count=0;
 	PyObject *str;
 	PyObject *list = PyList_New(PREALLOC_SIZE(maxcount));
 
 	if (list == NULL)
 		return NULL;
 
-	i = j = 0;
-	while ((j < len) && (maxcount-- > 0)) {
-		for(; j<len; j++) {
-			/* I found that using memchr makes no difference */
-			if (s[j] == ch) {
-				SPLIT_ADD(s, i, j);
-				i = j = j + 1;
-				break;
-			}
-		}
+	i = 0;
+	while ((i < len) && (maxcount-- > 0)) {
+		pos = stringlib_find_char(s+i, len-i, ch);
+		if (pos < 0)
+			break;
+		SPLIT_ADD(s, i, i+pos);
+		i = i + pos + 1;
 	}
 	if (i <= len) {
 		SPLIT_ADD(s, i, len);
@@ -5031,6 +5027,34 @@ PyString_Fini(void)
 	nullstring = NULL;
 }
 
+/* The interned dict never shrinks when strings die and leave it.  Replace
+   it with a copy sized for the strings still in it when that would save a
+   good part of the table; return the number of slots released. */
+
+int _PyString_CompactInterned(void)
+{
+	PyObject *copy;
+	Py_ssize_t size, used;
+
+	if (interned == NULL || !PyDict_Check(interned))
+		return 0;
+	size = _PyDict_TableSize(interned);
+	used = ((PyDictObject *)interned)->ma_used;
+	if (size <= PyDict_MINSIZE || used * 8 > size)
+		return 0;
+	/* The copy takes its own references to the strings, which are given
+	   back when the old dict goes. */
+	copy = PyDict_Copy(interned);
+	if (copy == NULL) {
+		PyErr_Clear();
+		return 0;
+	}
+	size -= _PyDict_TableSize(copy);
+	Py_DECREF(interned);
+	interned = copy;
+	return (int)size;
+}
+
 void _Py_ReleaseInternedStrings(void)
 {
 	PyObject *keys;
@@ -765,19 +765,21 @@ _PyTuple_Resize(PyObject **pv, Py_ssize_t newsize)
 	return 0;
 }
 
-void
-PyTuple_Fini(void)
+/* Free the saved tuples, but keep the shared empty tuple */
+
+int
+PyTuple_ClearFreeList(void)
 {
+	int freed = 0;
 #if MAXSAVESIZE > 0
 	int i;
 
-	Py_XDECREF(free_tuples[0]);
-	free_tuples[0] = NULL;
-
 	for (i = 1; i < MAXSAVESIZE; i++) {
 		PyTupleObject *p, *q;
 		p = free_tuples[i];
 		free_tuples[i] = NULL;
+		freed += num_free_tuples[i];
+		num_free_tuples[i] = 0;
 		while (p) {
 			q = p;
 			p = (PyTupleObject *)(p->ob_item[0]);
@@ -785,6 +787,17 @@ PyTuple_Fini(void)
 		}
 	}
 #endif
+	return freed;
+}
+
+void
+PyTuple_Fini(void)
+{
+#if MAXSAVESIZE > 0
+	Py_XDECREF(free_tuples[0]);
+	free_tuples[0] = NULL;
+#endif
+	(void)PyTuple_ClearFreeList();
 }
 
 /*********************** Tuple Iterator **************************/
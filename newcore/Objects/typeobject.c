@@ -5,6 +5,204 @@
 
 #include <ctype.h>
 
+
+/* Support type attribute cache */
+
+/* The cache can keep references to the names alive for longer than
+   they normally would.  This is why the maximum size is limited to
+   MCACHE_MAX_ATTR_SIZE, since it might be a problem if very large
+   strings are used as attribute names. */
+#define MCACHE_MAX_ATTR_SIZE	100
+#define MCACHE_SIZE_EXP		10
+#define MCACHE_HASH(version, name_hash)					\
+		(((unsigned int)(version) * (unsigned int)(name_hash))	\
+		 >> (8*sizeof(unsigned int) - MCACHE_SIZE_EXP))
+#define MCACHE_HASH_METHOD(type, name)                                  \
+		MCACHE_HASH((type)->tp_version_tag,                     \
+		            ((PyStringObject *)(name))->ob_shash)
+#define MCACHE_CACHEABLE_NAME(name)                                     \
+		PyString_CheckExact(name) &&                            \
+		PyString_GET_SIZE(name) <= MCACHE_MAX_ATTR_SIZE
+
+struct method_cache_entry {
+	unsigned int version;
+	PyObject *name;		/* reference to exactly a str or None */
+	PyObject *value;	/* borrowed */
+};
+
+static struct method_cache_entry method_cache[1 << MCACHE_SIZE_EXP];
+/* Version tags are never handed out twice:  code objects keep the tag
+   next to a borrowed descriptor in their attribute caches, and those
+   outlive PyType_ClearCache().  Tag 0 is never valid. */
+static unsigned int next_version_tag = 1;
+
+/* Lookups answered from the cache, and lookups that had to walk the MRO */
+static unsigned long method_cache_hits = 0;
+static unsigned long method_cache_misses = 0;
+
+/* Empty the cache by filling names with references to Py_None, so that
+   refilling it doesn't change the total reference count.  Values are
+   also set to NULL for added protection, as they are borrowed references.
+*/
+static void
+method_cache_fill_none(void)
+{
+	Py_ssize_t i;
+
+	for (i = 0; i < (1 << MCACHE_SIZE_EXP); i++) {
+		method_cache[i].version = 0;
+		method_cache[i].value = NULL;
+		Py_XDECREF(method_cache[i].name);
+		method_cache[i].name = Py_None;
+		Py_INCREF(Py_None);
+	}
+}
+
+unsigned int
+PyType_ClearCache(void)
+{
+	unsigned int cur_version_tag = next_version_tag - 1;
+
+	method_cache_fill_none();
+	/* mark all version tags as invalid */
+	PyType_Modified(&PyBaseObject_Type);
+	return cur_version_tag;
+}
+
+void
+_PyType_CacheStats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = method_cache_hits;
+	*misses = method_cache_misses;
+}
+
+void
+PyType_Modified(PyTypeObject *type)
+{
+	/* Invalidate any cached data for the specified type and all
+	   subclasses.  This function is called after the base
+	   classes, mro, or attributes of the type are altered.
+
+	   Invariants:
+
+	   - Py_TPFLAGS_VALID_VERSION_TAG is never set if
+	     Py_TPFLAGS_HAVE_VERSION_TAG is not set (e.g. on type
+	     objects coming from non-recompiled extension modules)
+
+	   - before Py_TPFLAGS_VALID_VERSION_TAG can be set on a type,
+	     it must first be set on all super types.
+
+	   This function clears the Py_TPFLAGS_VALID_VERSION_TAG of a
+	   type (so it must first clear it on all subclasses).  The
+	   tp_version_tag value is meaningless unless this flag is set.
+	   We don't assign new version tags eagerly, but only as
+	   needed.
+	 */
+	PyObject *raw, *ref;
+	Py_ssize_t i, n;
+
+	if (!PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG))
+		return;
+
+	raw = type->tp_subclasses;
+	if (raw != NULL) {
+		n = PyList_GET_SIZE(raw);
+		for (i = 0; i < n; i++) {
+			ref = PyList_GET_ITEM(raw, i);
+			ref = PyWeakref_GET_OBJECT(ref);
+			if (ref != Py_None) {
+				PyType_Modified((PyTypeObject *)ref);
+			}
+		}
+	}
+	type->tp_flags &= ~Py_TPFLAGS_VALID_VERSION_TAG;
+}
+
+static void
+type_mro_modified(PyTypeObject *type, PyObject *bases) {
+	/*
+	   Check that all base classes or elements of the mro of type are
+	   able to be cached.  This function is called after the base
+	   classes or mro of the type are altered.
+
+	   Unset HAVE_VERSION_TAG and VALID_VERSION_TAG if the type
+	   inherits from an old-style class, either directly or if it
+	   appears in the MRO of a new-style class.  No support either for
+	   custom MROs that include types that are not officially super
+	   types.
+
+	   Called from mro_internal, which will subsequently be called on
+	   each subclass when their mro is recursively updated.
+	 */
+	Py_ssize_t i, n;
+	int clear = 0;
+
+	if (!PyType_HasFeature(type, Py_TPFLAGS_HAVE_VERSION_TAG))
+		return;
+
+	n = PyTuple_GET_SIZE(bases);
+	for (i = 0; i < n; i++) {
+		PyObject *b = PyTuple_GET_ITEM(bases, i);
+		PyTypeObject *cls;
+
+		if (!PyType_Check(b) ) {
+			clear = 1;
+			break;
+		}
+
+		cls = (PyTypeObject *)b;
+
+		if (!PyType_HasFeature(cls, Py_TPFLAGS_HAVE_VERSION_TAG) ||
+		    !PyType_IsSubtype(type, cls)) {
+			clear = 1;
+			break;
+		}
+	}
+
+	if (clear)
+		type->tp_flags &= ~(Py_TPFLAGS_HAVE_VERSION_TAG|
+		                    Py_TPFLAGS_VALID_VERSION_TAG);
+}
+
+static int
+assign_version_tag(PyTypeObject *type)
+{
+	/* Ensure that the tp_version_tag is valid and set
+	   Py_TPFLAGS_VALID_VERSION_TAG.  To respect the invariant, this
+	   must first be done on all super classes.  Return 0 if this
+	   cannot be done, 1 if Py_TPFLAGS_VALID_VERSION_TAG.
+	*/
+	Py_ssize_t i, n;
+	PyObject *bases;
+
+	if (PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG))
+		return 1;
+	if (!PyType_HasFeature(type, Py_TPFLAGS_HAVE_VERSION_TAG))
+		return 0;
+	if (!PyType_HasFeature(type, Py_TPFLAGS_READY))
+		return 0;
+
+	/* After wrap-around every tag has been used once; rather than
+	   hand one out again, leave the type untagged and uncached. */
+	if (next_version_tag == 0)
+		return 0;
+	if (next_version_tag == 1)
+		/* just starting Python */
+		method_cache_fill_none();
+	type->tp_version_tag = next_version_tag++;
+
+	bases = type->tp_bases;
+	n = PyTuple_GET_SIZE(bases);
+	for (i = 0; i < n; i++) {
+		PyObject *b = PyTuple_GET_ITEM(bases, i);
+		assert(PyType_Check(b));
+		if (!assign_version_tag((PyTypeObject *)b))
+			return 0;
+	}
+	type->tp_flags |= Py_TPFLAGS_VALID_VERSION_TAG;
+	return 1;
+}
+
 static PyMemberDef type_members[] = {
 	{"__basicsize__", T_INT, offsetof(PyTypeObject,tp_basicsize),READONLY},
 	{"__itemsize__", T_INT, offsetof(PyTypeObject, tp_itemsize), READONLY},
@@ -117,6 +315,8 @@ type_set_module(PyTypeObject *type, PyObject *value, void *context)
 		return -1;
 	}
 
+	PyType_Modified(type);
+
 	return PyDict_SetItemString(type->tp_dict, "__module__", value);
 }
 
@@ -239,6 +439,10 @@ type_set_bases(PyTypeObject *type, PyObject *value, void *context)
 	if (!compatible_for_assignment(type->tp_base, new_base, "__bases__"))
 		return -1;
 
+	/* Cached lookups of this type and its subclasses used the old MRO;
+	   mro_internal() re-checks whether the new one can be cached */
+	PyType_Modified(type);
+
 	Py_INCREF(new_base);
 	Py_INCREF(value);
 
@@ -1350,6 +1554,14 @@ mro_internal(PyTypeObject *type)
 		}
 	}
 	type->tp_mro = tuple;
+
+	type_mro_modified(type, type->tp_mro);
+	/* corner case: the old-style super class might have been hidden
+	   from the custom MRO */
+	type_mro_modified(type, type->tp_bases);
+
+	PyType_Modified(type);
+
 	return 0;
 }
 
@@ -1527,7 +1739,7 @@ subtype_dict(PyObject *obj, void *context)
 	}
 	dict = *dictptr;
 	if (dict == NULL)
-		*dictptr = dict = PyDict_New();
+		*dictptr = dict = _PyObjectDict_New(obj->ob_type);
 	Py_XINCREF(dict);
 	return dict;
 }
@@ -2086,6 +2298,10 @@ type_new(PyTypeObject *metatype, PyObject *args, PyObject *kwds)
 	/* Put the proper slots in place */
 	fixup_slot_dispatchers(type);
 
+	/* Keys for the instance dicts to share */
+	if (type->tp_dictoffset)
+		et->ht_cached_keys = _PyDict_NewKeysForClass();
+
 	return (PyObject *)type;
 }
 
@@ -2095,7 +2311,20 @@ PyObject *
 _PyType_Lookup(PyTypeObject *type, PyObject *name)
 {
 	Py_ssize_t i, n;
-	PyObject *mro, *res, *base, *dict;
+	PyObject *mro, *res = NULL, *base, *dict;
+	unsigned int h;
+
+	if (MCACHE_CACHEABLE_NAME(name) &&
+	    PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+		/* fast path */
+		h = MCACHE_HASH_METHOD(type, name);
+		if (method_cache[h].version == type->tp_version_tag &&
+		    method_cache[h].name == name) {
+			method_cache_hits++;
+			return method_cache[h].value;
+		}
+	}
+	method_cache_misses++;
 
 	/* Look in tp_dict of types in MRO */
 	mro = type->tp_mro;
@@ -2119,9 +2348,18 @@ _PyType_Lookup(PyTypeObject *type, PyObject *name)
 		assert(dict && PyDict_Check(dict));
 		res = PyDict_GetItem(dict, name);
 		if (res != NULL)
-			return res;
+			break;
 	}
-	return NULL;
+
+	if (MCACHE_CACHEABLE_NAME(name) && assign_version_tag(type)) {
+		h = MCACHE_HASH_METHOD(type, name);
+		method_cache[h].version = type->tp_version_tag;
+		method_cache[h].value = res;  /* borrowed */
+		Py_INCREF(name);
+		Py_XDECREF(method_cache[h].name);
+		method_cache[h].name = name;
+	}
+	return res;
 }
 
 /* This is similar to PyObject_GenericGetAttr(),
@@ -2211,12 +2449,10 @@ type_setattro(PyTypeObject *type, PyObject *name, PyObject *value)
 			type->tp_name);
 		return -1;
 	}
-	/* XXX Example of how I expect this to be used...
-	if (update_subclasses(type, name, invalidate_cache, NULL) < 0)
-		return -1;
-	*/
 	if (PyObject_GenericSetAttr((PyObject *)type, name, value) < 0)
 		return -1;
+	/* The attribute may be cached for this type and its subclasses */
+	PyType_Modified(type);
 	return update_slot(type, name);
 }
 
@@ -2242,6 +2478,8 @@ type_dealloc(PyTypeObject *type)
 	PyObject_Free((char *)type->tp_doc);
 	Py_XDECREF(et->ht_name);
 	Py_XDECREF(et->ht_slots);
+	if (et->ht_cached_keys != NULL)
+		_PyDictKeys_DecRef(et->ht_cached_keys);
 	type->ob_type->tp_free((PyObject *)type);
 }
 
@@ -2313,11 +2551,15 @@ type_clear(PyTypeObject *type)
 	   for heaptypes. */
 	assert(type->tp_flags & Py_TPFLAGS_HEAPTYPE);
 
-	/* The only field we need to clear is tp_mro, which is part of a
-	   hard cycle (its first element is the class itself) that won't
-	   be broken otherwise (it's a tuple and tuples don't have a
-	   tp_clear handler).  None of the other fields need to be
-	   cleared, and here's why:
+	/* We need to invalidate the method cache carefully before clearing
+	   the dict, so that other objects caught in a reference cycle
+	   don't start calling destroyed methods.
+
+	   Otherwise, the only field we need to clear is tp_mro, which is
+	   part of a hard cycle (its first element is the class itself) that
+	   won't be broken otherwise (it's a tuple and tuples don't have a
+	   tp_clear handler).  None of the other fields need to be cleared,
+	   and here's why:
 
 	   tp_dict:
 	       It is a dict, so the collector will call its tp_clear.
@@ -2338,6 +2580,9 @@ type_clear(PyTypeObject *type)
 	       A tuple of strings can't be part of a cycle.
 	*/
 
+	PyType_Modified(type);
+	if (type->tp_dict)
+		PyDict_Clear(type->tp_dict);
 	Py_CLEAR(type->tp_mro);
 
 	return 0;
@@ -1188,6 +1188,81 @@ PyObject *PyUnicode_EncodeUTF7(const Py_UNICODE *s,
 #undef ENCODE
 #undef DECODE
 
+/* --- Word-at-a-time helpers --------------------------------------------- */
+
+/* The UTF-8 and ASCII codecs go through runs of ASCII a size_t worth of
+   input at a time: a word of bytes is all ASCII if none has its top bit
+   set, a word of Py_UNICODE units if none is above 0x7F.  Words are only
+   read where they are aligned, so this is safe on ARM too. */
+
+#define WORD_ALIGNED(p) (((Py_uintptr_t)(p) & (SIZEOF_SIZE_T - 1)) == 0)
+
+/* the top bit of every byte of a word */
+#define ASCII_BYTE_MASK ((size_t)-1 / 0xFF * 0x80)
+
+/* the bits of every Py_UNICODE unit of a word above 0x7F */
+#if Py_UNICODE_SIZE == 2
+#define ASCII_UNIT_MASK ((size_t)-1 / 0xFFFFU * 0xFF80U)
+#else
+#define ASCII_UNIT_MASK ((size_t)-1 / 0xFFFFFFFFUL * 0xFFFFFF80UL)
+#endif
+
+#define UNITS_PER_WORD (SIZEOF_SIZE_T / Py_UNICODE_SIZE)
+
+/* The number of leading ASCII bytes of [s, e) */
+static Py_ssize_t
+ascii_prefix(const char *s, const char *e)
+{
+    const char *p = s;
+
+    while (p < e) {
+        if (WORD_ALIGNED(p)) {
+            while (e - p >= SIZEOF_SIZE_T &&
+                   (*(const size_t *)p & ASCII_BYTE_MASK) == 0)
+                p += SIZEOF_SIZE_T;
+            if (p == e)
+                break;
+        }
+        if (*(const unsigned char *)p & 0x80)
+            break;
+        p++;
+    }
+    return p - s;
+}
+
+/* The number of leading ASCII units of [s, e) */
+static Py_ssize_t
+unicode_ascii_prefix(const Py_UNICODE *s, const Py_UNICODE *e)
+{
+    const Py_UNICODE *p = s;
+
+    while (p < e) {
+        if (WORD_ALIGNED(p)) {
+            while (e - p >= UNITS_PER_WORD &&
+                   (*(const size_t *)p & ASCII_UNIT_MASK) == 0)
+                p += UNITS_PER_WORD;
+            if (p == e)
+                break;
+        }
+        if (*p >= 0x80)
+            break;
+        p++;
+    }
+    return p - s;
+}
+
+/* Widen the leading ASCII bytes of [s, e) into dest, returning their
+   number.  The copy is a loop of its own, for compilers that vectorize. */
+static Py_ssize_t
+ascii_decode(const char *s, const char *e, Py_UNICODE *dest)
+{
+    Py_ssize_t i, n = ascii_prefix(s, e);
+
+    for (i = 0; i < n; i++)
+        dest[i] = (unsigned char)s[i];
+    return n;
+}
+
 /* --- UTF-8 Codec -------------------------------------------------------- */
 
 static
@@ -1232,10 +1307,20 @@ PyObject *PyUnicode_DecodeUTF8Stateful(const char *s,
     const char *e;
     PyUnicodeObject *unicode;
     Py_UNICODE *p;
+    const char *errin;
+    Py_UNICODE *errout;
     const char *errmsg = "";
     PyObject *errorHandler = NULL;
     PyObject *exc = NULL;
 
+    /* ASCII is the same in UTF-8 */
+    if (size == 1 && *(unsigned char*)s < 128) {
+	Py_UNICODE r = *(unsigned char*)s;
+	if (consumed)
+	    *consumed = 1;
+	return PyUnicode_FromUnicode(&r, 1);
+    }
+
     /* Note: size will always be longer than the resulting Unicode
        character count */
     unicode = _PyUnicode_New(size);
@@ -1255,6 +1340,21 @@ PyObject *PyUnicode_DecodeUTF8Stateful(const char *s,
         Py_UCS4 ch = (unsigned char)*s;
 
         if (ch < 0x80) {
+            /* Take runs of ASCII a word at a time where aligned */
+            if (WORD_ALIGNED(s)) {
+                while (e - s >= SIZEOF_SIZE_T &&
+                       (*(const size_t *)s & ASCII_BYTE_MASK) == 0) {
+                    for (n = 0; n < SIZEOF_SIZE_T; n++)
+                        p[n] = (unsigned char)s[n];
+                    s += SIZEOF_SIZE_T;
+                    p += SIZEOF_SIZE_T;
+                }
+                if (s == e)
+                    break;
+                ch = (unsigned char)*s;
+                if (ch >= 0x80)
+                    continue;
+            }
             *p++ = (Py_UNICODE)ch;
             s++;
             continue;
@@ -1380,13 +1480,19 @@ PyObject *PyUnicode_DecodeUTF8Stateful(const char *s,
 	continue;
 
     utf8Error:
+    /* The handler moves s and p through copies, so that the loop can
+       keep them in registers */
     outpos = p-PyUnicode_AS_UNICODE(unicode);
+    errin = s;
+    errout = p;
     if (unicode_decode_call_errorhandler(
 	     errors, &errorHandler,
 	     "utf8", errmsg,
-	     starts, size, &startinpos, &endinpos, &exc, &s,
-	     (PyObject **)&unicode, &outpos, &p))
+	     starts, size, &startinpos, &endinpos, &exc, &errin,
+	     (PyObject **)&unicode, &outpos, &errout))
 	goto onError;
+    s = errin;
+    p = errout;
     }
     if (consumed)
 	*consumed = s-starts;
@@ -1437,6 +1543,16 @@ PyUnicode_EncodeUTF8(const Py_UNICODE *s,
         v = NULL;   /* will allocate after we're done */
         p = stackbuf;
     }
+    else if (unicode_ascii_prefix(s, s + size) == size) {
+        /* All ASCII, as much text is: that takes just size bytes */
+        v = PyString_FromStringAndSize(NULL, size);
+        if (v != NULL) {
+            p = PyString_AS_STRING(v);
+            for (i = 0; i < size; i++)
+                p[i] = (char)s[i];
+        }
+        return v;
+    }
     else {
         /* Overallocate on the heap, and give the excess back at the end. */
         nallocated = size * 4;
@@ -2853,8 +2969,10 @@ PyObject *PyUnicode_DecodeASCII(const char *s,
     while (s < e) {
 	register unsigned char c = (unsigned char)*s;
 	if (c < 128) {
-	    *p++ = c;
-	    ++s;
+	    /* the whole run of ASCII */
+	    Py_ssize_t run = ascii_decode(s, e, p);
+	    p += run;
+	    s += run;
 	}
 	else {
 	    startinpos = s-starts;
@@ -4320,14 +4438,6 @@ int PyUnicode_EncodeDecimal(Py_UNICODE *s,
 #define STRINGLIB_NEW PyUnicode_FromUnicode
 #define STRINGLIB_STR PyUnicode_AS_UNICODE
 
-Py_LOCAL_INLINE(int)
-STRINGLIB_CMP(const Py_UNICODE* str, const Py_UNICODE* other, Py_ssize_t len)
-{
-    if (str[0] != other[0])
-        return 1;
-    return memcmp((void*) str, (void*) other, len * sizeof(Py_UNICODE));
-}
-
 #define STRINGLIB_EMPTY unicode_empty
 
 #include "stringlib/fastsearch.h"
@@ -4915,14 +5025,13 @@ PyObject *split_char(PyUnicodeObject *self,
     Py_ssize_t len = self->length;
     PyObject *str;
 
-    for (i = j = 0; i < len; ) {
-	if (self->str[i] == ch) {
-	    if (maxcount-- <= 0)
-		break;
-	    SPLIT_APPEND(self->str, j, i);
-	    i = j = i + 1;
-	} else
-	    i++;
+    for (j = 0; maxcount-- > 0; ) {
+	i = stringlib_find_char(self->str + j, len - j, ch);
+	if (i < 0)
+	    break;
+	i += j;
+	SPLIT_APPEND(self->str, j, i);
+	j = i + 1;
     }
     if (j <= len) {
 	SPLIT_APPEND(self->str, j, len);
@@ -4946,14 +5055,14 @@ PyObject *split_substring(PyUnicodeObject *self,
     Py_ssize_t sublen = substring->length;
     PyObject *str;
 
-    for (i = j = 0; i <= len - sublen; ) {
-	if (Py_UNICODE_MATCH(self, i, substring)) {
-	    if (maxcount-- <= 0)
-		break;
-	    SPLIT_APPEND(self->str, j, i);
-	    i = j = i + sublen;
-	} else
-	    i++;
+    for (j = 0; maxcount-- > 0; ) {
+	i = fastsearch(self->str + j, len - j, substring->str, sublen,
+		       FAST_SEARCH);
+	if (i < 0)
+	    break;
+	i += j;
+	SPLIT_APPEND(self->str, j, i);
+	j = i + sublen;
     }
     if (j <= len) {
 	SPLIT_APPEND(self->str, j, len);
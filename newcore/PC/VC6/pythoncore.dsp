@@ -149,6 +149,10 @@ SOURCE=..\..\Modules\_lsprof.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Modules\_opprofile.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Modules\_randommodule.c
 # End Source File
 # Begin Source File
@@ -463,6 +467,10 @@ SOURCE=..\..\Python\marshal.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Python\memrelease.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Modules\mathmodule.c
 # End Source File
 # Begin Source File
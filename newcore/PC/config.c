@@ -66,6 +66,7 @@ extern void init_codecs_kr(void);
 extern void init_codecs_tw(void);
 extern void init_subprocess(void);
 extern void init_lsprof(void);
+extern void init_opprofile(void);
 extern void init_ast(void);
 extern void init_types(void);
 
@@ -123,6 +124,7 @@ struct _inittab _PyImport_Inittab[] = {
         {"_bisect", init_bisect},
         {"_heapq", init_heapq},
 	{"_lsprof", init_lsprof},
+	{"_opprofile", init_opprofile},
 	{"itertools", inititertools},
         {"collections", initcollections},
 	{"_symtable", init_symtable},
@@ -245,10 +245,20 @@ parsetok(struct tok_state *tok, grammar *g, int start, perrdetail *err_ret,
 			n = NULL;
 			goto done;
 		}
-		r->n_str = tok->encoding;
+		/* The node is freed with PyObject_FREE, whereas the
+		   tokenizer got the name from PyMem_MALLOC. */
+		r->n_str = PyObject_MALLOC(strlen(tok->encoding) + 1);
+		if (!r->n_str) {
+			err_ret->error = E_NOMEM;
+			PyObject_FREE(r);
+			n = NULL;
+			goto done;
+		}
+		strcpy(r->n_str, tok->encoding);
+		PyMem_FREE(tok->encoding);
+		tok->encoding = NULL;
 		r->n_nchildren = 1;
 		r->n_child = n;
-		tok->encoding = NULL;
 		n = r;
 	}
 
@@ -116,6 +116,20 @@ getgrammar(char *filename)
 	return g;
 }
 
+#ifdef PYMALLOC_THREAD_CACHE
+/* obmalloc looks for the block cache of the current thread; pgen never has
+   a thread state */
+PyThreadState *_PyThreadState_Current = NULL;
+#endif
+
+/* obmalloc calls this when the system runs out of memory; pgen has no free
+   lists or caches to give back */
+Py_ssize_t
+PyMem_ReleaseCaches(int level)
+{
+	return 0;
+}
+
 /* Can't happen in pgen */
 PyObject*
 PyErr_Occurred()
@@ -77,6 +77,20 @@ void dump_tsc(int opcode, int ticked, uint64 inst0, uint64 inst1,
 /* Turn this on if your compiler chokes on the big switch: */
 /* #define CASE_TOO_BIG 1 */
 
+/* Define USE_COMPUTED_GOTOS (configure --with-computed-gotos) to have
+   every opcode jump straight to the next one through a table of label
+   addresses, instead of going back to the top of the switch.  This needs
+   the labels-as-values extension of GCC and Clang.  The builds that count
+   what goes through the top of the loop keep using the switch. */
+#ifdef USE_COMPUTED_GOTOS
+#ifndef __GNUC__
+#error "USE_COMPUTED_GOTOS needs a compiler with labels as values"
+#endif
+#if defined(DYNAMIC_EXECUTION_PROFILE) || defined(WITH_TSC)
+#undef USE_COMPUTED_GOTOS
+#endif
+#endif
+
 #ifdef Py_DEBUG
 /* For debugging the interpreter: */
 #define LLTRACE  1	/* Low-level trace feature */
@@ -87,15 +101,22 @@ typedef PyObject *(*callproc)(PyObject *, PyObject *, PyObject *);
 
 /* Forward declarations */
 #ifdef WITH_TSC
-static PyObject * call_function(PyObject ***, int, uint64*, uint64*);
+static PyObject * call_function(PyObject ***, int, PyOpcache *,
+				 uint64*, uint64*);
 #else
-static PyObject * call_function(PyObject ***, int);
+static PyObject * call_function(PyObject ***, int, PyOpcache *);
 #endif
-static PyObject * fast_function(PyObject *, PyObject ***, int, int, int);
+static PyObject * fast_function(PyObject *, PyObject ***, int, int, int,
+				PyOpcache *);
+static int keyword_slots(PyOpcache_Call *, PyCodeObject *, int, int,
+			 PyObject **);
 static PyObject * do_call(PyObject *, PyObject ***, int, int);
 static PyObject * ext_do_call(PyObject *, PyObject ***, int, int, int);
 static PyObject * update_keyword_args(PyObject *, int, PyObject ***,PyObject *);
 static PyObject * update_star_args(int, int, PyObject *, PyObject ***);
+#ifdef WITH_THREAD
+static void init_pending_lock(void);
+#endif
 static PyObject * load_args(PyObject ***, int);
 #define CALL_FLAG_VAR 1
 #define CALL_FLAG_KW 2
@@ -116,6 +137,8 @@ static PyObject * apply_slice(PyObject *, PyObject *, PyObject *);
 static int assign_slice(PyObject *, PyObject *,
 			PyObject *, PyObject *);
 static PyObject * cmp_outcome(int, PyObject *, PyObject *);
+static PyObject * load_attr_cached(PyObject *, PyObject *, PyOpcache *);
+static int store_attr_cached(PyObject *, PyObject *, PyObject *, PyOpcache *);
 static PyObject * import_from(PyObject *, PyObject *);
 static int import_all_from(PyObject *, PyObject *);
 static PyObject * build_class(PyObject *, PyObject *, PyObject *);
@@ -211,7 +234,7 @@ PyEval_GetCallStats(PyObject *self)
 #endif
 #include "pythread.h"
 
-static PyThread_type_lock interpreter_lock = 0; /* This is the GIL */
+static PyThread_type_gil interpreter_lock = 0; /* This is the GIL */
 static long main_thread = 0;
 
 int
@@ -233,21 +256,22 @@ PyEval_InitThreads(void)
 {
 	if (interpreter_lock)
 		return;
-	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
+	interpreter_lock = PyThread_allocate_gil(&_Py_Ticker);
+	PyThread_acquire_gil(interpreter_lock, 0);
 	main_thread = PyThread_get_thread_ident();
+	init_pending_lock();
 }
 
 void
 PyEval_AcquireLock(void)
 {
-	PyThread_acquire_lock(interpreter_lock, 1);
+	PyThread_acquire_gil(interpreter_lock, 0);
 }
 
 void
 PyEval_ReleaseLock(void)
 {
-	PyThread_release_lock(interpreter_lock);
+	PyThread_release_gil(interpreter_lock);
 }
 
 void
@@ -257,7 +281,7 @@ PyEval_AcquireThread(PyThreadState *tstate)
 		Py_FatalError("PyEval_AcquireThread: NULL new thread state");
 	/* Check someone has called PyEval_InitThreads() to create the lock */
 	assert(interpreter_lock);
-	PyThread_acquire_lock(interpreter_lock, 1);
+	PyThread_acquire_gil(interpreter_lock, 0);
 	if (PyThreadState_Swap(tstate) != NULL)
 		Py_FatalError(
 			"PyEval_AcquireThread: non-NULL old thread state");
@@ -270,7 +294,7 @@ PyEval_ReleaseThread(PyThreadState *tstate)
 		Py_FatalError("PyEval_ReleaseThread: NULL thread state");
 	if (PyThreadState_Swap(NULL) != tstate)
 		Py_FatalError("PyEval_ReleaseThread: wrong thread state");
-	PyThread_release_lock(interpreter_lock);
+	PyThread_release_gil(interpreter_lock);
 }
 
 /* This function is called from PyOS_AfterFork to ensure that newly
@@ -290,9 +314,10 @@ PyEval_ReInitThreads(void)
 	  much error-checking.  Doing this cleanly would require
 	  adding a new function to each thread_*.h.  Instead, just
 	  create a new lock and waste a little bit of memory */
-	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
+	interpreter_lock = PyThread_allocate_gil(&_Py_Ticker);
+	PyThread_acquire_gil(interpreter_lock, 0);
 	main_thread = PyThread_get_thread_ident();
+	init_pending_lock();
 
 	/* Update the threading module with the new state.
 	 */
@@ -325,7 +350,7 @@ PyEval_SaveThread(void)
 		Py_FatalError("PyEval_SaveThread: NULL tstate");
 #ifdef WITH_THREAD
 	if (interpreter_lock)
-		PyThread_release_lock(interpreter_lock);
+		PyThread_release_gil(interpreter_lock);
 #endif
 	return tstate;
 }
@@ -338,7 +363,8 @@ PyEval_RestoreThread(PyThreadState *tstate)
 #ifdef WITH_THREAD
 	if (interpreter_lock) {
 		int err = errno;
-		PyThread_acquire_lock(interpreter_lock, 1);
+		/* Most likely back from I/O, so ask for the lock at once */
+		PyThread_acquire_gil(interpreter_lock, 1);
 		errno = err;
 	}
 #endif
@@ -365,60 +391,304 @@ PyEval_RestoreThread(PyThreadState *tstate)
    will execute them.
 #endif
 
-   XXX WARNING!  ASYNCHRONOUSLY EXECUTING CODE!
-   There are two possible race conditions:
-   (1) nested asynchronous registry calls;
-   (2) registry calls made while pending calls are being processed.
-   While (1) is very unlikely, (2) is a real possibility.
-   The current code is safe against (2), but not against (1).
-   The safety against (2) is derived from the fact that only one
-   thread (the main thread) ever takes things out of the queue.
-
-   XXX Darn!  With the advent of thread state, we should have an array
-   of pending calls per thread in the thread state!  Later...
+   A call is registered in a node of a pool: the first NPENDINGCALLS
+   nodes are static, and the main thread adds more blocks of them, up
+   to MAXPENDINGBLOCKS, when a batch it takes has used more than half
+   of the nodes.  Registry itself never allocates; with no free node
+   it fails.  A call whose function and argument are already queued
+   and not yet started is not queued twice, so a signal handler uses
+   at most one node however often its signal arrives.
+
+   Registering claims a free node and pushes it onto pending_head; the
+   main thread takes the whole list at once, and runs it oldest first
+   at the next periodic check.  Where the compiler has an atomic
+   compare-and-swap this needs no lock, so nested registry from a
+   signal handler and registry from several threads are all safe.
+   Elsewhere the same steps are done holding pending_lock.  It is
+   tried without waiting so that a signal handler cannot deadlock on
+   it, and a registry that cannot get the lock fails; except on
+   Symbian, where no signal handler registers calls and the callers
+   are threads, which wait for it instead.
 */
 
 #define NPENDINGCALLS 32
-static struct {
-	int (*func)(void *);
-	void *arg;
-} pendingcalls[NPENDINGCALLS];
-static volatile int pendingfirst = 0;
-static volatile int pendinglast = 0;
+#define MAXPENDINGBLOCKS 32
+
+/* Node states */
+#define PENDING_FREE	0
+#define PENDING_CLAIMED	1	/* being filled in */
+#define PENDING_QUEUED	2	/* filled in, not yet started */
+
+typedef struct pendingcall {
+	int (*volatile func)(void *);
+	void *volatile arg;
+	struct pendingcall *next;
+	volatile int state;
+	volatile unsigned int seq;	/* bumped at each claim */
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval when;		/* time of registry */
+#endif
+} pendingcall;
+
+typedef struct pendingblock {
+	pendingcall calls[NPENDINGCALLS];
+	struct pendingblock *volatile next;
+} pendingblock;
+
+static pendingblock pending_nodes;		/* the first block */
+static pendingcall *volatile pending_head = NULL;	/* newest first */
+static pendingcall *pending_todo = NULL;	/* taken, oldest first */
 static volatile int things_to_do = 0;
 
+/* Statistics, for sys._pending_call_stats() */
+static long pending_run = 0;
+static volatile long pending_refused = 0;
+static volatile long pending_merged = 0;
+static int pending_nblocks = 1;		/* only the main thread adds */
+static int pending_max_batch = 0;
+static double pending_max_latency = 0.0;
+static double pending_total_latency = 0.0;
+
+#if defined(__GNUC__) && !defined(__SYMBIAN32__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define PENDING_CAS(p, old, new) __sync_bool_compare_and_swap(p, old, new)
+#define PENDING_RELEASE(p) __sync_lock_release(p)
+#define PENDING_BARRIER() __sync_synchronize()
+#define PENDING_LOCK() 1
+#define PENDING_UNLOCK()
+
+#ifdef WITH_THREAD
+static void
+init_pending_lock(void)
+{
+}
+#endif
+
+#else
+/* Only one thread at a time gets here, holding pending_lock */
+#define PENDING_CAS(p, old, new) \
+	(*(p) == (old) ? (*(p) = (new), 1) : 0)
+#define PENDING_RELEASE(p) (*(p) = 0)
+#define PENDING_BARRIER()
+#define PENDING_LOCK() pending_lock_acquire()
+#define PENDING_UNLOCK() pending_lock_release()
+
+#ifdef WITH_THREAD
+static PyThread_type_lock pending_lock = NULL;
+
+/* Called when threads start, and again in a child after a fork */
+static void
+init_pending_lock(void)
+{
+	pending_lock = PyThread_allocate_lock();
+}
+#endif
+static volatile int pending_busy = 0;
+
+static int
+pending_lock_acquire(void)
+{
+#ifdef WITH_THREAD
+	if (pending_lock != NULL) {
+#ifdef SYMBIAN
+		/* No signal handler gets here, and the lock is only
+		   held for a few instructions */
+		return PyThread_acquire_lock(pending_lock, WAIT_LOCK);
+#else
+		int i;
+		for (i = 0; i < 100; i++) {
+			if (PyThread_acquire_lock(pending_lock, NOWAIT_LOCK))
+				return 1;
+		}
+		return 0;
+#endif
+	}
+#endif
+	/* Until there are threads, only a signal handler can interrupt */
+	if (pending_busy)
+		return 0;
+	pending_busy = 1;
+	return 1;
+}
+
+static void
+pending_lock_release(void)
+{
+#ifdef WITH_THREAD
+	if (pending_lock != NULL) {
+		PyThread_release_lock(pending_lock);
+		return;
+	}
+#endif
+	pending_busy = 0;
+}
+#endif
+
+/* Return 1 if func(arg) is queued and not yet started.  The node's seq
+   is the same before and after, so the state and fields read belong to
+   one registry, and the call was still queued when last looked at. */
+
+static int
+pending_find(int (*func)(void *), void *arg)
+{
+	pendingblock *b;
+	pendingcall *call;
+	unsigned int seq;
+	int i;
+
+	for (b = &pending_nodes; b != NULL; b = b->next) {
+		for (i = 0; i < NPENDINGCALLS; i++) {
+			call = &b->calls[i];
+			if (call->state != PENDING_QUEUED)
+				continue;
+			seq = call->seq;
+			PENDING_BARRIER();
+			if (call->state != PENDING_QUEUED ||
+			    call->func != func || call->arg != arg)
+				continue;
+			PENDING_BARRIER();
+			if (call->state != PENDING_QUEUED)
+				continue;
+			PENDING_BARRIER();
+			if (call->seq == seq)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/* Claim a free node; NULL if none.  Never allocates. */
+
+static pendingcall *
+pending_claim(void)
+{
+	pendingblock *b;
+	pendingcall *call;
+	int i;
+
+	for (b = &pending_nodes; b != NULL; b = b->next) {
+		for (i = 0; i < NPENDINGCALLS; i++) {
+			call = &b->calls[i];
+			if (call->state == PENDING_FREE &&
+			    PENDING_CAS(&call->state, PENDING_FREE,
+					PENDING_CLAIMED)) {
+				call->seq++;
+				return call;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* Add a block of nodes.  Only the main thread calls this, outside any
+   signal handler, so it may allocate. */
+
+static void
+pending_grow(void)
+{
+	pendingblock *b, *nb;
+
+	if (pending_nblocks >= MAXPENDINGBLOCKS)
+		return;
+	nb = (pendingblock *)malloc(sizeof(pendingblock));
+	if (nb == NULL)
+		return;
+	memset(nb, 0, sizeof(pendingblock));
+	for (b = &pending_nodes; b->next != NULL; b = b->next)
+		;
+	PENDING_BARRIER();
+	b->next = nb;
+	pending_nblocks++;
+}
+
 int
 Py_AddPendingCall(int (*func)(void *), void *arg)
 {
-	static volatile int busy = 0;
-	int i, j;
-	/* XXX Begin critical section */
-	/* XXX If you want this to be safe against nested
-	   XXX asynchronous calls, you'll have to work harder! */
-	if (busy)
+	pendingcall *call, *head;
+
+	if (!PENDING_LOCK()) {
+		pending_refused++;
 		return -1;
-	busy = 1;
-	i = pendinglast;
-	j = (i + 1) % NPENDINGCALLS;
-	if (j == pendingfirst) {
-		busy = 0;
+	}
+	if (pending_find(func, arg)) {
+		PENDING_UNLOCK();
+		pending_merged++;
+		_Py_Ticker = 0;
+		things_to_do = 1;
+		return 0;
+	}
+	call = pending_claim();
+	if (call == NULL) {
+		PENDING_UNLOCK();
+		pending_refused++;
 		return -1; /* Queue full */
 	}
-	pendingcalls[i].func = func;
-	pendingcalls[i].arg = arg;
-	pendinglast = j;
+	call->func = func;
+	call->arg = arg;
+#ifdef HAVE_GETTIMEOFDAY
+#ifdef GETTIMEOFDAY_NO_TZ
+	gettimeofday(&call->when);
+#else
+	gettimeofday(&call->when, (struct timezone *)NULL);
+#endif
+#endif
+	PENDING_BARRIER();
+	call->state = PENDING_QUEUED;
+	do {
+		head = pending_head;
+		call->next = head;
+	} while (!PENDING_CAS(&pending_head, head, call));
+	PENDING_UNLOCK();
 
 	_Py_Ticker = 0;
 	things_to_do = 1; /* Signal main loop */
-	busy = 0;
-	/* XXX End critical section */
 	return 0;
 }
 
+/* Move the calls registered so far behind those in pending_todo, oldest
+   first; return how many there were, or -1 if pending_lock was busy */
+
+static int
+pending_take(void)
+{
+	pendingcall *list, *call, *next, **tail;
+	int n = 0;
+
+	if (!PENDING_LOCK())
+		return -1;
+	do {
+		list = pending_head;
+	} while (list != NULL && !PENDING_CAS(&pending_head, list, NULL));
+	PENDING_UNLOCK();
+
+	/* Reverse it */
+	call = NULL;
+	while (list != NULL) {
+		next = list->next;
+		list->next = call;
+		call = list;
+		list = next;
+		n++;
+	}
+	for (tail = &pending_todo; *tail != NULL; tail = &(*tail)->next)
+		;
+	*tail = call;
+	return n;
+}
+
 int
 Py_MakePendingCalls(void)
 {
 	static int busy = 0;
+	pendingcall *call;
+	int (*func)(void *);
+	void *arg;
+	int n;
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval now;
+	double latency;
+#endif
+
 #ifdef WITH_THREAD
 	if (!PyEval_InMainThread())
 		return 0;
@@ -427,16 +697,39 @@ Py_MakePendingCalls(void)
 		return 0;
 	busy = 1;
 	things_to_do = 0;
-	for (;;) {
-		int i;
-		int (*func)(void *);
-		void *arg;
-		i = pendingfirst;
-		if (i == pendinglast)
-			break; /* Queue empty */
-		func = pendingcalls[i].func;
-		arg = pendingcalls[i].arg;
-		pendingfirst = (i + 1) % NPENDINGCALLS;
+	n = pending_take();
+	if (n < 0) {
+		busy = 0;
+		things_to_do = 1; /* Try again soon */
+		return 0;
+	}
+	if (n > pending_max_batch)
+		pending_max_batch = n;
+	if (2 * n > pending_nblocks * NPENDINGCALLS)
+		pending_grow();
+#ifdef HAVE_GETTIMEOFDAY
+	if (pending_todo != NULL) {
+#ifdef GETTIMEOFDAY_NO_TZ
+		gettimeofday(&now);
+#else
+		gettimeofday(&now, (struct timezone *)NULL);
+#endif
+	}
+#endif
+	while ((call = pending_todo) != NULL) {
+		func = call->func;
+		arg = call->arg;
+#ifdef HAVE_GETTIMEOFDAY
+		latency = (now.tv_sec - call->when.tv_sec) +
+			(now.tv_usec - call->when.tv_usec) * 1e-6;
+		pending_total_latency += latency;
+		if (latency > pending_max_latency)
+			pending_max_latency = latency;
+#endif
+		pending_todo = call->next;
+		/* Started: a registry of the same call queues a new one */
+		PENDING_RELEASE(&call->state);
+		pending_run++;
 		if (func(arg) < 0) {
 			busy = 0;
 			things_to_do = 1; /* We're not done yet */
@@ -447,6 +740,20 @@ Py_MakePendingCalls(void)
 	return 0;
 }
 
+PyObject *
+_Py_PendingCallStats(void)
+{
+	return Py_BuildValue("{s:l,s:l,s:l,s:i,s:i,s:d,s:d}",
+			     "run", pending_run,
+			     "refused", (long)pending_refused,
+			     "merged", (long)pending_merged,
+			     "blocks", pending_nblocks,
+			     "max_batch", pending_max_batch,
+			     "max_latency", pending_max_latency,
+			     "mean_latency", pending_run ?
+				pending_total_latency / pending_run : 0.0);
+}
+
 
 /* The interpreter's recursion limit */
 
@@ -569,6 +876,9 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
            initial values are such as to make this false the first
            time it is tested. */
 	int instr_ub = -1, instr_lb = 0, instr_prev = -1;
+#if !defined(DYNAMIC_EXECUTION_PROFILE) && !defined(USE_COMPUTED_GOTOS)
+	int predicting = 1;	/* cleared while an opcode trace is set */
+#endif
 
 	unsigned char *first_instr;
 	PyObject *names;
@@ -577,6 +887,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 	/* Make it easier to find out where we are with a debugger */
 	char *filename;
 #endif
+#ifdef USE_COMPUTED_GOTOS
+	/* The address of the TARGET label of each opcode */
+#include "opcode_targets.h"
+#endif
 
 /* Tuple access macros */
 
@@ -653,18 +967,118 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 
         If collecting opcode statistics, turn off prediction so that
 	statistics are accurately maintained (the predictions bypass
-	the opcode frequency counter updates).
+	the opcode frequency counter updates).  For the same reason an
+	opcode trace function (PyEval_SetOpcodeTrace) turns them off while
+	it is set: the tracing code clears the local "predicting" before
+	each traced instruction, and the periodic checks set it again, so
+	the test stays in a register when no trace function is set.
+
+	With computed gotos the processor already predicts the jump at the
+	end of each opcode on its own, and the extra test would only be in
+	the way.
 */
 
-#ifdef DYNAMIC_EXECUTION_PROFILE
+#if defined(DYNAMIC_EXECUTION_PROFILE) || defined(USE_COMPUTED_GOTOS)
 #define PREDICT(op)		if (0) goto PRED_##op
+#define PREDICT_OFF()
+#define PREDICT_ON()
 #else
-#define PREDICT(op)		if (*next_instr == op) goto PRED_##op
+#define PREDICT(op)		if (*next_instr == op && predicting) goto PRED_##op
+#define PREDICT_OFF()		predicting = 0
+#define PREDICT_ON()		predicting = 1
 #endif
 
 #define PREDICTED(op)		PRED_##op: next_instr++
 #define PREDICTED_WITH_ARG(op)	PRED_##op: oparg = PEEKARG(); next_instr += 3
 
+/* Dispatch macros
+	Each opcode starts at TARGET(op), or TARGET_N(op, n) for the SLICE
+	families, and ends with DISPATCH() when the periodic checks at the
+	top of the loop are due, or with FAST_DISPATCH() when they can be
+	skipped.  With the switch these are `continue' and `goto
+	fast_next_opcode'.
+
+	With computed gotos both fetch the next opcode themselves and jump
+	to its label, so that every opcode has an indirect jump of its own
+	and the branch predictor learns which opcodes usually follow it,
+	instead of guessing from the history of the one shared jump of the
+	switch.  They fall back to the loop while a trace function is set,
+	as the line events are generated there, and DISPATCH() also when
+	the ticker runs out.
+*/
+
+#ifdef LLTRACE
+#define CAN_FAST_DISPATCH()	(tstate->c_tracefunc == NULL && !lltrace)
+#else
+#define CAN_FAST_DISPATCH()	(tstate->c_tracefunc == NULL)
+#endif
+
+#ifdef USE_COMPUTED_GOTOS
+#define TARGET(op)		TARGET_##op: case op:
+#define TARGET_N(op, n)		TARGET_##op##_##n: case op+n:
+#define FAST_DISPATCH() \
+	{ \
+		if (CAN_FAST_DISPATCH()) { \
+			f->f_lasti = INSTR_OFFSET(); \
+			opcode = NEXTOP(); \
+			oparg = 0; \
+			if (HAS_ARG(opcode)) \
+				oparg = NEXTARG(); \
+			goto *opcode_targets[opcode]; \
+		} \
+		goto fast_next_opcode; \
+	}
+#define DISPATCH() \
+	{ \
+		if (_Py_Ticker > 0) { \
+			_Py_Ticker--; \
+			FAST_DISPATCH(); \
+		} \
+		continue; \
+	}
+#else
+#define TARGET(op)		case op:
+#define TARGET_N(op, n)		case op+n:
+#define FAST_DISPATCH()		goto fast_next_opcode
+#define DISPATCH()		continue
+#endif
+
+/* Superinstructions
+	compile.c gives the first instruction of some common pairs an
+	opcode that does the work of both, and leaves the second one in
+	place.  The handler does the first half, then SUPER_NEXT() steps
+	over the second instruction, fetching its argument, and the handler
+	does the second half too, saving a dispatch.  While a trace function
+	is set the handler stops after the first half instead and lets the
+	loop execute the second instruction, so that it gets its line event.
+*/
+
+#define SUPER_NEXT() \
+	{ \
+		f->f_lasti = INSTR_OFFSET(); \
+		if (HAS_ARG(NEXTOP())) \
+			oparg = NEXTARG(); \
+	}
+
+/* Instruction caches
+	Once a code object has run often enough it gets cache entries for
+	its LOAD_GLOBAL, LOAD_ATTR and STORE_ATTR instructions, and for
+	the CALL_FUNCTIONs passing keywords, found through co_opcache_map
+	by the offset of the instruction.  OPCACHE_ENTRY() is the entry of
+	the instruction being executed, or NULL; it must come right after
+	the instruction and its argument have been fetched.
+*/
+
+#define OPCACHE_COUNT_RUN() \
+	if (co->co_opcache_runs < _PyCode_OPCACHE_MIN_RUNS && \
+	    ++co->co_opcache_runs == _PyCode_OPCACHE_MIN_RUNS) \
+		(void)_PyCode_InitOpcache(co)
+
+#define OPCACHE_ENTRY() \
+	(co->co_opcache_map == NULL || \
+	 co->co_opcache_map[INSTR_OFFSET() - 3] == 0 ? NULL : \
+	 &co->co_opcache[co->co_opcache_map[INSTR_OFFSET() - 3] - 1])
+
 /* Stack manipulation macros */
 
 /* The stack can grow at most MAXINT deep, as co_nlocals and
@@ -783,6 +1197,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #if defined(Py_DEBUG) || defined(LLTRACE)
 	filename = PyString_AsString(co->co_filename);
 #endif
+	OPCACHE_COUNT_RUN();
 
 	why = WHY_NOT;
 	err = 0;
@@ -831,6 +1246,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                         }
 			_Py_Ticker = _Py_CheckInterval;
 			tstate->tick_counter++;
+			PREDICT_ON();
 #ifdef WITH_TSC
 			ticked = 1;
 #endif
@@ -848,17 +1264,22 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			}
 #ifdef WITH_THREAD
 			if (interpreter_lock) {
-				/* Give another thread a chance */
+				/* Give another thread a chance, if one
+				   has waited for it long enough */
 
-				if (PyThreadState_Swap(NULL) != tstate)
-					Py_FatalError("ceval: tstate mix-up");
-				PyThread_release_lock(interpreter_lock);
+				if (PyThread_gil_requested(interpreter_lock)) {
+					if (PyThreadState_Swap(NULL) != tstate)
+						Py_FatalError(
+						    "ceval: tstate mix-up");
+					PyThread_release_gil(interpreter_lock);
 
-				/* Other threads may run now */
+					/* Other threads may run now */
 
-				PyThread_acquire_lock(interpreter_lock, 1);
-				if (PyThreadState_Swap(tstate) != NULL)
-					Py_FatalError("ceval: orphan tstate");
+					PyThread_acquire_gil(interpreter_lock, 0);
+					if (PyThreadState_Swap(tstate) != NULL)
+						Py_FatalError(
+						    "ceval: orphan tstate");
+				}
 
 				/* Check for thread interrupts */
 
@@ -884,10 +1305,18 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			   for expository comments */
 			f->f_stacktop = stack_pointer;
 
-			err = maybe_call_line_trace(tstate->c_tracefunc,
-						    tstate->c_traceobj,
-						    f, &instr_lb, &instr_ub,
-						    &instr_prev);
+			if (tstate->c_traceopcodes) {
+				PREDICT_OFF();
+				err = call_trace(tstate->c_tracefunc,
+						 tstate->c_traceobj, f,
+						 PyTrace_OPCODE, Py_None);
+			}
+			else
+				err = maybe_call_line_trace(
+					tstate->c_tracefunc,
+					tstate->c_traceobj,
+					f, &instr_lb, &instr_ub,
+					&instr_prev);
 			/* Reload possibly changed frame fields */
 			JUMPTO(f->f_lasti);
 			if (f->f_stacktop != NULL) {
@@ -943,56 +1372,124 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 
 		/* case STOP_CODE: this is an error! */
 
-		case NOP:
-			goto fast_next_opcode;
+		TARGET(NOP)
+			FAST_DISPATCH();
 
-		case LOAD_FAST:
+		TARGET(LOAD_FAST)
 			x = GETLOCAL(oparg);
 			if (x != NULL) {
 				Py_INCREF(x);
 				PUSH(x);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
+		  load_fast_error:
 			format_exc_check_arg(PyExc_UnboundLocalError,
 				UNBOUNDLOCAL_ERROR_MSG,
 				PyTuple_GetItem(co->co_varnames, oparg));
 			break;
 
-		case LOAD_CONST:
+		TARGET(LOAD_CONST)
 			x = GETITEM(consts, oparg);
 			Py_INCREF(x);
 			PUSH(x);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
 		PREDICTED_WITH_ARG(STORE_FAST);
-		case STORE_FAST:
+		TARGET(STORE_FAST)
 			v = POP();
 			SETLOCAL(oparg, v);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
+
+		TARGET(LOAD_FAST__LOAD_FAST)
+			x = GETLOCAL(oparg);
+			if (x == NULL)
+				goto load_fast_error;
+			Py_INCREF(x);
+			PUSH(x);
+			if (!CAN_FAST_DISPATCH())
+				FAST_DISPATCH();
+			SUPER_NEXT();
+			x = GETLOCAL(oparg);
+			if (x == NULL)
+				goto load_fast_error;
+			Py_INCREF(x);
+			PUSH(x);
+			FAST_DISPATCH();
+
+		TARGET(LOAD_FAST__LOAD_ATTR)
+			x = GETLOCAL(oparg);
+			if (x == NULL)
+				goto load_fast_error;
+			Py_INCREF(x);
+			PUSH(x);
+			if (!CAN_FAST_DISPATCH())
+				FAST_DISPATCH();
+			SUPER_NEXT();
+			goto load_attr;
+
+		TARGET(LOAD_FAST__LOAD_CONST)
+			x = GETLOCAL(oparg);
+			if (x == NULL)
+				goto load_fast_error;
+			Py_INCREF(x);
+			PUSH(x);
+			if (!CAN_FAST_DISPATCH())
+				FAST_DISPATCH();
+			SUPER_NEXT();
+			x = GETITEM(consts, oparg);
+			Py_INCREF(x);
+			PUSH(x);
+			FAST_DISPATCH();
+
+		PREDICTED_WITH_ARG(STORE_FAST__LOAD_FAST);
+		TARGET(STORE_FAST__LOAD_FAST)
+			v = POP();
+			SETLOCAL(oparg, v);
+			if (!CAN_FAST_DISPATCH())
+				FAST_DISPATCH();
+			SUPER_NEXT();
+			x = GETLOCAL(oparg);
+			if (x == NULL)
+				goto load_fast_error;
+			Py_INCREF(x);
+			PUSH(x);
+			FAST_DISPATCH();
+
+		TARGET(LOAD_CONST__RETURN_VALUE)
+			x = GETITEM(consts, oparg);
+			Py_INCREF(x);
+			if (!CAN_FAST_DISPATCH()) {
+				PUSH(x);
+				FAST_DISPATCH();
+			}
+			SUPER_NEXT();
+			retval = x;
+			why = WHY_RETURN;
+			goto fast_block_end;
 
 		PREDICTED(POP_TOP);
-		case POP_TOP:
+		TARGET(POP_TOP)
 			v = POP();
 			Py_DECREF(v);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
-		case ROT_TWO:
+		TARGET(ROT_TWO)
 			v = TOP();
 			w = SECOND();
 			SET_TOP(w);
 			SET_SECOND(v);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
-		case ROT_THREE:
+		TARGET(ROT_THREE)
 			v = TOP();
 			w = SECOND();
 			x = THIRD();
 			SET_TOP(w);
 			SET_SECOND(x);
 			SET_THIRD(v);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
-		case ROT_FOUR:
+		TARGET(ROT_FOUR)
 			u = TOP();
 			v = SECOND();
 			w = THIRD();
@@ -1001,15 +1498,15 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			SET_SECOND(w);
 			SET_THIRD(x);
 			SET_FOURTH(u);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
-		case DUP_TOP:
+		TARGET(DUP_TOP)
 			v = TOP();
 			Py_INCREF(v);
 			PUSH(v);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
-		case DUP_TOPX:
+		TARGET(DUP_TOPX)
 			if (oparg == 2) {
 				x = TOP();
 				Py_INCREF(x);
@@ -1018,7 +1515,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				STACKADJ(2);
 				SET_TOP(x);
 				SET_SECOND(w);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			} else if (oparg == 3) {
 				x = TOP();
 				Py_INCREF(x);
@@ -1030,84 +1527,84 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				SET_TOP(x);
 				SET_SECOND(w);
 				SET_THIRD(v);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
 			Py_FatalError("invalid argument to DUP_TOPX"
 				      " (bytecode corruption?)");
 			/* Never returns, so don't bother to set why. */
 			break;
 
-		case UNARY_POSITIVE:
+		TARGET(UNARY_POSITIVE)
 			v = TOP();
 			x = PyNumber_Positive(v);
 			Py_DECREF(v);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_NEGATIVE:
+		TARGET(UNARY_NEGATIVE)
 			v = TOP();
 			x = PyNumber_Negative(v);
 			Py_DECREF(v);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_NOT:
+		TARGET(UNARY_NOT)
 			v = TOP();
 			err = PyObject_IsTrue(v);
 			Py_DECREF(v);
 			if (err == 0) {
 				Py_INCREF(Py_True);
 				SET_TOP(Py_True);
-				continue;
+				DISPATCH();
 			}
 			else if (err > 0) {
 				Py_INCREF(Py_False);
 				SET_TOP(Py_False);
 				err = 0;
-				continue;
+				DISPATCH();
 			}
 			STACKADJ(-1);
 			break;
 
-		case UNARY_CONVERT:
+		TARGET(UNARY_CONVERT)
 			v = TOP();
 			x = PyObject_Repr(v);
 			Py_DECREF(v);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_INVERT:
+		TARGET(UNARY_INVERT)
 			v = TOP();
 			x = PyNumber_Invert(v);
 			Py_DECREF(v);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_POWER:
+		TARGET(BINARY_POWER)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Power(v, w, Py_None);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_MULTIPLY:
+		TARGET(BINARY_MULTIPLY)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Multiply(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_DIVIDE:
+		TARGET(BINARY_DIVIDE)
 			if (!_Py_QnewFlag) {
 				w = POP();
 				v = TOP();
@@ -1115,42 +1612,42 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				Py_DECREF(v);
 				Py_DECREF(w);
 				SET_TOP(x);
-				if (x != NULL) continue;
+				if (x != NULL) DISPATCH();
 				break;
 			}
 			/* -Qnew is in effect:	fall through to
 			   BINARY_TRUE_DIVIDE */
-		case BINARY_TRUE_DIVIDE:
+		TARGET(BINARY_TRUE_DIVIDE)
 			w = POP();
 			v = TOP();
 			x = PyNumber_TrueDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_FLOOR_DIVIDE:
+		TARGET(BINARY_FLOOR_DIVIDE)
 			w = POP();
 			v = TOP();
 			x = PyNumber_FloorDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_MODULO:
+		TARGET(BINARY_MODULO)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Remainder(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_ADD:
+		TARGET(BINARY_ADD)
 			w = POP();
 			v = TOP();
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1177,10 +1674,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 		  skip_decref_vx:
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_SUBTRACT:
+		TARGET(BINARY_SUBTRACT)
 			w = POP();
 			v = TOP();
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1200,10 +1697,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_SUBSCR:
+		TARGET(BINARY_SUBSCR)
 			w = POP();
 			v = TOP();
 			if (PyList_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1224,60 +1721,60 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_LSHIFT:
+		TARGET(BINARY_LSHIFT)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Lshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_RSHIFT:
+		TARGET(BINARY_RSHIFT)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Rshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_AND:
+		TARGET(BINARY_AND)
 			w = POP();
 			v = TOP();
 			x = PyNumber_And(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_XOR:
+		TARGET(BINARY_XOR)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Xor(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_OR:
+		TARGET(BINARY_OR)
 			w = POP();
 			v = TOP();
 			x = PyNumber_Or(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case LIST_APPEND:
+		TARGET(LIST_APPEND)
 			w = POP();
 			v = POP();
 			err = PyList_Append(v, w);
@@ -1285,31 +1782,31 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(w);
 			if (err == 0) {
 				PREDICT(JUMP_ABSOLUTE);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case INPLACE_POWER:
+		TARGET(INPLACE_POWER)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlacePower(v, w, Py_None);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_MULTIPLY:
+		TARGET(INPLACE_MULTIPLY)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceMultiply(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_DIVIDE:
+		TARGET(INPLACE_DIVIDE)
 			if (!_Py_QnewFlag) {
 				w = POP();
 				v = TOP();
@@ -1317,42 +1814,42 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				Py_DECREF(v);
 				Py_DECREF(w);
 				SET_TOP(x);
-				if (x != NULL) continue;
+				if (x != NULL) DISPATCH();
 				break;
 			}
 			/* -Qnew is in effect:	fall through to
 			   INPLACE_TRUE_DIVIDE */
-		case INPLACE_TRUE_DIVIDE:
+		TARGET(INPLACE_TRUE_DIVIDE)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceTrueDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_FLOOR_DIVIDE:
+		TARGET(INPLACE_FLOOR_DIVIDE)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceFloorDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_MODULO:
+		TARGET(INPLACE_MODULO)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceRemainder(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_ADD:
+		TARGET(INPLACE_ADD)
 			w = POP();
 			v = TOP();
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1379,10 +1876,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 		  skip_decref_v:
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_SUBTRACT:
+		TARGET(INPLACE_SUBTRACT)
 			w = POP();
 			v = TOP();
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1402,63 +1899,63 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_LSHIFT:
+		TARGET(INPLACE_LSHIFT)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceLshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_RSHIFT:
+		TARGET(INPLACE_RSHIFT)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceRshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_AND:
+		TARGET(INPLACE_AND)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceAnd(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_XOR:
+		TARGET(INPLACE_XOR)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceXor(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_OR:
+		TARGET(INPLACE_OR)
 			w = POP();
 			v = TOP();
 			x = PyNumber_InPlaceOr(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case SLICE+0:
-		case SLICE+1:
-		case SLICE+2:
-		case SLICE+3:
+		TARGET_N(SLICE, 0)
+		TARGET_N(SLICE, 1)
+		TARGET_N(SLICE, 2)
+		TARGET_N(SLICE, 3)
 			if ((opcode-SLICE) & 2)
 				w = POP();
 			else
@@ -1473,13 +1970,13 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_XDECREF(v);
 			Py_XDECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case STORE_SLICE+0:
-		case STORE_SLICE+1:
-		case STORE_SLICE+2:
-		case STORE_SLICE+3:
+		TARGET_N(STORE_SLICE, 0)
+		TARGET_N(STORE_SLICE, 1)
+		TARGET_N(STORE_SLICE, 2)
+		TARGET_N(STORE_SLICE, 3)
 			if ((opcode-STORE_SLICE) & 2)
 				w = POP();
 			else
@@ -1495,13 +1992,13 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(u);
 			Py_XDECREF(v);
 			Py_XDECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case DELETE_SLICE+0:
-		case DELETE_SLICE+1:
-		case DELETE_SLICE+2:
-		case DELETE_SLICE+3:
+		TARGET_N(DELETE_SLICE, 0)
+		TARGET_N(DELETE_SLICE, 1)
+		TARGET_N(DELETE_SLICE, 2)
+		TARGET_N(DELETE_SLICE, 3)
 			if ((opcode-DELETE_SLICE) & 2)
 				w = POP();
 			else
@@ -1516,10 +2013,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(u);
 			Py_XDECREF(v);
 			Py_XDECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case STORE_SUBSCR:
+		TARGET(STORE_SUBSCR)
 			w = TOP();
 			v = SECOND();
 			u = THIRD();
@@ -1529,10 +2026,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(u);
 			Py_DECREF(v);
 			Py_DECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case DELETE_SUBSCR:
+		TARGET(DELETE_SUBSCR)
 			w = TOP();
 			v = SECOND();
 			STACKADJ(-2);
@@ -1540,10 +2037,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			err = PyObject_DelItem(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case PRINT_EXPR:
+		TARGET(PRINT_EXPR)
 			v = POP();
 			w = PySys_GetObject("displayhook");
 			if (w == NULL) {
@@ -1567,11 +2064,11 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_XDECREF(x);
 			break;
 
-		case PRINT_ITEM_TO:
+		TARGET(PRINT_ITEM_TO)
 			w = stream = POP();
 			/* fall through to PRINT_ITEM */
 
-		case PRINT_ITEM:
+		TARGET(PRINT_ITEM)
 			v = POP();
 			if (stream == NULL || stream == Py_None) {
 				w = PySys_GetObject("stdout");
@@ -1618,14 +2115,14 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_XDECREF(stream);
 			stream = NULL;
 			if (err == 0)
-				continue;
+				DISPATCH();
 			break;
 
-		case PRINT_NEWLINE_TO:
+		TARGET(PRINT_NEWLINE_TO)
 			w = stream = POP();
 			/* fall through to PRINT_NEWLINE */
 
-		case PRINT_NEWLINE:
+		TARGET(PRINT_NEWLINE)
 			if (stream == NULL || stream == Py_None) {
 				w = PySys_GetObject("stdout");
 				if (w == NULL) {
@@ -1649,7 +2146,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #ifdef CASE_TOO_BIG
 		default: switch (opcode) {
 #endif
-		case RAISE_VARARGS:
+		TARGET(RAISE_VARARGS)
 			u = v = w = NULL;
 			switch (oparg) {
 			case 3:
@@ -1671,27 +2168,27 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			}
 			break;
 
-		case LOAD_LOCALS:
+		TARGET(LOAD_LOCALS)
 			if ((x = f->f_locals) != NULL) {
 				Py_INCREF(x);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			PyErr_SetString(PyExc_SystemError, "no locals");
 			break;
 
-		case RETURN_VALUE:
+		TARGET(RETURN_VALUE)
 			retval = POP();
 			why = WHY_RETURN;
 			goto fast_block_end;
 
-		case YIELD_VALUE:
+		TARGET(YIELD_VALUE)
 			retval = POP();
 			f->f_stacktop = stack_pointer;
 			why = WHY_YIELD;
 			goto fast_yield;
 
-		case EXEC_STMT:
+		TARGET(EXEC_STMT)
 			w = TOP();
 			v = SECOND();
 			u = THIRD();
@@ -1704,7 +2201,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(w);
 			break;
 
-		case POP_BLOCK:
+		TARGET(POP_BLOCK)
 			{
 				PyTryBlock *b = PyFrame_BlockPop(f);
 				while (STACK_LEVEL() > b->b_level) {
@@ -1712,9 +2209,9 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 					Py_DECREF(v);
 				}
 			}
-			continue;
+			DISPATCH();
 
-		case END_FINALLY:
+		TARGET(END_FINALLY)
 			v = POP();
 			if (PyInt_Check(v)) {
 				why = (enum why_code) PyInt_AS_LONG(v);
@@ -1738,7 +2235,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			break;
 
-		case BUILD_CLASS:
+		TARGET(BUILD_CLASS)
 			u = TOP();
 			v = SECOND();
 			w = THIRD();
@@ -1750,7 +2247,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(w);
 			break;
 
-		case STORE_NAME:
+		TARGET(STORE_NAME)
 			w = GETITEM(names, oparg);
 			v = POP();
 			if ((x = f->f_locals) != NULL) {
@@ -1759,7 +2256,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				else
 					err = PyObject_SetItem(x, w, v);
 				Py_DECREF(v);
-				if (err == 0) continue;
+				if (err == 0) DISPATCH();
 				break;
 			}
 			PyErr_Format(PyExc_SystemError,
@@ -1767,7 +2264,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				     PyObject_REPR(w));
 			break;
 
-		case DELETE_NAME:
+		TARGET(DELETE_NAME)
 			w = GETITEM(names, oparg);
 			if ((x = f->f_locals) != NULL) {
 				if ((err = PyObject_DelItem(x, w)) != 0)
@@ -1781,7 +2278,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			break;
 
 		PREDICTED_WITH_ARG(UNPACK_SEQUENCE);
-		case UNPACK_SEQUENCE:
+		TARGET(UNPACK_SEQUENCE)
 			v = POP();
 			if (PyTuple_CheckExact(v) && PyTuple_GET_SIZE(v) == oparg) {
 				PyObject **items = ((PyTupleObject *)v)->ob_item;
@@ -1791,7 +2288,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 					PUSH(w);
 				}
 				Py_DECREF(v);
-				continue;
+				DISPATCH();
 			} else if (PyList_CheckExact(v) && PyList_GET_SIZE(v) == oparg) {
 				PyObject **items = ((PyListObject *)v)->ob_item;
 				while (oparg--) {
@@ -1809,18 +2306,25 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			break;
 
-		case STORE_ATTR:
+		TARGET(STORE_ATTR)
+		{
+			PyOpcache *oc = OPCACHE_ENTRY();
+
 			w = GETITEM(names, oparg);
 			v = TOP();
 			u = SECOND();
 			STACKADJ(-2);
-			err = PyObject_SetAttr(v, w, u); /* v.w = u */
+			if (oc != NULL)
+				err = store_attr_cached(v, w, u, oc);
+			else
+				err = PyObject_SetAttr(v, w, u); /* v.w = u */
 			Py_DECREF(v);
 			Py_DECREF(u);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
+		}
 
-		case DELETE_ATTR:
+		TARGET(DELETE_ATTR)
 			w = GETITEM(names, oparg);
 			v = POP();
 			err = PyObject_SetAttr(v, w, (PyObject *)NULL);
@@ -1828,22 +2332,22 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			break;
 
-		case STORE_GLOBAL:
+		TARGET(STORE_GLOBAL)
 			w = GETITEM(names, oparg);
 			v = POP();
 			err = PyDict_SetItem(f->f_globals, w, v);
 			Py_DECREF(v);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case DELETE_GLOBAL:
+		TARGET(DELETE_GLOBAL)
 			w = GETITEM(names, oparg);
 			if ((err = PyDict_DelItem(f->f_globals, w)) != 0)
 				format_exc_check_arg(
 				    PyExc_NameError, GLOBAL_NAME_ERROR_MSG, w);
 			break;
 
-		case LOAD_NAME:
+		TARGET(LOAD_NAME)
 			w = GETITEM(names, oparg);
 			if ((v = f->f_locals) == NULL) {
 				PyErr_Format(PyExc_SystemError,
@@ -1878,66 +2382,50 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				Py_INCREF(x);
 			}
 			PUSH(x);
-			continue;
+			DISPATCH();
 
-		case LOAD_GLOBAL:
-			w = GETITEM(names, oparg);
-			if (PyString_CheckExact(w)) {
-				/* Inline the PyDict_GetItem() calls.
-				   WARNING: this is an extreme speed hack.
-				   Do not try this at home. */
-				long hash = ((PyStringObject *)w)->ob_shash;
-				if (hash != -1) {
-					PyDictObject *d;
-					PyDictEntry *e;
-					d = (PyDictObject *)(f->f_globals);
-					e = d->ma_lookup(d, w, hash);
-					if (e == NULL) {
-						x = NULL;
-						break;
-					}
-					x = e->me_value;
-					if (x != NULL) {
-						Py_INCREF(x);
-						PUSH(x);
-						continue;
-					}
-					d = (PyDictObject *)(f->f_builtins);
-					e = d->ma_lookup(d, w, hash);
-					if (e == NULL) {
-						x = NULL;
-						break;
-					}
-					x = e->me_value;
-					if (x != NULL) {
-						Py_INCREF(x);
-						PUSH(x);
-						continue;
-					}
-					goto load_global_error;
-				}
+		TARGET(LOAD_GLOBAL)
+		{
+			/* The versions before the lookup; if it changes the
+			   dicts, the entry just won't match next time. */
+			Py_dictversion_t gver, bver;
+			PyOpcache *oc = OPCACHE_ENTRY();
+
+			gver = ((PyDictObject *)f->f_globals)->ma_version;
+			bver = ((PyDictObject *)f->f_builtins)->ma_version;
+			if (oc != NULL && oc->u.lg.globals_ver == gver &&
+			    oc->u.lg.builtins_ver == bver) {
+				x = oc->u.lg.ptr;
+				Py_INCREF(x);
+				PUSH(x);
+				DISPATCH();
 			}
-			/* This is the un-inlined version of the code above */
-			x = PyDict_GetItem(f->f_globals, w);
+			w = GETITEM(names, oparg);
+			x = _PyDict_LoadGlobal((PyDictObject *)f->f_globals,
+					       (PyDictObject *)f->f_builtins,
+					       w);
 			if (x == NULL) {
-				x = PyDict_GetItem(f->f_builtins, w);
-				if (x == NULL) {
-				  load_global_error:
+				if (!PyErr_Occurred())
 					format_exc_check_arg(
 						    PyExc_NameError,
 						    GLOBAL_NAME_ERROR_MSG, w);
-					break;
-				}
+				break;
+			}
+			if (oc != NULL) {
+				oc->u.lg.ptr = x;
+				oc->u.lg.globals_ver = gver;
+				oc->u.lg.builtins_ver = bver;
 			}
 			Py_INCREF(x);
 			PUSH(x);
-			continue;
+			DISPATCH();
+		}
 
-		case DELETE_FAST:
+		TARGET(DELETE_FAST)
 			x = GETLOCAL(oparg);
 			if (x != NULL) {
 				SETLOCAL(oparg, NULL);
-				continue;
+				DISPATCH();
 			}
 			format_exc_check_arg(
 				PyExc_UnboundLocalError,
@@ -1946,19 +2434,19 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				);
 			break;
 
-		case LOAD_CLOSURE:
+		TARGET(LOAD_CLOSURE)
 			x = freevars[oparg];
 			Py_INCREF(x);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case LOAD_DEREF:
+		TARGET(LOAD_DEREF)
 			x = freevars[oparg];
 			w = PyCell_Get(x);
 			if (w != NULL) {
 				PUSH(w);
-				continue;
+				DISPATCH();
 			}
 			err = -1;
 			/* Don't stomp existing exception */
@@ -1982,14 +2470,14 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			}
 			break;
 
-		case STORE_DEREF:
+		TARGET(STORE_DEREF)
 			w = POP();
 			x = freevars[oparg];
 			PyCell_Set(x, w);
 			Py_DECREF(w);
-			continue;
+			DISPATCH();
 
-		case BUILD_TUPLE:
+		TARGET(BUILD_TUPLE)
 			x = PyTuple_New(oparg);
 			if (x != NULL) {
 				for (; --oparg >= 0;) {
@@ -1997,11 +2485,11 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 					PyTuple_SET_ITEM(x, oparg, w);
 				}
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case BUILD_LIST:
+		TARGET(BUILD_LIST)
 			x =  PyList_New(oparg);
 			if (x != NULL) {
 				for (; --oparg >= 0;) {
@@ -2009,26 +2497,35 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 					PyList_SET_ITEM(x, oparg, w);
 				}
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case BUILD_MAP:
+		TARGET(BUILD_MAP)
 			x = PyDict_New();
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case LOAD_ATTR:
+		TARGET(LOAD_ATTR)
+		  load_attr:
+		{
+			PyOpcache *oc = OPCACHE_ENTRY();
+
 			w = GETITEM(names, oparg);
 			v = TOP();
-			x = PyObject_GetAttr(v, w);
+			if (oc != NULL)
+				x = load_attr_cached(v, w, oc);
+			else
+				x = PyObject_GetAttr(v, w);
 			Py_DECREF(v);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
+		}
 
-		case COMPARE_OP:
+		TARGET(COMPARE_OP__JUMP_IF_FALSE)
+		TARGET(COMPARE_OP)
 			w = POP();
 			v = TOP();
 			if (PyInt_CheckExact(w) && PyInt_CheckExact(v)) {
@@ -2059,11 +2556,26 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(w);
 			SET_TOP(x);
 			if (x == NULL) break;
+			if (opcode == COMPARE_OP__JUMP_IF_FALSE &&
+			    (x == Py_True || x == Py_False) &&
+			    CAN_FAST_DISPATCH()) {
+				SUPER_NEXT();
+				if (x == Py_False) {
+					/* POP_TOP at the target */
+					JUMPBY(oparg);
+					FAST_DISPATCH();
+				}
+				/* Skip over the POP_TOP */
+				next_instr++;
+				STACKADJ(-1);
+				Py_DECREF(x);
+				FAST_DISPATCH();
+			}
 			PREDICT(JUMP_IF_FALSE);
 			PREDICT(JUMP_IF_TRUE);
-			continue;
+			DISPATCH();
 
-		case IMPORT_NAME:
+		TARGET(IMPORT_NAME)
 			w = GETITEM(names, oparg);
 			x = PyDict_GetItemString(f->f_builtins, "__import__");
 			if (x == NULL) {
@@ -2104,10 +2616,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			READ_TIMESTAMP(intr1);
 			Py_DECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case IMPORT_STAR:
+		TARGET(IMPORT_STAR)
 			v = POP();
 			PyFrame_FastToLocals(f);
 			if ((x = f->f_locals) == NULL) {
@@ -2120,33 +2632,33 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			READ_TIMESTAMP(intr1);
 			PyFrame_LocalsToFast(f, 0);
 			Py_DECREF(v);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case IMPORT_FROM:
+		TARGET(IMPORT_FROM)
 			w = GETITEM(names, oparg);
 			v = TOP();
 			READ_TIMESTAMP(intr0);
 			x = import_from(v, w);
 			READ_TIMESTAMP(intr1);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case JUMP_FORWARD:
+		TARGET(JUMP_FORWARD)
 			JUMPBY(oparg);
-			goto fast_next_opcode;
+			FAST_DISPATCH();
 
 		PREDICTED_WITH_ARG(JUMP_IF_FALSE);
-		case JUMP_IF_FALSE:
+		TARGET(JUMP_IF_FALSE)
 			w = TOP();
 			if (w == Py_True) {
 				PREDICT(POP_TOP);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
 			if (w == Py_False) {
 				JUMPBY(oparg);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
 			err = PyObject_IsTrue(w);
 			if (err > 0)
@@ -2155,18 +2667,18 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				JUMPBY(oparg);
 			else
 				break;
-			continue;
+			DISPATCH();
 
 		PREDICTED_WITH_ARG(JUMP_IF_TRUE);
-		case JUMP_IF_TRUE:
+		TARGET(JUMP_IF_TRUE)
 			w = TOP();
 			if (w == Py_False) {
 				PREDICT(POP_TOP);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
 			if (w == Py_True) {
 				JUMPBY(oparg);
-				goto fast_next_opcode;
+				FAST_DISPATCH();
 			}
 			err = PyObject_IsTrue(w);
 			if (err > 0) {
@@ -2177,14 +2689,15 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				;
 			else
 				break;
-			continue;
+			DISPATCH();
 
 		PREDICTED_WITH_ARG(JUMP_ABSOLUTE);
-		case JUMP_ABSOLUTE:
+		TARGET(JUMP_ABSOLUTE)
 			JUMPTO(oparg);
-			continue;
+			OPCACHE_COUNT_RUN();
+			DISPATCH();
 
-		case GET_ITER:
+		TARGET(GET_ITER)
 			/* before: [obj]; after [getiter(obj)] */
 			v = TOP();
 			x = PyObject_GetIter(v);
@@ -2192,21 +2705,22 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			if (x != NULL) {
 				SET_TOP(x);
 				PREDICT(FOR_ITER);
-				continue;
+				DISPATCH();
 			}
 			STACKADJ(-1);
 			break;
 
 		PREDICTED_WITH_ARG(FOR_ITER);
-		case FOR_ITER:
+		TARGET(FOR_ITER)
 			/* before: [iter]; after: [iter, iter()] *or* [] */
 			v = TOP();
 			x = (*v->ob_type->tp_iternext)(v);
 			if (x != NULL) {
 				PUSH(x);
 				PREDICT(STORE_FAST);
+				PREDICT(STORE_FAST__LOAD_FAST);
 				PREDICT(UNPACK_SEQUENCE);
-				continue;
+				DISPATCH();
 			}
 			if (PyErr_Occurred()) {
 				if (!PyErr_ExceptionMatches(PyExc_StopIteration))
@@ -2217,13 +2731,13 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
  			x = v = POP();
 			Py_DECREF(v);
 			JUMPBY(oparg);
-			continue;
+			DISPATCH();
 
-		case BREAK_LOOP:
+		TARGET(BREAK_LOOP)
 			why = WHY_BREAK;
 			goto fast_block_end;
 
-		case CONTINUE_LOOP:
+		TARGET(CONTINUE_LOOP)
 			retval = PyInt_FromLong(oparg);
 			if (!retval) {
 				x = NULL;
@@ -2232,17 +2746,17 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			why = WHY_CONTINUE;
 			goto fast_block_end;
 
-		case SETUP_LOOP:
-		case SETUP_EXCEPT:
-		case SETUP_FINALLY:
+		TARGET(SETUP_LOOP)
+		TARGET(SETUP_EXCEPT)
+		TARGET(SETUP_FINALLY)
 			/* NOTE: If you add any new block-setup opcodes that are not try/except/finally
 			   handlers, you may need to update the PyGen_NeedsFinalizing() function. */
 
 			PyFrame_BlockSetup(f, opcode, INSTR_OFFSET() + oparg,
 					   STACK_LEVEL());
-			continue;
+			DISPATCH();
 
-		case WITH_CLEANUP:
+		TARGET(WITH_CLEANUP)
 		{
 			/* TOP is the context.__exit__ bound method.
 			   Below that are 1-3 values indicating how/why
@@ -2302,26 +2816,27 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			break;
 		}
 
-		case CALL_FUNCTION:
+		TARGET(CALL_FUNCTION)
 		{
 			PyObject **sp;
+			PyOpcache *oc = OPCACHE_ENTRY();
 			PCALL(PCALL_ALL);
 			sp = stack_pointer;
 #ifdef WITH_TSC
-			x = call_function(&sp, oparg, &intr0, &intr1);
+			x = call_function(&sp, oparg, oc, &intr0, &intr1);
 #else
-			x = call_function(&sp, oparg);
+			x = call_function(&sp, oparg, oc);
 #endif
 			stack_pointer = sp;
 			PUSH(x);
 			if (x != NULL)
-				continue;
+				DISPATCH();
 			break;
 		}
 
-		case CALL_FUNCTION_VAR:
-		case CALL_FUNCTION_KW:
-		case CALL_FUNCTION_VAR_KW:
+		TARGET(CALL_FUNCTION_VAR)
+		TARGET(CALL_FUNCTION_KW)
+		TARGET(CALL_FUNCTION_VAR_KW)
 		{
 		    int na = oparg & 0xff;
 		    int nk = (oparg>>8) & 0xff;
@@ -2361,11 +2876,11 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 		    }
 		    PUSH(x);
 		    if (x != NULL)
-			    continue;
+			    DISPATCH();
 		    break;
 		}
 
-		case MAKE_FUNCTION:
+		TARGET(MAKE_FUNCTION)
 			v = POP(); /* code object */
 			x = PyFunction_New(v, f->f_globals);
 			Py_DECREF(v);
@@ -2387,7 +2902,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			PUSH(x);
 			break;
 
-		case MAKE_CLOSURE:
+		TARGET(MAKE_CLOSURE)
 		{
 			v = POP(); /* code object */
 			x = PyFunction_New(v, f->f_globals);
@@ -2422,7 +2937,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			break;
 		}
 
-		case BUILD_SLICE:
+		TARGET(BUILD_SLICE)
 			if (oparg == 3)
 				w = POP();
 			else
@@ -2434,14 +2949,17 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 			Py_DECREF(v);
 			Py_XDECREF(w);
 			SET_TOP(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case EXTENDED_ARG:
+		TARGET(EXTENDED_ARG)
 			opcode = NEXTOP();
 			oparg = oparg<<16 | NEXTARG();
 			goto dispatch_opcode;
 
+#ifdef USE_COMPUTED_GOTOS
+		_unknown_opcode:
+#endif
 		default:
 			fprintf(stderr,
 				"XXX lineno: %d, opcode: %d\n",
@@ -2473,7 +2991,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 				else {
 #endif
 					READ_TIMESTAMP(loop1);
-					continue; /* Normal, fast path */
+					DISPATCH(); /* Normal, fast path */
 #ifdef CHECKEXC
 				}
 #endif
@@ -3359,6 +3877,7 @@ PyEval_SetTrace(Py_tracefunc func, PyObject *arg)
 	Py_XINCREF(arg);
 	tstate->c_tracefunc = NULL;
 	tstate->c_traceobj = NULL;
+	tstate->c_traceopcodes = 0;
 	/* Must make sure that profiling is not ignored if 'temp' is freed */
 	tstate->use_tracing = tstate->c_profilefunc != NULL;
 	Py_XDECREF(temp);
@@ -3369,6 +3888,18 @@ PyEval_SetTrace(Py_tracefunc func, PyObject *arg)
 			       || (tstate->c_profilefunc != NULL));
 }
 
+/* Like PyEval_SetTrace(), but the trace function is called before every
+   instruction with PyTrace_OPCODE, and gets no PyTrace_LINE events.  For
+   profilers written in C: f_lasti of the frame is the instruction's
+   offset.  The Python level sys.settrace() replaces it as usual. */
+
+void
+PyEval_SetOpcodeTrace(Py_tracefunc func, PyObject *arg)
+{
+	PyEval_SetTrace(func, arg);
+	PyThreadState_GET()->c_traceopcodes = (func != NULL);
+}
+
 PyObject *
 PyEval_GetBuiltins(void)
 {
@@ -3577,7 +4108,7 @@ if (tstate->use_tracing && tstate->c_profilefunc) { \
 	}
 
 static PyObject *
-call_function(PyObject ***pp_stack, int oparg
+call_function(PyObject ***pp_stack, int oparg, PyOpcache *oc
 #ifdef WITH_TSC
 		, uint64* pintr0, uint64* pintr1
 #endif
@@ -3639,7 +4170,7 @@ call_function(PyObject ***pp_stack, int oparg
 			Py_INCREF(func);
 		READ_TIMESTAMP(*pintr0);
 		if (PyFunction_Check(func))
-			x = fast_function(func, pp_stack, n, na, nk);
+			x = fast_function(func, pp_stack, n, na, nk, oc);
 		else
 			x = do_call(func, pp_stack, na, nk);
 		READ_TIMESTAMP(*pintr1);
@@ -3664,11 +4195,16 @@ call_function(PyObject ***pp_stack, int oparg
    arguments and is called with only positional arguments -- it
    inlines the most primitive frame setup code from
    PyEval_EvalCodeEx(), which vastly reduces the checks that must be
-   done before evaluating the frame.
+   done before evaluating the frame.  Functions without *args, **kw
+   and cells are also bound here when the call leaves out parameters
+   that have defaults, or names them by keyword at a call site whose
+   cache entry (oc) knows their slots.  Everything else, including
+   calls that are an error, goes through PyEval_EvalCodeEx().
 */
 
 static PyObject *
-fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
+fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk,
+	      PyOpcache *oc)
 {
 	PyCodeObject *co = (PyCodeObject *)PyFunction_GET_CODE(func);
 	PyObject *globals = PyFunction_GET_GLOBALS(func);
@@ -3678,13 +4214,30 @@ fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
 
 	PCALL(PCALL_FUNCTION);
 	PCALL(PCALL_FAST_FUNCTION);
-	if (argdefs == NULL && co->co_argcount == n && nk==0 &&
-	    co->co_flags == (CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE)) {
+	if (argdefs != NULL) {
+		d = &PyTuple_GET_ITEM(argdefs, 0);
+		nd = ((PyTupleObject *)argdefs)->ob_size;
+	}
+	if (co->co_flags == (CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE) &&
+	    na <= co->co_argcount) {
 		PyFrameObject *f;
 		PyObject *retval = NULL;
 		PyThreadState *tstate = PyThreadState_GET();
 		PyObject **fastlocals, **stack;
-		int i;
+		int i, m = co->co_argcount - nd;
+
+		if (nk == 0) {
+			/* the parameters not passed must all have defaults */
+			if (na < m)
+				goto slow;
+		}
+		else {
+			if (oc == NULL ||
+			    keyword_slots(&oc->u.call, co, na, nk,
+					  (*pp_stack) - 2*nk) < 0 ||
+			    oc->u.call.first_missing < m)
+				goto slow;
+		}
 
 		PCALL(PCALL_FASTER_FUNCTION);
 		assert(globals != NULL);
@@ -3700,26 +4253,118 @@ fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
 		fastlocals = f->f_localsplus;
 		stack = (*pp_stack) - n;
 
-		for (i = 0; i < n; i++) {
+		for (i = 0; i < na; i++) {
 			Py_INCREF(*stack);
 			fastlocals[i] = *stack++;
 		}
+		if (na < co->co_argcount) {
+			for (i = 0; i < nk; i++) {
+				/* skip the keyword, take the value */
+				stack++;
+				Py_INCREF(*stack);
+				fastlocals[oc->u.call.slots[i]] = *stack++;
+			}
+			for (i = na; i < co->co_argcount; i++) {
+				if (fastlocals[i] == NULL) {
+					Py_INCREF(d[i - m]);
+					fastlocals[i] = d[i - m];
+				}
+			}
+		}
 		retval = PyEval_EvalFrameEx(f,0);
 		++tstate->recursion_depth;
 		Py_DECREF(f);
 		--tstate->recursion_depth;
 		return retval;
 	}
-	if (argdefs != NULL) {
-		d = &PyTuple_GET_ITEM(argdefs, 0);
-		nd = ((PyTupleObject *)argdefs)->ob_size;
-	}
+  slow:
 	return PyEval_EvalCodeEx(co, globals,
 				 (PyObject *)NULL, (*pp_stack)-n, na,
 				 (*pp_stack)-2*nk, nk, d, nd,
 				 PyFunction_GET_CLOSURE(func));
 }
 
+/* Find the parameters the nk keywords in kws (alternating with their
+   values) bind to in co, when na arguments come before them, and keep
+   them in c.  Return 0 if c then holds them, or -1, without setting an
+   exception, if the call should take the general path: when the
+   keywords are not all parameters that no positional argument fills, or
+   when the call site keeps seeing other functions or keywords. */
+
+#define OPCACHE_CALL_MAX_MISSES	50
+
+static int
+keyword_slots(PyOpcache_Call *c, PyCodeObject *co, int na, int nk,
+	      PyObject **kws)
+{
+	PyObject *names, *kw, *nm;
+	unsigned char slots[PyOpcache_CALL_MAXKW];
+	int i, j, k;
+
+	if (c->varnames == co->co_varnames && c->na == na &&
+	    c->argcount == co->co_argcount &&
+	    PyTuple_GET_SIZE(c->names) == nk) {
+		for (i = 0; i < nk; i++) {
+			if (kws[2*i] != PyTuple_GET_ITEM(c->names, i))
+				break;
+		}
+		if (i == nk)
+			return 0;
+	}
+	if (nk > PyOpcache_CALL_MAXKW || co->co_argcount > 255 ||
+	    c->misses == OPCACHE_CALL_MAX_MISSES)
+		return -1;
+	c->misses++;
+
+	for (i = 0; i < nk; i++) {
+		kw = kws[2*i];
+		if (kw == NULL || !PyString_CheckExact(kw))
+			return -1;
+		for (j = na; j < co->co_argcount; j++) {
+			nm = PyTuple_GET_ITEM(co->co_varnames, j);
+			if (nm == kw || (PyString_CheckExact(nm) &&
+					 _PyString_Eq(nm, kw)))
+				break;
+		}
+		if (j == co->co_argcount)
+			return -1;
+		/* a keyword given twice is for the general path to report */
+		for (k = 0; k < i; k++) {
+			if (slots[k] == j)
+				return -1;
+		}
+		slots[i] = (unsigned char)j;
+	}
+	names = PyTuple_New(nk);
+	if (names == NULL) {
+		PyErr_Clear();
+		return -1;
+	}
+	for (i = 0; i < nk; i++) {
+		Py_INCREF(kws[2*i]);
+		PyTuple_SET_ITEM(names, i, kws[2*i]);
+	}
+
+	Py_XDECREF(c->varnames);
+	Py_XDECREF(c->names);
+	Py_INCREF(co->co_varnames);
+	c->varnames = co->co_varnames;
+	c->names = names;
+	c->na = na;
+	c->argcount = co->co_argcount;
+	memcpy(c->slots, slots, nk);
+	c->first_missing = co->co_argcount;
+	for (j = co->co_argcount - 1; j >= na; j--) {
+		for (i = 0; i < nk; i++) {
+			if (slots[i] == j)
+				break;
+		}
+		if (i == nk)
+			c->first_missing = j;
+	}
+	return 0;
+}
+
 static PyObject *
 update_keyword_args(PyObject *orig_kwdict, int nk, PyObject ***pp_stack,
                     PyObject *func)
@@ -4041,6 +4686,132 @@ cmp_outcome(int op, register PyObject *v, register PyObject *w)
 	return v;
 }
 
+/* LOAD_ATTR and STORE_ATTR with a cache entry.  For objects whose type
+   uses the generic attribute functions, the entry keeps what the type has
+   under the name and where the instance dict is.  While the type keeps its
+   version tag that stays true for all its instances, so the lookup skips
+   the search through the MRO.  An instruction that keeps seeing other
+   types or changed ones stops filling its entry after
+   OPCACHE_ATTR_MAX_MISSES times. */
+
+#define OPCACHE_ATTR_MAX_MISSES	50
+
+static void
+opcache_attr_fill(PyOpcache_Attr *a, PyTypeObject *tp, PyObject *name,
+		  int store)
+{
+	PyObject *descr;
+
+	a->type = NULL;
+	if (a->misses == OPCACHE_ATTR_MAX_MISSES)
+		return;
+	a->misses++;
+	if (!PyString_CheckExact(name) || tp->tp_dict == NULL ||
+	    tp->tp_dictoffset < 0)
+		return;
+	if (store ? tp->tp_setattro != PyObject_GenericSetAttr :
+		    tp->tp_getattro != PyObject_GenericGetAttr)
+		return;
+	descr = _PyType_Lookup(tp, name);
+	if (!PyType_HasFeature(tp, Py_TPFLAGS_VALID_VERSION_TAG))
+		return;
+	if (descr != NULL &&
+	    !PyType_HasFeature(descr->ob_type, Py_TPFLAGS_HAVE_CLASS))
+		return;
+	a->type = tp;
+	a->version = tp->tp_version_tag;
+	a->descr = descr;
+	a->dictoffset = tp->tp_dictoffset;
+}
+
+#define OPCACHE_ATTR_HIT(a, tp) \
+	((a)->type == (tp) && (a)->version == (tp)->tp_version_tag && \
+	 PyType_HasFeature((tp), Py_TPFLAGS_VALID_VERSION_TAG))
+
+#define OPCACHE_ATTR_DICT(a, v) \
+	((a)->dictoffset == 0 ? NULL : \
+	 *(PyObject **)((char *)(v) + (a)->dictoffset))
+
+/* PyObject_GenericGetAttr() with the descriptor from the entry */
+
+static PyObject *
+load_attr_cached(PyObject *v, PyObject *name, PyOpcache *oc)
+{
+	PyOpcache_Attr *a = &oc->u.attr;
+	PyTypeObject *tp = v->ob_type;
+	PyObject *descr, *dict, *res;
+	descrgetfunc f = NULL;
+
+	if (!OPCACHE_ATTR_HIT(a, tp)) {
+		opcache_attr_fill(a, tp, name, 0);
+		return PyObject_GetAttr(v, name);
+	}
+	descr = a->descr;
+	if (descr != NULL) {
+		Py_INCREF(descr);
+		f = descr->ob_type->tp_descr_get;
+		if (f != NULL && PyDescr_IsData(descr)) {
+			res = f(descr, v, (PyObject *)tp);
+			Py_DECREF(descr);
+			return res;
+		}
+	}
+	dict = OPCACHE_ATTR_DICT(a, v);
+	if (dict != NULL) {
+		Py_INCREF(dict);
+		res = _PyDict_GetItemHint(dict, name, &a->hint);
+		if (res != NULL) {
+			Py_INCREF(res);
+			Py_XDECREF(descr);
+			Py_DECREF(dict);
+			return res;
+		}
+		Py_DECREF(dict);
+	}
+	if (f != NULL) {
+		res = f(descr, v, (PyObject *)tp);
+		Py_DECREF(descr);
+		return res;
+	}
+	if (descr != NULL)
+		return descr;
+	/* Let it raise the AttributeError */
+	return PyObject_GetAttr(v, name);
+}
+
+/* PyObject_GenericSetAttr() with the descriptor from the entry */
+
+static int
+store_attr_cached(PyObject *v, PyObject *name, PyObject *value,
+		  PyOpcache *oc)
+{
+	PyOpcache_Attr *a = &oc->u.attr;
+	PyTypeObject *tp = v->ob_type;
+	PyObject *descr;
+	descrsetfunc f;
+	int res;
+
+	if (!OPCACHE_ATTR_HIT(a, tp)) {
+		opcache_attr_fill(a, tp, name, 1);
+		return PyObject_SetAttr(v, name, value);
+	}
+	descr = a->descr;
+	if (descr != NULL) {
+		f = descr->ob_type->tp_descr_set;
+		if (f != NULL) {
+			Py_INCREF(descr);
+			res = f(descr, v, value);
+			Py_DECREF(descr);
+			return res;
+		}
+	}
+	if (a->dictoffset == 0)
+		return PyObject_SetAttr(v, name, value);
+	return _PyObjectDict_SetItem(tp,
+				     (PyObject **)((char *)v + a->dictoffset),
+				     name, value);
+}
+
 static PyObject *
 import_from(PyObject *v, PyObject *name)
 {
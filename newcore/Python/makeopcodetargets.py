@@ -0,0 +1,49 @@
+#! /usr/bin/env python
+"""Generate Python/opcode_targets.h, the jump table ceval.c uses when it is
+built with USE_COMPUTED_GOTOS.
+
+Usage: makeopcodetargets.py [outfile]
+
+Run it again whenever Lib/opcode.py changes.
+"""
+
+import os
+import sys
+
+def load_opcodes():
+    # Lib/opcode.py of this source tree, not of the Python running us
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        os.pardir, "Lib", "opcode.py")
+    ns = {}
+    execfile(path, ns)
+    return ns["opmap"]
+
+def write_contents(f):
+    targets = ['_unknown_opcode'] * 256
+    for name, op in load_opcodes().items():
+        # STOP_CODE marks the end of the code and is never executed
+        if name == 'STOP_CODE':
+            continue
+        # SLICE+0 and friends get the labels of TARGET_N(SLICE, 0)
+        targets[op] = "TARGET_%s" % name.replace("+", "_")
+    f.write("/* Generated by Python/makeopcodetargets.py; do not edit. */\n")
+    f.write("static void *opcode_targets[256] = {\n")
+    f.write(",\n".join(["\t&&%s" % s for s in targets]))
+    f.write("\n};\n")
+
+def main():
+    if len(sys.argv) > 2:
+        sys.exit("Usage: %s [outfile]" % sys.argv[0])
+    if len(sys.argv) == 2:
+        outfile = sys.argv[1]
+    else:
+        outfile = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                               "opcode_targets.h")
+    f = open(outfile, "w")
+    try:
+        write_contents(f)
+    finally:
+        f.close()
+
+if __name__ == "__main__":
+    main()
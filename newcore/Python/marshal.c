@@ -359,12 +359,21 @@ w_object(PyObject *v, WFILE *p)
 	}
 	else if (PyCode_Check(v)) {
 		PyCodeObject *co = (PyCodeObject *)v;
+		PyObject *code;
+		/* Only the standard opcodes go out; see compile.c */
+		code = _PyCode_UnfuseInstructions(co->co_code);
+		if (code == NULL) {
+			p->depth--;
+			p->error = 1;
+			return;
+		}
 		w_byte(TYPE_CODE, p);
 		w_long(co->co_argcount, p);
 		w_long(co->co_nlocals, p);
 		w_long(co->co_stacksize, p);
 		w_long(co->co_flags, p);
-		w_object(co->co_code, p);
+		w_object(code, p);
+		Py_DECREF(code);
 		w_object(co->co_consts, p);
 		w_object(co->co_names, p);
 		w_object(co->co_varnames, p);
@@ -928,6 +937,14 @@ r_object(RFILE *p)
 			code = r_object(p);
 			if (code == NULL)
 				goto code_error;
+			if (PyString_Check(code)) {
+				PyObject *fused;
+				fused = _PyCode_FuseInstructions(code);
+				Py_DECREF(code);
+				code = fused;
+				if (code == NULL)
+					goto code_error;
+			}
 			consts = r_object(p);
 			if (consts == NULL)
 				goto code_error;
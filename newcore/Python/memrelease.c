@@ -0,0 +1,149 @@
+/* Releasing the memory kept in free lists and caches; see pymem.h */
+
+#include "Python.h"
+#include "frameobject.h"
+
+/* At most this many caches can be registered, the built-in ones included */
+#define MAX_RELEASERS	32
+
+struct releaser {
+	int level;
+	PyMem_CacheReleaser func;
+};
+
+static int release_linecache(void);
+static int release_import_caches(void);
+
+static struct releaser releasers[MAX_RELEASERS] = {
+	{PyMem_RELEASE_FREELISTS,	PyFrame_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyMethod_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyCFunction_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyTuple_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyList_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyDict_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyInt_ClearFreeList},
+	{PyMem_RELEASE_FREELISTS,	PyFloat_ClearFreeList},
+	{PyMem_RELEASE_CACHES,		release_linecache},
+	{PyMem_RELEASE_CACHES,		release_import_caches},
+	{PyMem_RELEASE_CACHES,		_PyString_CompactInterned},
+};
+static int nreleasers = 11;
+
+/* Set while the caches are being released, so that an allocation failing
+   in the middle of it does not start over. */
+static int releasing = 0;
+
+int
+PyMem_RegisterCache(int level, PyMem_CacheReleaser func)
+{
+	if (level < PyMem_RELEASE_FREELISTS || level > PyMem_RELEASE_ALL) {
+		PyErr_SetString(PyExc_ValueError, "invalid cache level");
+		return -1;
+	}
+	if (nreleasers == MAX_RELEASERS) {
+		PyErr_SetString(PyExc_RuntimeError,
+				"too many caches registered");
+		return -1;
+	}
+	releasers[nreleasers].level = level;
+	releasers[nreleasers].func = func;
+	nreleasers++;
+	return 0;
+}
+
+Py_ssize_t
+PyMem_ReleaseCaches(int level)
+{
+	PyObject *type, *value, *traceback;
+	Py_ssize_t released = 0;
+	int l, i;
+
+	if (releasing)
+		return 0;
+	releasing = 1;
+	if (level > PyMem_RELEASE_FREELISTS)
+		PyErr_Fetch(&type, &value, &traceback);
+
+	if (level >= PyMem_RELEASE_ALL)
+		released += PyGC_Collect();
+	/* Caches hold on to objects that end up in the free lists when
+	   released, so the higher levels go first. */
+	for (l = level; l >= PyMem_RELEASE_FREELISTS; l--) {
+		for (i = 0; i < nreleasers; i++) {
+			if (releasers[i].level == l)
+				released += releasers[i].func();
+		}
+	}
+	if (level >= PyMem_RELEASE_ALL) {
+		/* Blocks cached by threads keep their arenas in use */
+		PyThreadState *tstate;
+		tstate = PyInterpreterState_ThreadHead(
+				PyThreadState_GET()->interp);
+		for (; tstate != NULL; tstate = PyThreadState_Next(tstate))
+			_PyObject_ClearThreadCache(tstate);
+	}
+	(void)_PyObject_TrimArenas(0);
+
+	if (level > PyMem_RELEASE_FREELISTS)
+		PyErr_Restore(type, value, traceback);
+	releasing = 0;
+	return released;
+}
+
+/* linecache keeps the lines of every source file a traceback showed */
+
+static int
+release_linecache(void)
+{
+	PyObject *linecache, *cache, *result;
+	int n = 0;
+
+	linecache = PyDict_GetItemString(PyImport_GetModuleDict(),
+					 "linecache");
+	if (linecache == NULL)
+		return 0;
+	cache = PyObject_GetAttrString(linecache, "cache");
+	if (cache != NULL && PyDict_Check(cache))
+		n = (int)PyDict_Size(cache);
+	Py_XDECREF(cache);
+	result = PyObject_CallMethod(linecache, "clearcache", NULL);
+	if (result == NULL) {
+		PyErr_Clear();
+		return 0;
+	}
+	Py_DECREF(result);
+	return n;
+}
+
+/* The importers found for each sys.path entry, and the table of contents
+   of every zip file imported from.  Both are looked up again the next
+   time they are needed. */
+
+static int
+release_import_caches(void)
+{
+	PyObject *cache, *zipimport;
+	int n = 0;
+
+	cache = PySys_GetObject("path_importer_cache");
+	if (cache != NULL && PyDict_Check(cache)) {
+		n += (int)PyDict_Size(cache);
+		PyDict_Clear(cache);
+	}
+	zipimport = PyDict_GetItemString(PyImport_GetModuleDict(),
+					 "zipimport");
+	if (zipimport != NULL) {
+		cache = PyObject_GetAttrString(zipimport,
+					       "_zip_directory_cache");
+		if (cache == NULL)
+			PyErr_Clear();
+		else {
+			if (PyDict_Check(cache)) {
+				n += (int)PyDict_Size(cache);
+				PyDict_Clear(cache);
+			}
+			Py_DECREF(cache);
+		}
+	}
+	return n;
+}
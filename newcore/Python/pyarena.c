@@ -61,7 +61,9 @@ struct _arena {
 
         /* A Python list object containing references to all the PyObject
            pointers associated with this area.  They will be DECREFed
-           when the arena is freed.
+           when the arena is freed.  Created by the first call to
+           PyArena_AddPyObject(); arenas that only hold the compiler's
+           scratch data never need one.
         */
         PyObject *a_objects;
 
@@ -140,12 +142,7 @@ PyArena_New()
                 free((void *)arena);
                 return (PyArena*)PyErr_NoMemory();
         }
-        arena->a_objects = PyList_New(0);
-        if (!arena->a_objects) {
-                block_free(arena->a_head);
-                free((void *)arena);
-                return (PyArena*)PyErr_NoMemory();
-        }
+        arena->a_objects = NULL;
 #if defined(Py_DEBUG)
         arena->total_allocs = 0;
         arena->total_size = 0;
@@ -167,7 +164,7 @@ PyArena_Free(PyArena *arena)
                 "alloc=%d size=%d blocks=%d block_size=%d big=%d objects=%d\n",
                 arena->total_allocs, arena->total_size, arena->total_blocks,
                 arena->total_block_size, arena->total_big_blocks,
-                PyList_Size(arena->a_objects));
+                arena->a_objects ? PyList_Size(arena->a_objects) : 0);
         */
 #endif
 	block_free(arena->a_head);
@@ -178,11 +175,14 @@ PyArena_Free(PyArena *arena)
 
         /* Clear all the elements from the list.  This is necessary
            to guarantee that they will be DECREFed. */
-        r = PyList_SetSlice(arena->a_objects,
-                            0, PyList_GET_SIZE(arena->a_objects), NULL);
-        assert(r == 0);
-        assert(PyList_GET_SIZE(arena->a_objects) == 0);
-        Py_DECREF(arena->a_objects);
+        if (arena->a_objects) {
+                r = PyList_SetSlice(arena->a_objects,
+                                    0, PyList_GET_SIZE(arena->a_objects),
+                                    NULL);
+                assert(r == 0);
+                assert(PyList_GET_SIZE(arena->a_objects) == 0);
+                Py_DECREF(arena->a_objects);
+        }
 	free(arena);
 }
 
@@ -212,7 +212,13 @@ PyArena_Malloc(PyArena *arena, size_t size)
 int
 PyArena_AddPyObject(PyArena *arena, PyObject *obj)
 {
-        int r = PyList_Append(arena->a_objects, obj);
+        int r;
+        if (!arena->a_objects) {
+                arena->a_objects = PyList_New(0);
+                if (!arena->a_objects)
+                        return -1;
+        }
+        r = PyList_Append(arena->a_objects, obj);
         if (r >= 0) {
                 Py_DECREF(obj);
         }
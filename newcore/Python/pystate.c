@@ -192,6 +192,9 @@ PyThreadState_New(PyInterpreterState *interp)
 		tstate->c_tracefunc = NULL;
 		tstate->c_profileobj = NULL;
 		tstate->c_traceobj = NULL;
+		tstate->c_traceopcodes = 0;
+
+		tstate->obmalloc_cache = NULL;
 
 #ifdef WITH_THREAD
 		_PyGILState_NoteThreadState(tstate);
@@ -231,6 +234,10 @@ PyThreadState_Clear(PyThreadState *tstate)
 	tstate->c_tracefunc = NULL;
 	Py_CLEAR(tstate->c_profileobj);
 	Py_CLEAR(tstate->c_traceobj);
+
+	/* The pools are shared, so this needs the lock held here;
+	   PyThreadState_Delete() may run without it. */
+	_PyObject_ClearThreadCache(tstate);
 }
 
 
@@ -294,6 +301,8 @@ PyThreadState_DeleteCurrent()
 	if (tstate == NULL)
 		Py_FatalError(
 			"PyThreadState_DeleteCurrent: no current tstate");
+	/* Blocks freed since PyThreadState_Clear() are cached again */
+	_PyObject_ClearThreadCache(tstate);
 	_PyThreadState_Current = NULL;
 	tstate_delete_common(tstate);
 	if (autoTLSkey && PyThread_get_key_value(autoTLSkey) == tstate)
@@ -36,6 +36,7 @@
 
 #ifdef SYMBIAN
 #include "profiletimer.h"
+#include "mem_alloc.h"
 #else
 #define TEST_PROBE
 #endif
@@ -190,6 +191,13 @@ Py_InitializeEx(int install_sigs)
 		Py_OptimizeFlag = add_flag(Py_OptimizeFlag, p);
 		
 	}
+#ifdef SYMBIAN
+	/* Has to come before anything is allocated */
+	if ((p = Py_GETENV("PYTHONALLOCATOR")) && *p != '\0') {
+		if (SPy_SelectAllocator(p) < 0)
+			Py_FatalError("Py_Initialize: can't select PYTHONALLOCATOR");
+	}
+#endif
 	interp = PyInterpreterState_New();
 	
 	if (interp == NULL){
@@ -553,7 +561,9 @@ Py_Finalize(void)
 
 	_PyExc_Fini();
 
-	/* Delete current thread */
+	/* Delete current thread, with its cache flushed while it is
+	   still current (the interpreter's cleanup filled it again) */
+	_PyObject_ClearThreadCache(tstate);
 	PyThreadState_Swap(NULL);
 	PyInterpreterState_Delete(interp);
 
@@ -703,6 +713,7 @@ Py_EndInterpreter(PyThreadState *tstate)
 
 	PyImport_Cleanup();
 	PyInterpreterState_Clear(interp);
+	_PyObject_ClearThreadCache(tstate);
 	PyThreadState_Swap(NULL);
 	PyInterpreterState_Delete(interp);
 }
@@ -18,6 +18,9 @@ Data members:
 #include "code.h"
 #include "frameobject.h"
 #include "eval.h"
+#ifdef WITH_THREAD
+#include "pythread.h"
+#endif
 
 #include "osdefs.h"
 
@@ -429,7 +432,8 @@ PyDoc_STRVAR(setcheckinterval_doc,
 "setcheckinterval(n)\n\
 \n\
 Tell the Python interpreter to check for asynchronous events every\n\
-n instructions.  This also affects how often thread switches occur."
+n instructions.  This is also how often the thread running may hand\n\
+over to another; see setswitchinterval()."
 );
 
 static PyObject *
@@ -442,6 +446,48 @@ PyDoc_STRVAR(getcheckinterval_doc,
 "getcheckinterval() -> current check interval; see setcheckinterval()."
 );
 
+#ifdef WITH_THREAD
+static PyObject *
+sys_setswitchinterval(PyObject *self, PyObject *args)
+{
+	double d;
+	if (!PyArg_ParseTuple(args, "d:setswitchinterval", &d))
+		return NULL;
+	if (!(d > 0.0)) {
+		PyErr_SetString(PyExc_ValueError,
+				"switch interval must be strictly positive");
+		return NULL;
+	}
+	/* The interval is kept in microseconds, in a long */
+	if (1e6 * d >= (double)LONG_MAX) {
+		PyErr_SetString(PyExc_OverflowError,
+				"switch interval is too large");
+		return NULL;
+	}
+	PyThread_set_switch_interval((long)(1e6 * d));
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(setswitchinterval_doc,
+"setswitchinterval(n)\n\
+\n\
+Set how long, in seconds, a thread waits for the interpreter lock before\n\
+the thread holding it is asked to hand it over.  Where the platform has\n\
+no such lock, threads switch every check interval instead."
+);
+
+static PyObject *
+sys_getswitchinterval(PyObject *self, PyObject *args)
+{
+	return PyFloat_FromDouble(1e-6 * PyThread_get_switch_interval());
+}
+
+PyDoc_STRVAR(getswitchinterval_doc,
+"getswitchinterval() -> current switch interval; see setswitchinterval()."
+);
+#endif
+
 #ifdef WITH_TSC
 static PyObject *
 sys_settscdump(PyObject *self, PyObject *args)
@@ -626,6 +672,117 @@ sys_getcounts(PyObject *self)
 }
 #endif
 
+static PyObject *
+sys_clear_type_cache(PyObject* self, PyObject* args)
+{
+	PyType_ClearCache();
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(sys_clear_type_cache__doc__,
+"_clear_type_cache() -> None\n\
+Clear the internal type lookup cache.");
+
+static PyObject *
+sys_type_cache_stats(PyObject* self, PyObject* args)
+{
+	unsigned long hits, misses;
+	_PyType_CacheStats(&hits, &misses);
+	return Py_BuildValue("(kk)", hits, misses);
+}
+
+PyDoc_STRVAR(sys_type_cache_stats__doc__,
+"_type_cache_stats() -> (hits, misses)\n\
+Return how many type attribute lookups were answered from the internal\n\
+type lookup cache and how many had to search the method resolution order.");
+
+static PyObject *
+sys_pending_call_stats(PyObject* self, PyObject* args)
+{
+	return _Py_PendingCallStats();
+}
+
+PyDoc_STRVAR(sys_pending_call_stats__doc__,
+"_pending_call_stats() -> dict\n\
+Return counters for the calls scheduled with Py_AddPendingCall(): how\n\
+many ran, how many were refused for lack of room, how many were merged\n\
+with the same call already queued, the number of blocks of call slots,\n\
+the most run at once and, where the time is known, the longest and mean\n\
+delay before a call ran, in seconds.");
+
+static PyObject *
+sys_trimheap(PyObject *self, PyObject *args)
+{
+	int keep = -1;
+	if (!PyArg_ParseTuple(args, "|i:trimheap", &keep))
+		return NULL;
+	return PyInt_FromSize_t(_PyObject_TrimArenas(keep));
+}
+
+PyDoc_STRVAR(trimheap_doc,
+"trimheap([keep]) -> number of bytes released\n\
+\n\
+Return the empty arenas of the small object allocator to the system,\n\
+keeping the first keep of them for reuse.  By default as many are kept as\n\
+set with setsparearenas()."
+);
+
+static PyObject *
+sys_releasecaches(PyObject *self, PyObject *args)
+{
+	int level = PyMem_RELEASE_ALL;
+	if (!PyArg_ParseTuple(args, "|i:releasecaches", &level))
+		return NULL;
+	if (level < PyMem_RELEASE_FREELISTS || level > PyMem_RELEASE_ALL) {
+		PyErr_SetString(PyExc_ValueError,
+				"level must be between 1 and 3");
+		return NULL;
+	}
+	return PyInt_FromSsize_t(PyMem_ReleaseCaches(level));
+}
+
+PyDoc_STRVAR(releasecaches_doc,
+"releasecaches([level]) -> number of items released\n\
+\n\
+Free the memory the interpreter keeps around for reuse, as when the system\n\
+is short of it.  Level 1 empties the free lists of the builtin types, 2\n\
+also clears caches such as linecache and the importer caches, and 3, the\n\
+default, also runs a full garbage collection first."
+);
+
+static PyObject *
+sys_setsparearenas(PyObject *self, PyObject *args)
+{
+	int n;
+	if (!PyArg_ParseTuple(args, "i:setsparearenas", &n))
+		return NULL;
+	if (n < 0) {
+		PyErr_SetString(PyExc_ValueError,
+				"number of spare arenas must be >= 0");
+		return NULL;
+	}
+	_PyObject_SetSpareArenas(n);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(setsparearenas_doc,
+"setsparearenas(n)\n\
+\n\
+Keep at least n empty arenas of the small object allocator for reuse\n\
+instead of returning them to the system as soon as they become empty."
+);
+
+static PyObject *
+sys_getsparearenas(PyObject *self)
+{
+	return PyInt_FromLong(_PyObject_SetSpareArenas(-1));
+}
+
+PyDoc_STRVAR(getsparearenas_doc,
+"getsparearenas() -> current number of spare arenas; see setsparearenas()."
+);
+
 PyDoc_STRVAR(getframe_doc,
 "_getframe([depth]) -> frameobject\n\
 \n\
@@ -771,6 +928,8 @@ static PyMethodDef sys_methods[] = {
 	{"getrefcount",	(PyCFunction)sys_getrefcount, METH_O, getrefcount_doc},
 	{"getrecursionlimit", (PyCFunction)sys_getrecursionlimit, METH_NOARGS,
 	 getrecursionlimit_doc},
+	{"getsparearenas", (PyCFunction)sys_getsparearenas, METH_NOARGS,
+	 getsparearenas_doc},
 	{"_getframe", sys_getframe, METH_VARARGS, getframe_doc},
 #ifdef MS_WINDOWS
 	{"getwindowsversion", (PyCFunction)sys_getwindowsversion, METH_NOARGS,
@@ -783,10 +942,17 @@ static PyMethodDef sys_methods[] = {
 	{"setdefaultencoding", sys_setdefaultencoding, METH_VARARGS,
 	 setdefaultencoding_doc},
 #endif
+	{"releasecaches", sys_releasecaches, METH_VARARGS, releasecaches_doc},
 	{"setcheckinterval",	sys_setcheckinterval, METH_VARARGS,
 	 setcheckinterval_doc},
 	{"getcheckinterval",	sys_getcheckinterval, METH_NOARGS,
 	 getcheckinterval_doc},
+#ifdef WITH_THREAD
+	{"setswitchinterval",	sys_setswitchinterval, METH_VARARGS,
+	 setswitchinterval_doc},
+	{"getswitchinterval",	sys_getswitchinterval, METH_NOARGS,
+	 getswitchinterval_doc},
+#endif
 #ifdef HAVE_DLOPEN
 	{"setdlopenflags", sys_setdlopenflags, METH_VARARGS,
 	 setdlopenflags_doc},
@@ -794,11 +960,20 @@ static PyMethodDef sys_methods[] = {
 	{"setprofile",	sys_setprofile, METH_O, setprofile_doc},
 	{"setrecursionlimit", sys_setrecursionlimit, METH_VARARGS,
 	 setrecursionlimit_doc},
+	{"setsparearenas", sys_setsparearenas, METH_VARARGS,
+	 setsparearenas_doc},
 #ifdef WITH_TSC
 	{"settscdump", sys_settscdump, METH_VARARGS, settscdump_doc},
 #endif
 	{"settrace",	sys_settrace, METH_O, settrace_doc},
 	{"call_tracing", sys_call_tracing, METH_VARARGS, call_tracing_doc},
+	{"_clear_type_cache",	sys_clear_type_cache,	  METH_NOARGS,
+	 sys_clear_type_cache__doc__},
+	{"_type_cache_stats",	sys_type_cache_stats,	  METH_NOARGS,
+	 sys_type_cache_stats__doc__},
+	{"_pending_call_stats",	sys_pending_call_stats,	  METH_NOARGS,
+	 sys_pending_call_stats__doc__},
+	{"trimheap",	sys_trimheap, METH_VARARGS, trimheap_doc},
 	{NULL,		NULL}		/* sentinel */
 };
 
@@ -942,11 +1117,15 @@ exit() -- exit the interpreter by raising SystemExit\n\
 getdlopenflags() -- returns flags to be used for dlopen() calls\n\
 getrefcount() -- return the reference count for an object (plus one :-)\n\
 getrecursionlimit() -- return the max recursion depth for the interpreter\n\
+releasecaches() -- free the memory kept in free lists and caches\n\
 setcheckinterval() -- control how often the interpreter checks for events\n\
 setdlopenflags() -- set the flags to be used for dlopen() calls\n\
 setprofile() -- set the global profiling function\n\
 setrecursionlimit() -- set the max recursion depth for the interpreter\n\
+setswitchinterval() -- control how long threads wait for each other\n\
+setsparearenas() -- set how many empty arenas are kept for reuse\n\
 settrace() -- set the global debug tracing function\n\
+trimheap() -- return empty arenas to the system\n\
 "
 )
 /* end of sys_doc */ ;
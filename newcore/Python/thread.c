@@ -100,6 +100,10 @@ PyThread_init_thread(void)
    or the size specified by the THREAD_STACK_SIZE macro. */
 static size_t _pythread_stacksize = 0;
 
+/* How long, in microseconds, a thread waits for the interpreter lock
+   before it asks the thread holding it to hand it over */
+static long _pythread_switch_interval = 5000;
+
 #ifdef SGI_THREADS
 #include "thread_sgi.h"
 #endif
@@ -177,6 +181,53 @@ PyThread_set_stacksize(size_t size)
 #endif
 }
 
+long
+PyThread_get_switch_interval(void)
+{
+	return _pythread_switch_interval;
+}
+
+void
+PyThread_set_switch_interval(long microseconds)
+{
+	if (microseconds < 1)
+		microseconds = 1;
+	_pythread_switch_interval = microseconds;
+}
+
+#ifndef Py_HAVE_NATIVE_GIL
+/* If the platform has not supplied an interpreter lock that waiting
+   threads can ask for, use a plain lock.  The thread holding it then
+   hands it over whenever the eval loop offers to, which is every
+   _Py_CheckInterval instructions, and the switch interval is not used.
+*/
+
+PyThread_type_gil
+PyThread_allocate_gil(volatile int *ticker)
+{
+	return (PyThread_type_gil)PyThread_allocate_lock();
+}
+
+void
+PyThread_acquire_gil(PyThread_type_gil gil, int blocked)
+{
+	PyThread_acquire_lock((PyThread_type_lock)gil, WAIT_LOCK);
+}
+
+void
+PyThread_release_gil(PyThread_type_gil gil)
+{
+	PyThread_release_lock((PyThread_type_lock)gil);
+}
+
+int
+PyThread_gil_requested(PyThread_type_gil gil)
+{
+	return 1;
+}
+
+#endif /* Py_HAVE_NATIVE_GIL */
+
 #ifndef Py_HAVE_NATIVE_TLS
 /* If the platform has not supplied a platform specific
    TLS implementation, provide our own.
@@ -546,6 +546,161 @@ PyThread_release_lock(PyThread_type_lock lock)
 
 #endif /* USE_SEMAPHORES */
 
+/*
+ * Interpreter lock support.
+ *
+ * Releasing and at once acquiring a plain lock rarely lets a waiting
+ * thread in, so a thread running Python code kept the interpreter lock
+ * for as long as it liked, while threads coming back from I/O waited.
+ * Here a waiting thread asks for the lock after the switch interval, or
+ * at once when it comes back from a blocking call, and the thread asked
+ * hands it to that thread before it may take it back.
+ */
+
+#include <sys/time.h>
+#include <errno.h>
+
+#define Py_HAVE_NATIVE_GIL
+
+typedef struct {
+	int		locked;
+	unsigned long	switch_number;	/* times the lock was acquired */
+	volatile int	drop_request;
+	long		requester;	/* thread that asked, if drop_request */
+	volatile int	*ticker;
+	pthread_mutex_t	mut;
+	pthread_cond_t	released;	/* signalled when unlocked */
+	pthread_cond_t	switched;	/* signalled when acquired */
+} pthread_gil;
+
+PyThread_type_gil
+PyThread_allocate_gil(volatile int *ticker)
+{
+	pthread_gil *gil;
+	int status, error = 0;
+
+	dprintf(("PyThread_allocate_gil called\n"));
+	if (!initialized)
+		PyThread_init_thread();
+
+	gil = (pthread_gil *)malloc(sizeof(pthread_gil));
+	if (gil) {
+		memset((void *)gil, '\0', sizeof(pthread_gil));
+		gil->ticker = ticker;
+
+		status = pthread_mutex_init(&gil->mut,
+					    pthread_mutexattr_default);
+		CHECK_STATUS("pthread_mutex_init");
+		status = pthread_cond_init(&gil->released,
+					   pthread_condattr_default);
+		CHECK_STATUS("pthread_cond_init");
+		status = pthread_cond_init(&gil->switched,
+					   pthread_condattr_default);
+		CHECK_STATUS("pthread_cond_init");
+
+		if (error) {
+			free((void *)gil);
+			gil = NULL;
+		}
+	}
+
+	dprintf(("PyThread_allocate_gil() -> %p\n", gil));
+	return (PyThread_type_gil)gil;
+}
+
+/* Acquiring and releasing the GIL has no way to report failure to the
+   caller, so there is no error flag to set; just say what failed. */
+#define CHECK_STATUS_GIL(name)  if (status != 0) { perror(name); }
+
+/* Ask the thread holding the lock for it; gil->mut must be held */
+#define GIL_REQUEST(gil, me) { \
+	(gil)->drop_request = 1; \
+	(gil)->requester = (me); \
+	*(gil)->ticker = 0; \
+}
+
+void
+PyThread_acquire_gil(PyThread_type_gil g, int blocked)
+{
+	pthread_gil *gil = (pthread_gil *)g;
+	long me = PyThread_get_thread_ident();
+	struct timeval now;
+	struct timespec deadline;
+	unsigned long switch_number;
+	long interval;
+	int status;
+
+	status = pthread_mutex_lock(&gil->mut);
+	CHECK_STATUS_GIL("pthread_mutex_lock[gil]");
+
+	/* Once a thread has asked, the lock is for that thread */
+	while (gil->locked ||
+	       (gil->drop_request && gil->requester != me)) {
+		if (blocked && gil->locked && !gil->drop_request)
+			GIL_REQUEST(gil, me);
+		switch_number = gil->switch_number;
+		interval = _pythread_switch_interval;
+		gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + interval / 1000000;
+		deadline.tv_nsec = (now.tv_usec + interval % 1000000) * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		status = pthread_cond_timedwait(&gil->released, &gil->mut,
+						&deadline);
+		/* Ask if the lock has not changed hands meanwhile */
+		if (status == ETIMEDOUT && gil->locked &&
+		    !gil->drop_request && gil->switch_number == switch_number)
+			GIL_REQUEST(gil, me);
+	}
+	gil->locked = 1;
+	gil->switch_number++;
+	gil->drop_request = 0;
+	status = pthread_cond_broadcast(&gil->switched);
+	CHECK_STATUS_GIL("pthread_cond_broadcast[gil]");
+
+	status = pthread_mutex_unlock(&gil->mut);
+	CHECK_STATUS_GIL("pthread_mutex_unlock[gil]");
+}
+
+void
+PyThread_release_gil(PyThread_type_gil g)
+{
+	pthread_gil *gil = (pthread_gil *)g;
+	unsigned long switch_number;
+	int status;
+
+	status = pthread_mutex_lock(&gil->mut);
+	CHECK_STATUS_GIL("pthread_mutex_lock[gil]");
+
+	gil->locked = 0;
+	if (gil->drop_request) {
+		/* Wake the thread that asked, whichever that is, and let it
+		   have the lock before taking it back */
+		status = pthread_cond_broadcast(&gil->released);
+		CHECK_STATUS_GIL("pthread_cond_broadcast[gil]");
+		switch_number = gil->switch_number;
+		while (gil->switch_number == switch_number) {
+			status = pthread_cond_wait(&gil->switched, &gil->mut);
+			CHECK_STATUS_GIL("pthread_cond_wait[gil]");
+		}
+	}
+	else {
+		status = pthread_cond_signal(&gil->released);
+		CHECK_STATUS_GIL("pthread_cond_signal[gil]");
+	}
+
+	status = pthread_mutex_unlock(&gil->mut);
+	CHECK_STATUS_GIL("pthread_mutex_unlock[gil]");
+}
+
+int
+PyThread_gil_requested(PyThread_type_gil g)
+{
+	return ((pthread_gil *)g)->drop_request;
+}
+
 /* set the thread stack size.
  * Return 0 if size is valid, -1 if size is invalid,
  * -2 if setting stack size is not supported.
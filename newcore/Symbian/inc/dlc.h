@@ -5,7 +5,12 @@
  *  A memory allocator that uses a local disconnected chunk as the underlying
  *  mechanism for requesting memory from and returning memory to the Symbian OS.
  *  The use of a local disconnected chunk makes it possible to free noncontiguous
- *  pieces of memory. Currently only blocks of one size are supported.
+ *  pieces of memory. Allocations are single blocks of DLC_BLOCK_SIZE, which
+ *  can then be resized in place to runs of contiguous blocks.
+ *
+ *  The OS specific part (reserving the address range and committing and
+ *  decommitting blocks in it) is kept behind a small backend interface in
+ *  dlc.cpp, so the allocator also runs on a POSIX host using mmap/madvise.
  *
  * Copyright (c) 2007-2009 Nokia Corporation
  *
@@ -30,7 +35,15 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
+#ifdef __SYMBIAN32__
 #include <e32def.h>
+#else
+typedef int TBool;
+#define ETrue 1
+#define EFalse 0
+#endif
 
 #ifdef __WINS__
 #define DLC_MAX_SIZE (1024*1024*16)
@@ -40,11 +53,17 @@ extern "C" {
 
 int dlc_init();
 void dlc_fini();  
-void *dlc_alloc(int size);
+void *dlc_alloc(size_t size);
 void dlc_free(void *ptr);
+int dlc_resize(void *ptr, size_t size);
+int dlc_size(void *ptr);
 void dlc_stats(int *allocated_blocks, int *free_blocks);
 TBool dlc_is_allocated(void *ptr);
 
+#ifndef ARENA_SIZE
+#define ARENA_SIZE  (64 << 10)  /* 64KB, as in Symbian/inc/pyconfig.h */
+#endif
+
 #define DLC_BLOCK_SIZE ARENA_SIZE
 
 #ifdef __cplusplus
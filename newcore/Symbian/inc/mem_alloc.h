@@ -26,12 +26,27 @@ PyAPI_FUNC(void*) _PyCore_Malloc(size_t size);
 PyAPI_FUNC(void*) _PyCore_Realloc(void *p, size_t size);
 PyAPI_FUNC(void) _PyCore_Free(void *ptr);
 PyAPI_FUNC(void) SPy_SetAllocator(void* (*alloc)(size_t, void*), void* (*realloc)(void*, size_t, void*), void (*free)(void*, void*), void *context);
+PyAPI_FUNC(void) SPy_GetAllocator(void* (**alloc)(size_t, void*), void* (**realloc)(void*, size_t, void*), void (**free)(void*, void*), void **context);
+/* Picks one of the built-in allocator backends ("system", "dlc" or
+   "arena") by name. Must be called before Py_Initialize; Py_Initialize
+   itself selects the backend named by PYTHONALLOCATOR if it is set.
+   Returns -1 for an unknown name, or for a change of backend once the
+   current one has handed out a block. */
+PyAPI_FUNC(int) SPy_SelectAllocator(const char *name);
+PyAPI_FUNC(const char*) SPy_GetAllocatorName();
 PyAPI_FUNC(int) SPy_DLC_Init();
 PyAPI_FUNC(void) SPy_DLC_Fini();
 PyAPI_FUNC(void*) SPy_DLC_Alloc(size_t nBytes, void *context);
 PyAPI_FUNC(void*) SPy_DLC_Realloc(void* ptr, size_t nBytes, void *context);
 PyAPI_FUNC(void) SPy_DLC_Free(void* ptr, void *context);
 
+/* Sampling heap profiler layered on top of the allocator above; see
+   heapprofmodule.c. */
+PyAPI_FUNC(int) SPy_HeapProfile_Start(size_t sample_bytes);
+PyAPI_FUNC(void) SPy_HeapProfile_Stop(void);
+PyAPI_FUNC(void) SPy_HeapProfile_Clear(void);
+PyAPI_FUNC(int) SPy_HeapProfile_Dump(const char *path);
+
 #ifdef __cplusplus
 }
 #endif
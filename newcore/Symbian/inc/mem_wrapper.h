@@ -33,6 +33,11 @@ PyAPI_FUNC (void*) malloc_wrapper(size_t bytes);
 PyAPI_FUNC (void*) realloc_wrapper(void *ptr, size_t bytes);
 PyAPI_FUNC (void) free_wrapper(void *ptr);
 PyAPI_FUNC (void) free_all_allocations();
+/* Number and total size of the tracked blocks that are still live, and the
+   highest total size seen since tracking started or the last call to
+   reset_allocation_peak(). Any of the pointers may be NULL. */
+PyAPI_FUNC (void) get_allocation_stats(size_t *count, size_t *bytes, size_t *peak);
+PyAPI_FUNC (void) reset_allocation_peak();
 
 #ifdef __cplusplus
 }
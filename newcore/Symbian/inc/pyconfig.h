@@ -864,6 +864,10 @@
 /* Define to 1 if your <sys/time.h> declares `struct tm'. */
 /* #undef TM_IN_SYS_TIME */
 
+/* Define to dispatch opcodes with computed gotos (GCC labels as values).
+   Only GCCE builds can have it; the emulator compiler has no such thing. */
+/* #undef USE_COMPUTED_GOTOS */
+
 /* Define if you want to use MacPython modules on MacOSX in unix-Python. */
 /* #undef USE_TOOLBOX_OBJECT_GLUE */
 
@@ -5,7 +5,12 @@
  *  A memory allocator that uses a local disconnected chunk as the underlying
  *  mechanism for requesting memory from and returning memory to the Symbian OS.
  *  The use of a local disconnected chunk makes it possible to free noncontiguous
- *  pieces of memory. Currently only blocks of one size are supported.
+ *  pieces of memory. Allocations are single blocks of DLC_BLOCK_SIZE, which
+ *  can then be resized in place to runs of contiguous blocks.
+ *
+ *  Free blocks are tracked in a word-packed bitmap, searched with a
+ *  find-first-set starting from a hint cursor, so allocation and the stats
+ *  query do not scan the whole block table.
  *
  * Copyright (c) 2007-2009 Nokia Corporation
  *
@@ -26,37 +31,59 @@
 #include "Python.h"
 #include "dlc.h"
 
+#ifdef __SYMBIAN32__
 #include <e32std.h>
 #include <e32debug.h>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
 
 #define DLC_DEBUG 0
 
-#if DLC_DEBUG
+#if DLC_DEBUG && defined(__SYMBIAN32__)
 #define LOG(x) RDebug::Print x ;
 #else
 #define LOG(x) 
 #endif
 
-/* This is a very simple allocator that can allocate and free just blocks of one size. 
+/* This is a very simple allocator that hands out DLC_BLOCK_SIZE blocks, and 
+ * lets a block be resized in place to a run of contiguous blocks. 
  * DLC_BLOCK_SIZE is defined in dlc.h. */
 #define DLC_MAX_BLOCKS ((DLC_MAX_SIZE)/(DLC_BLOCK_SIZE))
 #define DLC_BLOCK_OFFSET(i) ((i)*(DLC_BLOCK_SIZE))
+#define DLC_BLOCKS_FOR(size) (((size)+(DLC_BLOCK_SIZE)-1)/(DLC_BLOCK_SIZE))
+
+/* The free map has one bit per block, set while the block is free. */
+typedef unsigned int dlc_word;
+#define DLC_WORD_BITS 32
+#define DLC_MAP_WORDS (((DLC_MAX_BLOCKS)+DLC_WORD_BITS-1)/DLC_WORD_BITS)
 
 /* Shamelessly using WSD for now. */
-RChunk *dlc_chunk;
-TBool dlc_block_is_free[DLC_MAX_BLOCKS];
+static unsigned char *dlc_base;
+static dlc_word dlc_free_map[DLC_MAP_WORDS];
+/* Index of the lowest map word that may still have a free bit. Everything 
+ * below it is known to be allocated. */
+static int dlc_hint;
+static int dlc_allocated_blocks;
+/* Number of blocks in the run starting at a block, 0 for blocks that do not 
+ * start an allocation. */
+static unsigned short dlc_run_length[DLC_MAX_BLOCKS];
 
-extern "C" {
-/* Initialize the DLC allocator. Return: 0 on success, -1 on failure. */
-int dlc_init()
+/* Backend: reserve DLC_MAX_SIZE bytes of address space, and commit or 
+ * decommit block sized ranges at block aligned offsets inside it. */
+
+#ifdef __SYMBIAN32__
+
+static RChunk *dlc_chunk;
+
+static int dlc_os_reserve()
 {
     TInt error=KErrNone;
-    int i;
     dlc_chunk=new RChunk;
-    if (!dlc_chunk) {
-        dlc_chunk=NULL;
+    if (!dlc_chunk)
         return -1;
-    }
     /* Create a disconnected local chunk of maximum size DLC_MAX_SIZE, with no physical memory committed at first. */
     error=dlc_chunk->CreateDisconnectedLocal(0, 0, DLC_MAX_SIZE);
     if (error != KErrNone) {
@@ -64,28 +91,172 @@ int dlc_init()
         dlc_chunk=NULL;
         return -1;
     }
+    dlc_base=dlc_chunk->Base();
+    return 0;
+}
+
+static void dlc_os_release()
+{
+    dlc_chunk->Close();
+    delete dlc_chunk; 
+    dlc_chunk=NULL;
+}
+
+static int dlc_os_commit(int offset, int size)
+{
+    return dlc_chunk->Commit(offset, size) == KErrNone ? 0 : -1;
+}
+
+static void dlc_os_decommit(int offset, int size)
+{
+    dlc_chunk->Decommit(offset, size);
+}
+
+static void dlc_os_panic(int reason)
+{
+    User::Panic(_L("DLCDoubleFree"),reason);
+}
+
+#else /* POSIX host */
+
+static int dlc_os_reserve()
+{
+    void *p=mmap(NULL, DLC_MAX_SIZE, PROT_NONE, 
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return -1;
+    dlc_base=(unsigned char *)p;
+    return 0;
+}
+
+static void dlc_os_release()
+{
+    munmap(dlc_base, DLC_MAX_SIZE);
+}
+
+static int dlc_os_commit(int offset, int size)
+{
+    return mprotect(dlc_base+offset, size, PROT_READ|PROT_WRITE);
+}
+
+static void dlc_os_decommit(int offset, int size)
+{
+    /* Drop the pages, then make the range inaccessible again so stray 
+     * accesses to freed blocks fault like they do on a Symbian chunk. */
+    madvise(dlc_base+offset, size, MADV_DONTNEED);
+    mprotect(dlc_base+offset, size, PROT_NONE);
+}
+
+static void dlc_os_panic(int reason)
+{
+    fprintf(stderr, "DLCDoubleFree %d\n", reason);
+    abort();
+}
+
+#endif /* __SYMBIAN32__ */
+
+/* Index of the lowest set bit in a nonzero word. */
+static int dlc_ffs(dlc_word w)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(w);
+#else
+    static const unsigned char debruijn[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    return debruijn[((dlc_word)((w & -w) * 0x077CB531U)) >> 27];
+#endif
+}
+
+#define DLC_IS_FREE(i) \
+    (dlc_free_map[(i)/DLC_WORD_BITS] & ((dlc_word)1 << ((i)%DLC_WORD_BITS)))
+#define DLC_MARK_FREE(i) \
+    (dlc_free_map[(i)/DLC_WORD_BITS] |= ((dlc_word)1 << ((i)%DLC_WORD_BITS)))
+#define DLC_MARK_USED(i) \
+    (dlc_free_map[(i)/DLC_WORD_BITS] &= ~((dlc_word)1 << ((i)%DLC_WORD_BITS)))
+
+/* Return the index of the lowest free block, or -1 if there is none. */
+static int dlc_find_free()
+{
+    int w;
+    for (w=dlc_hint; w<DLC_MAP_WORDS; w++)
+        if (dlc_free_map[w]) {
+            dlc_hint=w;
+            return w*DLC_WORD_BITS+dlc_ffs(dlc_free_map[w]);
+        }
+    dlc_hint=DLC_MAP_WORDS;
+    return -1;
+}
+
+/* Return 1 if blocks [first, first+count) exist and are all free. */
+static int dlc_range_is_free(int first, int count)
+{
+    int i;
+    if (first+count > DLC_MAX_BLOCKS)
+        return 0;
+    for (i=first; i<first+count; i++)
+        if (!DLC_IS_FREE(i))
+            return 0;
+    return 1;
+}
+
+/* Return the index of the block starting the allocation at ptr, or -1 if ptr 
+ * is not the start of a DLC allocation. */
+static int dlc_run_start(void *ptr)
+{
+    unsigned char *p=(unsigned char *)ptr;
+    int offset;
+    if (!dlc_base || p < dlc_base || p >= dlc_base+DLC_MAX_SIZE)
+        return -1;
+    offset=p-dlc_base;
+    if (offset % DLC_BLOCK_SIZE)
+        return -1;
+    if (dlc_run_length[offset/DLC_BLOCK_SIZE] == 0)
+        return -1;
+    return offset/DLC_BLOCK_SIZE;
+}
+
+extern "C" {
+/* Initialize the DLC allocator. Return: 0 on success, -1 on failure. */
+int dlc_init()
+{
+    int i;
+    if (dlc_os_reserve() < 0) {
+        dlc_base=NULL;
+        return -1;
+    }
+    for (i=0; i<DLC_MAP_WORDS; i++)
+        dlc_free_map[i]=~(dlc_word)0;
     for (i=0; i<DLC_MAX_BLOCKS; i++)
-        dlc_block_is_free[i]=1;
+        dlc_run_length[i]=0;
+    /* Clear the bits past the last block if the map has a partial word. */
+    if (DLC_MAX_BLOCKS % DLC_WORD_BITS)
+        dlc_free_map[DLC_MAP_WORDS-1]=
+            ((dlc_word)1 << (DLC_MAX_BLOCKS % DLC_WORD_BITS))-1;
+    dlc_hint=0;
+    dlc_allocated_blocks=0;
     return 0;
 }
 
 void dlc_fini()
 {
-    if (dlc_chunk != NULL) {    
-        dlc_chunk->Close();
-        delete dlc_chunk; 
-        dlc_chunk=NULL;
+    if (dlc_base != NULL) {    
+        dlc_os_release();
+        dlc_base=NULL;
     }
 }
 
+#if DLC_DEBUG
 static void _dlc_log_stats()
 {
     int allocated_blocks, free_blocks;
     dlc_stats(&allocated_blocks, &free_blocks);
     LOG((_L("DLC alloced %d free %d"), allocated_blocks, free_blocks));
 }
+#endif
 
-void *dlc_alloc(int size)
+void *dlc_alloc(size_t size)
 {
     int i;
 
@@ -98,55 +269,112 @@ void *dlc_alloc(int size)
     if (size != DLC_BLOCK_SIZE)
         return NULL;
     /* Find a free block */
-    for (i=0; i<DLC_MAX_BLOCKS; i++)
-        if (dlc_block_is_free[i]) {
-            TInt error=dlc_chunk->Commit(DLC_BLOCK_OFFSET(i), DLC_BLOCK_SIZE);
-            if (error != KErrNone) 
-                return NULL;            
-            dlc_block_is_free[i]=0;
-            LOG((_L("DLC allocated block #%d"),i));
-            return dlc_chunk->Base()+DLC_BLOCK_OFFSET(i);
-        }
-    /* No free blocks - memory exhausted. */
-    return NULL;
+    i=dlc_find_free();
+    if (i < 0) 
+        /* No free blocks - memory exhausted. */
+        return NULL;
+    if (dlc_os_commit(DLC_BLOCK_OFFSET(i), DLC_BLOCK_SIZE) < 0) 
+        return NULL;            
+    DLC_MARK_USED(i);
+    dlc_run_length[i]=1;
+    dlc_allocated_blocks++;
+    LOG((_L("DLC allocated block #%d"),i));
+    return dlc_base+DLC_BLOCK_OFFSET(i);
+}
+
+/* Decommit and release blocks [first, first+count). */
+static void dlc_release_blocks(int first, int count)
+{
+    int i;
+    dlc_os_decommit(DLC_BLOCK_OFFSET(first), DLC_BLOCK_OFFSET(count));
+    for (i=first; i<first+count; i++)
+        DLC_MARK_FREE(i);
+    dlc_allocated_blocks-=count;
+    if (first/DLC_WORD_BITS < dlc_hint)
+        dlc_hint=first/DLC_WORD_BITS;
 }
 
 void dlc_free(void *ptr)
 {
-	int offset=(unsigned char *)ptr-dlc_chunk->Base();
+    int offset=(unsigned char *)ptr-dlc_base;
     int block_index=offset/DLC_BLOCK_SIZE;
+    int count;
 #if DLC_DEBUG    
     LOG((_L("DLC free block #%d offset %x address %x"),block_index, offset, (int)ptr));
     _dlc_log_stats();
 #endif
-    if (dlc_block_is_free[block_index]) {
+    if (DLC_IS_FREE(block_index) || dlc_run_length[block_index] == 0) {
         LOG((_L("DLC PANIC: Block already free")));
-        User::Panic(_L("DLCDoubleFree"),1);
+        dlc_os_panic(1);
     }
-    dlc_chunk->Decommit(offset, DLC_BLOCK_SIZE);
-    dlc_block_is_free[block_index]=1;
+    count=dlc_run_length[block_index];
+    dlc_run_length[block_index]=0;
+    dlc_release_blocks(block_index, count);
+}
+
+/* Resize the allocation at ptr to hold at least size bytes without moving 
+ * it. Growing commits the free blocks directly after the run, shrinking 
+ * decommits the blocks no longer needed. Return: 0 on success, -1 if the 
+ * allocation cannot be resized in place (it is left untouched then). 
+ * Sizes over DLC_MAX_SIZE are refused before they are rounded up to 
+ * blocks, where they could overflow an int. */
+int dlc_resize(void *ptr, size_t size)
+{
+    int first=dlc_run_start(ptr);
+    int count, new_count;
+    if (first < 0 || size > DLC_MAX_SIZE)
+        return -1;
+    count=dlc_run_length[first];
+    new_count=(int)DLC_BLOCKS_FOR(size);
+    if (new_count == 0)
+        new_count=1;
+    if (new_count > count) {
+        int i;
+        if (!dlc_range_is_free(first+count, new_count-count))
+            return -1;
+        if (dlc_os_commit(DLC_BLOCK_OFFSET(first+count), 
+                          DLC_BLOCK_OFFSET(new_count-count)) < 0)
+            return -1;
+        for (i=first+count; i<first+new_count; i++)
+            DLC_MARK_USED(i);
+        dlc_allocated_blocks+=new_count-count;
+        LOG((_L("DLC grew block #%d from %d to %d blocks"),first, count, new_count));
+    }
+    else if (new_count < count) {
+        dlc_release_blocks(first+new_count, count-new_count);
+        LOG((_L("DLC shrank block #%d from %d to %d blocks"),first, count, new_count));
+    }
+    dlc_run_length[first]=new_count;
+    return 0;
+}
+
+/* Return the number of bytes committed for the allocation at ptr, or 0 if 
+ * ptr does not start a DLC allocation. */
+int dlc_size(void *ptr)
+{
+    int first=dlc_run_start(ptr);
+    if (first < 0)
+        return 0;
+    return DLC_BLOCK_OFFSET(dlc_run_length[first]);
 }
 
 void dlc_stats(int *allocated_blocks, int *free_blocks)
 {
-    int i;
-    *allocated_blocks=0;
-    *free_blocks=0;
-    for (i=0; i<DLC_MAX_BLOCKS; i++) 
-        if (dlc_block_is_free[i])
-            (*free_blocks)++;
-        else
-            (*allocated_blocks)++;
+    *allocated_blocks=dlc_allocated_blocks;
+    *free_blocks=DLC_MAX_BLOCKS-dlc_allocated_blocks;
 }
 
 TBool dlc_is_allocated(void *ptr)
 {
-    if (ptr)
+    if (ptr && dlc_base)
     {
-        int offset = (unsigned char *)ptr - dlc_chunk->Base();
-        int block_index = offset/DLC_BLOCK_SIZE;
-        if (offset >= 0 && !dlc_block_is_free[block_index])
-            return ETrue;	
+        unsigned char *p = (unsigned char *)ptr;
+        if (p >= dlc_base && p < dlc_base + DLC_MAX_SIZE)
+        {
+            int block_index = (p - dlc_base)/DLC_BLOCK_SIZE;
+            if (!DLC_IS_FREE(block_index))
+                return ETrue;
+        }
     }
     return EFalse;
 }
@@ -0,0 +1,608 @@
+/* Copyright (c) 2009 Nokia Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Sampling heap profiler.
+
+   The profiler installs itself as the allocator behind PyCore_MALLOC_FUNC
+   (see mem_alloc.c) and forwards every request to the allocator that was
+   installed before it, so it works the same on top of the DLC and on top
+   of the plain C heap.  Everything obmalloc hands out -- arenas and the
+   objects too large for its pools -- passes through this hook.
+
+   Recording every allocation would be far too slow on a phone, so the
+   hook samples by bytes: a countdown is decremented by each request size
+   and, when it runs out, the allocation that crossed the threshold is
+   recorded and the countdown is re-armed with a jittered interval around
+   the sample rate.  A sample stands for the sample rate times the number
+   of intervals it crossed, which makes the reported byte totals an
+   unbiased estimate of the real ones.
+
+   For each sample the Python stack of the current thread (file, function
+   and line of up to HEAPPROF_MAX_DEPTH frames) is looked up in a table of
+   allocation sites.  Sampled pointers are remembered until they are freed
+   or reallocated, so each site also knows how many of its bytes are still
+   live.  The tables are kept in memory from malloc(), never from the hook
+   itself, and are written out in callgrind format so that the result can
+   be browsed with kcachegrind or summarised with callgrind_annotate.
+
+   The hook is only called with the GIL held (obmalloc relies on the same
+   thing), which is what serialises access to the tables below.
+*/
+
+#include "Python.h"
+#include "frameobject.h"
+#include "mem_alloc.h"
+
+#define HEAPPROF_DEFAULT_RATE	(16 * 1024)
+#define HEAPPROF_MAX_DEPTH	16
+
+/* Hash table sizes, all powers of two. */
+#define HEAPPROF_NAME_BUCKETS	256
+#define HEAPPROF_SITE_BUCKETS	1024
+#define HEAPPROF_LIVE_BUCKETS	4096
+
+/* An interned copy of a file or function name.  Frames compare names by
+   pointer, so each distinct string is stored exactly once. */
+typedef struct heapprof_name {
+	struct heapprof_name *next;
+	unsigned long hash;
+	char str[1];
+} heapprof_name;
+
+typedef struct {
+	const char *file;
+	const char *func;
+	int line;
+} heapprof_frame;
+
+/* One distinct Python stack; frames[0] is the innermost frame. */
+typedef struct heapprof_site {
+	struct heapprof_site *next;
+	unsigned long hash;
+	size_t samples;
+	size_t bytes;		/* estimated bytes allocated here */
+	size_t live_bytes;	/* estimated bytes not yet freed */
+	int depth;
+	heapprof_frame frames[1];
+} heapprof_site;
+
+/* A sampled block that has not been freed yet. */
+typedef struct heapprof_live {
+	struct heapprof_live *next;
+	void *ptr;
+	size_t bytes;
+	heapprof_site *site;
+} heapprof_live;
+
+static heapprof_name *name_table[HEAPPROF_NAME_BUCKETS];
+static heapprof_site *site_table[HEAPPROF_SITE_BUCKETS];
+static heapprof_live *live_table[HEAPPROF_LIVE_BUCKETS];
+
+static int heapprof_running = 0;
+static int heapprof_paused = 0;
+static size_t heapprof_rate = HEAPPROF_DEFAULT_RATE;
+static long heapprof_countdown = 0;
+static unsigned long heapprof_seed = 1;
+
+static size_t heapprof_nsamples = 0;	/* samples taken */
+static size_t heapprof_ndropped = 0;	/* samples lost to malloc failure */
+static size_t heapprof_nlive = 0;	/* entries in live_table */
+
+/* The allocator the profiler forwards to. */
+static void *(*prev_alloc)(size_t, void *) = NULL;
+static void *(*prev_realloc)(void *, size_t, void *) = NULL;
+static void (*prev_free)(void *, void *) = NULL;
+static void *prev_context = NULL;
+
+static char native_name[] = "<native>";
+
+#define PTR_BUCKET(p) \
+	((((Py_uintptr_t)(p)) >> 4) & (HEAPPROF_LIVE_BUCKETS - 1))
+
+/* Pick the next sample interval uniformly from [rate/2, 3*rate/2), so
+   that allocation patterns with a fixed period are not always sampled at
+   the same point. */
+static long
+heapprof_next_interval(void)
+{
+	heapprof_seed = heapprof_seed * 1103515245UL + 12345UL;
+	return (long)(heapprof_rate / 2 +
+		      (heapprof_seed >> 8) % (heapprof_rate ? heapprof_rate : 1));
+}
+
+static const char *
+heapprof_intern(PyObject *s)
+{
+	const char *str;
+	unsigned long hash = 5381;
+	const unsigned char *c;
+	heapprof_name *name;
+	size_t len;
+
+	if (s == NULL || !PyString_Check(s))
+		return native_name;
+	str = PyString_AS_STRING(s);
+	for (c = (const unsigned char *)str; *c; c++)
+		hash = hash * 33 + *c;
+	name = name_table[hash & (HEAPPROF_NAME_BUCKETS - 1)];
+	for (; name != NULL; name = name->next) {
+		if (name->hash == hash && strcmp(name->str, str) == 0)
+			return name->str;
+	}
+	len = strlen(str);
+	name = (heapprof_name *)malloc(sizeof(heapprof_name) + len);
+	if (name == NULL)
+		return NULL;
+	name->hash = hash;
+	memcpy(name->str, str, len + 1);
+	name->next = name_table[hash & (HEAPPROF_NAME_BUCKETS - 1)];
+	name_table[hash & (HEAPPROF_NAME_BUCKETS - 1)] = name;
+	return name->str;
+}
+
+static heapprof_site *
+heapprof_find_site(heapprof_frame *frames, int depth)
+{
+	unsigned long hash = (unsigned long)depth;
+	heapprof_site *site;
+	size_t framesize;
+	int i;
+
+	for (i = 0; i < depth; i++) {
+		hash = hash * 1000003UL ^ (unsigned long)(Py_uintptr_t)frames[i].file;
+		hash = hash * 1000003UL ^ (unsigned long)(Py_uintptr_t)frames[i].func;
+		hash = hash * 1000003UL ^ (unsigned long)frames[i].line;
+	}
+	site = site_table[hash & (HEAPPROF_SITE_BUCKETS - 1)];
+	for (; site != NULL; site = site->next) {
+		if (site->hash != hash || site->depth != depth)
+			continue;
+		for (i = 0; i < depth; i++) {
+			if (site->frames[i].file != frames[i].file ||
+			    site->frames[i].func != frames[i].func ||
+			    site->frames[i].line != frames[i].line)
+				break;
+		}
+		if (i == depth)
+			return site;
+	}
+	framesize = (depth - 1) * sizeof(heapprof_frame);
+	site = (heapprof_site *)malloc(sizeof(heapprof_site) + framesize);
+	if (site == NULL)
+		return NULL;
+	memset(site, 0, sizeof(heapprof_site));
+	site->hash = hash;
+	site->depth = depth;
+	memcpy(site->frames, frames, depth * sizeof(heapprof_frame));
+	site->next = site_table[hash & (HEAPPROF_SITE_BUCKETS - 1)];
+	site_table[hash & (HEAPPROF_SITE_BUCKETS - 1)] = site;
+	return site;
+}
+
+static void
+heapprof_sample(void *p, size_t size)
+{
+	heapprof_frame frames[HEAPPROF_MAX_DEPTH];
+	PyThreadState *tstate = _PyThreadState_Current;
+	PyFrameObject *f;
+	heapprof_site *site;
+	heapprof_live *live;
+	size_t weight;
+	int depth = 0;
+
+	/* Charge the sample one rate's worth of bytes for every interval
+	   it used up, so that large blocks are not undercounted. */
+	weight = 0;
+	do {
+		weight += heapprof_rate;
+		heapprof_countdown += heapprof_next_interval();
+	} while (heapprof_countdown <= 0);
+	if (heapprof_paused)
+		return;
+
+	f = tstate != NULL ? tstate->frame : NULL;
+	for (; f != NULL && depth < HEAPPROF_MAX_DEPTH; f = f->f_back) {
+		PyCodeObject *co = f->f_code;
+		frames[depth].file = heapprof_intern(co->co_filename);
+		frames[depth].func = heapprof_intern(co->co_name);
+		if (frames[depth].file == NULL || frames[depth].func == NULL)
+			goto dropped;
+		frames[depth].line = PyCode_Addr2Line(co, f->f_lasti);
+		depth++;
+	}
+	if (depth == 0) {
+		/* Allocated from C with no Python code running, e.g. while
+		   the interpreter is starting up. */
+		frames[0].file = native_name;
+		frames[0].func = native_name;
+		frames[0].line = 0;
+		depth = 1;
+	}
+
+	if ((site = heapprof_find_site(frames, depth)) == NULL)
+		goto dropped;
+	if ((live = (heapprof_live *)malloc(sizeof(heapprof_live))) == NULL)
+		goto dropped;
+	site->samples++;
+	site->bytes += weight;
+	site->live_bytes += weight;
+	live->ptr = p;
+	live->bytes = weight;
+	live->site = site;
+	live->next = live_table[PTR_BUCKET(p)];
+	live_table[PTR_BUCKET(p)] = live;
+	heapprof_nlive++;
+	heapprof_nsamples++;
+	return;
+
+  dropped:
+	heapprof_ndropped++;
+}
+
+/* Called for every block given back to the allocator; it only costs a
+   bucket scan while sampled blocks are outstanding. */
+static void
+heapprof_forget(void *p)
+{
+	heapprof_live **plive = &live_table[PTR_BUCKET(p)];
+	heapprof_live *live;
+
+	for (; (live = *plive) != NULL; plive = &live->next) {
+		if (live->ptr == p) {
+			*plive = live->next;
+			live->site->live_bytes -= live->bytes;
+			heapprof_nlive--;
+			free(live);
+			return;
+		}
+	}
+}
+
+static void *
+heapprof_alloc(size_t size, void *context)
+{
+	void *p;
+
+	if (prev_alloc)
+		p = prev_alloc(size, prev_context);
+	else
+		p = malloc(size);
+	if (p != NULL && (heapprof_countdown -= (long)size) <= 0)
+		heapprof_sample(p, size);
+	return p;
+}
+
+static void *
+heapprof_realloc(void *p, size_t size, void *context)
+{
+	void *q;
+
+	if (prev_realloc)
+		q = prev_realloc(p, size, prev_context);
+	else
+		q = realloc(p, size);
+	if (q == NULL)
+		return NULL;
+	/* A resize counts as freeing the old block and allocating a new
+	   one, even when the block did not move. */
+	if (p != NULL && heapprof_nlive)
+		heapprof_forget(p);
+	if ((heapprof_countdown -= (long)size) <= 0)
+		heapprof_sample(q, size);
+	return q;
+}
+
+static void
+heapprof_free(void *p, void *context)
+{
+	if (p != NULL && heapprof_nlive)
+		heapprof_forget(p);
+	if (prev_free)
+		prev_free(p, prev_context);
+	else
+		free(p);
+}
+
+int
+SPy_HeapProfile_Start(size_t sample_bytes)
+{
+	if (heapprof_running)
+		return -1;
+	heapprof_rate = sample_bytes ? sample_bytes : HEAPPROF_DEFAULT_RATE;
+	heapprof_countdown = heapprof_next_interval();
+	SPy_GetAllocator(&prev_alloc, &prev_realloc, &prev_free,
+			 &prev_context);
+	SPy_SetAllocator(heapprof_alloc, heapprof_realloc, heapprof_free,
+			 NULL);
+	heapprof_running = 1;
+	return 0;
+}
+
+/* Blocks allocated while the profiler was running can safely be freed
+   after it stops, since it never changes what the underlying allocator
+   hands out.  The collected sites are kept until SPy_HeapProfile_Clear(),
+   with their live byte counts frozen at the time of the call. */
+void
+SPy_HeapProfile_Stop(void)
+{
+	if (!heapprof_running)
+		return;
+	SPy_SetAllocator(prev_alloc, prev_realloc, prev_free, prev_context);
+	heapprof_running = 0;
+}
+
+void
+SPy_HeapProfile_Clear(void)
+{
+	int i;
+
+	for (i = 0; i < HEAPPROF_LIVE_BUCKETS; i++) {
+		heapprof_live *live = live_table[i], *next;
+		for (; live != NULL; live = next) {
+			next = live->next;
+			free(live);
+		}
+		live_table[i] = NULL;
+	}
+	for (i = 0; i < HEAPPROF_SITE_BUCKETS; i++) {
+		heapprof_site *site = site_table[i], *next;
+		for (; site != NULL; site = next) {
+			next = site->next;
+			free(site);
+		}
+		site_table[i] = NULL;
+	}
+	for (i = 0; i < HEAPPROF_NAME_BUCKETS; i++) {
+		heapprof_name *name = name_table[i], *next;
+		for (; name != NULL; name = next) {
+			next = name->next;
+			free(name);
+		}
+		name_table[i] = NULL;
+	}
+	heapprof_nsamples = heapprof_ndropped = heapprof_nlive = 0;
+}
+
+/* Write the collected sites in callgrind format.  The innermost frame of
+   each site gets the self cost, and every caller gets a call record with
+   the same cost as inclusive cost, so that kcachegrind can build the
+   call graph.  Returns 0 on success and -1 if the file cannot be
+   written. */
+int
+SPy_HeapProfile_Dump(const char *path)
+{
+	size_t total_bytes = 0, total_live = 0;
+	FILE *fp;
+	int i, j;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return -1;
+	for (i = 0; i < HEAPPROF_SITE_BUCKETS; i++) {
+		heapprof_site *site;
+		for (site = site_table[i]; site != NULL; site = site->next) {
+			total_bytes += site->bytes;
+			total_live += site->live_bytes;
+		}
+	}
+	fprintf(fp, "# callgrind format\n");
+	fprintf(fp, "version: 1\n");
+	fprintf(fp, "creator: _heapprof\n");
+	fprintf(fp, "desc: Sample rate: %lu bytes\n",
+		(unsigned long)heapprof_rate);
+	fprintf(fp, "desc: Dropped samples: %lu\n",
+		(unsigned long)heapprof_ndropped);
+	fprintf(fp, "positions: line\n");
+	fprintf(fp, "events: Bytes Samples LiveBytes\n");
+	fprintf(fp, "summary: %lu %lu %lu\n", (unsigned long)total_bytes,
+		(unsigned long)heapprof_nsamples, (unsigned long)total_live);
+
+	for (i = 0; i < HEAPPROF_SITE_BUCKETS; i++) {
+		heapprof_site *site;
+		for (site = site_table[i]; site != NULL; site = site->next) {
+			heapprof_frame *fr = site->frames;
+			fprintf(fp, "\nfl=%s\nfn=%s\n%d %lu %lu %lu\n",
+				fr[0].file, fr[0].func, fr[0].line,
+				(unsigned long)site->bytes,
+				(unsigned long)site->samples,
+				(unsigned long)site->live_bytes);
+			for (j = 1; j < site->depth; j++) {
+				fprintf(fp, "fl=%s\nfn=%s\n", fr[j].file,
+					fr[j].func);
+				fprintf(fp, "cfl=%s\ncfn=%s\n", fr[j-1].file,
+					fr[j-1].func);
+				fprintf(fp, "calls=%lu %d\n",
+					(unsigned long)site->samples,
+					fr[j-1].line);
+				fprintf(fp, "%d %lu %lu %lu\n", fr[j].line,
+					(unsigned long)site->bytes,
+					(unsigned long)site->samples,
+					(unsigned long)site->live_bytes);
+			}
+		}
+	}
+	if (fclose(fp) != 0)
+		return -1;
+	return 0;
+}
+
+
+/* Python interface */
+
+PyDoc_STRVAR(heapprof_start__doc__,
+"start([rate]) -> None\n"
+"\n"
+"Start sampling allocations made through the core allocator, about one\n"
+"sample every 'rate' bytes (default 16384).\n");
+
+static PyObject *
+heapprof_start(PyObject *self, PyObject *args)
+{
+	long rate = HEAPPROF_DEFAULT_RATE;
+
+	if (!PyArg_ParseTuple(args, "|l:start", &rate))
+		return NULL;
+	if (rate <= 0) {
+		PyErr_SetString(PyExc_ValueError, "rate must be positive");
+		return NULL;
+	}
+	if (SPy_HeapProfile_Start((size_t)rate) < 0) {
+		PyErr_SetString(PyExc_RuntimeError,
+				"heap profiler is already running");
+		return NULL;
+	}
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(heapprof_stop__doc__,
+"stop() -> None\n"
+"\n"
+"Stop sampling.  The collected data is kept until clear() is called.\n");
+
+static PyObject *
+heapprof_stop(PyObject *self, PyObject *noargs)
+{
+	SPy_HeapProfile_Stop();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(heapprof_isrunning__doc__,
+"isrunning() -> status\n"
+"\n"
+"Returns true if the heap profiler is running.\n");
+
+static PyObject *
+heapprof_isrunning(PyObject *self, PyObject *noargs)
+{
+	return PyBool_FromLong((long)heapprof_running);
+}
+
+PyDoc_STRVAR(heapprof_clear__doc__,
+"clear() -> None\n"
+"\n"
+"Discard all collected samples.\n");
+
+static PyObject *
+heapprof_clear(PyObject *self, PyObject *noargs)
+{
+	SPy_HeapProfile_Clear();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(heapprof_dump__doc__,
+"dump(filename) -> None\n"
+"\n"
+"Write the collected samples to a file in callgrind format.\n");
+
+static PyObject *
+heapprof_dump(PyObject *self, PyObject *args)
+{
+	char *path;
+
+	if (!PyArg_ParseTuple(args, "s:dump", &path))
+		return NULL;
+	/* Keep the GIL: the hook may not change the tables while they are
+	   being written out. */
+	if (SPy_HeapProfile_Dump(path) < 0)
+		return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(heapprof_getsites__doc__,
+"getsites() -> list\n"
+"\n"
+"Return a list of (stack, samples, bytes, live_bytes) tuples, one for\n"
+"each allocation site.  stack is a tuple of (filename, function, line)\n"
+"tuples, innermost frame first.\n");
+
+static PyObject *
+heapprof_getsites(PyObject *self, PyObject *noargs)
+{
+	PyObject *result, *item;
+	int i, j;
+
+	if ((result = PyList_New(0)) == NULL)
+		return NULL;
+	/* Building the list goes through the hook as well; don't let it
+	   add sites while they are being walked. */
+	heapprof_paused = 1;
+	for (i = 0; i < HEAPPROF_SITE_BUCKETS; i++) {
+		heapprof_site *site;
+		for (site = site_table[i]; site != NULL; site = site->next) {
+			PyObject *stack = PyTuple_New(site->depth);
+			if (stack == NULL)
+				goto error;
+			for (j = 0; j < site->depth; j++) {
+				heapprof_frame *fr = &site->frames[j];
+				PyObject *t = Py_BuildValue("(ssi)", fr->file,
+							    fr->func, fr->line);
+				if (t == NULL) {
+					Py_DECREF(stack);
+					goto error;
+				}
+				PyTuple_SET_ITEM(stack, j, t);
+			}
+			item = Py_BuildValue("(Nkkk)", stack,
+					     (unsigned long)site->samples,
+					     (unsigned long)site->bytes,
+					     (unsigned long)site->live_bytes);
+			if (item == NULL)
+				goto error;
+			if (PyList_Append(result, item) < 0) {
+				Py_DECREF(item);
+				goto error;
+			}
+			Py_DECREF(item);
+		}
+	}
+	heapprof_paused = 0;
+	return result;
+
+  error:
+	heapprof_paused = 0;
+	Py_DECREF(result);
+	return NULL;
+}
+
+PyDoc_STRVAR(heapprof__doc__,
+"This module provides a sampling profiler for the core allocator.\n"
+"\n"
+"start() -- Start sampling allocations.\n"
+"stop() -- Stop sampling allocations.\n"
+"isrunning() -- Returns true if the profiler is running.\n"
+"clear() -- Discard the collected samples.\n"
+"dump() -- Write the samples to a file in callgrind format.\n"
+"getsites() -- Return the samples grouped by allocation site.\n");
+
+static PyMethodDef heapprof_methods[] = {
+	{"start",	heapprof_start,	METH_VARARGS, heapprof_start__doc__},
+	{"stop",	heapprof_stop,	METH_NOARGS,  heapprof_stop__doc__},
+	{"isrunning",	heapprof_isrunning, METH_NOARGS,
+	 heapprof_isrunning__doc__},
+	{"clear",	heapprof_clear,	METH_NOARGS,  heapprof_clear__doc__},
+	{"dump",	heapprof_dump,	METH_VARARGS, heapprof_dump__doc__},
+	{"getsites",	heapprof_getsites, METH_NOARGS,
+	 heapprof_getsites__doc__},
+	{NULL,		NULL}		/* Sentinel */
+};
+
+PyMODINIT_FUNC
+init_heapprof(void)
+{
+	Py_InitModule3("_heapprof", heapprof_methods, heapprof__doc__);
+}
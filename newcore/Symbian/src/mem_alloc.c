@@ -20,6 +20,9 @@ static void*(*allocator_alloc)(size_t, void*) = NULL;
 static void*(*allocator_realloc)(void*, size_t, void*) = NULL;
 static void(*allocator_free)(void*, void*) = NULL;
 static void* allocator_context = NULL;
+/* Set once _PyCore_Malloc or _PyCore_Realloc has handed out a block, after
+   which the backend can't be changed: the new one couldn't free it. */
+static int allocator_used = 0;
 
 int SPy_DLC_Init()
 {
@@ -45,9 +48,14 @@ void* SPy_DLC_Realloc(void* ptr, size_t nBytes, void* context)
     void *newptr = NULL;
     if (dlc_is_allocated(ptr)) 
     {        
+        /* Grow or shrink the block run in place if the neighbouring blocks
+           allow it, and only move the data out of the chunk otherwise. */
+        if (dlc_resize(ptr, nBytes) == 0)
+            return ptr;
         if ((newptr = malloc(nBytes)))
         {
-            memcpy(newptr, ptr, DLC_BLOCK_SIZE);
+            size_t oldsize = dlc_size(ptr);
+            memcpy(newptr, ptr, nBytes < oldsize ? nBytes : oldsize);
             dlc_free(ptr);
         }
     }
@@ -67,18 +75,26 @@ void SPy_DLC_Free(void* ptr, void* context)
 
 void* _PyCore_Malloc(size_t size)
 {
+    void *ptr;
     if (allocator_alloc)
-        return allocator_alloc(size, allocator_context);
-
-    return malloc(size);
+        ptr = allocator_alloc(size, allocator_context);
+    else
+        ptr = malloc(size);
+    if (ptr)
+        allocator_used = 1;
+    return ptr;
 }
 
 void* _PyCore_Realloc(void *p, size_t size)
 {
+    void *ptr;
     if (allocator_realloc)
-        return allocator_realloc(p, size, allocator_context);
-
-    return realloc(p, size);    
+        ptr = allocator_realloc(p, size, allocator_context);
+    else
+        ptr = realloc(p, size);
+    if (ptr)
+        allocator_used = 1;
+    return ptr;
 }
 
 void _PyCore_Free(void *ptr)
@@ -97,3 +113,221 @@ void SPy_SetAllocator(void* (*alloc)(size_t, void*), void* (*realloc)(void*, siz
     allocator_context = context;
 }
 
+void SPy_GetAllocator(void* (**alloc)(size_t, void*), void* (**realloc)(void*, size_t, void*), void (**free)(void*, void*), void **context)
+{
+    *alloc = allocator_alloc;
+    *realloc = allocator_realloc;
+    *free = allocator_free;
+    *context = allocator_context;
+}
+
+/* Bump allocator: blocks are carved one after the other out of large
+   chunks and a chunk is only returned to the system when every block in it
+   has been freed. Freeing or resizing the most recent block of a chunk moves
+   the bump pointer back, so stack-like patterns reuse memory. Each block is
+   preceded by a header naming its chunk; blocks bigger than an obmalloc
+   arena do not go into chunks and have a NULL chunk in their header. Like
+   DLC this is not thread safe, it relies on the caller holding the GIL. */
+
+#define BUMP_CHUNK_SIZE (16 * ARENA_SIZE + 1024)
+#define BUMP_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+struct bump_chunk {
+    struct bump_chunk *prev;
+    struct bump_chunk *next;
+    char *top;              /* first free byte */
+    size_t live;            /* blocks not yet freed */
+};
+
+struct bump_header {
+    struct bump_chunk *chunk;
+    size_t size;            /* rounded up size of the block */
+};
+
+#define BUMP_CHUNK_START(c) ((char *)(c) + BUMP_ALIGN(sizeof(struct bump_chunk)))
+#define BUMP_CHUNK_END(c) ((char *)(c) + BUMP_CHUNK_SIZE)
+#define BUMP_HEADER(p) ((struct bump_header *)(p) - 1)
+#define BUMP_LARGE (ARENA_SIZE + sizeof(struct bump_header))
+
+static struct bump_chunk *bump_chunks = NULL;   /* current chunk first */
+
+static void* bump_alloc(size_t nBytes, void *context)
+{
+    struct bump_chunk *chunk = bump_chunks;
+    struct bump_header *hdr;
+    size_t need = BUMP_ALIGN(nBytes) + sizeof(struct bump_header);
+
+    if (need > BUMP_LARGE)
+    {
+        if (!(hdr = (struct bump_header *)malloc(need)))
+            return NULL;
+        hdr->chunk = NULL;
+        hdr->size = BUMP_ALIGN(nBytes);
+        return hdr + 1;
+    }
+    if (chunk == NULL || chunk->top + need > BUMP_CHUNK_END(chunk))
+    {
+        if (!(chunk = (struct bump_chunk *)malloc(BUMP_CHUNK_SIZE)))
+            return NULL;
+        chunk->prev = NULL;
+        chunk->next = bump_chunks;
+        chunk->top = BUMP_CHUNK_START(chunk);
+        chunk->live = 0;
+        if (bump_chunks)
+            bump_chunks->prev = chunk;
+        bump_chunks = chunk;
+    }
+    hdr = (struct bump_header *)chunk->top;
+    hdr->chunk = chunk;
+    hdr->size = need - sizeof(struct bump_header);
+    chunk->top += need;
+    chunk->live++;
+    return hdr + 1;
+}
+
+static void bump_free(void *ptr, void *context)
+{
+    struct bump_header *hdr;
+    struct bump_chunk *chunk;
+
+    if (ptr == NULL)
+        return;
+    hdr = BUMP_HEADER(ptr);
+    if ((chunk = hdr->chunk) == NULL)
+    {
+        free(hdr);
+        return;
+    }
+    if ((char *)ptr + hdr->size == chunk->top)
+        chunk->top = (char *)hdr;
+    if (--chunk->live > 0)
+        return;
+    if (chunk == bump_chunks)
+    {
+        /* Keep the current chunk around for the next allocations */
+        chunk->top = BUMP_CHUNK_START(chunk);
+        return;
+    }
+    chunk->prev->next = chunk->next;
+    if (chunk->next)
+        chunk->next->prev = chunk->prev;
+    free(chunk);
+}
+
+static void* bump_realloc(void *ptr, size_t nBytes, void *context)
+{
+    struct bump_header *hdr;
+    struct bump_chunk *chunk;
+    void *newptr;
+    size_t size = BUMP_ALIGN(nBytes);
+
+    if (ptr == NULL)
+        return bump_alloc(nBytes, context);
+    hdr = BUMP_HEADER(ptr);
+    if ((chunk = hdr->chunk) == NULL)
+    {
+        if (size + sizeof(struct bump_header) > BUMP_LARGE)
+        {
+            if (!(hdr = (struct bump_header *)realloc(hdr,
+                        size + sizeof(struct bump_header))))
+                return NULL;
+            hdr->size = size;
+            return hdr + 1;
+        }
+    }
+    else if ((char *)ptr + hdr->size == chunk->top)
+    {
+        /* The last block of its chunk can grow or shrink in place */
+        if ((char *)ptr + size <= BUMP_CHUNK_END(chunk))
+        {
+            hdr->size = size;
+            chunk->top = (char *)ptr + size;
+            return ptr;
+        }
+    }
+    else if (size <= hdr->size)
+        return ptr;
+
+    if (!(newptr = bump_alloc(nBytes, context)))
+        return NULL;
+    memcpy(newptr, ptr, size < hdr->size ? size : hdr->size);
+    bump_free(ptr, context);
+    return newptr;
+}
+
+static int bump_init()
+{
+    return 0;
+}
+
+static void bump_fini()
+{
+    struct bump_chunk *chunk;
+
+    /* Blocks too big for a chunk are left to free_all_allocations */
+    while ((chunk = bump_chunks) != NULL)
+    {
+        bump_chunks = chunk->next;
+        free(chunk);
+    }
+}
+
+/* The backends that SPy_SelectAllocator knows by name. The system backend
+   has no functions of its own, _PyCore_Malloc and friends then call the C
+   library directly. */
+
+struct allocator_backend {
+    const char *name;
+    int (*init)();
+    void (*fini)();
+    void* (*alloc)(size_t, void*);
+    void* (*realloc)(void*, size_t, void*);
+    void (*free)(void*, void*);
+};
+
+static const struct allocator_backend allocator_backends[] = {
+    {"system", NULL, NULL, NULL, NULL, NULL},
+    {"dlc", SPy_DLC_Init, SPy_DLC_Fini,
+        SPy_DLC_Alloc, SPy_DLC_Realloc, SPy_DLC_Free},
+    {"arena", bump_init, bump_fini, bump_alloc, bump_realloc, bump_free},
+    {NULL}
+};
+
+static const struct allocator_backend *find_backend(void* (*alloc)(size_t, void*))
+{
+    const struct allocator_backend *b;
+    for (b = allocator_backends; b->name; b++)
+        if (b->alloc == alloc)
+            return b;
+    return NULL;
+}
+
+int SPy_SelectAllocator(const char *name)
+{
+    const struct allocator_backend *b, *current;
+
+    for (b = allocator_backends; b->name; b++)
+        if (strcmp(b->name, name) == 0)
+            break;
+    if (b->name == NULL)
+        return -1;
+    current = find_backend(allocator_alloc);
+    if (b == current)
+        return 0;
+    /* The current backend may own live blocks, and its fini would pull
+       them from under their users */
+    if (allocator_used)
+        return -1;
+    if (b->init && b->init() < 0)
+        return -1;
+    if (current && current->fini)
+        current->fini();
+    SPy_SetAllocator(b->alloc, b->realloc, b->free, NULL);
+    return 0;
+}
+
+const char* SPy_GetAllocatorName()
+{
+    const struct allocator_backend *b = find_backend(allocator_alloc);
+    return b ? b->name : NULL;
+}
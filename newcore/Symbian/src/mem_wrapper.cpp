@@ -15,80 +15,253 @@
  */
 
 #include "mem_wrapper.h"
+#include <pthread.h>
 
 extern "C" {
 
-/* This linked list will contain all the allocations made by the interpreter
- * which are not yet freed */
-struct alloc_list_node {
-  void *ptr;
-  struct alloc_list_node *prev;
+/* All the allocations made by the interpreter which are not yet freed are
+ * kept in a hash table keyed by pointer, so that free_wrapper and
+ * realloc_wrapper find their entry in constant time however many blocks
+ * are live.
+ *
+ * The table is split into TRACKER_SEGMENTS segments, picked by the top bits
+ * of the pointer hash. Each segment is an open-addressing table with linear
+ * probing and has its own mutex and its own capacity, so threads rarely
+ * contend for a lock and growing one segment does not stall the others.
+ * Freed slots are marked with TRACKER_DELETED so that probe sequences stay
+ * intact; they are dropped when the segment is rehashed.
+ */
+
+#define TRACKER_SEGMENT_BITS 4
+#define TRACKER_SEGMENTS (1 << TRACKER_SEGMENT_BITS)
+#define TRACKER_MIN_SLOTS 64
+#define TRACKER_DELETED ((void *)1)
+
+struct alloc_entry {
+    void *ptr;
+    size_t size;
+};
+
+struct alloc_segment {
+    pthread_mutex_t lock;
+    struct alloc_entry *slots;
+    size_t mask;        // number of slots - 1, or 0 if not allocated yet
+    size_t used;        // live entries
+    size_t filled;      // live and deleted entries
+};
+
+#define SEGMENT_INIT {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0}
+
+static struct alloc_segment segments[TRACKER_SEGMENTS] = {
+    SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT,
+    SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT,
+    SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT,
+    SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT, SEGMENT_INIT
 };
 
-// Always points to the tail of the alloc list node
-struct alloc_list_node *alloc_chain_tail_ptr = NULL;
+// Totals over all the segments, guarded by stats_lock
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t live_count = 0;
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+
 bool track_alloc = true;
 void *libc_handle = NULL;
 
+typedef void* (*MALLOC)(size_t);
+typedef void* (*REALLOC)(void*, size_t);
+typedef void (*FREE)(void*);
+
+static MALLOC libc_malloc = NULL;
+static REALLOC libc_realloc = NULL;
+static FREE libc_free = NULL;
+
 void track_allocations(bool track_flag)
 {
     track_alloc = track_flag;
 }
 
-void new_alloc_list_node(void *ptr)
+void check_and_load_libc()
 {
-    typedef void* (*MALLOC)(size_t);
-    MALLOC malloc = (MALLOC) dlsym(libc_handle, LIBC_MALLOC_ORDINAL);
-    struct alloc_list_node *new_node;
-    new_node = (struct alloc_list_node *) malloc (sizeof(struct alloc_list_node));
-    new_node->prev = alloc_chain_tail_ptr;
-    new_node->ptr = ptr;
-    alloc_chain_tail_ptr = new_node;
+    if (libc_handle == NULL)
+    {
+        void *handle = dlopen("libc.dll", RTLD_NOW | RTLD_LOCAL);
+        libc_malloc = (MALLOC) dlsym(handle, LIBC_MALLOC_ORDINAL);
+        libc_realloc = (REALLOC) dlsym(handle, LIBC_REALLOC_ORDINAL);
+        libc_free = (FREE) dlsym(handle, LIBC_FREE_ORDINAL);
+        libc_handle = handle;
+    }
 }
 
-void check_and_load_libc()
+static unsigned int tracker_hash(void *ptr)
 {
-    if (libc_handle == NULL)
-        libc_handle = dlopen("libc.dll", RTLD_NOW | RTLD_LOCAL);
+    // Fibonacci hashing; the low bits of a block address are always zero
+    return (unsigned int)((Py_uintptr_t)ptr >> 3) * 2654435761U;
+}
+
+static struct alloc_segment *tracker_segment(unsigned int hash)
+{
+    return &segments[hash >> (32 - TRACKER_SEGMENT_BITS)];
+}
+
+/* Rebuild the segment with room for at least twice its live entries. The
+ * segment lock must be held. Returns false if no memory is available, in
+ * which case the segment is left as it was. */
+static bool tracker_resize(struct alloc_segment *seg)
+{
+    size_t newsize = TRACKER_MIN_SLOTS;
+    while (newsize <= (seg->used + 1) * 2)
+        newsize <<= 1;
+
+    struct alloc_entry *newslots = (struct alloc_entry *)
+        libc_malloc(newsize * sizeof(struct alloc_entry));
+    if (newslots == NULL)
+        return false;
+    memset(newslots, 0, newsize * sizeof(struct alloc_entry));
+
+    if (seg->slots != NULL)
+    {
+        for (size_t i = 0; i <= seg->mask; i++)
+        {
+            struct alloc_entry *old = &seg->slots[i];
+            if (old->ptr == NULL || old->ptr == TRACKER_DELETED)
+                continue;
+            size_t j = tracker_hash(old->ptr) & (newsize - 1);
+            while (newslots[j].ptr != NULL)
+                j = (j + 1) & (newsize - 1);
+            newslots[j] = *old;
+        }
+        libc_free(seg->slots);
+    }
+    seg->slots = newslots;
+    seg->mask = newsize - 1;
+    seg->filled = seg->used;
+    return true;
+}
+
+static void tracker_add(void *ptr, size_t size)
+{
+    unsigned int hash = tracker_hash(ptr);
+    struct alloc_segment *seg = tracker_segment(hash);
+
+    pthread_mutex_lock(&seg->lock);
+    // Keep at most three quarters of the slots in use
+    if (seg->slots == NULL || (seg->filled + 1) * 4 > (seg->mask + 1) * 3)
+    {
+        if (!tracker_resize(seg))
+        {
+            // Out of memory: the block simply goes untracked
+            pthread_mutex_unlock(&seg->lock);
+            return;
+        }
+    }
+    size_t i = hash & seg->mask;
+    while (seg->slots[i].ptr != NULL && seg->slots[i].ptr != TRACKER_DELETED)
+        i = (i + 1) & seg->mask;
+    if (seg->slots[i].ptr == NULL)
+        seg->filled++;
+    seg->slots[i].ptr = ptr;
+    seg->slots[i].size = size;
+    seg->used++;
+    pthread_mutex_unlock(&seg->lock);
+
+    pthread_mutex_lock(&stats_lock);
+    live_count++;
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+        peak_bytes = live_bytes;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* Forget a block. Returns false if it was not being tracked, otherwise
+ * stores its size in *size. */
+static bool tracker_remove(void *ptr, size_t *size)
+{
+    unsigned int hash = tracker_hash(ptr);
+    struct alloc_segment *seg = tracker_segment(hash);
+    bool found = false;
+
+    pthread_mutex_lock(&seg->lock);
+    if (seg->slots != NULL)
+    {
+        size_t i = hash & seg->mask;
+        for (; seg->slots[i].ptr != NULL; i = (i + 1) & seg->mask)
+        {
+            if (seg->slots[i].ptr == ptr)
+            {
+                seg->slots[i].ptr = TRACKER_DELETED;
+                *size = seg->slots[i].size;
+                seg->used--;
+                found = true;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&seg->lock);
+
+    if (found)
+    {
+        pthread_mutex_lock(&stats_lock);
+        live_count--;
+        live_bytes -= *size;
+        pthread_mutex_unlock(&stats_lock);
+    }
+    return found;
+}
+
+void get_allocation_stats(size_t *count, size_t *bytes, size_t *peak)
+{
+    pthread_mutex_lock(&stats_lock);
+    if (count)
+        *count = live_count;
+    if (bytes)
+        *bytes = live_bytes;
+    if (peak)
+        *peak = peak_bytes;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void reset_allocation_peak()
+{
+    pthread_mutex_lock(&stats_lock);
+    peak_bytes = live_bytes;
+    pthread_mutex_unlock(&stats_lock);
 }
 
 void *malloc_wrapper(size_t bytes)
 {
     check_and_load_libc();
-    typedef void* (*MALLOC)(size_t);
-    MALLOC malloc = (MALLOC) dlsym(libc_handle, LIBC_MALLOC_ORDINAL);
-    void *ptr = (*malloc)(bytes);
+    void *ptr = libc_malloc(bytes);
 
-    if (track_alloc)
-        new_alloc_list_node(ptr);
+    if (track_alloc && ptr != NULL)
+        tracker_add(ptr, bytes);
 
     return ptr;
 }
 
+/* Blocks are forgotten even while tracking is switched off, so that
+ * free_all_allocations never frees a block twice. */
 
 void *realloc_wrapper(void *ptr, size_t bytes)
 {
     check_and_load_libc();
-    typedef void* (*REALLOC)(void*, size_t);
-    REALLOC realloc = (REALLOC) dlsym(libc_handle, LIBC_REALLOC_ORDINAL);
-    void *realloc_ptr = (*realloc)(ptr, bytes);
+    size_t oldsize = 0;
+    bool tracked = false;
+
+    // Forget the old block first, another thread may be handed its
+    // address as soon as it is released.
+    if (ptr != NULL)
+        tracked = tracker_remove(ptr, &oldsize);
 
-    if (!track_alloc)
-        return realloc_ptr;
+    void *realloc_ptr = libc_realloc(ptr, bytes);
 
-    struct alloc_list_node *temp;
-    for(temp = alloc_chain_tail_ptr; ptr!= NULL && temp != NULL; temp = temp->prev)
+    if (realloc_ptr != NULL)
     {
-        if (temp->ptr == ptr)
-        {
-            temp->ptr = realloc_ptr;
-            break;
-        }
+        if (tracked || (track_alloc && ptr == NULL))
+            tracker_add(realloc_ptr, bytes);
     }
-    // If we didn't find it or if ptr was NULL in the first place,
-    // create a new node at the end of the chain
-    if (temp == NULL || ptr == NULL)
-            new_alloc_list_node(realloc_ptr);
+    else if (tracked && bytes != 0)
+        tracker_add(ptr, oldsize);    // The old block is still there
 
     return realloc_ptr;
 }
@@ -96,42 +269,46 @@ void *realloc_wrapper(void *ptr, size_t bytes)
 void free_wrapper(void *ptr)
 {
     check_and_load_libc();
-    typedef void* (*FREE)(void*);
-    FREE free = (FREE) dlsym(libc_handle, LIBC_FREE_ORDINAL);
-    (*free)(ptr);
+    size_t size;
 
-    if (!track_alloc)
-        return;
+    if (ptr != NULL)
+        tracker_remove(ptr, &size);
 
-    struct alloc_list_node *temp, *temp_next;
-    for(temp = alloc_chain_tail_ptr; temp != NULL; temp_next = temp, temp = temp->prev)
-    {
-        if (temp->ptr == ptr)
-        {
-            if (alloc_chain_tail_ptr == temp)
-                alloc_chain_tail_ptr = temp->prev;
-            else
-                temp_next->prev = temp->prev;
-            free(temp);
-            break;
-        }
-    }
+    libc_free(ptr);
 }
 
 /* This method is called by Py_Finalize to free all non-freed allocations */
 void free_all_allocations()
 {
-    if (track_alloc)
+    check_and_load_libc();
+    for (int s = 0; s < TRACKER_SEGMENTS; s++)
     {
-        while(alloc_chain_tail_ptr != NULL)
+        struct alloc_segment *seg = &segments[s];
+        pthread_mutex_lock(&seg->lock);
+        if (seg->slots != NULL)
         {
-            struct alloc_list_node *to_be_freed = alloc_chain_tail_ptr;
-            alloc_chain_tail_ptr = alloc_chain_tail_ptr->prev;
-            free(to_be_freed->ptr);
-            free(to_be_freed);
+            for (size_t i = 0; i <= seg->mask; i++)
+            {
+                void *ptr = seg->slots[i].ptr;
+                if (ptr != NULL && ptr != TRACKER_DELETED)
+                    libc_free(ptr);
+            }
+            libc_free(seg->slots);
         }
-    }    
-    dlclose(libc_handle);
+        seg->slots = NULL;
+        seg->mask = seg->used = seg->filled = 0;
+        pthread_mutex_unlock(&seg->lock);
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    live_count = live_bytes = peak_bytes = 0;
+    pthread_mutex_unlock(&stats_lock);
+
+    void *handle = libc_handle;
     libc_handle = NULL;
+    libc_malloc = NULL;
+    libc_realloc = NULL;
+    libc_free = NULL;
+    dlclose(handle);
 }
 }
@@ -0,0 +1,210 @@
+#! /usr/bin/env python
+
+"""Compare the allocator backends on the same workloads.
+
+Usage: allocbench.py [-n rounds] [-b backend,...] [workload ...]
+
+Every workload is run in a fresh interpreter for each backend, started
+with the PYTHONALLOCATOR environment variable naming it, since the
+allocator can only be chosen before Py_Initialize.  For each workload the table shows:
+
+  ops/s       allocations and releases per second, best of the rounds
+  peak        highest resident set size of the process, in KB
+  retained    the part of the memory the workload took that is still held
+              after it dropped 90% of its objects; 10% means no
+              fragmentation at all
+
+The backends are those known to SPy_SelectAllocator in
+Symbian/src/mem_alloc.c.  Builds where PyCore_MALLOC_FUNC is plain malloc
+ignore PYTHONALLOCATOR and report the same numbers for every backend.
+
+Where processes cannot be started (such as on the phone), run one
+backend by hand with --child and compare the numbers yourself.
+"""
+
+import sys, os, time, getopt
+
+BACKENDS = ['system', 'dlc', 'arena']
+KEEP_EVERY = 10             # objects kept alive out of the retained test
+
+### Workloads; each returns the number of objects created and the ones
+### still alive when it returns.
+
+def small_objects(n):
+    data = []
+    for i in xrange(n):
+        data.append((i, str(i), [i], {i: i}))
+    return 4 * n, data
+
+def strings(n):
+    # Sizes spread over the small, medium and large block ranges
+    data = []
+    for i in xrange(n):
+        data.append('x' * ((i * 37) % 20000))
+    return n, data
+
+def growing(n):
+    # Containers reallocated many times over as they grow
+    data = []
+    for i in xrange(n // 100):
+        l = []
+        d = {}
+        for j in xrange(100):
+            l.append(j)
+            d[j] = l
+        data.append((l, d))
+    return 2 * (n // 100), data
+
+def churn(n):
+    # Short lived objects interleaved with long lived ones
+    data = []
+    for i in xrange(n):
+        tmp = [str(i)] * (i % 50)
+        if i % 7 == 0:
+            data.append(tmp)
+    return n, data
+
+WORKLOADS = [
+    ('small', small_objects, 100000),
+    ('strings', strings, 2000),
+    ('growing', growing, 100000),
+    ('churn', churn, 100000),
+    ]
+
+### Memory figures, in KB; None where the platform does not tell
+
+def _status_field(name):
+    try:
+        f = open('/proc/self/status')
+    except IOError:
+        return None
+    try:
+        for line in f:
+            if line.startswith(name + ':'):
+                return int(line.split()[1])
+    finally:
+        f.close()
+    return None
+
+def current_rss():
+    return _status_field('VmRSS')
+
+def peak_rss():
+    peak = _status_field('VmHWM')
+    if peak is None:
+        try:
+            import resource
+        except ImportError:
+            return None
+        peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss or None
+    return peak
+
+### Measuring, in the child interpreter
+
+def measure(func, n, rounds):
+    # Fill the heap and let most of it go, leaving every KEEP_EVERYth
+    # object in place.  This comes first, while the process has not
+    # taken any memory for the workload yet.
+    base = current_rss()
+    ops, data = func(n)
+    top = current_rss()
+    data = data[::KEEP_EVERY]
+    after = current_rss()
+    del data
+    if base is None or top is None or after is None or top <= base:
+        retained = None
+    else:
+        retained = 100.0 * (after - base) / (top - base)
+
+    best = None
+    for i in range(rounds):
+        t = time.time()
+        ops, data = func(n)
+        del data
+        t = time.time() - t
+        if best is None or t < best:
+            best = t
+    ops_per_sec = ops * 2 / max(best, 1e-6)
+    return ops_per_sec, peak_rss(), retained
+
+def run_child(names, rounds):
+    for name, func, n in WORKLOADS:
+        if names and name not in names:
+            continue
+        print repr((name,) + measure(func, n, rounds))
+        sys.stdout.flush()
+
+### Driving the children and reporting
+
+def run_backend(backend, name, rounds):
+    import subprocess
+    env = os.environ.copy()
+    env['PYTHONALLOCATOR'] = backend
+    args = [sys.executable, os.path.abspath(__file__), '--child',
+            '-n', str(rounds), name]
+    p = subprocess.Popen(args, env=env, stdout=subprocess.PIPE)
+    output = p.communicate()[0]
+    if p.returncode:
+        raise RuntimeError('%s: exit status %d' % (backend, p.returncode))
+    return eval(output)[1:]
+
+def format_value(value, format):
+    if value is None:
+        return '-'
+    return format % value
+
+def report(table, backends, names):
+    print '%-10s %-8s %12s %10s %9s' % ('workload', 'backend', 'ops/s',
+                                        'peak KB', 'retained')
+    print '-' * 53
+    for name, func, n in WORKLOADS:
+        if names and name not in names:
+            continue
+        for backend in backends:
+            ops, peak, retained = table[backend][name]
+            print '%-10s %-8s %12s %10s %9s' % (
+                name, backend, format_value(ops, '%.0f'),
+                format_value(peak, '%d'), format_value(retained, '%.1f%%'))
+
+def usage(msg=None):
+    if msg:
+        print >>sys.stderr, msg
+    print >>sys.stderr, __doc__
+    sys.exit(2)
+
+def main():
+    try:
+        opts, names = getopt.getopt(sys.argv[1:], 'n:b:h', ['child'])
+    except getopt.error, msg:
+        usage(msg)
+    rounds = 3
+    backends = BACKENDS
+    child = False
+    for o, a in opts:
+        if o == '-n':
+            rounds = int(a)
+        elif o == '-b':
+            backends = a.split(',')
+        elif o == '--child':
+            child = True
+        else:
+            usage()
+    known = [w[0] for w in WORKLOADS]
+    for name in names:
+        if name not in known:
+            usage('unknown workload %r' % name)
+
+    if child:
+        run_child(names, rounds)
+        return
+    # A process of its own for each workload, so that one does not run in
+    # the memory another has left behind
+    table = {}
+    for backend in backends:
+        table[backend] = {}
+        for name in names or known:
+            table[backend][name] = run_backend(backend, name, rounds)
+    report(table, backends, names)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,102 @@
+#! /usr/bin/env python
+
+"""Measure how long a thread woken by I/O waits for the interpreter lock.
+
+Usage: ccbench.py [-t threads] [-d seconds] [-i interval]
+
+A latency thread blocks on one end of a socket pair; the main thread
+writes the current time to the other end every few milliseconds.  The
+latency is the time from the write until the latency thread has read it
+back, which is mostly the time it waits for the interpreter lock.  The
+test is repeated with 0 up to the given number of threads looping over
+pure Python code at the same time.  For each run the table shows:
+
+  avg, max    latency, in milliseconds
+  loops/s     iterations of the busy threads together, to show what the
+              latency thread costs them
+
+-i sets sys.setswitchinterval() first, in seconds, where there is one.
+With a plain interpreter lock, a busy thread keeps it across the switch
+points and the latency grows with the number of busy threads.
+"""
+
+import sys, time, getopt, socket, threading
+
+SEND_EVERY = 0.005          # seconds between messages
+
+def busy(counts, index, stop):
+    n = 0
+    while not stop:
+        for i in xrange(1000):
+            pass
+        n += 1
+    counts[index] = n
+
+def latency_thread(sock, latencies):
+    buf = ''
+    while True:
+        data = sock.recv(1024)
+        now = time.time()
+        if not data:
+            break
+        buf += data
+        while '\n' in buf:
+            line, buf = buf.split('\n', 1)
+            latencies.append(now - float(line))
+
+def run(nthreads, duration):
+    a, b = socket.socketpair()
+    latencies = []
+    counts = [0] * nthreads
+    stop = []
+    reader = threading.Thread(target=latency_thread, args=(b, latencies))
+    reader.start()
+    workers = [threading.Thread(target=busy, args=(counts, i, stop))
+               for i in range(nthreads)]
+    for w in workers:
+        w.start()
+    start = time.time()
+    while time.time() - start < duration:
+        a.sendall('%r\n' % time.time())
+        time.sleep(SEND_EVERY)
+    stop.append(1)
+    for w in workers:
+        w.join()
+    elapsed = time.time() - start
+    a.close()
+    reader.join()
+    b.close()
+    return latencies, sum(counts) / elapsed
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 't:d:i:')
+    except getopt.error, msg:
+        sys.exit('%s\n%s' % (msg, __doc__))
+    maxthreads = 2
+    duration = 2.0
+    for o, a in opts:
+        if o == '-t':
+            maxthreads = int(a)
+        elif o == '-d':
+            duration = float(a)
+        elif o == '-i':
+            if not hasattr(sys, 'setswitchinterval'):
+                sys.exit('this Python has no switch interval')
+            sys.setswitchinterval(float(a))
+    if hasattr(sys, 'getswitchinterval'):
+        print 'switch interval: %g ms' % (sys.getswitchinterval() * 1e3)
+    print 'check interval: %d instructions' % sys.getcheckinterval()
+    print
+    print '%-8s %10s %10s %12s' % ('threads', 'avg', 'max', 'loops/s')
+    for n in range(maxthreads + 1):
+        latencies, rate = run(n, duration)
+        if not latencies:
+            print '%-8d %10s %10s %12.0f' % (n, '-', '-', rate)
+            continue
+        avg = sum(latencies) / len(latencies)
+        print '%-8d %10.3f %10.3f %12.0f' % (n, avg * 1e3,
+                                             max(latencies) * 1e3, rate)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#! /usr/bin/env python
+
+"""Time conversions and division of long integers.
+
+Usage: longbench.py [-n repeat] [-s size[,size...]] [-t test[,test...]]
+
+Each test works on numbers of about the given sizes in decimal digits
+(default 1000,10000,100000,1000000):
+
+  str      str(x), decimal output
+  long     long(s), decimal input
+  divmod   divmod(x, y) for x of the given size and y of half of it
+  mul      x * y, the same operands, for scale
+
+The table shows the best of the repeats in milliseconds; sizes over
+100000 digits are timed once.  Going from 1000 to 1000000 digits,
+quadratic code takes a million times longer.
+"""
+
+import sys, time, getopt
+
+def number(ndigits, seed):
+    # A pseudo-random number with exactly ndigits decimal digits, made by
+    # parsing a string in a power of 2 base, which is quick at any size.
+    nbits = int(ndigits * 3.3219280948873622)
+    x = seed
+    chunks = []
+    for i in range(nbits // 60 + 1):
+        x = (x * 6364136223846793005L + 1442695040888963407L) % 2**64
+        chunks.append('%015x' % (x >> 4))
+    x = long(''.join(chunks), 16) >> (60 * len(chunks) - nbits)
+    ten = 10L ** (ndigits - 1)
+    while x >= 10 * ten:
+        x >>= 1
+    while x < ten:
+        x <<= 1
+    return x
+
+def setup(ndigits):
+    x = number(ndigits, 1)
+    y = number(max(ndigits // 2, 1), 2)
+    return {'x': x, 'y': y, 's': str(x)}
+
+TESTS = [
+    ('str', lambda d: str(d['x'])),
+    ('long', lambda d: long(d['s'])),
+    ('divmod', lambda d: divmod(d['x'], d['y'])),
+    ('mul', lambda d: d['x'] * d['y']),
+]
+
+def timed(func, arg, repeat):
+    best = None
+    for i in range(repeat):
+        t = time.time()
+        func(arg)
+        t = time.time() - t
+        if best is None or t < best:
+            best = t
+    return best
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'n:s:t:')
+    except getopt.error, msg:
+        sys.exit('%s\n%s' % (msg, __doc__))
+    repeat, sizes, names = 3, [1000, 10000, 100000, 1000000], None
+    for o, a in opts:
+        if o == '-n':
+            repeat = int(a)
+        elif o == '-s':
+            sizes = [int(s) for s in a.split(',')]
+        elif o == '-t':
+            names = a.split(',')
+
+    print '%-10s' % 'digits',
+    for size in sizes:
+        print '%12d' % size,
+    print
+    data = [setup(size) for size in sizes]
+    for name, func in TESTS:
+        if names and name not in names:
+            continue
+        print '%-10s' % name,
+        for d in data:
+            n = repeat
+            if len(d['s']) > 100000:
+                n = 1
+            print '%12.3f' % (timed(func, d, n) * 1e3),
+            sys.stdout.flush()
+        print
+
+if __name__ == '__main__':
+    main()
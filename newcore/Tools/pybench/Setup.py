@@ -37,3 +37,7 @@ try:
     from Unicode import *
 except (ImportError, SyntaxError):
     pass
+try:
+    from Threads import *
+except ImportError:
+    pass
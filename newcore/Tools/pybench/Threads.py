@@ -0,0 +1,61 @@
+from pybench import Test
+import thread
+
+class ThreadedAllocation(Test):
+
+    version = 2.0
+    operations = 4 * 10 * 5
+    rounds = 100000
+
+    def test(self):
+
+        class C(object):
+            __slots__ = ()
+
+        allocate_lock = thread.allocate_lock
+        def worker(n, done):
+            s, t, u = 'abc', 'de', 'fgh'
+            for i in xrange(n):
+                # Small strings and instances which have no free lists,
+                # allocated and freed right away
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+                a = s + t; b = C(); c = s + u; d = C(); e = t + u
+            done.release()
+
+        locks = []
+        for j in range(4):
+            done = allocate_lock()
+            done.acquire()
+            locks.append(done)
+            thread.start_new_thread(worker, (self.rounds, done))
+        for done in locks:
+            done.acquire()
+
+    def calibrate(self):
+
+        class C(object):
+            __slots__ = ()
+
+        allocate_lock = thread.allocate_lock
+        def worker(n, done):
+            s, t, u = 'abc', 'de', 'fgh'
+            for i in xrange(n):
+                pass
+            done.release()
+
+        locks = []
+        for j in range(4):
+            done = allocate_lock()
+            done.acquire()
+            locks.append(done)
+            thread.start_new_thread(worker, (self.rounds, done))
+        for done in locks:
+            done.acquire()
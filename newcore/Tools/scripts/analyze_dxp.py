@@ -0,0 +1,110 @@
+#! /usr/bin/env python
+"""Show which opcodes, and which pairs of opcodes, a program executes most.
+
+This needs a Python built with -DDYNAMIC_EXECUTION_PROFILE, and for the
+pairs also with -DDXPAIRS; sys.getdxp() then returns the counts.  The pairs
+are what to look at when choosing new superinstructions for compile.c.
+
+Usage: analyze_dxp.py [-n count] script.py [args]
+
+runs the script and prints the most common opcodes and pairs.  From
+another program, call render_common_opcodes() and render_common_pairs()
+after the code of interest has run.
+"""
+
+import os
+import sys
+import getopt
+import opcode
+
+if not hasattr(sys, "getdxp"):
+    raise RuntimeError("Can't import analyze_dxp: Python built without"
+                       " -DDYNAMIC_EXECUTION_PROFILE.")
+
+def has_pairs(profile):
+    """Tell whether the profile holds the counts of pairs (-DDXPAIRS)."""
+    return len(profile) > 0 and isinstance(profile[0], list)
+
+def snapshot_profile():
+    """Return the counts of executed opcodes so far."""
+    profile = sys.getdxp()
+    if has_pairs(profile):
+        # The last row counts the opcodes on their own
+        return profile[256]
+    return profile
+
+def opname(op):
+    return opcode.opname[op]
+
+def common_opcodes(profile=None):
+    """Return a list of (opcode, count) pairs, most frequent first."""
+    if profile is None:
+        profile = snapshot_profile()
+    elif has_pairs(profile):
+        profile = profile[256]
+    result = [(op, count) for op, count in enumerate(profile) if count]
+    result.sort(key=lambda x: x[1], reverse=True)
+    return result
+
+def common_pairs(profile=None):
+    """Return a list of ((opcode, next opcode), count), most frequent
+    first."""
+    if profile is None:
+        profile = sys.getdxp()
+    if not has_pairs(profile):
+        raise ValueError("Python was built without -DDXPAIRS")
+    result = []
+    for op1 in range(256):
+        row = profile[op1]
+        for op2 in range(256):
+            if row[op2]:
+                result.append(((op1, op2), row[op2]))
+    result.sort(key=lambda x: x[1], reverse=True)
+    return result
+
+def render_common_opcodes(profile=None, count=30):
+    lines = []
+    ops = common_opcodes(profile)
+    total = float(sum([c for op, c in ops])) or 1.0
+    for op, c in ops[:count]:
+        lines.append("%-24s %12d %6.2f%%\n" % (opname(op), c,
+                                               100 * c / total))
+    return "".join(lines)
+
+def render_common_pairs(profile=None, count=30):
+    lines = []
+    pairs = common_pairs(profile)
+    total = float(sum([c for p, c in pairs])) or 1.0
+    for (op1, op2), c in pairs[:count]:
+        lines.append("%-24s %-24s %12d %6.2f%%\n" % (opname(op1),
+                                                     opname(op2), c,
+                                                     100 * c / total))
+    return "".join(lines)
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "n:")
+    except getopt.error, msg:
+        sys.exit("%s\n%s" % (msg, __doc__))
+    count = 30
+    for o, a in opts:
+        if o == "-n":
+            count = int(a)
+    if not args:
+        sys.exit(__doc__)
+    sys.argv = args
+    # As if the script had been run on its own
+    sys.path[0] = os.path.dirname(os.path.abspath(args[0]))
+    try:
+        execfile(args[0], {"__name__": "__main__"})
+    except SystemExit:
+        pass
+    profile = sys.getdxp()
+    print "Most common opcodes:"
+    print render_common_opcodes(profile, count)
+    if has_pairs(profile):
+        print "Most common pairs:"
+        print render_common_pairs(profile, count)
+
+if __name__ == "__main__":
+    main()
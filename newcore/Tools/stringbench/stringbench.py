@@ -0,0 +1,121 @@
+#! /usr/bin/env python
+
+"""Time substring searches in str and unicode objects.
+
+Usage: stringbench.py [-n repeat] [-s size] [-t test[,test...]] [-u]
+
+Each test runs find, rfind, count, replace, split or partition on a
+haystack of about the given size in characters (default 256K):
+
+  log-*    lines of a web server log, searched for a field that is there
+           or a value that is not, the way scripts pick log files apart
+  prose-*  ordinary English text and words or phrases from it
+  patho-*  needles that nearly match all over the haystack, which take
+           a naive or Boyer-Moore style search quadratic time
+
+The table shows the best of the repeats in microseconds, for str and,
+with -u, for unicode as well.
+"""
+
+import sys, time, getopt
+
+def log_text(size):
+    lines = []
+    n = 0
+    i = 0
+    while n < size:
+        line = ('2008-11-%02d 12:%02d:%02d,%03d %s [worker-%d] GET '
+                '/api/v1/items?id=%d HTTP/1.1 200 %dms\n' %
+                (i % 30 + 1, i % 60, i * 7 % 60, i * 13 % 1000,
+                 ('INFO', 'DEBUG', 'WARN', 'INFO', 'INFO')[i % 5],
+                 i % 8, i * 37 % 10007, i % 97))
+        lines.append(line)
+        n += len(line)
+        i += 1
+    return ''.join(lines)[:size]
+
+PROSE = ("The quick brown fox jumps over the lazy dog, and then sits "
+         "down to read the morning paper (page 3, column 2).\n")
+
+def prose_text(size):
+    return (PROSE * (size // len(PROSE) + 1))[:size]
+
+def patho_text(size):
+    return 'a' * size
+
+# name, haystack, method, arguments
+TESTS = [
+    ('log-find-rare', log_text, 'find', ('ERROR',)),
+    ('log-find-char', log_text, 'find', ('#',)),
+    ('log-find-field', log_text, 'find', ('[worker-9]',)),
+    ('log-find-line', log_text, 'find',
+     ('12:00:00,000 WARN [worker-3] GET /api/v2/',)),
+    ('log-count-level', log_text, 'count', ('WARN',)),
+    ('log-count-lines', log_text, 'count', ('\n',)),
+    ('log-split-lines', log_text, 'split', ('\n',)),
+    ('log-split-field', log_text, 'split', (' HTTP/1.1 ',)),
+    ('log-partition', log_text, 'partition', ('id=9999 ',)),
+    ('log-rfind-field', log_text, 'rfind', ('[worker-9]',)),
+    ('log-replace', log_text, 'replace', ('HTTP/1.1', 'HTTP/1.0')),
+    ('prose-find-word', prose_text, 'find', ('cat',)),
+    ('prose-find-phrase', prose_text, 'find',
+     ('the quick brown fox jumps over',)),
+    ('prose-count-word', prose_text, 'count', ('the',)),
+    ('prose-replace', prose_text, 'replace', ('fox', 'cat')),
+    ('prose-rpartition', prose_text, 'rpartition', ('Fox',)),
+    ('patho-find-ab', patho_text, 'find', ('a' * 20 + 'b',)),
+    ('patho-find-aba', patho_text, 'find',
+     ('a' * 50 + 'b' + 'a' * 50,)),
+    ('patho-find-long', patho_text, 'find',
+     ('a' * 500 + 'b' + 'a' * 500,)),
+    ('patho-count-aba', patho_text, 'count',
+     ('a' * 50 + 'b' + 'a' * 50,)),
+    ('patho-rfind-ba', patho_text, 'rfind', ('b' + 'a' * 50,)),
+]
+
+def timed(func, repeat):
+    best = None
+    for i in range(repeat):
+        t = time.time()
+        func()
+        t = time.time() - t
+        if best is None or t < best:
+            best = t
+    return best
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'n:s:t:u')
+    except getopt.error, msg:
+        sys.exit('%s\n%s' % (msg, __doc__))
+    repeat, size, names, types = 5, 262144, None, (str,)
+    for o, a in opts:
+        if o == '-n':
+            repeat = int(a)
+        elif o == '-s':
+            size = int(a)
+        elif o == '-t':
+            names = a.split(',')
+        elif o == '-u':
+            types = (str, unicode)
+
+    print '%-20s %-10s' % ('test', 'method'),
+    for t in types:
+        print '%10s' % (t.__name__ + ' us'),
+    print
+    texts = {}
+    for name, make, method, args in TESTS:
+        if names and name not in names:
+            continue
+        if make not in texts:
+            texts[make] = make(size)
+        print '%-20s %-10s' % (name, method),
+        for t in types:
+            text = t(texts[make])
+            targs = tuple([t(a) for a in args])
+            func = getattr(text, method)
+            print '%10.1f' % (timed(lambda: func(*targs), repeat) * 1e6),
+        print
+
+if __name__ == '__main__':
+    main()
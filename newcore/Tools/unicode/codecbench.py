@@ -0,0 +1,101 @@
+#! /usr/bin/env python
+
+"""Measure the throughput of the UTF-8, Latin-1 and ASCII codecs.
+
+Usage: codecbench.py [-n repeat] [-s size] [-t text[,text...]]
+
+Each text is a line of ordinary prose or markup in one language or
+script.  It is timed repeated up to about the given size in characters
+(default 64K), and on its own, as the short strings that programs
+convert all the time (the "/1" rows).  Every codec that can handle a
+text is timed decoding and encoding it; the table shows the best of the
+repeats in megabytes of encoded data per second.
+"""
+
+import sys, time, getopt
+
+# Text in a few scripts, written with escapes to keep this file ASCII
+TEXTS = [
+    ('ascii', u"The quick brown fox jumps over the lazy dog, and then "
+              u"sits down to read the morning paper (page 3, column 2).\n"),
+    ('html', u'<p class="note">Status: <b>OK</b> \u2014 200 items, '
+             u'<a href="/list?page=2">next page</a></p>\n'),
+    ('latin1', u"Le c\xe9l\xe8bre ma\xeetre d'h\xf4tel a d\xe9j\xe0 "
+               u"re\xe7u la na\xefve b\xe9b\xe9 \xe0 No\xebl; "
+               u"Gr\xfc\xdfe aus K\xf6ln, se\xf1or.\n"),
+    ('mixed', u"Version 2.5 \u2014 \xa9 2008 Nokia. "
+              u"Caf\xe9 \u201cM\xfcnchen\u201d, "
+              u"\u0417\u0434\u0440\u0430\u0432\u0441\u0442\u0432\u0443\u0439"
+              u"\u0442\u0435! Price: 10 \u20ac\n"),
+    ('cyrillic', u"\u041c\u043e\u0441\u043a\u0432\u0430 \u2014 "
+                 u"\u0441\u0442\u043e\u043b\u0438\u0446\u0430 "
+                 u"\u0420\u043e\u0441\u0441\u0438\u0438, "
+                 u"\u043a\u0440\u0443\u043f\u043d\u0435"
+                 u"\u0439\u0448\u0438\u0439 "
+                 u"\u0433\u043e\u0440\u043e\u0434 "
+                 u"\u0441\u0442\u0440\u0430\u043d\u044b.\n"),
+    ('greek', u"\u0397 \u0391\u03b8\u03ae\u03bd\u03b1 "
+              u"\u03b5\u03af\u03bd\u03b1\u03b9 \u03b7 "
+              u"\u03c0\u03c1\u03c9\u03c4\u03b5\u03cd\u03bf\u03c5\u03c3\u03b1 "
+              u"\u03c4\u03b7\u03c2 "
+              u"\u0395\u03bb\u03bb\u03ac\u03b4\u03b1\u03c2.\n"),
+    ('cjk', u"\u5317\u4eac\u662f\u4e2d\u534e\u4eba\u6c11\u5171\u548c\u56fd"
+            u"\u7684\u9996\u90fd\u3002\u6771\u4eac\u306f\u65e5\u672c\u306e"
+            u"\u9996\u90fd\u3067\u3059\u3002\n"),
+]
+
+CODECS = ['utf-8', 'latin-1', 'ascii']
+
+def timed(func, arg, repeat, loops):
+    """Best time of repeat runs of loops calls of func(arg), per call"""
+    best = None
+    for i in range(repeat):
+        t = time.time()
+        for j in xrange(loops):
+            func(arg)
+        t = time.time() - t
+        if best is None or t < best:
+            best = t
+    return best / loops
+
+def rate(nbytes, seconds):
+    if seconds <= 0:
+        return '     -'
+    return '%6.1f' % (nbytes / seconds / 1e6)
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'n:s:t:')
+    except getopt.error, msg:
+        sys.exit('%s\n%s' % (msg, __doc__))
+    repeat, size, names = 5, 65536, None
+    for o, a in opts:
+        if o == '-n':
+            repeat = int(a)
+        elif o == '-s':
+            size = int(a)
+        elif o == '-t':
+            names = a.split(',')
+
+    print '%-10s %-8s %8s %8s %8s' % ('text', 'codec', 'bytes',
+                                     'dec MB/s', 'enc MB/s')
+    for name, para in TEXTS:
+        if names and name not in names:
+            continue
+        # the long text once, then the paragraph as often
+        pieces = max(size // len(para), 1)
+        for text, loops, label in ((para * pieces, 1, name),
+                                   (para, pieces, name + '/1')):
+            for codec in CODECS:
+                try:
+                    data = text.encode(codec)
+                except UnicodeError:
+                    continue
+                dec = timed(lambda s: s.decode(codec), data, repeat, loops)
+                enc = timed(lambda u: u.encode(codec), text, repeat, loops)
+                print '%-10s %-8s %8d %8s %8s' % (label, codec, len(data),
+                                                  rate(len(data), dec),
+                                                  rate(len(data), enc))
+
+if __name__ == '__main__':
+    main()